@@ -113,4 +113,94 @@
  */
 #define XIPFS_MAX_OPEN_DESC (16)
 
+/**
+ * @def XIPFS_BUFFER_SLOT_NUM
+ *
+ * @brief The number of flash pages the I/O buffer can hold at
+ * once. Each slot costs a flash page of RAM
+ */
+#define XIPFS_BUFFER_SLOT_NUM (2)
+
+/**
+ * @def XIPFS_PATH_INDEX_SIZE
+ *
+ * @brief The number of slots of each table of the in-RAM path
+ * index, which holds up to three quarters as many files and as
+ * many directories. Each slot costs 20 bytes of RAM on 32-bit
+ * targets. Zero disables the index and paths are then looked up
+ * by scanning the file system
+ */
+#define XIPFS_PATH_INDEX_SIZE (0)
+
+/**
+ * @def XIPFS_GC_WATERMARK
+ *
+ * @brief When XIPFS_GC_DEFERRED is non-zero, removed files
+ * keep their pages until the garbage collection reclaims them.
+ * It runs when a new file would leave fewer free pages than this
+ * number, or when it does not fit. Zero defers the collection as
+ * long as possible
+ */
+#define XIPFS_GC_WATERMARK (0)
+
+/**
+ * @def XIPFS_GC_DEFERRED
+ *
+ * @brief Non-zero to only mark a removed file, by clearing the
+ * first byte of its path, and to leave its pages to the garbage
+ * collection. Zero reclaims the pages of the removed files
+ * before the operation that removed them returns, as the marked
+ * files are not understood by earlier versions of xipfs. A file
+ * system mounted with zero reclaims the marked files it holds
+ */
+#define XIPFS_GC_DEFERRED (0)
+
+/**
+ * @def XIPFS_DIR_TABLE_SIZE
+ *
+ * @brief The number of directories of the directory table, at
+ * most 254. When non-zero, a file structure holds the identifier
+ * of its directory and its name within it instead of its whole
+ * path, and a file of the file system maps the identifiers to
+ * the directory names, so that renaming a directory rewrites no
+ * file. Each directory costs XIPFS_PATH_MAX bytes of RAM. Zero
+ * keeps whole paths in the file structures, the two layouts are
+ * not compatible
+ */
+#define XIPFS_DIR_TABLE_SIZE (0)
+
+/**
+ * @def XIPFS_PATH_SLOT_MAX
+ *
+ * @brief The maximum slot number for the list holding the paths
+ * a file was renamed to. A rename then programs the next free
+ * slot instead of rewriting the first page of the file, which
+ * only happens once every XIPFS_PATH_SLOT_MAX + 1 renames. Each
+ * slot costs XIPFS_PATH_MAX bytes of the first page of every
+ * file. Zero keeps the layout of the file structures unchanged,
+ * the layouts are not compatible
+ */
+#define XIPFS_PATH_SLOT_MAX (0)
+
+/**
+ * @def XIPFS_PACKED_FILE_MAX
+ *
+ * @brief The maximum size of a packed file, at most 1024. The
+ * packed files of a directory are records of the file that
+ * marks the directory, so that several small files share a
+ * single page. They are created with xipfs_new_packed_file and
+ * are read-only. Zero disables packed files
+ */
+#define XIPFS_PACKED_FILE_MAX (0)
+
+/**
+ * @def XIPFS_EMPTY_DIR_LOG
+ *
+ * @brief Non-zero to record the empty directories in a shared
+ * one page log rather than marking each of them with a file of
+ * its own. A directory then falls back to such a file only when
+ * the log is full. Zero disables the log
+ */
+#define XIPFS_EMPTY_DIR_LOG (0)
+
 #endif /* XIPFS_CONFIG_H */
@@ -41,14 +41,33 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Returns the new address of the xipfs file passed as
+ * the first argument, NULL if it was removed
+ */
+typedef xipfs_file_t *(*xipfs_desc_relocate_t)(xipfs_file_t *filp, void *arg);
+
+/**
+ * @brief Returns the new position of the packed file at the
+ * position passed as the first argument
+ */
+typedef xipfs_file_position_t (*xipfs_desc_repack_t)(xipfs_file_position_t packed, void *arg);
+
 int xipfs_file_desc_track(xipfs_file_desc_t *descp);
 int xipfs_dir_desc_track(xipfs_dir_desc_t *descp);
 int xipfs_file_desc_untrack(xipfs_file_desc_t *descp);
 int xipfs_dir_desc_untrack(xipfs_dir_desc_t *descp);
 int xipfs_file_desc_tracked(xipfs_file_desc_t *descp);
 int xipfs_dir_desc_tracked(xipfs_dir_desc_t *descp);
+int xipfs_map_track(xipfs_map_t *mapp);
+int xipfs_map_tracked(xipfs_map_t *mapp);
+int xipfs_map_untrack(xipfs_map_t *mapp);
 int xipfs_desc_untrack_all(xipfs_mount_t *mp);
-int xipfs_desc_update(xipfs_mount_t *mp, xipfs_file_t *removed, xipfs_file_position_t reserved);
+int xipfs_desc_update(xipfs_mount_t *mp, xipfs_desc_relocate_t relocate, void *arg);
+int xipfs_desc_move(xipfs_mount_t *mp, xipfs_file_t *from, xipfs_file_t *to);
+int xipfs_desc_repack(xipfs_mount_t *mp, xipfs_file_t *from, xipfs_file_t *to, xipfs_desc_repack_t repack, void *arg);
+int xipfs_desc_unpack(xipfs_mount_t *mp, xipfs_file_t *filp, xipfs_file_position_t packed);
+int xipfs_desc_truncate(xipfs_mount_t *mp, xipfs_file_t *filp, xipfs_file_position_t size);
 
 #ifdef __cplusplus
 }
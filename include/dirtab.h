@@ -0,0 +1,77 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+#ifndef XIPFS_DIRTAB_H
+#define XIPFS_DIRTAB_H
+
+#include "xipfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @def XIPFS_DIRTAB_ENTRY
+ *
+ * @brief The first character of the path of a file structure
+ * that holds the identifier of its directory and its name
+ */
+#define XIPFS_DIRTAB_ENTRY ('\x01')
+
+/**
+ * @def XIPFS_DIRTAB_TABLE
+ *
+ * @brief The path of the file structure that holds the
+ * directory table
+ */
+#define XIPFS_DIRTAB_TABLE ('\x02')
+
+int xipfs_dirtab_check(const char *path);
+int xipfs_dirtab_encode(xipfs_mount_t *mp, const char *path, char *raw);
+int xipfs_dirtab_fit(xipfs_mount_t *mp, const char *path);
+int xipfs_dirtab_is(const xipfs_file_t *filp, const char *path);
+void xipfs_dirtab_invalidate(const void *addr);
+int xipfs_dirtab_load(xipfs_mount_t *mp);
+void xipfs_dirtab_move(xipfs_file_t *from, xipfs_file_t *to);
+const char *xipfs_dirtab_path(const xipfs_file_t *filp, char *buf);
+int xipfs_dirtab_prepare(xipfs_mount_t *mp, const xipfs_file_spec_t specs[], size_t n);
+int xipfs_dirtab_rename(xipfs_mount_t *mp, const char *from, const char *to);
+int xipfs_dirtab_reserve(xipfs_mount_t *mp);
+int xipfs_dirtab_table(const xipfs_file_t *filp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XIPFS_DIRTAB_H */
@@ -41,6 +41,14 @@
 extern "C" {
 #endif
 
+/**
+ * @def XIPFS_FILE_EXEC_INSTALL
+ *
+ * @brief The execution right of a file being installed, which
+ * becomes 0 or 1 by clearing bits once the file is complete
+ */
+#define XIPFS_FILE_EXEC_INSTALL (3)
+
 extern char *xipfs_infos_file;
 
 int xipfs_file_erase(xipfs_file_t *filp);
@@ -50,14 +58,24 @@ int xipfs_file_safe_exec(xipfs_file_t *filp, char *const argv[],
                          const void *user_syscalls[XIPFS_SYSCALL_MAX]);
 int xipfs_file_filp_check(const xipfs_file_t *filp);
 xipfs_file_position_t xipfs_file_get_max_pos(const xipfs_file_t *filp);
+const char *xipfs_file_get_path(const xipfs_file_t *filp);
 xipfs_file_position_t xipfs_file_get_reserved(const xipfs_file_t *filp);
 xipfs_file_position_t xipfs_file_get_size(const xipfs_file_t *filp);
 xipfs_file_position_t xipfs_file_get_size_(const xipfs_file_t *filp);
+int xipfs_file_install_resume(xipfs_file_t *filp, xipfs_file_position_t *pos);
 int xipfs_file_path_check(const char *path);
+int xipfs_file_read(xipfs_file_t *filp, xipfs_file_position_t pos,
+                    void *dest, size_t len);
 int xipfs_file_read_8(xipfs_file_t *filp, xipfs_file_position_t pos, char *byte);
+int xipfs_file_readv(xipfs_file_t *filp, xipfs_file_position_t pos,
+                     const xipfs_iovec_t iov[], size_t len);
 int xipfs_file_rename(xipfs_file_t *filp, const char *to_path);
 int xipfs_file_set_size(xipfs_file_t *filp, xipfs_file_position_t size);
+int xipfs_file_write(xipfs_file_t *filp, xipfs_file_position_t pos,
+                     const void *src, size_t len);
 int xipfs_file_write_8(xipfs_file_t *filp, xipfs_file_position_t pos, char byte);
+int xipfs_file_writev(xipfs_file_t *filp, xipfs_file_position_t pos,
+                      const xipfs_iovec_t iov[], size_t len);
 
 #ifdef __cplusplus
 }
@@ -58,6 +58,7 @@ int xipfs_flash_is_erased_page(unsigned page);
 int xipfs_flash_overflow(const void *addr, size_t size);
 int xipfs_flash_page_aligned(const void *addr);
 int xipfs_flash_page_overflow(const void *addr, size_t size);
+void xipfs_flash_page_programmed(unsigned page);
 int xipfs_flash_write_32(void *dest, uint32_t src);
 int xipfs_flash_write_8(void *dest, uint8_t src);
 int xipfs_flash_write_unaligned(void *dest, const void *src, size_t n);
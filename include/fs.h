@@ -39,14 +39,26 @@
 extern "C" {
 #endif
 
+xipfs_file_t *xipfs_fs_copy(xipfs_mount_t *vfs_mp, xipfs_file_t *filp, const char *path);
+int xipfs_fs_file_count(xipfs_mount_t *vfs_mp);
 int xipfs_fs_format(xipfs_mount_t *vfs_mp);
 int xipfs_fs_free_pages(xipfs_mount_t *vfs_mp);
+int xipfs_fs_gc(xipfs_mount_t *vfs_mp);
+int xipfs_fs_gc_cost(xipfs_mount_t *vfs_mp, xipfs_file_t *filp);
+int xipfs_fs_gc_step(xipfs_mount_t *vfs_mp, size_t max_pages);
 int xipfs_fs_get_page_number(const xipfs_mount_t *vfs_mp);
 xipfs_file_t *xipfs_fs_head(xipfs_mount_t *vfs_mp);
+void xipfs_fs_invalidate(xipfs_mount_t *vfs_mp);
 xipfs_file_t *xipfs_fs_new_file(xipfs_mount_t *vfs_mp, const char *path, xipfs_file_position_t size, int exec);
+int xipfs_fs_new_files(xipfs_mount_t *vfs_mp, const xipfs_file_spec_t specs[], size_t n);
+xipfs_file_t *xipfs_fs_new_table(xipfs_mount_t *vfs_mp, char kind, int reclaim);
 xipfs_file_t *xipfs_fs_next(xipfs_file_t *filp);
-int xipfs_fs_remove(xipfs_file_t *dst);
+int xipfs_fs_remove(xipfs_mount_t *vfs_mp, xipfs_file_t *filp);
+int xipfs_fs_rename(xipfs_mount_t *vfs_mp, xipfs_file_t *filp, const char *to);
 int xipfs_fs_rename_all(xipfs_mount_t *vfs_mp, const char *from, const char *to);
+xipfs_file_t *xipfs_fs_resize(xipfs_mount_t *vfs_mp, xipfs_file_t *filp, xipfs_file_position_t size);
+xipfs_file_t *xipfs_fs_table(xipfs_mount_t *vfs_mp, char kind);
+int xipfs_fs_table_commit(xipfs_mount_t *vfs_mp, xipfs_file_t *filp, size_t size);
 xipfs_file_t *xipfs_fs_tail(xipfs_mount_t *vfs_mp);
 xipfs_file_t *xipfs_fs_tail_next(xipfs_mount_t *vfs_mp);
 
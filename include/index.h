@@ -0,0 +1,58 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+#ifndef XIPFS_INDEX_H
+#define XIPFS_INDEX_H
+
+#include "xipfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void xipfs_index_add(xipfs_file_t *filp);
+int xipfs_index_build(xipfs_mount_t *mp);
+xipfs_file_t *xipfs_index_dir(const char *path, size_t len, size_t *count);
+xipfs_file_t *xipfs_index_file(const char *path, size_t len);
+void xipfs_index_invalidate(const void *addr);
+void xipfs_index_move(xipfs_file_t *from, xipfs_file_t *to);
+int xipfs_index_ready(xipfs_mount_t *mp);
+void xipfs_index_remove(xipfs_file_t *filp);
+void xipfs_index_shift(xipfs_file_t *removed, xipfs_file_position_t reserved);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XIPFS_INDEX_H */
@@ -0,0 +1,57 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+#ifndef XIPFS_PACK_H
+#define XIPFS_PACK_H
+
+#include "xipfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int xipfs_pack_count(const xipfs_file_t *filp);
+const void *xipfs_pack_data(const xipfs_file_t *filp, xipfs_file_position_t packed, size_t *size);
+xipfs_file_position_t xipfs_pack_find(const xipfs_file_t *filp, const char *name);
+int xipfs_pack_fit(xipfs_mount_t *mp, const char *from, const char *to);
+xipfs_file_position_t xipfs_pack_list(const xipfs_file_t *filp, xipfs_file_position_t pos, char *name);
+int xipfs_pack_move(xipfs_mount_t *mp, const char *from, const char *to);
+int xipfs_pack_new(xipfs_mount_t *mp, xipfs_file_t *dirp, const char *path, const void *data, size_t size);
+int xipfs_pack_remove(xipfs_mount_t *mp, xipfs_file_t *dirp, xipfs_file_position_t packed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XIPFS_PACK_H */
@@ -127,6 +127,16 @@ typedef struct xipfs_path_s {
      * of the type of the xipfs path
      */
     xipfs_file_t *witness;
+    /**
+     * The xipfs file structure that marks the parent directory,
+     * holding its packed files, NULL if there is none
+     */
+    xipfs_file_t *dir;
+    /**
+     * The position of the packed file within the witness, -1
+     * if the xipfs path is not a packed file
+     */
+    xipfs_file_position_t packed;
     /**
      * The type of the xipfs path
      */
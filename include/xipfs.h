@@ -86,6 +86,112 @@
  */
 #define XIPFS_MAX_OPEN_DESC (16)
 
+#ifndef XIPFS_BUFFER_SLOT_NUM
+/**
+ * @def XIPFS_BUFFER_SLOT_NUM
+ *
+ * @brief The number of flash pages the I/O buffer can hold at
+ * once. Each slot costs a flash page of RAM
+ */
+#define XIPFS_BUFFER_SLOT_NUM (2)
+#endif /* !XIPFS_BUFFER_SLOT_NUM */
+
+#ifndef XIPFS_PATH_INDEX_SIZE
+/**
+ * @def XIPFS_PATH_INDEX_SIZE
+ *
+ * @brief The number of slots of each table of the in-RAM path
+ * index, which holds up to three quarters as many files and as
+ * many directories. Each slot costs 20 bytes of RAM on 32-bit
+ * targets. Zero disables the index and paths are then looked up
+ * by scanning the file system
+ */
+#define XIPFS_PATH_INDEX_SIZE (0)
+#endif /* !XIPFS_PATH_INDEX_SIZE */
+
+#ifndef XIPFS_GC_WATERMARK
+/**
+ * @def XIPFS_GC_WATERMARK
+ *
+ * @brief When XIPFS_GC_DEFERRED is non-zero, removed files
+ * keep their pages until the garbage collection reclaims them.
+ * It runs when a new file would leave fewer free pages than this
+ * number, or when it does not fit. Zero defers the collection as
+ * long as possible
+ */
+#define XIPFS_GC_WATERMARK (0)
+#endif /* !XIPFS_GC_WATERMARK */
+
+#ifndef XIPFS_GC_DEFERRED
+/**
+ * @def XIPFS_GC_DEFERRED
+ *
+ * @brief Non-zero to only mark a removed file, by clearing the
+ * first byte of its path, and to leave its pages to the garbage
+ * collection. Zero reclaims the pages of the removed files
+ * before the operation that removed them returns, as the marked
+ * files are not understood by earlier versions of xipfs. A file
+ * system mounted with zero reclaims the marked files it holds
+ */
+#define XIPFS_GC_DEFERRED (0)
+#endif /* !XIPFS_GC_DEFERRED */
+
+#ifndef XIPFS_DIR_TABLE_SIZE
+/**
+ * @def XIPFS_DIR_TABLE_SIZE
+ *
+ * @brief The number of directories of the directory table, at
+ * most 254. When non-zero, a file structure holds the identifier
+ * of its directory and its name within it instead of its whole
+ * path, and a file of the file system maps the identifiers to
+ * the directory names, so that renaming a directory rewrites no
+ * file. Each directory costs XIPFS_PATH_MAX bytes of RAM. Zero
+ * keeps whole paths in the file structures, the two layouts are
+ * not compatible
+ */
+#define XIPFS_DIR_TABLE_SIZE (0)
+#endif /* !XIPFS_DIR_TABLE_SIZE */
+
+#ifndef XIPFS_PATH_SLOT_MAX
+/**
+ * @def XIPFS_PATH_SLOT_MAX
+ *
+ * @brief The maximum slot number for the list holding the paths
+ * a file was renamed to. A rename then programs the next free
+ * slot instead of rewriting the first page of the file, which
+ * only happens once every XIPFS_PATH_SLOT_MAX + 1 renames. Each
+ * slot costs XIPFS_PATH_MAX bytes of the first page of every
+ * file. Zero keeps the layout of the file structures unchanged,
+ * the layouts are not compatible
+ */
+#define XIPFS_PATH_SLOT_MAX (0)
+#endif /* !XIPFS_PATH_SLOT_MAX */
+
+#ifndef XIPFS_PACKED_FILE_MAX
+/**
+ * @def XIPFS_PACKED_FILE_MAX
+ *
+ * @brief The maximum size of a packed file, at most 1024. The
+ * packed files of a directory are records of the file that
+ * marks the directory, so that several small files share a
+ * single page. They are created with xipfs_new_packed_file and
+ * are read-only. Zero disables packed files
+ */
+#define XIPFS_PACKED_FILE_MAX (0)
+#endif /* !XIPFS_PACKED_FILE_MAX */
+
+#ifndef XIPFS_EMPTY_DIR_LOG
+/**
+ * @def XIPFS_EMPTY_DIR_LOG
+ *
+ * @brief Non-zero to record the empty directories in a shared
+ * one page log rather than marking each of them with a file of
+ * its own. A directory then falls back to such a file only when
+ * the log is full. Zero disables the log
+ */
+#define XIPFS_EMPTY_DIR_LOG (0)
+#endif /* !XIPFS_EMPTY_DIR_LOG */
+
 #ifdef XIPFS_ENABLE_SAFE_EXEC_SUPPORT
 
 /**
@@ -194,6 +300,58 @@
 #error "xipfs_config.h: XIPFS_MAX_OPEN_DESC undefined"
 #endif /* !XIPFS_MAX_OPEN_DESC */
 
+#ifndef XIPFS_BUFFER_SLOT_NUM
+#error "xipfs_config.h: XIPFS_BUFFER_SLOT_NUM undefined"
+#endif /* !XIPFS_BUFFER_SLOT_NUM */
+
+#if XIPFS_BUFFER_SLOT_NUM < 1
+#error "xipfs_config.h: XIPFS_BUFFER_SLOT_NUM must be at least 1"
+#endif /* XIPFS_BUFFER_SLOT_NUM < 1 */
+
+#ifndef XIPFS_PATH_INDEX_SIZE
+#error "xipfs_config.h: XIPFS_PATH_INDEX_SIZE undefined"
+#endif /* !XIPFS_PATH_INDEX_SIZE */
+
+#ifndef XIPFS_GC_WATERMARK
+#error "xipfs_config.h: XIPFS_GC_WATERMARK undefined"
+#endif /* !XIPFS_GC_WATERMARK */
+
+#ifndef XIPFS_GC_DEFERRED
+#error "xipfs_config.h: XIPFS_GC_DEFERRED undefined"
+#endif /* !XIPFS_GC_DEFERRED */
+
+#ifndef XIPFS_DIR_TABLE_SIZE
+#error "xipfs_config.h: XIPFS_DIR_TABLE_SIZE undefined"
+#endif /* !XIPFS_DIR_TABLE_SIZE */
+
+#if XIPFS_DIR_TABLE_SIZE > 254
+#error "xipfs_config.h: XIPFS_DIR_TABLE_SIZE must be at most 254"
+#endif /* XIPFS_DIR_TABLE_SIZE > 254 */
+
+#ifndef XIPFS_PATH_SLOT_MAX
+#error "xipfs_config.h: XIPFS_PATH_SLOT_MAX undefined"
+#endif /* !XIPFS_PATH_SLOT_MAX */
+
+#if XIPFS_PATH_SLOT_MAX < 0
+#error "xipfs_config.h: XIPFS_PATH_SLOT_MAX must be positive or zero"
+#endif /* XIPFS_PATH_SLOT_MAX < 0 */
+
+#ifndef XIPFS_PACKED_FILE_MAX
+#error "xipfs_config.h: XIPFS_PACKED_FILE_MAX undefined"
+#endif /* !XIPFS_PACKED_FILE_MAX */
+
+#if XIPFS_PACKED_FILE_MAX < 0 || XIPFS_PACKED_FILE_MAX > 1024
+#error "xipfs_config.h: XIPFS_PACKED_FILE_MAX must be between 0 and 1024"
+#endif /* XIPFS_PACKED_FILE_MAX < 0 || XIPFS_PACKED_FILE_MAX > 1024 */
+
+#ifndef XIPFS_EMPTY_DIR_LOG
+#error "xipfs_config.h: XIPFS_EMPTY_DIR_LOG undefined"
+#endif /* !XIPFS_EMPTY_DIR_LOG */
+
+#if XIPFS_EMPTY_DIR_LOG < 0
+#error "xipfs_config.h: XIPFS_EMPTY_DIR_LOG must be positive or zero"
+#endif /* XIPFS_EMPTY_DIR_LOG < 0 */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -270,6 +428,15 @@ typedef struct xipfs_file_s {
      * Execution right
      */
     uint32_t exec;
+#if XIPFS_PATH_SLOT_MAX > 0
+    /**
+     * The table lists the paths the file was renamed to, with
+     * the last entry reflecting the current path of the file,
+     * or path if the table is empty. This method helps to avoid
+     * flashing the flash page every time the file is renamed
+     */
+    char path_slot[XIPFS_PATH_SLOT_MAX][XIPFS_PATH_MAX];
+#endif /* XIPFS_PATH_SLOT_MAX > 0 */
     /**
      * First byte of the file's data
      */
@@ -283,23 +450,132 @@ typedef struct xipfs_mount_s {
     void *page_addr;
     mutex_t *execution_mutex;
     mutex_t *mutex;
+    /**
+     * The last file of the file system, NULL if there is no
+     * file. Managed by xipfs, valid only if cached is set
+     */
+    xipfs_file_t *tail;
+    /**
+     * The number of files of the file system. Managed by
+     * xipfs, valid only if cached is set
+     */
+    size_t file_count;
+    /**
+     * The number of NVM pages reserved by the files. Managed
+     * by xipfs, valid only if cached is set
+     */
+    size_t used_pages;
+    /**
+     * The number of NVM pages reserved by removed files, which
+     * the garbage collection reclaims. Managed by xipfs, valid
+     * only if cached is set
+     */
+    size_t dead_pages;
+    /**
+     * Non-zero if the fields above reflect the file system,
+     * they are computed again by walking the files otherwise
+     */
+    int cached;
+    /**
+     * The removed file in front of the file being moved by the
+     * incremental garbage collection, NULL if there is none.
+     * Managed by xipfs
+     */
+    xipfs_file_t *gc_hole;
+    /**
+     * The file being moved by the incremental garbage
+     * collection. Managed by xipfs
+     */
+    xipfs_file_t *gc_file;
+    /**
+     * The number of pages of the file being moved, past its
+     * first one, already copied. Managed by xipfs
+     */
+    size_t gc_pages;
 } xipfs_mount_t;
 
 typedef struct xipfs_dir_desc_s {
     xipfs_file_t *filp;
     char dirname[XIPFS_PATH_MAX];
+    /**
+     * The position of the next packed file to list when filp
+     * marks the directory, -1 until the first one is listed
+     */
+    xipfs_file_position_t packed;
+    /**
+     * The position of the next record of the log of the empty
+     * directories to list once the files are listed, -1 once
+     * all of them are
+     */
+    xipfs_file_position_t empty;
 } xipfs_dir_desc_t;
 
 typedef struct xipfs_file_desc_s {
     xipfs_file_t *filp;
     xipfs_file_position_t pos;
     int flags;
+    /**
+     * The end of the bytes written with xipfs_pwrite, which does
+     * not move pos. Like pos, it becomes the size of the file when
+     * the file is closed or synchronised
+     */
+    xipfs_file_position_t end;
+    /**
+     * The position of the packed file within filp, which then
+     * marks its directory, -1 if the file is not packed
+     */
+    xipfs_file_position_t packed;
 } xipfs_file_desc_t;
 
+/**
+ * @brief A read-only mapping of the content of a file, tracked
+ * like the open descriptors. The garbage collection and the
+ * resize of a file update its address, which thus must be read
+ * again after such an operation, and a removal of the file sets
+ * it to NULL
+ */
+typedef struct xipfs_map_s {
+    /**
+     * The xipfs file holding the mapped bytes, NULL once it is
+     * removed. Managed by xipfs
+     */
+    xipfs_file_t *filp;
+    /**
+     * The position of the packed file within filp, -1 if the
+     * file is not packed. Managed by xipfs
+     */
+    xipfs_file_position_t packed;
+    /**
+     * The address of the first mapped byte
+     */
+    const void *addr;
+    /**
+     * The number of mapped bytes
+     */
+    size_t len;
+} xipfs_map_t;
+
 typedef struct xipfs_dirent_s {
     char dirname[XIPFS_PATH_MAX];
 } xipfs_dirent_t;
 
+/**
+ * @brief Description of a file to create with xipfs_new_files
+ */
+typedef struct xipfs_file_spec_s {
+    const char *path;           /**< The path of the file. */
+    xipfs_file_position_t size; /**< The size to reserve. */
+    uint32_t exec;              /**< Execution right. */
+} xipfs_file_spec_t;
+
+/**
+ * @brief A segment of a vectored read or write
+ */
+typedef struct xipfs_iovec_s {
+    void *base; /**< The first byte of the segment. */
+    size_t len; /**< The number of bytes of the segment. */
+} xipfs_iovec_t;
+
 struct xipfs_statvfs {
     unsigned long f_bsize;   /**< File system block size. */
     unsigned long f_frsize;  /**< Fundamental file system block size. */
@@ -312,6 +588,28 @@ struct xipfs_statvfs {
     unsigned long f_namemax; /**< Maximum filename length. */
 };
 
+/**
+ * @brief Statistics of the xipfs I/O buffer, used to size
+ * XIPFS_BUFFER_SLOT_NUM
+ *
+ * Only writes are accounted for in hits, misses and evictions,
+ * since reads never load a flash page into the I/O buffer, and
+ * writes to erased flash are streams rather than hits or misses
+ */
+typedef struct xipfs_buffer_stats_s {
+    unsigned long hits;      /**< Writes to an already buffered
+                                  flash page. */
+    unsigned long misses;    /**< Writes that had to load a flash
+                                  page into a slot. */
+    unsigned long evictions; /**< Misses that had to evict a
+                                  buffered flash page. */
+    unsigned long erases;    /**< Flash pages erased by flushes. */
+    unsigned long programmed_words; /**< 32-bit words programmed
+                                         by flushes and streams. */
+    unsigned long streams;   /**< Writes programmed straight into
+                                  erased flash. */
+} xipfs_buffer_stats_t;
+
 /**
  * @brief Translate the given page number into the page's
  * starting address
@@ -372,12 +670,25 @@ unsigned xipfs_nvm_page(const void *addr);
  */
 void xipfs_nvm_write(void *target_addr, const void *data, size_t len);
 
+/**
+ * @brief Copies the statistics of the xipfs I/O buffer
+ *
+ * @param[out] stats statistics since the last reset
+ */
+void xipfs_buffer_stats(xipfs_buffer_stats_t *stats);
+
+/**
+ * @brief Resets the statistics of the xipfs I/O buffer
+ */
+void xipfs_buffer_stats_reset(void);
+
 /*
  * xipfs system calls
  */
 
 int xipfs_close(xipfs_mount_t *mp, xipfs_file_desc_t *descp);
 int xipfs_closedir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp);
+int xipfs_copy(xipfs_mount_t *mp, const char *from, const char *to);
 
 /**
  * @warning The order of the members in the enumeration must
@@ -420,24 +731,42 @@ int xipfs_execv(xipfs_mount_t *mp, const char *full_path, char *const argv[],
 int xipfs_safe_execv(xipfs_mount_t *mp, const char *full_path, char *const argv[],
                      const void *user_syscalls[XIPFS_SYSCALL_MAX]);
 
+int xipfs_fallocate(xipfs_mount_t *mp, xipfs_file_desc_t *descp, off_t offset, off_t len);
 int xipfs_format(xipfs_mount_t *mp);
 int xipfs_fstat(xipfs_mount_t *mp, xipfs_file_desc_t *descp, struct stat *buf);
 int xipfs_fsync(xipfs_mount_t *mp, xipfs_file_desc_t *descp, off_t pos);
+int xipfs_ftruncate(xipfs_mount_t *mp, xipfs_file_desc_t *descp, off_t length);
+int xipfs_gc(xipfs_mount_t *mp);
+int xipfs_gc_step(xipfs_mount_t *mp, size_t max_pages);
+int xipfs_install_commit(xipfs_mount_t *mp, xipfs_file_desc_t *descp);
+int xipfs_install_finish(xipfs_mount_t *mp, xipfs_file_desc_t *descp, uint32_t exec);
+off_t xipfs_install_open(xipfs_mount_t *mp, xipfs_file_desc_t *descp, const char *path, xipfs_file_position_t size);
 off_t xipfs_lseek(xipfs_mount_t *mp, xipfs_file_desc_t *descp, off_t off, int whence);
 int xipfs_mkdir(xipfs_mount_t *mp, const char *name, mode_t mode);
+int xipfs_mmap(xipfs_mount_t *mp, xipfs_file_desc_t *descp, off_t offset, xipfs_map_t *mapp);
 int xipfs_mount(xipfs_mount_t *mp);
+int xipfs_munmap(xipfs_mount_t *mp, xipfs_map_t *mapp);
 int xipfs_new_file(xipfs_mount_t *mp, const char *path, xipfs_file_position_t size, uint32_t exec);
+int xipfs_new_files(xipfs_mount_t *mp, const xipfs_file_spec_t specs[], size_t n);
+int xipfs_new_packed_file(xipfs_mount_t *mp, const char *path, const void *buf, size_t size);
 int xipfs_open(xipfs_mount_t *mp, xipfs_file_desc_t *descp, const char *name, int flags, mode_t mode);
 int xipfs_opendir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp, const char *dirname);
+ssize_t xipfs_pread(xipfs_mount_t *mp, xipfs_file_desc_t *descp, void *dest, size_t nbytes, off_t offset);
+ssize_t xipfs_pwrite(xipfs_mount_t *mp, xipfs_file_desc_t *descp, const void *src, size_t nbytes, off_t offset);
 ssize_t xipfs_read(xipfs_mount_t *mp, xipfs_file_desc_t *descp, void *dest, size_t nbytes);
 int xipfs_readdir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp, xipfs_dirent_t *direntp);
+ssize_t xipfs_readv(xipfs_mount_t *mp, xipfs_file_desc_t *descp, const xipfs_iovec_t iov[], int iovcnt);
 int xipfs_rename(xipfs_mount_t *mp, const char *from_path, const char *to_path);
 int xipfs_rmdir(xipfs_mount_t *mp, const char *name);
+int xipfs_rmdir_all(xipfs_mount_t *mp, const char *name);
 int xipfs_stat(xipfs_mount_t *mp, const char *path, struct stat *buf);
 int xipfs_statvfs(xipfs_mount_t *mp, const char *restrict path, struct xipfs_statvfs *restrict buf);
 int xipfs_umount(xipfs_mount_t *mp);
 int xipfs_unlink(xipfs_mount_t *mp, const char *name);
+int xipfs_unlink_cost(xipfs_mount_t *mp, const char *name);
+int xipfs_unlink_many(xipfs_mount_t *mp, const char *const names[], size_t count);
 ssize_t xipfs_write(xipfs_mount_t *mp, xipfs_file_desc_t *descp, const void *src, size_t nbytes);
+ssize_t xipfs_writev(xipfs_mount_t *mp, xipfs_file_desc_t *descp, const xipfs_iovec_t iov[], int iovcnt);
 
 #ifdef XIPFS_ENABLE_SAFE_EXEC_SUPPORT
 
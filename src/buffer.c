@@ -49,9 +49,17 @@
 /**
  * @internal
  *
- * @brief An enumeration that describes the state of the buffer
+ * @brief An enumeration that describes the state of a buffer
+ * slot
+ *
+ * @warning XIPFS_BUFFER_KO must remain the first member so that
+ * zero-initialized slots are invalid
  */
 typedef enum xipfs_buffer_state_e {
+    /**
+     *  An invalid buffer state
+     */
+    XIPFS_BUFFER_KO,
     /**
      * A valid buffer state
      */
@@ -60,20 +68,16 @@ typedef enum xipfs_buffer_state_e {
      * A valid buffer state with RAM writes not commited to flash.
      */
     XIPFS_BUFFER_DIRTY,
-    /**
-     *  An invalid buffer state
-     */
-    XIPFS_BUFFER_KO,
 } xipfs_buffer_state_t;
 
 /**
  * @internal
  *
- * @brief A structure that describes xipfs buffer
+ * @brief A structure that describes a slot of the xipfs buffer
  */
 typedef struct xipfs_buf_s {
     /**
-     * The state of the buffer
+     * The state of the buffer slot
      */
     xipfs_buffer_state_t state;
     /**
@@ -88,121 +92,400 @@ typedef struct xipfs_buf_s {
      * The flash page address loaded into the I/O buffer
      */
     const char *page_addr;
+    /**
+     * The value of the access clock when the slot was last used,
+     * the slot with the lowest value is evicted first
+     */
+    unsigned long last_use;
 } xipfs_buf_t;
 
 /**
  * @internal
  *
- * @brief The buffer used by xipfs
+ * @brief The buffer slots used by xipfs
+ */
+static xipfs_buf_t xipfs_buf[XIPFS_BUFFER_SLOT_NUM];
+
+/**
+ * @internal
+ *
+ * @brief A structure that describes the partial write block left
+ * by a write streamed straight into erased flash, kept in RAM
+ * until it is complete or flushed
+ */
+typedef struct xipfs_buf_tail_s {
+    /**
+     * The write block
+     */
+    char block[XIPFS_NVM_WRITE_BLOCK_SIZE] __attribute__ ((aligned(XIPFS_NVM_WRITE_BLOCK_ALIGNMENT)));
+    /**
+     * The flash address of the write block, NULL if there is no
+     * partial write block
+     */
+    char *addr;
+    /**
+     * The number of leading bytes of the write block that are
+     * up to date
+     */
+    size_t len;
+} xipfs_buf_tail_t;
+
+/**
+ * @internal
+ *
+ * @brief The partial write block of the last streamed write
+ */
+static xipfs_buf_tail_t xipfs_buf_tail;
+
+/**
+ * @internal
+ *
+ * @brief The access clock of the buffer slots
+ */
+static unsigned long xipfs_buffer_clock;
+
+/**
+ * @internal
+ *
+ * @brief The statistics of the buffer slots
  */
-static xipfs_buf_t xipfs_buf = {
-    .state = XIPFS_BUFFER_KO,
-};
+static xipfs_buffer_stats_t xipfs_buffer_statistics;
 
 /**
  * @internal
  *
  * @pre num must be a valid flash page number
  *
- * @brief Check whether the page passed as an argument is the
- * same as the one in the buffer
+ * @brief Looks for the buffer slot holding a flash page
  *
  * @param num A flash page number
  *
- * @return Returns one if the page passed as an argument is the
- * same as the one in the buffer or a zero otherwise
+ * @return Returns a pointer to the buffer slot holding the page
+ * or NULL if the page is not buffered
  */
-static int
-xipfs_buffer_page_changed(unsigned num)
+static xipfs_buf_t *
+xipfs_buffer_lookup(unsigned num)
 {
-    return xipfs_buf.page_num != num;
+    size_t i;
+
+    for (i = 0; i < XIPFS_BUFFER_SLOT_NUM; i++) {
+        if (xipfs_buf[i].state != XIPFS_BUFFER_KO &&
+            xipfs_buf[i].page_num == num) {
+            return &xipfs_buf[i];
+        }
+    }
+
+    return NULL;
 }
 
 /**
  * @internal
  *
- * @brief Checks whether the I/O buffer requires flushing
+ * @pre slot must be a pointer to a valid buffer slot
+ *
+ * @brief Programs in place the words of a buffer slot that
+ * differ from flash, rounding each run of modified words to the
+ * flash write block size
  *
- * @return Returns one if the buffer requires flushing or a
- * zero otherwise
+ * @param slot A pointer to the buffer slot to program
  */
-static inline int
-xipfs_buffer_need_flush(void)
+static void
+xipfs_buffer_slot_program(xipfs_buf_t *slot)
 {
-    return (xipfs_buf.state == XIPFS_BUFFER_DIRTY);
+    const uint32_t *flash, *ram;
+    size_t i, start, end, words;
+
+    flash = (const uint32_t *)(uintptr_t)slot->page_addr;
+    ram = (const uint32_t *)(uintptr_t)slot->buf;
+    words = XIPFS_NVM_PAGE_SIZE / sizeof(*ram);
+    i = 0;
+    while (i < words) {
+        if (flash[i] == ram[i]) {
+            i++;
+            continue;
+        }
+        start = i;
+        while (i < words && flash[i] != ram[i]) {
+            i++;
+        }
+        start *= sizeof(*ram);
+        start -= start % XIPFS_NVM_WRITE_BLOCK_SIZE;
+        end = i * sizeof(*ram);
+        end += (XIPFS_NVM_WRITE_BLOCK_SIZE - end % XIPFS_NVM_WRITE_BLOCK_SIZE) %
+            XIPFS_NVM_WRITE_BLOCK_SIZE;
+        xipfs_nvm_write((void *)(uintptr_t)&slot->page_addr[start],
+            &slot->buf[start], end - start);
+        xipfs_buffer_statistics.programmed_words +=
+            (end - start) / sizeof(*ram);
+    }
 }
 
 /**
  * @internal
  *
- * @brief Flushes the I/O buffer
+ * @brief Programs the partial write block of the last streamed
+ * write, its bytes past the written ones keeping their value in
+ * flash
  *
  * @return Returns zero if the function succeeds or a negative
  * value otherwise
  */
-int
-xipfs_buffer_flush(void)
+static int
+xipfs_buffer_tail_flush(void)
 {
-    size_t i = 0;
-    unsigned int flash_value;
+    char *addr;
 
-    if (xipfs_buf.state != XIPFS_BUFFER_DIRTY) {
+    if ((addr = xipfs_buf_tail.addr) == NULL) {
+        return 0;
+    }
+    xipfs_buf_tail.addr = NULL;
+    xipfs_flash_page_programmed(xipfs_nvm_page(addr));
+    xipfs_nvm_write(addr, xipfs_buf_tail.block, XIPFS_NVM_WRITE_BLOCK_SIZE);
+    xipfs_buffer_statistics.programmed_words +=
+        XIPFS_NVM_WRITE_BLOCK_SIZE / sizeof(uint32_t);
+    if (memcmp(addr, xipfs_buf_tail.block, XIPFS_NVM_WRITE_BLOCK_SIZE) != 0) {
+        xipfs_errno = XIPFS_ENVMC;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre slot must be a pointer to a buffer slot
+ *
+ * @brief Flushes a buffer slot
+ *
+ * The slot is compared with flash word by word. Nothing is
+ * written if the page did not change. If every change only
+ * clears bits, the modified words are programmed in place.
+ * The page is erased and fully reprogrammed only when a bit has
+ * to be set back to its erased state
+ *
+ * @param slot A pointer to the buffer slot to flush
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_buffer_slot_flush(xipfs_buf_t *slot)
+{
+    const uint32_t *flash, *ram;
+    int changed = 0, erase = 0;
+    size_t i;
+
+    if (slot->state != XIPFS_BUFFER_DIRTY) {
         /* no need to flush the buffer */
         return 0;
     }
 
-    // Is a flashpage erase needed ?
-    for (i = 0; i < (XIPFS_NVM_PAGE_SIZE / sizeof(flash_value)); ++i) {
-        if ( ((~xipfs_buf.page_addr[i]) & xipfs_buf.buf[i]) != 0 ) {
-            if (xipfs_flash_erase_page(xipfs_buf.page_num) < 0) {
-                /* xipfs_errno was set */
-                return -1;
+    flash = (const uint32_t *)(uintptr_t)slot->page_addr;
+    ram = (const uint32_t *)(uintptr_t)slot->buf;
+    for (i = 0; i < XIPFS_NVM_PAGE_SIZE / sizeof(*ram); i++) {
+        if (flash[i] != ram[i]) {
+            changed = 1;
+            if ((~flash[i] & ram[i]) != 0) {
+                erase = 1;
+                break;
             }
+        }
+    }
 
-            break;
+    if (erase == 1) {
+        /* flashpage_write_and_verify erases the page first */
+        xipfs_buffer_statistics.erases++;
+        xipfs_buffer_statistics.programmed_words +=
+            XIPFS_NVM_PAGE_SIZE / sizeof(*ram);
+        xipfs_flash_page_programmed(slot->page_num);
+        if (flashpage_write_and_verify(slot->page_num, slot->buf) != FLASHPAGE_OK) {
+            xipfs_errno = XIPFS_ENVMC;
+            return -1;
+        }
+    } else if (changed == 1) {
+        xipfs_flash_page_programmed(slot->page_num);
+        xipfs_buffer_slot_program(slot);
+        if (memcmp(slot->page_addr, slot->buf, XIPFS_NVM_PAGE_SIZE) != 0) {
+            xipfs_errno = XIPFS_ENVMC;
+            return -1;
         }
     }
 
-    if(flashpage_write_and_verify(xipfs_buf.page_num, xipfs_buf.buf) != FLASHPAGE_OK) {
+    slot->state = XIPFS_BUFFER_OK;
+
+    return 0;
+}
+
+/**
+ * @brief Flushes the partial write block of the last streamed
+ * write, then all the dirty slots of the I/O buffer, in
+ * ascending flash page order
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_buffer_flush(void)
+{
+    xipfs_buf_t *slot;
+    size_t i;
+
+    if (xipfs_buffer_tail_flush() < 0) {
+        /* xipfs_errno was set */
         return -1;
     }
+    for (;;) {
+        slot = NULL;
+        for (i = 0; i < XIPFS_BUFFER_SLOT_NUM; i++) {
+            if (xipfs_buf[i].state == XIPFS_BUFFER_DIRTY &&
+                (slot == NULL || xipfs_buf[i].page_num < slot->page_num)) {
+                slot = &xipfs_buf[i];
+            }
+        }
+        if (slot == NULL) {
+            /* no slot left to flush */
+            return 0;
+        }
+        if (xipfs_buffer_slot_flush(slot) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief Drops the content of the I/O buffer without writing it
+ * back to flash
+ *
+ * This function must be called whenever flash pages are
+ * modified without going through the I/O buffer, so that it
+ * does not serve or write back outdated bytes
+ */
+void
+xipfs_buffer_invalidate(void)
+{
+    size_t i;
 
-    xipfs_buf.state = XIPFS_BUFFER_OK;
+    for (i = 0; i < XIPFS_BUFFER_SLOT_NUM; i++) {
+        xipfs_buf[i].state = XIPFS_BUFFER_KO;
+    }
+    xipfs_buf_tail.addr = NULL;
+}
 
-    return 0;
+/**
+ * @brief Copies the statistics of the I/O buffer
+ *
+ * @param stats A pointer to a memory region where to store the
+ * statistics
+ */
+void
+xipfs_buffer_stats(xipfs_buffer_stats_t *stats)
+{
+    assert(stats != NULL);
+
+    *stats = xipfs_buffer_statistics;
+}
+
+/**
+ * @brief Resets the statistics of the I/O buffer
+ */
+void
+xipfs_buffer_stats_reset(void)
+{
+    (void)memset(&xipfs_buffer_statistics, 0,
+        sizeof(xipfs_buffer_statistics));
 }
 
 /**
  * @internal
  *
+ * @pre slot must be a pointer to a buffer slot
+ *
  * @pre num must be a valid flash page number
  *
  * @pre addr must be a valid flash page address
  *
- * @brief Loads a flash page into the I/O buffer
+ * @brief Loads a flash page into a buffer slot
  *
- * @param num The number of the flash page to load into the I/O
- * buffer
+ * @param slot A pointer to the buffer slot to load
+ *
+ * @param num The number of the flash page to load into the
+ * buffer slot
  *
  * @param addr The address of the flash page to load into the
- * I/O buffer
+ * buffer slot
  */
 static void
-xipfs_buffer_load(unsigned num, const void *addr)
+xipfs_buffer_load(xipfs_buf_t *slot, unsigned num, const void *addr)
 {
-    size_t i;
+    (void)memcpy(slot->buf, addr, XIPFS_NVM_PAGE_SIZE);
+    slot->page_num = num;
+    slot->page_addr = addr;
+    slot->state = XIPFS_BUFFER_OK;
+}
 
-    for (i = 0; i < XIPFS_NVM_PAGE_SIZE; i++) {
-        xipfs_buf.buf[i] = ((const char *)addr)[i];
+/**
+ * @internal
+ *
+ * @pre ptr must be a valid flash address
+ *
+ * @pre The n bytes starting at ptr must not overflow the flash
+ * page pointed to by ptr
+ *
+ * @brief Copies n bytes of a single flash page, taking them
+ * from the buffer slot holding this page if it is dirty, or
+ * straight from the memory-mapped flash and the partial write
+ * block otherwise
+ *
+ * @param dest A pointer to an accessible memory region where to
+ * store the read bytes
+ *
+ * @param ptr A pointer to the flash bytes to read
+ *
+ * @param n The number of bytes to read
+ */
+static void
+xipfs_buffer_read_run(void *dest, const void *ptr, size_t n)
+{
+    const char *start, *end;
+    xipfs_buf_t *slot;
+    size_t pos;
+
+    slot = xipfs_buffer_lookup(xipfs_nvm_page(ptr));
+    if (slot != NULL && slot->state == XIPFS_BUFFER_DIRTY) {
+        pos = (uintptr_t)ptr % XIPFS_NVM_PAGE_SIZE;
+        (void)memcpy(dest, &slot->buf[pos], n);
+        return;
+    }
+    /* the flash page content is up to date, but for the partial
+     * write block of the last streamed write */
+    (void)memcpy(dest, ptr, n);
+    start = xipfs_buf_tail.addr;
+    if (start == NULL) {
+        return;
+    }
+    end = start + xipfs_buf_tail.len;
+    if (start < (const char *)ptr) {
+        start = ptr;
+    }
+    if (end > (const char *)ptr + n) {
+        end = (const char *)ptr + n;
+    }
+    if (start < end) {
+        (void)memcpy((char *)dest + (start - (const char *)ptr),
+            &xipfs_buf_tail.block[start - xipfs_buf_tail.addr],
+            (size_t)(end - start));
     }
-    xipfs_buf.page_num = num;
-    xipfs_buf.page_addr = addr;
-    xipfs_buf.state = XIPFS_BUFFER_OK;
 }
 
 /**
  * @brief Buffered implementation of the read(2) function
  *
+ * The memory region is split at flash page boundaries and each
+ * run is copied at once. Reading never loads a flash page into
+ * a buffer slot, thus it never triggers a flush nor an eviction
+ *
  * @param dest A pointer to an accessible memory region where to
  * store the read bytes
  *
@@ -217,9 +500,9 @@ xipfs_buffer_load(unsigned num, const void *addr)
 int
 xipfs_buffer_read(void *dest, const void *src, size_t len)
 {
-    const void *addr, *ptr;
-    size_t pos, i;
-    unsigned num;
+    const char *ptr;
+    char *out;
+    size_t n;
 
     assert(dest != NULL);
     assert(src != NULL);
@@ -227,26 +510,26 @@ xipfs_buffer_read(void *dest, const void *src, size_t len)
         xipfs_errno = XIPFS_ENULLPOINTER;
         return -1;
     }
+    if (len == 0) {
+        return 0;
+    }
+    if (xipfs_flash_in(src) == 0 ||
+        xipfs_flash_in((const char *)src + len - 1) == 0) {
+        xipfs_errno = XIPFS_EOUTNVM;
+        return -1;
+    }
 
-    for (i = 0; i < len; i++) {
-        ptr = (const char *)src + i;
-        if (xipfs_flash_in(ptr) < 0) {
-            /* xipfs_errno was set */
-            return -1;
+    ptr = src;
+    out = dest;
+    while (len > 0) {
+        n = XIPFS_NVM_PAGE_SIZE - (uintptr_t)ptr % XIPFS_NVM_PAGE_SIZE;
+        if (n > len) {
+            n = len;
         }
-        num = xipfs_nvm_page(ptr);
-        addr = xipfs_nvm_addr(num);
-        if (xipfs_buf.state == XIPFS_BUFFER_KO) {
-            xipfs_buffer_load(num, addr);
-        } else if (xipfs_buffer_page_changed(num) == 1) {
-            if (xipfs_buffer_flush() < 0) {
-                /* xipfs_errno was set */
-                return -1;
-            }
-            xipfs_buffer_load(num, addr);
-        }
-        pos = (uintptr_t)ptr % XIPFS_NVM_PAGE_SIZE;
-        ((char *)dest)[i] = xipfs_buf.buf[pos];
+        xipfs_buffer_read_run(out, ptr, n);
+        ptr += n;
+        out += n;
+        len -= n;
     }
 
     return 0;
@@ -288,9 +571,174 @@ xipfs_buffer_read_32(unsigned *dest, const void *src)
     return xipfs_buffer_read(dest, src, sizeof(*dest));
 }
 
+/**
+ * @internal
+ *
+ * @pre ptr must be a valid flash address
+ *
+ * @brief Returns the buffer slot holding the flash page pointed
+ * to by ptr, loading the page into the least recently used slot
+ * if it is not buffered yet
+ *
+ * @param ptr A pointer to a byte of the flash page to load
+ *
+ * @return Returns a pointer to the buffer slot or NULL if the
+ * evicted slot could not be flushed
+ */
+static xipfs_buf_t *
+xipfs_buffer_acquire(const void *ptr)
+{
+    xipfs_buf_t *slot;
+    unsigned num;
+    size_t i;
+
+    num = xipfs_nvm_page(ptr);
+    if ((slot = xipfs_buffer_lookup(num)) != NULL) {
+        xipfs_buffer_statistics.hits++;
+    } else {
+        xipfs_buffer_statistics.misses++;
+        slot = &xipfs_buf[0];
+        for (i = 0; i < XIPFS_BUFFER_SLOT_NUM; i++) {
+            if (xipfs_buf[i].state == XIPFS_BUFFER_KO) {
+                slot = &xipfs_buf[i];
+                break;
+            }
+            if (xipfs_buf[i].last_use < slot->last_use) {
+                slot = &xipfs_buf[i];
+            }
+        }
+        if (slot->state != XIPFS_BUFFER_KO) {
+            xipfs_buffer_statistics.evictions++;
+            if (xipfs_buffer_slot_flush(slot) < 0) {
+                /* xipfs_errno was set */
+                return NULL;
+            }
+        }
+        /* the slot starts from the streamed bytes of the page */
+        if (xipfs_buf_tail.addr != NULL &&
+            xipfs_nvm_page(xipfs_buf_tail.addr) == num &&
+            xipfs_buffer_tail_flush() < 0) {
+            /* xipfs_errno was set */
+            return NULL;
+        }
+        xipfs_buffer_load(slot, num, xipfs_nvm_addr(num));
+    }
+    slot->last_use = ++xipfs_buffer_clock;
+
+    return slot;
+}
+
+/**
+ * @internal
+ *
+ * @pre ptr must be a valid flash address
+ *
+ * @pre The n bytes starting at ptr must not overflow the flash
+ * page pointed to by ptr
+ *
+ * @brief Programs n bytes of a single flash page straight into
+ * flash when they only target erased cells of a page that has
+ * no dirty buffer slot, as appending to a file does. The whole
+ * write blocks are programmed at once and a trailing partial
+ * block is kept in RAM, so that the next contiguous write
+ * completes it rather than programming it twice
+ *
+ * @param ptr A pointer to the flash bytes to write
+ *
+ * @param in A pointer to the bytes to write
+ *
+ * @param n The number of bytes to write
+ *
+ * @return Returns one if the bytes were written, zero if they
+ * must go through a buffer slot, or a negative value otherwise
+ */
+static int
+xipfs_buffer_stream(char *ptr, const char *in, size_t n)
+{
+    xipfs_buf_t *slot;
+    size_t mod, chunk, i;
+
+    slot = xipfs_buffer_lookup(xipfs_nvm_page(ptr));
+    if (slot != NULL && slot->state == XIPFS_BUFFER_DIRTY) {
+        return 0;
+    }
+    mod = (uintptr_t)ptr % XIPFS_NVM_WRITE_BLOCK_SIZE;
+    if (xipfs_buf_tail.addr != NULL && xipfs_buf_tail.addr == ptr - mod &&
+        xipfs_buf_tail.len > mod) {
+        /* the bytes were already streamed */
+        return 0;
+    }
+    if (xipfs_buf_tail.addr != NULL &&
+        !(xipfs_buf_tail.addr == ptr - mod && xipfs_buf_tail.len == mod) &&
+        xipfs_buf_tail.addr < ptr + n &&
+        ptr < xipfs_buf_tail.addr + XIPFS_NVM_WRITE_BLOCK_SIZE) {
+        /* the cells of the kept block still read as erased in
+         * flash, unless the bytes continue it */
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        if ((uint8_t)ptr[i] != XIPFS_NVM_ERASE_STATE) {
+            return 0;
+        }
+    }
+
+    if (slot != NULL) {
+        /* the clean slot would no longer match flash */
+        slot->state = XIPFS_BUFFER_KO;
+    }
+    if (xipfs_buf_tail.addr != NULL && (xipfs_buf_tail.addr != ptr - mod ||
+        xipfs_buf_tail.len != mod)) {
+        if (xipfs_buffer_tail_flush() < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    xipfs_buffer_statistics.streams++;
+    while (n > 0) {
+        mod = (uintptr_t)ptr % XIPFS_NVM_WRITE_BLOCK_SIZE;
+        if (mod == 0 && n >= XIPFS_NVM_WRITE_BLOCK_SIZE) {
+            chunk = n - n % XIPFS_NVM_WRITE_BLOCK_SIZE;
+            if (xipfs_flash_write_unaligned(ptr, in, chunk) < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+            xipfs_buffer_statistics.programmed_words +=
+                chunk / sizeof(uint32_t);
+        } else {
+            if (xipfs_buf_tail.addr == NULL) {
+                xipfs_buf_tail.addr = ptr - mod;
+                (void)memcpy(xipfs_buf_tail.block, xipfs_buf_tail.addr,
+                    XIPFS_NVM_WRITE_BLOCK_SIZE);
+            }
+            chunk = XIPFS_NVM_WRITE_BLOCK_SIZE - mod;
+            if (chunk > n) {
+                chunk = n;
+            }
+            (void)memcpy(&xipfs_buf_tail.block[mod], in, chunk);
+            xipfs_buf_tail.len = mod + chunk;
+            if (xipfs_buf_tail.len == XIPFS_NVM_WRITE_BLOCK_SIZE &&
+                xipfs_buffer_tail_flush() < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+        }
+        ptr += chunk;
+        in += chunk;
+        n -= chunk;
+    }
+
+    return 1;
+}
+
 /**
  * @brief Buffered implementation of the write(2) function
  *
+ * The memory region is split at flash page boundaries. A run
+ * that only targets erased cells is programmed straight into
+ * flash, any other run is copied at once into the buffer slot
+ * holding its flash page. A slot is flushed only when it is
+ * evicted to make room for another flash page
+ *
  * @param dest A pointer to an accessible memory region where to
  * store the bytes to write
  *
@@ -305,9 +753,11 @@ xipfs_buffer_read_32(unsigned *dest, const void *src)
 int
 xipfs_buffer_write(void *dest, const void *src, size_t len)
 {
-    void *addr, *ptr;
-    size_t pos, i;
-    unsigned num;
+    xipfs_buf_t *slot;
+    const char *in;
+    char *ptr;
+    size_t pos, n;
+    int ret;
 
     assert(dest != NULL);
     assert(src != NULL);
@@ -315,27 +765,38 @@ xipfs_buffer_write(void *dest, const void *src, size_t len)
         xipfs_errno = XIPFS_ENULLPOINTER;
         return -1;
     }
+    if (len == 0) {
+        return 0;
+    }
+    if (xipfs_flash_in(dest) == 0 ||
+        xipfs_flash_in((char *)dest + len - 1) == 0) {
+        xipfs_errno = XIPFS_EOUTNVM;
+        return -1;
+    }
 
-    for (i = 0; i < len; i++) {
-        ptr = (char *)dest + i;
-        if (xipfs_flash_in(ptr) < 0) {
+    ptr = dest;
+    in = src;
+    while (len > 0) {
+        pos = (uintptr_t)ptr % XIPFS_NVM_PAGE_SIZE;
+        n = XIPFS_NVM_PAGE_SIZE - pos;
+        if (n > len) {
+            n = len;
+        }
+        if ((ret = xipfs_buffer_stream(ptr, in, n)) < 0) {
             /* xipfs_errno was set */
             return -1;
         }
-        num = xipfs_nvm_page(ptr);
-        addr = xipfs_nvm_addr(num);
-        if (xipfs_buf.state == XIPFS_BUFFER_KO) {
-            xipfs_buffer_load(num, addr);
-        } else if (xipfs_buffer_page_changed(num) == 1) {
-            if (xipfs_buffer_flush() < 0) {
+        if (ret == 0) {
+            if ((slot = xipfs_buffer_acquire(ptr)) == NULL) {
                 /* xipfs_errno was set */
                 return -1;
             }
-            xipfs_buffer_load(num, addr);
+            (void)memcpy(&slot->buf[pos], in, n);
+            slot->state = XIPFS_BUFFER_DIRTY;
         }
-        pos = (uintptr_t)ptr % XIPFS_NVM_PAGE_SIZE;
-        xipfs_buf.buf[pos] = ((char *)src)[i];
-        xipfs_buf.state = XIPFS_BUFFER_DIRTY;
+        ptr += n;
+        in += n;
+        len -= n;
     }
 
     return 0;
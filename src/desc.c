@@ -35,6 +35,7 @@
 #include <assert.h>
 #include <errno.h>
 
+#include "include/desc.h"
 #include "include/file.h"
 #include "include/xipfs.h"
 
@@ -45,6 +46,7 @@ typedef enum desc_type_e {
     DESC_FREE,
     DESC_FILE,
     DESC_DIR,
+    DESC_MAP,
 } desc_type_t;
 
 /**
@@ -156,6 +158,28 @@ xipfs_dir_desc_track(xipfs_dir_desc_t *descp)
     return _xipfs_desc_track(descp, DESC_DIR);
 }
 
+/**
+ * @pre mapp must be a pointer that references an accessible
+ * memory region
+ *
+ * @brief Keeps track of a new mapping structure
+ *
+ * @param mapp A pointer to a memory region containing the
+ * mapping structure to keep track
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_map_track(xipfs_map_t *mapp)
+{
+    if (mapp == NULL) {
+        return -EFAULT;
+    }
+
+    return _xipfs_desc_track(mapp, DESC_MAP);
+}
+
 /**
  * @internal
  *
@@ -250,6 +274,28 @@ xipfs_dir_desc_untrack(xipfs_dir_desc_t *descp)
     return _xipfs_desc_untrack(descp, DESC_DIR);
 }
 
+/**
+ * @pre mapp must be a pointer that references an accessible
+ * memory region
+ *
+ * @brief Stop keeping track of a mapping structure
+ *
+ * @param mapp A pointer to a memory region containing the
+ * mapping structure to stop keeping track
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_map_untrack(xipfs_map_t *mapp)
+{
+    if (mapp == NULL) {
+        return -EFAULT;
+    }
+
+    return _xipfs_desc_untrack(mapp, DESC_MAP);
+}
+
 /**
  * @internal
  *
@@ -325,6 +371,51 @@ xipfs_dir_desc_tracked(xipfs_dir_desc_t *descp)
     return _xipfs_desc_tracked(descp, DESC_DIR);
 }
 
+/**
+ * @pre mapp must be a pointer that references an accessible
+ * memory region
+ *
+ * @brief Check whether a mapping structure is tracked
+ *
+ * @param mapp A pointer to a memory region containing the
+ * mapping structure to check
+ *
+ * @return Returns zero if the mapping structure is tracked or a
+ * negative value otherwise
+ */
+int
+xipfs_map_tracked(xipfs_map_t *mapp)
+{
+    return _xipfs_desc_tracked(mapp, DESC_MAP);
+}
+
+/**
+ * @internal
+ *
+ * @brief Updates the address of a mapping after the mapped
+ * bytes were moved, or clears the mapping if they were removed
+ *
+ * @param mapp A pointer to the mapping structure
+ *
+ * @param from The former address of the first byte of the
+ * mapped file
+ *
+ * @param to The new address of the first byte of the mapped
+ * file, NULL if it was removed
+ */
+static void
+_xipfs_map_rebase(xipfs_map_t *mapp, const void *from, const void *to)
+{
+    if (to == NULL) {
+        mapp->filp = NULL;
+        mapp->addr = NULL;
+        mapp->len = 0;
+        return;
+    }
+    mapp->addr = (const char *)to +
+        ((const char *)mapp->addr - (const char *)from);
+}
+
 /**
  * @pre mp must be a pointer that references a memory region
  * containing an xipfs mount point structure which is accessible
@@ -341,6 +432,7 @@ xipfs_desc_untrack_all(xipfs_mount_t *mp)
 {
     xipfs_file_desc_t *file_descp;
     xipfs_dir_desc_t *dir_descp;
+    xipfs_map_t *mapp;
     uintptr_t filp, start, end;
     size_t i;
 
@@ -372,6 +464,15 @@ xipfs_desc_untrack_all(xipfs_mount_t *mp)
                 }
             }
             break;
+        case DESC_MAP:
+            mapp = _open_desc[i].addr;
+            filp = (uintptr_t)mapp->filp;
+            if (filp >= start  && filp < end) {
+                _xipfs_map_rebase(mapp, NULL, NULL);
+                _open_desc[i].addr = NULL;
+                _open_desc[i].type = DESC_FREE;
+            }
+            break;
         case DESC_FREE:
         default:
             break;
@@ -386,39 +487,33 @@ xipfs_desc_untrack_all(xipfs_mount_t *mp)
  * containing an xipfs mount point structure which is accessible
  * and valid
  *
- * @pre removed must be a pointer that references an accessible
- * memory region
- *
- * @brief Update the tracked open descriptor structures by
- * modifying the internal address of the xipfs file, following
- * the removal of a file at the mount point, with both elements
- * provided as arguments
+ * @brief Update the tracked open descriptor structures of the
+ * mount point, in a single pass, after files were moved or
+ * removed. The new address of the xipfs file of each descriptor
+ * is given by the relocation function, the descriptor being
+ * untracked if the file was removed
  *
  * @param mp A pointer to a memory region containing an xipfs
  * mount point structure
  *
- * @param removed A pointer to a memory region containing the
- * removed xipfs file structure
+ * @param relocate A function returning the new address of the
+ * xipfs file passed as an argument, NULL if it was removed
  *
- * @param reserved The reserved size of the removed xipfs file
- * structure
+ * @param arg The last argument passed to the relocation
+ * function
  */
 int
-xipfs_desc_update(xipfs_mount_t *mp, xipfs_file_t *removed,
-                  xipfs_file_position_t reserved)
+xipfs_desc_update(xipfs_mount_t *mp, xipfs_desc_relocate_t relocate,
+                  void *arg)
 {
-    xipfs_file_desc_t *file_descp;
-    xipfs_dir_desc_t *dir_descp;
+    xipfs_file_t **filpp;
     uintptr_t filp, start, end;
     size_t i;
 
     if (mp == NULL) {
         return -EFAULT;
     }
-    if (removed == NULL) {
-        return -EFAULT;
-    }
-    if (reserved < 0) {
+    if (relocate == NULL) {
         return -EFAULT;
     }
 
@@ -427,39 +522,278 @@ xipfs_desc_update(xipfs_mount_t *mp, xipfs_file_t *removed,
     for (i = 0; i < XIPFS_MAX_OPEN_DESC; i++) {
         switch (_open_desc[i].type) {
         case DESC_FILE:
-            file_descp = _open_desc[i].addr;
-            filp = (uintptr_t)file_descp->filp;
-            if (filp != (uintptr_t)xipfs_infos_file) {
-                if (filp >= start  && filp < end) {
-                    if (filp > (uintptr_t)removed) {
-                        file_descp->filp = (xipfs_file_t *)
-                            (uintptr_t)file_descp->filp - reserved;
-                    } else if (filp == (uintptr_t)removed) {
-                        _open_desc[i].addr = NULL;
-                        _open_desc[i].type = DESC_FREE;
-                    }
-                }
+            filpp = &((xipfs_file_desc_t *)_open_desc[i].addr)->filp;
+            break;
+        case DESC_DIR:
+            filpp = &((xipfs_dir_desc_t *)_open_desc[i].addr)->filp;
+            break;
+        case DESC_MAP:
+            filpp = &((xipfs_map_t *)_open_desc[i].addr)->filp;
+            break;
+        case DESC_FREE:
+        default:
+            continue;
+        }
+        filp = (uintptr_t)*filpp;
+        if (filp == (uintptr_t)xipfs_infos_file) {
+            continue;
+        }
+        if (filp < start || filp >= end) {
+            continue;
+        }
+        *filpp = relocate(*filpp, arg);
+        if (_open_desc[i].type == DESC_MAP) {
+            _xipfs_map_rebase(_open_desc[i].addr, (void *)filp, *filpp);
+        }
+        if (*filpp == NULL) {
+            _open_desc[i].addr = NULL;
+            _open_desc[i].type = DESC_FREE;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Relocation function of xipfs_desc_move
+ *
+ * @param filp The address of the xipfs file of a descriptor
+ *
+ * @param arg A pointer to the former and new addresses of the
+ * moved xipfs file
+ *
+ * @return Returns the new address of the xipfs file
+ */
+static xipfs_file_t *
+xipfs_desc_move_one(xipfs_file_t *filp, void *arg)
+{
+    xipfs_file_t **move = arg;
+
+    return (filp == move[0]) ? move[1] : filp;
+}
+
+/**
+ * @pre mp must be a pointer that references a memory region
+ * containing an xipfs mount point structure which is accessible
+ * and valid
+ *
+ * @brief Update the tracked open descriptor structures that
+ * refer to a single xipfs file that was moved or removed, the
+ * other files staying in place
+ *
+ * @param mp A pointer to a memory region containing an xipfs
+ * mount point structure
+ *
+ * @param from The former address of the xipfs file
+ *
+ * @param to The new address of the xipfs file, NULL if it was
+ * removed
+ */
+int
+xipfs_desc_move(xipfs_mount_t *mp, xipfs_file_t *from,
+                xipfs_file_t *to)
+{
+    xipfs_file_t *move[2];
+
+    if (from == NULL) {
+        return -EFAULT;
+    }
+    move[0] = from;
+    move[1] = to;
+
+    return xipfs_desc_update(mp, xipfs_desc_move_one, move);
+}
+
+/**
+ * @pre mp must be a pointer that references a memory region
+ * containing an xipfs mount point structure which is accessible
+ * and valid
+ *
+ * @brief Update the tracked open file descriptor structures
+ * that refer to packed files of a directory, once the packed
+ * files were copied to another xipfs file. The open directory
+ * descriptor structures keep listing the former xipfs file
+ *
+ * @param mp A pointer to a memory region containing an xipfs
+ * mount point structure
+ *
+ * @param from The former xipfs file holding the packed files
+ *
+ * @param to The new xipfs file holding the packed files
+ *
+ * @param repack A function returning the new position of a
+ * packed file
+ *
+ * @param arg The last argument passed to the function
+ */
+int
+xipfs_desc_repack(xipfs_mount_t *mp, xipfs_file_t *from,
+                  xipfs_file_t *to, xipfs_desc_repack_t repack,
+                  void *arg)
+{
+    xipfs_file_position_t packed;
+    xipfs_file_desc_t *descp;
+    xipfs_map_t *mapp;
+    size_t i;
+
+    if (mp == NULL) {
+        return -EFAULT;
+    }
+    if (from == NULL || to == NULL || repack == NULL) {
+        return -EFAULT;
+    }
+
+    for (i = 0; i < XIPFS_MAX_OPEN_DESC; i++) {
+        switch (_open_desc[i].type) {
+        case DESC_FILE:
+            descp = _open_desc[i].addr;
+            if (descp->filp == from && descp->packed >= 0) {
+                descp->filp = to;
+                descp->packed = repack(descp->packed, arg);
+            }
+            break;
+        case DESC_MAP:
+            mapp = _open_desc[i].addr;
+            if (mapp->filp == from && mapp->packed >= 0) {
+                packed = repack(mapp->packed, arg);
+                _xipfs_map_rebase(mapp, &from->buf[mapp->packed],
+                    &to->buf[packed]);
+                mapp->filp = to;
+                mapp->packed = packed;
             }
             break;
         case DESC_DIR:
-            dir_descp = _open_desc[i].addr;
-            filp = (uintptr_t)dir_descp->filp;
-            if (filp != (uintptr_t)xipfs_infos_file) {
-                if (filp >= start  && filp < end) {
-                    if (filp > (uintptr_t)removed) {
-                        dir_descp->filp = (xipfs_file_t *)
-                            (uintptr_t)dir_descp->filp - reserved;
-                    } else if (filp == (uintptr_t)removed) {
-                        _open_desc[i].addr = NULL;
-                        _open_desc[i].type = DESC_FREE;
-                    }
-                }
+        case DESC_FREE:
+        default:
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @pre mp must be a pointer that references a memory region
+ * containing an xipfs mount point structure which is accessible
+ * and valid
+ *
+ * @brief Untrack the open file descriptor and mapping structures
+ * that refer to a packed file that was removed
+ *
+ * @param mp A pointer to a memory region containing an xipfs
+ * mount point structure
+ *
+ * @param filp The xipfs file holding the packed file
+ *
+ * @param packed The position of the packed file
+ */
+int
+xipfs_desc_unpack(xipfs_mount_t *mp, xipfs_file_t *filp,
+                  xipfs_file_position_t packed)
+{
+    xipfs_file_desc_t *descp;
+    xipfs_map_t *mapp;
+    size_t i;
+
+    if (mp == NULL) {
+        return -EFAULT;
+    }
+    if (filp == NULL) {
+        return -EFAULT;
+    }
+
+    for (i = 0; i < XIPFS_MAX_OPEN_DESC; i++) {
+        switch (_open_desc[i].type) {
+        case DESC_FILE:
+            descp = _open_desc[i].addr;
+            if (descp->filp != filp || descp->packed != packed) {
+                continue;
+            }
+            break;
+        case DESC_MAP:
+            mapp = _open_desc[i].addr;
+            if (mapp->filp != filp || mapp->packed != packed) {
+                continue;
             }
+            _xipfs_map_rebase(mapp, NULL, NULL);
             break;
+        case DESC_DIR:
         case DESC_FREE:
         default:
             continue;
         }
+        _open_desc[i].addr = NULL;
+        _open_desc[i].type = DESC_FREE;
+    }
+
+    return 0;
+}
+
+/**
+ * @pre mp must be a pointer that references a memory region
+ * containing an xipfs mount point structure which is accessible
+ * and valid
+ *
+ * @brief Moves back the position, and the end of the bytes
+ * written with xipfs_pwrite, of the tracked open file descriptor
+ * structures that refer to a truncated xipfs file, since the
+ * size of a file is set from them when it is closed, and
+ * shortens its mappings
+ *
+ * @param mp A pointer to a memory region containing an xipfs
+ * mount point structure
+ *
+ * @param filp The truncated xipfs file
+ *
+ * @param size The new size of the file
+ */
+int
+xipfs_desc_truncate(xipfs_mount_t *mp, xipfs_file_t *filp,
+                    xipfs_file_position_t size)
+{
+    xipfs_file_desc_t *descp;
+    xipfs_map_t *mapp;
+    size_t off, i;
+
+    if (mp == NULL) {
+        return -EFAULT;
+    }
+    if (filp == NULL) {
+        return -EFAULT;
+    }
+
+    for (i = 0; i < XIPFS_MAX_OPEN_DESC; i++) {
+        switch (_open_desc[i].type) {
+        case DESC_FILE:
+            descp = _open_desc[i].addr;
+            if (descp->filp == filp && descp->packed < 0) {
+                if (descp->pos > size) {
+                    descp->pos = size;
+                }
+                if (descp->end > size) {
+                    descp->end = size;
+                }
+            }
+            break;
+        case DESC_MAP:
+            mapp = _open_desc[i].addr;
+            if (mapp->filp != filp || mapp->packed >= 0) {
+                break;
+            }
+            off = (size_t)((const unsigned char *)mapp->addr - filp->buf);
+            if (off >= (size_t)size) {
+                mapp->len = 0;
+            } else if (mapp->len > (size_t)size - off) {
+                mapp->len = (size_t)size - off;
+            }
+            break;
+        case DESC_DIR:
+        case DESC_FREE:
+        default:
+            break;
+        }
     }
 
     return 0;
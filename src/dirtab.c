@@ -0,0 +1,1644 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+
+/*
+ * libc includes
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * xipfs includes
+ */
+#include "include/xipfs.h"
+#include "include/buffer.h"
+#include "include/dirtab.h"
+#include "include/errno.h"
+#include "include/file.h"
+#include "include/flash.h"
+#include "include/fs.h"
+#include "include/index.h"
+
+#if XIPFS_DIR_TABLE_SIZE > 0
+
+/**
+ * @internal
+ *
+ * @def ROUND
+ *
+ * @brief Round x to the next power of two y
+ *
+ * @param x The number to round to the next power of two y
+ *
+ * @param y The power of two with which to round x
+ */
+#define ROUND(x, y) (((x) + (y) - 1) & ~((y) - 1))
+
+/**
+ * @internal
+ *
+ * @def XIPFS_DIRTAB_NAME_MAX
+ *
+ * @brief The maximum length of a directory name, which leaves
+ * room for the slashes around it and a file name after it
+ */
+#define XIPFS_DIRTAB_NAME_MAX (XIPFS_PATH_MAX - 4)
+
+/**
+ * @internal
+ *
+ * @def XIPFS_DIRTAB_RESERVE
+ *
+ * @brief The number of records a single operation may append
+ * to the directory table
+ */
+#define XIPFS_DIRTAB_RESERVE (3)
+
+/**
+ * @internal
+ *
+ * @def XIPFS_DIRTAB_LOG_SIZE
+ *
+ * @brief The number of bytes of the file of the directory table
+ * available for records
+ */
+#define XIPFS_DIRTAB_LOG_SIZE \
+    (XIPFS_NVM_PAGE_SIZE - sizeof(xipfs_file_t))
+
+/**
+ * @internal
+ *
+ * @def XIPFS_DIRTAB_RECORD_SIZE
+ *
+ * @brief The size of a record of the directory table holding a
+ * name of len characters
+ *
+ * @param len The length of the name
+ */
+#define XIPFS_DIRTAB_RECORD_SIZE(len) \
+    (sizeof(xipfs_dirtab_record_t) + ROUND((size_t)(len), sizeof(uint32_t)))
+
+/**
+ * @internal
+ *
+ * @brief The states of a directory identifier
+ */
+enum {
+    /**
+     * The identifier can be allocated
+     */
+    XIPFS_DIRTAB_FREE,
+    /**
+     * The identifier names a directory
+     */
+    XIPFS_DIRTAB_LIVE,
+    /**
+     * The identifier no longer names a directory, it can be
+     * allocated once the table is folded
+     */
+    XIPFS_DIRTAB_RELEASED,
+};
+
+/**
+ * @internal
+ *
+ * @brief A record of the directory table in flash, followed by
+ * the name of the directory padded to a 32-bit boundary. The
+ * records are appended to the table, the last record of an
+ * identifier is the one that counts
+ */
+typedef struct xipfs_dirtab_record_s {
+    /**
+     * The identifier of the directory, in the erased state past
+     * the last record
+     */
+    uint8_t id;
+    /**
+     * The identifier of the parent directory, zero for the root
+     */
+    uint8_t parent;
+    /**
+     * The length of the name, zero if the identifier is released
+     */
+    uint8_t len;
+    /**
+     * Cleared once the whole record is written
+     */
+    uint8_t done;
+} xipfs_dirtab_record_t;
+
+/**
+ * @internal
+ *
+ * @brief A directory of the directory table in RAM
+ */
+typedef struct xipfs_dirtab_dir_s {
+    /**
+     * The state of the identifier
+     */
+    uint8_t state;
+    /**
+     * The identifier of the parent directory, zero for the root
+     */
+    uint8_t parent;
+    /**
+     * The length of the name
+     */
+    uint8_t len;
+    /**
+     * Set while folding if a file needs the directory
+     */
+    uint8_t mark;
+    /**
+     * The name of the directory, without slashes nor null
+     * character
+     */
+    char name[XIPFS_DIRTAB_NAME_MAX];
+} xipfs_dirtab_dir_t;
+
+/**
+ * @internal
+ *
+ * @brief A structure that describes the directory table
+ */
+typedef struct xipfs_dirtab_s {
+    /**
+     * The mount point the table is bound to, NULL if none
+     */
+    xipfs_mount_t *mp;
+    /**
+     * The address range of the mount point
+     */
+    uintptr_t start, end;
+    /**
+     * Non-zero if the table reflects the file system
+     */
+    int valid;
+    /**
+     * The file holding the table, NULL if there is none yet
+     */
+    xipfs_file_t *table;
+    /**
+     * The number of bytes of records in the file
+     */
+    size_t used;
+    /**
+     * The directories, indexed by their identifier minus one
+     */
+    xipfs_dirtab_dir_t dir[XIPFS_DIR_TABLE_SIZE];
+} xipfs_dirtab_t;
+
+/**
+ * @internal
+ *
+ * @brief The directory table of xipfs
+ */
+static xipfs_dirtab_t xipfs_dirtab;
+
+/**
+ * @internal
+ *
+ * @brief Retrieves a directory of the table
+ *
+ * @param id The identifier of the directory, not zero
+ *
+ * @return Returns a pointer to the directory
+ */
+static xipfs_dirtab_dir_t *
+xipfs_dirtab_dir(unsigned id)
+{
+    assert(id > 0 && id <= XIPFS_DIR_TABLE_SIZE);
+
+    return &xipfs_dirtab.dir[id - 1];
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks whether a directory is below another one
+ *
+ * @param id The identifier of the directory
+ *
+ * @param ancestor The identifier of the other directory
+ *
+ * @return Returns one if ancestor is id or one of its parents,
+ * zero otherwise
+ */
+static int
+xipfs_dirtab_below(unsigned id, unsigned ancestor)
+{
+    size_t depth;
+
+    for (depth = 0; id != 0 && depth < XIPFS_PATH_MAX / 2; depth++) {
+        if (id == ancestor) {
+            return 1;
+        }
+        id = xipfs_dirtab_dir(id)->parent;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Releases a directory and the directories below it
+ *
+ * @param id The identifier of the directory
+ */
+static void
+xipfs_dirtab_release_dirs(unsigned id)
+{
+    xipfs_dirtab_dir_t *dirp;
+    unsigned i;
+
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        dirp = xipfs_dirtab_dir(i);
+        if (dirp->state == XIPFS_DIRTAB_LIVE &&
+            xipfs_dirtab_below(i, id)) {
+            dirp->state = XIPFS_DIRTAB_RELEASED;
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Looks up a directory by its parent and its name
+ *
+ * @param parent The identifier of the parent directory
+ *
+ * @param name A pointer to the name of the directory
+ *
+ * @param len The length of the name
+ *
+ * @return Returns the identifier of the directory or zero if
+ * there is none
+ */
+static unsigned
+xipfs_dirtab_child(unsigned parent, const char *name, size_t len)
+{
+    xipfs_dirtab_dir_t *dirp;
+    unsigned i;
+
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        dirp = xipfs_dirtab_dir(i);
+        if (dirp->state == XIPFS_DIRTAB_LIVE &&
+            dirp->parent == parent && dirp->len == len &&
+            memcmp(dirp->name, name, len) == 0) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre path must start with a slash and path[len-1] must be a
+ * slash
+ *
+ * @brief Looks up the directories of a path, from the root
+ * down to the first one that is not in the table
+ *
+ * @param path A pointer to a path
+ *
+ * @param len The length of the path of the directory to look
+ * up, including its trailing slash
+ *
+ * @param id A pointer where to store the identifier of the
+ * last directory found, zero for the root
+ *
+ * @return Returns the number of directories not found
+ */
+static size_t
+xipfs_dirtab_walk(const char *path, size_t len, unsigned *id)
+{
+    size_t i, start, missing;
+    unsigned child;
+
+    *id = 0;
+    missing = 0;
+    start = 1;
+    for (i = 1; i < len; i++) {
+        if (path[i] != '/') {
+            continue;
+        }
+        if (missing == 0) {
+            child = xipfs_dirtab_child(*id, &path[start], i - start);
+            if (child != 0) {
+                *id = child;
+            } else {
+                missing++;
+            }
+        } else {
+            missing++;
+        }
+        start = i + 1;
+    }
+
+    return missing;
+}
+
+/**
+ * @internal
+ *
+ * @brief Counts the identifiers that can be allocated
+ *
+ * @return Returns the number of free identifiers
+ */
+static size_t
+xipfs_dirtab_free_ids(void)
+{
+    size_t count;
+    unsigned i;
+
+    count = 0;
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        if (xipfs_dirtab_dir(i)->state == XIPFS_DIRTAB_FREE) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks whether records and identifiers can be added to
+ * the table without folding it
+ *
+ * @param records The number of records to append
+ *
+ * @param ids The number of identifiers to allocate
+ *
+ * @return Returns one if they fit or zero otherwise
+ */
+static int
+xipfs_dirtab_fits(size_t records, size_t ids)
+{
+    if (records == 0) {
+        return 1;
+    }
+    if (xipfs_dirtab.table == NULL) {
+        return 0;
+    }
+    if (xipfs_dirtab.used + records *
+            XIPFS_DIRTAB_RECORD_SIZE(XIPFS_DIRTAB_NAME_MAX) >
+            XIPFS_DIRTAB_LOG_SIZE) {
+        return 0;
+    }
+
+    return xipfs_dirtab_free_ids() >= ids;
+}
+
+/**
+ * @internal
+ *
+ * @pre The table must have room for the record
+ *
+ * @brief Appends a record to the table in flash, without
+ * erasing anything
+ *
+ * @param dst The address of the record
+ *
+ * @param id The identifier of the directory
+ *
+ * @param dirp The directory, NULL to release the identifier
+ *
+ * @return Returns the size of the record or a negative value
+ * otherwise
+ */
+static int
+xipfs_dirtab_write(void *dst, unsigned id, const xipfs_dirtab_dir_t *dirp)
+{
+    struct {
+        xipfs_dirtab_record_t record;
+        char name[XIPFS_DIRTAB_NAME_MAX + sizeof(uint32_t)];
+    } buf;
+    const uint8_t done = 0;
+    size_t size;
+
+    (void)memset(&buf, XIPFS_NVM_ERASE_STATE, sizeof(buf));
+    buf.record.id = (uint8_t)id;
+    buf.record.parent = 0;
+    buf.record.len = 0;
+    if (dirp != NULL) {
+        buf.record.parent = dirp->parent;
+        buf.record.len = dirp->len;
+        (void)memcpy(buf.name, dirp->name, dirp->len);
+    }
+    size = XIPFS_DIRTAB_RECORD_SIZE(buf.record.len);
+    assert(size <= sizeof(buf));
+
+    /* the record only counts once it is whole */
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_buffer_invalidate();
+    if (xipfs_flash_write_unaligned(dst, &buf, size) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_flash_write_unaligned(
+            &((xipfs_dirtab_record_t *)dst)->done, &done,
+            sizeof(done)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return (int)size;
+}
+
+/**
+ * @internal
+ *
+ * @pre The table must have room for the record
+ *
+ * @brief Appends the current state of a directory to the table
+ *
+ * @param id The identifier of the directory
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_dirtab_append(unsigned id)
+{
+    xipfs_dirtab_dir_t *dirp;
+    int ret;
+
+    assert(xipfs_dirtab.table != NULL);
+
+    dirp = xipfs_dirtab_dir(id);
+    ret = xipfs_dirtab_write(xipfs_dirtab.table->buf + xipfs_dirtab.used,
+        id, (dirp->state == XIPFS_DIRTAB_LIVE) ? dirp : NULL);
+    if (ret < 0) {
+        /* xipfs_errno was set */
+        xipfs_dirtab.valid = 0;
+        return -1;
+    }
+    xipfs_dirtab.used += (size_t)ret;
+    assert(xipfs_dirtab.used <= XIPFS_DIRTAB_LOG_SIZE);
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre The table must have room for the record and a free
+ * identifier
+ *
+ * @brief Allocates an identifier for a directory
+ *
+ * @param parent The identifier of the parent directory
+ *
+ * @param name A pointer to the name of the directory
+ *
+ * @param len The length of the name
+ *
+ * @return Returns the identifier or zero otherwise
+ */
+static unsigned
+xipfs_dirtab_alloc(unsigned parent, const char *name, size_t len)
+{
+    xipfs_dirtab_dir_t *dirp;
+    unsigned i;
+
+    assert(len > 0 && len <= XIPFS_DIRTAB_NAME_MAX);
+
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        dirp = xipfs_dirtab_dir(i);
+        if (dirp->state == XIPFS_DIRTAB_FREE) {
+            break;
+        }
+    }
+    assert(i <= XIPFS_DIR_TABLE_SIZE);
+
+    dirp->state = XIPFS_DIRTAB_LIVE;
+    dirp->parent = (uint8_t)parent;
+    dirp->len = (uint8_t)len;
+    (void)memcpy(dirp->name, name, len);
+    if (xipfs_dirtab_append(i) < 0) {
+        /* xipfs_errno was set */
+        dirp->state = XIPFS_DIRTAB_FREE;
+        return 0;
+    }
+
+    return i;
+}
+
+/**
+ * @internal
+ *
+ * @brief Rewrites the table in a new file, leaving out the
+ * released directories and the ones that no file needs, then
+ * removes the former file
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param reclaim Non-zero if the pages of removed files may be
+ * reclaimed to make room for the new file, which moves files
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_dirtab_fold(xipfs_mount_t *mp, int reclaim)
+{
+    xipfs_dirtab_dir_t *dirp;
+    xipfs_file_t *filp;
+    const char *path;
+    unsigned i, id;
+    size_t used;
+    int ret;
+
+    /* mark the directories of the files and their parents */
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        xipfs_dirtab_dir(i)->mark = 0;
+    }
+    xipfs_errno = XIPFS_OK;
+    if ((filp = xipfs_fs_head(mp)) != NULL) {
+        do {
+            path = xipfs_file_get_path(filp);
+            if (path[0] != XIPFS_DIRTAB_ENTRY) {
+                continue;
+            }
+            id = (uint8_t)path[1];
+            while (id != 0 && xipfs_dirtab_dir(id)->mark == 0) {
+                xipfs_dirtab_dir(id)->mark = 1;
+                id = xipfs_dirtab_dir(id)->parent;
+            }
+        } while ((filp = xipfs_fs_next(filp)) != NULL);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        dirp = xipfs_dirtab_dir(i);
+        if (dirp->state != XIPFS_DIRTAB_LIVE || dirp->mark == 0) {
+            dirp->state = XIPFS_DIRTAB_FREE;
+        }
+    }
+
+    if ((filp = xipfs_fs_new_table(mp, XIPFS_DIRTAB_TABLE, reclaim)) == NULL) {
+        /* xipfs_errno was set */
+        xipfs_dirtab.valid = 0;
+        return -1;
+    }
+    used = 0;
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        dirp = xipfs_dirtab_dir(i);
+        if (dirp->state != XIPFS_DIRTAB_LIVE) {
+            continue;
+        }
+        if ((ret = xipfs_dirtab_write(filp->buf + used, i, dirp)) < 0) {
+            /* xipfs_errno was set */
+            xipfs_dirtab.valid = 0;
+            return -1;
+        }
+        used += (size_t)ret;
+    }
+    /* the new table replaces the former ones once complete */
+    if (xipfs_fs_table_commit(mp, filp, used) < 0) {
+        /* xipfs_errno was set */
+        xipfs_dirtab.valid = 0;
+        return -1;
+    }
+    xipfs_dirtab.table = filp;
+    xipfs_dirtab.used = used;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Makes room in the table, folding it if needed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param records The number of records to append
+ *
+ * @param ids The number of identifiers to allocate
+ *
+ * @param reclaim Non-zero if the pages of removed files may be
+ * reclaimed, which moves files
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_dirtab_room(xipfs_mount_t *mp, size_t records, size_t ids,
+                  int reclaim)
+{
+    if (xipfs_dirtab_fits(records, ids)) {
+        return 0;
+    }
+    if (xipfs_dirtab_fold(mp, reclaim) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_dirtab_fits(records, ids) == 0) {
+        xipfs_errno = XIPFS_ENOSPACE;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre path must start with a slash and path[len-1] must be a
+ * slash
+ *
+ * @brief Makes room in the table for the directories of a path
+ * that are not in the table yet, folding it if needed, which
+ * does not move any file
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param path A pointer to a path
+ *
+ * @param len The length of the path of the directory, including
+ * its trailing slash
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_dirtab_need(xipfs_mount_t *mp, const char *path, size_t len)
+{
+    size_t missing;
+    unsigned id;
+
+    missing = xipfs_dirtab_walk(path, len, &id);
+    if (xipfs_dirtab_fits(missing, missing)) {
+        return 0;
+    }
+    if (xipfs_dirtab_fold(mp, 0) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    /* directories no file needed were left out */
+    missing = xipfs_dirtab_walk(path, len, &id);
+    if (xipfs_dirtab_fits(missing, missing) == 0) {
+        xipfs_errno = XIPFS_ENOSPACE;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre path must start with a slash and path[len-1] must be a
+ * slash
+ *
+ * @brief Retrieves the identifier of a directory, allocating
+ * the ones of the directories of its path that are not in the
+ * table yet
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param path A pointer to a path
+ *
+ * @param len The length of the path of the directory, including
+ * its trailing slash
+ *
+ * @return Returns the identifier of the directory, zero for the
+ * root, or a negative value otherwise
+ */
+static int
+xipfs_dirtab_ensure(xipfs_mount_t *mp, const char *path, size_t len)
+{
+    size_t i, start, missing;
+    unsigned id;
+
+    if ((missing = xipfs_dirtab_walk(path, len, &id)) == 0) {
+        return (int)id;
+    }
+    if (xipfs_dirtab_need(mp, path, len) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    missing = xipfs_dirtab_walk(path, len, &id);
+
+    /* skip the directories found */
+    id = 0;
+    start = 1;
+    for (i = 1; i < len && missing > 0; i++) {
+        if (path[i] != '/') {
+            continue;
+        }
+        if (xipfs_dirtab_child(id, &path[start], i - start) != 0) {
+            id = xipfs_dirtab_child(id, &path[start], i - start);
+        } else {
+            if (i - start > XIPFS_DIRTAB_NAME_MAX) {
+                xipfs_errno = XIPFS_ENULTER;
+                return -1;
+            }
+            if ((id = xipfs_dirtab_alloc(id, &path[start],
+                    i - start)) == 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+            missing--;
+        }
+        start = i + 1;
+    }
+
+    return (int)id;
+}
+
+/**
+ * @internal
+ *
+ * @brief Computes the length of the path of a directory,
+ * including its slashes
+ *
+ * @param id The identifier of the directory
+ *
+ * @return Returns the length of the path
+ */
+static size_t
+xipfs_dirtab_len(unsigned id)
+{
+    size_t len, depth;
+
+    len = 1;
+    for (depth = 0; id != 0 && depth < XIPFS_PATH_MAX / 2; depth++) {
+        len += (size_t)xipfs_dirtab_dir(id)->len + 1;
+        id = xipfs_dirtab_dir(id)->parent;
+    }
+
+    return (id == 0) ? len : XIPFS_PATH_MAX;
+}
+
+/**
+ * @internal
+ *
+ * @pre path must start with a slash and be len characters long
+ *
+ * @brief Looks for the slash that ends the path of the parent
+ * directory of a file or of a directory
+ *
+ * @param path A pointer to a path
+ *
+ * @param len The length of the path
+ *
+ * @return Returns the position of the slash, zero for the root
+ */
+static size_t
+xipfs_dirtab_parent(const char *path, size_t len)
+{
+    size_t slash;
+
+    assert(len >= 2);
+
+    /* the trailing slash of a directory is not its parent's */
+    for (slash = len - 2; slash > 0 && path[slash] != '/'; slash--)
+        ;
+
+    return slash;
+}
+
+/**
+ * @internal
+ *
+ * @brief Replays the records of a table file
+ *
+ * @param table The file holding the table
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_dirtab_replay(xipfs_file_t *table)
+{
+    const xipfs_dirtab_record_t *record;
+    xipfs_dirtab_dir_t *dirp;
+    size_t off, size, i;
+
+    off = 0;
+    while (off + sizeof(*record) <= XIPFS_DIRTAB_LOG_SIZE) {
+        record = (const xipfs_dirtab_record_t *)(table->buf + off);
+        if (*(const uint32_t *)record == (uint32_t)XIPFS_FLASH_ERASE_STATE) {
+            break;
+        }
+        size = XIPFS_DIRTAB_RECORD_SIZE(record->len);
+        if (record->len > XIPFS_DIRTAB_NAME_MAX ||
+            off + size > XIPFS_DIRTAB_LOG_SIZE) {
+            /* an interrupted record, the table is folded before
+             * anything is appended past it */
+            off = XIPFS_DIRTAB_LOG_SIZE;
+            break;
+        }
+        off += size;
+        if (record->done != 0) {
+            /* an interrupted record */
+            continue;
+        }
+        if (record->id == 0 || record->id > XIPFS_DIR_TABLE_SIZE ||
+            record->parent > XIPFS_DIR_TABLE_SIZE ||
+            record->parent == record->id) {
+            xipfs_errno = XIPFS_EINVAL;
+            return -1;
+        }
+        if (record->len == 0) {
+            xipfs_dirtab_release_dirs(record->id);
+            continue;
+        }
+        for (i = 0; i < record->len; i++) {
+            if (((const char *)(record + 1))[i] == '/') {
+                xipfs_errno = XIPFS_EINVAL;
+                return -1;
+            }
+        }
+        dirp = xipfs_dirtab_dir(record->id);
+        dirp->state = XIPFS_DIRTAB_LIVE;
+        dirp->parent = record->parent;
+        dirp->len = record->len;
+        (void)memcpy(dirp->name, record + 1, record->len);
+    }
+    xipfs_dirtab.table = table;
+    xipfs_dirtab.used = off;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks the consistency of the directories of the
+ * table with each other and with the files
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the table is consistent or a negative
+ * value otherwise
+ */
+static int
+xipfs_dirtab_verify(xipfs_mount_t *mp)
+{
+    xipfs_dirtab_dir_t *dirp;
+    xipfs_file_t *filp;
+    const char *path;
+    unsigned i, id;
+    char name[XIPFS_DIRTAB_NAME_MAX + 1];
+
+    for (i = 1; i <= XIPFS_DIR_TABLE_SIZE; i++) {
+        dirp = xipfs_dirtab_dir(i);
+        if (dirp->state != XIPFS_DIRTAB_LIVE) {
+            continue;
+        }
+        (void)memcpy(name, dirp->name, dirp->len);
+        name[dirp->len] = '\0';
+        if (xipfs_file_path_check(name) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if ((dirp->parent != 0 && xipfs_dirtab_dir(dirp->parent)->state
+                != XIPFS_DIRTAB_LIVE) ||
+            xipfs_dirtab_len(i) > XIPFS_PATH_MAX - 2 ||
+            xipfs_dirtab_child(dirp->parent, dirp->name, dirp->len) != i) {
+            /* a missing parent, a cycle or a duplicate */
+            xipfs_errno = XIPFS_EINVAL;
+            return -1;
+        }
+    }
+
+    xipfs_errno = XIPFS_OK;
+    if ((filp = xipfs_fs_head(mp)) != NULL) {
+        do {
+            path = xipfs_file_get_path(filp);
+            if (path[0] != XIPFS_DIRTAB_ENTRY) {
+                continue;
+            }
+            id = (uint8_t)path[1];
+            if (xipfs_dirtab_dir(id)->state != XIPFS_DIRTAB_LIVE ||
+                xipfs_dirtab_len(id) + strlen(&path[2]) >=
+                    XIPFS_PATH_MAX) {
+                xipfs_errno = XIPFS_EINVAL;
+                return -1;
+            }
+        } while ((filp = xipfs_fs_next(filp)) != NULL);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Extern functions
+ */
+
+/**
+ * @pre path must be a pointer that references a null-terminated
+ * string
+ *
+ * @brief Checks the path stored in a file structure, either a
+ * whole path, a directory identifier followed by a name, or the
+ * mark of the file of the directory table
+ *
+ * @param path The path to check
+ *
+ * @return Returns zero if the path is valid or a negative value
+ * otherwise
+ */
+int
+xipfs_dirtab_check(const char *path)
+{
+    unsigned id;
+
+    if (path != NULL && path[0] == XIPFS_DIRTAB_ENTRY) {
+        id = (uint8_t)path[1];
+        if (id == 0 || id > XIPFS_DIR_TABLE_SIZE ||
+            path[2] == '\0' || path[2] == '/') {
+            xipfs_errno = XIPFS_EINVAL;
+            return -1;
+        }
+        return xipfs_file_path_check(&path[2]);
+    }
+    if (path != NULL && path[0] == XIPFS_DIRTAB_TABLE) {
+        if (path[1] != '\0') {
+            xipfs_errno = XIPFS_EINVAL;
+            return -1;
+        }
+        return 0;
+    }
+
+    return xipfs_file_path_check(path);
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre path must be a pointer that references a path which is
+ * accessible, null-terminated, starts with a slash, normalized,
+ * and shorter than XIPFS_PATH_MAX
+ *
+ * @brief Converts a path to the form stored in a file
+ * structure, the identifier of its directory followed by its
+ * name, allocating identifiers for the directories not in the
+ * table yet
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param path A pointer to a path
+ *
+ * @param raw A pointer to a memory region of XIPFS_PATH_MAX
+ * bytes where to store the converted path
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_dirtab_encode(xipfs_mount_t *mp, const char *path, char *raw)
+{
+    size_t len, slash;
+    int id;
+
+    assert(path != NULL);
+    assert(raw != NULL);
+
+    if (xipfs_dirtab_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    len = strnlen(path, XIPFS_PATH_MAX);
+    if (len < 2 || len == XIPFS_PATH_MAX) {
+        xipfs_errno = XIPFS_ENULTER;
+        return -1;
+    }
+    if ((slash = xipfs_dirtab_parent(path, len)) == 0) {
+        /* the files of the root keep their whole path */
+        (void)strcpy(raw, path);
+        return 0;
+    }
+    if ((id = xipfs_dirtab_ensure(mp, path, slash + 1)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    raw[0] = XIPFS_DIRTAB_ENTRY;
+    raw[1] = (char)id;
+    (void)strcpy(&raw[2], &path[slash + 1]);
+
+    return 0;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre path must be a pointer that references a path which is
+ * accessible, null-terminated, starts with a slash, normalized,
+ * and shorter than XIPFS_PATH_MAX
+ *
+ * @brief Makes room in the directory table for the directories
+ * of a path, without moving any file, so that creating a file
+ * at this path does not fail because of the table
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param path A pointer to a path
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_dirtab_fit(xipfs_mount_t *mp, const char *path)
+{
+    size_t len, slash;
+
+    assert(path != NULL);
+
+    if (xipfs_dirtab_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    len = strnlen(path, XIPFS_PATH_MAX);
+    if (len < 2 || (slash = xipfs_dirtab_parent(path, len)) == 0) {
+        return 0;
+    }
+
+    return xipfs_dirtab_need(mp, path, slash + 1);
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre path must be a pointer that references a null-terminated
+ * string
+ *
+ * @brief Checks whether a file has the path passed as an
+ * argument
+ *
+ * @param filp A pointer to the xipfs file structure
+ *
+ * @param path A pointer to a path
+ *
+ * @return Returns one if the file has this path or zero
+ * otherwise
+ */
+int
+xipfs_dirtab_is(const xipfs_file_t *filp, const char *path)
+{
+    char buf[XIPFS_PATH_MAX];
+
+    return strcmp(xipfs_dirtab_path(filp, buf), path) == 0;
+}
+
+/**
+ * @brief Drops the directory table if the address belongs to
+ * the mount point it is bound to, it is loaded again on next
+ * use
+ *
+ * @param addr An address in the NVM
+ */
+void
+xipfs_dirtab_invalidate(const void *addr)
+{
+    if (xipfs_dirtab.mp != NULL &&
+        (uintptr_t)addr >= xipfs_dirtab.start &&
+        (uintptr_t)addr < xipfs_dirtab.end) {
+        xipfs_dirtab.valid = 0;
+    }
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Binds the directory table to a mount point, reading
+ * it from the file system unless it is already loaded
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_dirtab_load(xipfs_mount_t *mp)
+{
+    xipfs_file_t *table;
+
+    assert(mp != NULL);
+
+    /* the mount point structure may have been set up again for
+     * other pages */
+    if (xipfs_dirtab.mp == mp && xipfs_dirtab.valid == 1 &&
+        xipfs_dirtab.start == (uintptr_t)mp->page_addr &&
+        xipfs_dirtab.end == xipfs_dirtab.start +
+            mp->page_num * XIPFS_NVM_PAGE_SIZE) {
+        return 0;
+    }
+
+    (void)memset(&xipfs_dirtab, 0, sizeof(xipfs_dirtab));
+    xipfs_errno = XIPFS_OK;
+    if ((table = xipfs_fs_table(mp, XIPFS_DIRTAB_TABLE)) == NULL) {
+        if (xipfs_errno != XIPFS_OK) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    } else if (xipfs_dirtab_replay(table) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_dirtab_verify(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_dirtab.mp = mp;
+    xipfs_dirtab.start = (uintptr_t)mp->page_addr;
+    xipfs_dirtab.end = xipfs_dirtab.start +
+        mp->page_num * XIPFS_NVM_PAGE_SIZE;
+    xipfs_dirtab.valid = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Updates the directory table after a file was moved
+ *
+ * @param from The former address of the moved file
+ *
+ * @param to The new address of the moved file
+ */
+void
+xipfs_dirtab_move(xipfs_file_t *from, xipfs_file_t *to)
+{
+    if (xipfs_dirtab.table == from) {
+        xipfs_dirtab.table = to;
+    }
+}
+
+/**
+ * @pre The directory table must be loaded for the mount point
+ * of the file
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Retrieves the whole path of a file
+ *
+ * @param filp A pointer to the xipfs file structure
+ *
+ * @param buf A pointer to a memory region of XIPFS_PATH_MAX
+ * bytes where to build the path if needed
+ *
+ * @return Returns a pointer to the path of the file
+ */
+const char *
+xipfs_dirtab_path(const xipfs_file_t *filp, char *buf)
+{
+    unsigned ids[XIPFS_PATH_MAX / 2];
+    xipfs_dirtab_dir_t *dirp;
+    const char *path;
+    size_t depth, len;
+    unsigned id;
+
+    path = xipfs_file_get_path(filp);
+    if (path[0] != XIPFS_DIRTAB_ENTRY) {
+        return path;
+    }
+
+    depth = 0;
+    for (id = (uint8_t)path[1]; id != 0;
+            id = xipfs_dirtab_dir(id)->parent) {
+        assert(depth < XIPFS_PATH_MAX / 2);
+        ids[depth++] = id;
+    }
+    len = 0;
+    buf[len++] = '/';
+    while (depth > 0) {
+        dirp = xipfs_dirtab_dir(ids[--depth]);
+        assert(len + dirp->len + 1 < XIPFS_PATH_MAX);
+        (void)memcpy(&buf[len], dirp->name, dirp->len);
+        len += dirp->len;
+        buf[len++] = '/';
+    }
+    assert(len + strlen(&path[2]) < XIPFS_PATH_MAX);
+    (void)strcpy(&buf[len], &path[2]);
+
+    return buf;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre The paths of the specifications must be null-terminated,
+ * start with a slash, normalized, and be shorter than
+ * XIPFS_PATH_MAX
+ *
+ * @brief Makes room in the directory table for the directories
+ * of the files to create, so that no file is created while the
+ * files are placed. The pages of removed files may be reclaimed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param specs The specifications of the files to create
+ *
+ * @param n The number of specifications
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_dirtab_prepare(xipfs_mount_t *mp, const xipfs_file_spec_t specs[],
+                     size_t n)
+{
+    size_t i, j, k, l, count, pass;
+    const char *path;
+    unsigned id;
+
+    if (xipfs_dirtab_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+        /* count the distinct directories not in the table */
+        count = 0;
+        for (i = 0; i < n; i++) {
+            path = specs[i].path;
+            k = strlen(path) - 1;
+            if (xipfs_dirtab_walk(path, k, &id) == 0) {
+                continue;
+            }
+            for (j = 1; j < k; j++) {
+                if (path[j] != '/') {
+                    continue;
+                }
+                /* each directory is allocated once */
+                if (xipfs_dirtab_walk(path, j + 1, &id) == 0) {
+                    continue;
+                }
+                for (l = 0; l < i; l++) {
+                    if (strlen(specs[l].path) > j + 1 &&
+                        strncmp(specs[l].path, path, j + 1) == 0) {
+                        break;
+                    }
+                }
+                if (l == i) {
+                    count++;
+                }
+            }
+        }
+        if (xipfs_dirtab_fits(count, count)) {
+            return 0;
+        }
+        if (pass == 0 && xipfs_dirtab_fold(mp, 1) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    xipfs_errno = XIPFS_ENOSPACE;
+
+    return -1;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre to must not be below from
+ *
+ * @brief Renames a directory by updating its record of the
+ * table, the files below it follow without being rewritten
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param from The path of the directory to rename
+ *
+ * @param to The new path of the directory
+ *
+ * @return Returns the number of files below the directory, zero
+ * if the directory is not in the table and its files have to be
+ * renamed one by one, or a negative value otherwise
+ */
+int
+xipfs_dirtab_rename(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    char buf[XIPFS_PATH_MAX];
+    size_t from_len, to_len, len, longest, slash;
+    xipfs_file_t *filp, *self;
+    xipfs_dirtab_dir_t *dirp;
+    unsigned id, target;
+    const char *path;
+    int parent, count;
+
+    if (xipfs_dirtab_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    from_len = strlen(from);
+    to_len = strlen(to);
+    if (from_len < 2 || from[from_len-1] != '/' ||
+        to_len < 2 || to[to_len-1] != '/') {
+        return 0;
+    }
+    if (xipfs_dirtab_walk(from, from_len, &id) != 0 || id == 0) {
+        return 0;
+    }
+
+    /* the renamed paths must still fit */
+    count = 0;
+    longest = 0;
+    self = NULL;
+    xipfs_errno = XIPFS_OK;
+    if ((filp = xipfs_fs_head(mp)) != NULL) {
+        do {
+            path = xipfs_dirtab_path(filp, buf);
+            if (strncmp(path, from, from_len) != 0) {
+                continue;
+            }
+            if (path[from_len] == '\0') {
+                /* the file standing for the directory itself */
+                self = filp;
+            }
+            if ((len = strlen(path)) > longest) {
+                longest = len;
+            }
+            count++;
+        } while ((filp = xipfs_fs_next(filp)) != NULL);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (longest - from_len + to_len >= XIPFS_PATH_MAX) {
+        xipfs_errno = XIPFS_ENULTER;
+        return -1;
+    }
+    slash = xipfs_dirtab_parent(to, to_len);
+    if (to_len - slash - 2 > XIPFS_DIRTAB_NAME_MAX) {
+        xipfs_errno = XIPFS_ENULTER;
+        return -1;
+    }
+
+    if (xipfs_dirtab_room(mp, XIPFS_DIRTAB_RESERVE, 1, 0) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if ((parent = xipfs_dirtab_ensure(mp, to, slash + 1)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_dirtab_walk(from, from_len, &id) != 0 || id == 0) {
+        /* no file was below the directory, the table was folded
+         * without it */
+        if (self != NULL && xipfs_fs_rename(mp, self, to) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        return count;
+    }
+    assert(xipfs_dirtab_below((unsigned)parent, id) == 0);
+    /* a directory left over by former files */
+    target = xipfs_dirtab_child((unsigned)parent, &to[slash + 1],
+        to_len - slash - 2);
+    if (target != 0) {
+        xipfs_dirtab_release_dirs(target);
+        if (xipfs_dirtab_append(target) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    dirp = xipfs_dirtab_dir(id);
+    dirp->parent = (uint8_t)parent;
+    dirp->len = (uint8_t)(to_len - slash - 2);
+    (void)memcpy(dirp->name, &to[slash + 1], dirp->len);
+    if (xipfs_dirtab_append(id) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_index_invalidate(mp->page_addr);
+
+    if (self != NULL) {
+        if (xipfs_fs_rename(mp, self, to) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Makes room in the directory table for the records of
+ * one operation, so that the table is not rewritten while the
+ * operation holds pointers to files. The pages of removed files
+ * may be reclaimed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_dirtab_reserve(xipfs_mount_t *mp)
+{
+    if (xipfs_dirtab_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_dirtab.table == NULL) {
+        /* the table is created with the first directory */
+        return 0;
+    }
+
+    return xipfs_dirtab_room(mp, XIPFS_DIRTAB_RESERVE, 1, 1);
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Checks whether a file holds the directory table
+ *
+ * @param filp A pointer to the xipfs file structure
+ *
+ * @return Returns one if the file holds the directory table or
+ * zero otherwise
+ */
+int
+xipfs_dirtab_table(const xipfs_file_t *filp)
+{
+    return filp->path[0] == XIPFS_DIRTAB_TABLE;
+}
+
+#else /* XIPFS_DIR_TABLE_SIZE > 0 */
+
+int
+xipfs_dirtab_check(const char *path)
+{
+    return xipfs_file_path_check(path);
+}
+
+int
+xipfs_dirtab_encode(xipfs_mount_t *mp, const char *path, char *raw)
+{
+    (void)mp;
+
+    if (strnlen(path, XIPFS_PATH_MAX) == XIPFS_PATH_MAX) {
+        xipfs_errno = XIPFS_ENULTER;
+        return -1;
+    }
+    (void)strcpy(raw, path);
+
+    return 0;
+}
+
+int
+xipfs_dirtab_fit(xipfs_mount_t *mp, const char *path)
+{
+    (void)mp;
+    (void)path;
+
+    return 0;
+}
+
+int
+xipfs_dirtab_is(const xipfs_file_t *filp, const char *path)
+{
+    return strcmp(xipfs_file_get_path(filp), path) == 0;
+}
+
+void
+xipfs_dirtab_invalidate(const void *addr)
+{
+    (void)addr;
+}
+
+int
+xipfs_dirtab_load(xipfs_mount_t *mp)
+{
+    (void)mp;
+
+    return 0;
+}
+
+void
+xipfs_dirtab_move(xipfs_file_t *from, xipfs_file_t *to)
+{
+    (void)from;
+    (void)to;
+}
+
+const char *
+xipfs_dirtab_path(const xipfs_file_t *filp, char *buf)
+{
+    (void)buf;
+
+    return xipfs_file_get_path(filp);
+}
+
+int
+xipfs_dirtab_prepare(xipfs_mount_t *mp, const xipfs_file_spec_t specs[],
+                     size_t n)
+{
+    (void)mp;
+    (void)specs;
+    (void)n;
+
+    return 0;
+}
+
+int
+xipfs_dirtab_rename(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    (void)mp;
+    (void)from;
+    (void)to;
+
+    return 0;
+}
+
+int
+xipfs_dirtab_reserve(xipfs_mount_t *mp)
+{
+    (void)mp;
+
+    return 0;
+}
+
+int
+xipfs_dirtab_table(const xipfs_file_t *filp)
+{
+    (void)filp;
+
+    return 0;
+}
+
+#endif /* XIPFS_DIR_TABLE_SIZE > 0 */
@@ -55,10 +55,14 @@
  */
 #include "include/buffer.h"
 #include "include/desc.h"
+#include "include/dirtab.h"
+#include "include/emptydir.h"
 #include "include/errno.h"
 #include "include/file.h"
 #include "include/flash.h"
 #include "include/fs.h"
+#include "include/index.h"
+#include "include/pack.h"
 #include "include/path.h"
 #include "include/xipfs.h"
 
@@ -101,6 +105,18 @@
  */
 #define UNUSED(x) ((void)(x))
 
+/**
+ * @internal
+ *
+ * @def EMPTY_DIR_RESERVED
+ *
+ * @brief The number of bytes reserved by the file that keeps an
+ * empty directory
+ */
+#define EMPTY_DIR_RESERVED \
+    ((XIPFS_NVM_PAGE_SIZE + sizeof(xipfs_file_t) + \
+      XIPFS_NVM_PAGE_SIZE - 1) / XIPFS_NVM_PAGE_SIZE * XIPFS_NVM_PAGE_SIZE)
+
 /*
  * Helper functions
  */
@@ -178,9 +194,9 @@ basename(char *base, const char *path)
  * accessible memory region
  *
  * @brief Remove a file by flushing the read/write buffer,
- * consolidating the file system, and updating the internal
- * xipfs file addresses of all open VFS file descriptor
- * structures
+ * marking the file as removed, and closing the open VFS
+ * descriptor structures that refer to it. The descriptors of
+ * the other files are updated by the garbage collection
  *
  * @param xipfs_mp A pointer to a memory region containing an
  * xipfs mount point structure
@@ -195,19 +211,17 @@ basename(char *base, const char *path)
 static int
 sync_remove_file(xipfs_mount_t *mp, xipfs_file_t *filp)
 {
-    xipfs_file_position_t reserved;
-
     assert(mp != NULL);
     assert(filp != NULL);
 
     if (xipfs_buffer_flush() < 0) {
         return -1;
     }
-    reserved = filp->reserved;
-    if (xipfs_fs_remove(filp) < 0) {
+    if (xipfs_fs_remove(mp, filp) < 0) {
         return -1;
     }
-    xipfs_desc_update(mp, filp, reserved);
+    /* the removed file does not move yet */
+    xipfs_desc_move(mp, filp, NULL);
 
     return 0;
 }
@@ -215,383 +229,2140 @@ sync_remove_file(xipfs_mount_t *mp, xipfs_file_t *filp)
 /**
  * @internal
  *
- * @brief Checks if the xipfs mount point structure passed as
- * an argument is valid
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Reclaims the pages of the files marked as removed
+ * before an operation returns, so that no marked file is left
+ * in flash, unless XIPFS_GC_DEFERRED leaves them to the garbage
+ * collection. The files that follow them move, along with the
+ * open descriptors
  *
  * @param xipfs_mp A pointer to a memory region containing an
  * xipfs mount point structure
  *
- * @return Returns zero if the xipfs mount point structure
- * passed as an argument is valid or a negative value otherwise
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
  */
 static int
-xipfs_mp_check(const xipfs_mount_t *mp)
+reclaim_removed(xipfs_mount_t *mp)
 {
-    unsigned int page;
+    assert(mp != NULL);
 
-    if (mp == NULL) {
-        return -EFAULT;
-    }
-    if (mp->magic != XIPFS_MAGIC) {
-        return -EINVAL;
-    }
-    if ( (mp->mount_path == NULL) ||
-         (mp->mount_path[0] == '\0') ||
-         ((mp->mount_path[0] == '/') && mp->mount_path[1] == '\0') ) {
-        return -EINVAL;
-    }
-    if (!xipfs_flash_in(mp->page_addr)) {
-        return -EINVAL;
-    }
-    if (mp->page_num == 0) {
-        return -EINVAL;
+#if XIPFS_GC_DEFERRED == 0
+    if (xipfs_fs_gc(mp) < 0) {
+        return -1;
     }
-#if (XIPFS_NVM_NUMOF <= 0)
-#error "XIPFS_NVM_NUMOF <= 0"
-#endif
+#else /* XIPFS_GC_DEFERRED == 0 */
+    (void)mp;
+#endif /* XIPFS_GC_DEFERRED == 0 */
 
-#if (XIPFS_NVM_PAGE_SIZE <= 0)
-#error "XIPFS_NVM_PAGE_SIZE <= 0"
-#endif
-
-#if (! (XIPFS_FILE_POSITION_MAX > (0U)) )
-#error "XIPFS_FILE_POSITION_MAX <= 0"
-#endif
-    const size_t filesystem_max_pages_count = (size_t)XIPFS_FILE_POSITION_MAX / (size_t)XIPFS_NVM_PAGE_SIZE;
-    if (filesystem_max_pages_count == 0) {
-        return -EINVAL;
-    }
-    if (filesystem_max_pages_count < (size_t)XIPFS_NVM_NUMOF) {
-        return -EINVAL;
-    }
-    if (mp->page_num > (size_t)XIPFS_NVM_NUMOF) {
-        return -EINVAL;
-    }
-    /* Given that :
-     * - mp->page_num is a size_t,
-     * - xipfs_nvm_page returns an unsigned int,
-     * - both xipfs_fs_free_pages and xipfs_fs_get_page_number return an int,
-     * - (size_t)INT_MAX < (size_t)UINT_MAX <= SIZE_MAX,
-     * just ensure that mountpoint's page_num is less than INT_MAX to be consistent.
-     */
-    if (mp->page_num > (size_t)INT_MAX) {
-        return -EINVAL;
-    }
-    /*
-     * Because :
-     * - mp->page_num is a size_t,
-     * - both xipfs_fs_free_pages and xipfs_fs_get_page_number return an int,
-     * - (size_t)INT_MAX < (size_t)UINT_MAX <= SIZE_MAX,
-     * let's check that xipfs_nvm_page does not return values greater than INT_MAX.
-     */
-    page = xipfs_nvm_page(mp->page_addr);
-    if (page > (unsigned int)INT_MAX) {
-        return -EINVAL;
-    }
-    /* Check that the nvm range defined by the mountpoint is in the maximum
-     * pages count supported by the NVM.
-     */
-    if (((unsigned int)XIPFS_NVM_NUMOF - page) < mp->page_num) {
-        return -EINVAL;
-    }
+    return 0;
+}
 
-    if (mp->mutex == NULL) {
-        return -EINVAL;
-    }
+/**
+ * @internal
+ *
+ * @pre dirname and path must be pointers that reference
+ * null-terminated paths
+ *
+ * @brief Compares the path of an entry with the path of the
+ * directory being read
+ *
+ * @param dirname The path of the directory, ending with a slash
+ *
+ * @param path The path of the entry
+ *
+ * @return Returns the length of the common prefix of both
+ * paths, which is the length of dirname if the entry is in the
+ * directory, or XIPFS_PATH_MAX if a path is not null-terminated
+ */
+static size_t
+dirent_prefix(const char *dirname, const char *path)
+{
+    size_t i;
 
-    if (mp->execution_mutex == NULL) {
-        return -EINVAL;
+    i = 0;
+    while (i < XIPFS_PATH_MAX) {
+        if (path[i] != dirname[i]) {
+            break;
+        }
+        if (dirname[i] == '\0') {
+            break;
+        }
+        if (path[i] == '\0') {
+            break;
+        }
+        i++;
     }
 
-    return 0;
+    return i;
 }
 
 /**
  * @internal
  *
- * @pre should be call after xipfs_mp_check
+ * @pre path must be the path of an entry of a directory whose
+ * path is i characters long
+ *
+ * @brief Copies the name of the component of a path that
+ * follows its directory, with a trailing slash if the component
+ * is a directory
+ *
+ * @param direntp A pointer to the directory entry to fill
+ *
+ * @param path The path of the entry
+ *
+ * @param i The length of the path of the directory
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value if the path is not null-terminated
  */
 static int
-xipfs_file_desc_check(const xipfs_mount_t *mp, const xipfs_file_desc_t *descp)
+dirent_name(xipfs_dirent_t *direntp, const char *path, size_t i)
 {
-    uintptr_t start, end, filp;
-
-    assert(mp != NULL);
+    size_t j;
 
-    start = (uintptr_t)mp->page_addr;
-    end = start + mp->page_num * XIPFS_NVM_PAGE_SIZE;
-
-    if (descp == NULL) {
-        return -EFAULT;
-    }
-    if (descp->filp == NULL) {
-        return -EINVAL;
+    if (path[i] == '/') {
+        /* skip first slash */
+        i++;
     }
-    filp = (uintptr_t)descp->filp;
-    if (!(filp >= start && filp < end)) {
-        return -EINVAL;
-    }
-    /*
-     * Since xipfs_file_position_t is a signed type, ensure that
-     * the position is equal to or greater than zero.
-     */
-    if (descp->pos < 0) {
-        return -EINVAL;
+    j = i;
+    while (j < XIPFS_PATH_MAX) {
+        if (path[j] == '\0') {
+            direntp->dirname[j-i] = '\0';
+            break;
+        }
+        if (path[j] == '/') {
+            direntp->dirname[j-i] = '/';
+            direntp->dirname[j-i+1] = '\0';
+            break;
+        }
+        direntp->dirname[j-i] = path[j];
+        j++;
     }
-    if (!((descp->flags & O_CREAT)  == O_CREAT  ||
-          (descp->flags & O_EXCL)   == O_EXCL   ||
-          (descp->flags & O_WRONLY) == O_WRONLY ||
-          (descp->flags & O_RDONLY) == O_RDONLY ||
-          (descp->flags & O_RDWR)   == O_RDWR   ||
-          (descp->flags & O_APPEND) == O_APPEND))
-    {
-        return -EINVAL;
+    if (j == XIPFS_PATH_MAX) {
+        return -1;
     }
 
     return 0;
 }
 
-/*
- * Operations on open files
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre dirname must be the path of a directory that lost its
+ * last entry, ending with a slash
+ *
+ * @brief Keeps an empty directory, as a record of the log of
+ * the empty directories if there is room for it or as a file of
+ * its own otherwise
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param dirname The path of the directory
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
  */
-
-int
-xipfs_close(xipfs_mount_t *mp, xipfs_file_desc_t *descp)
+static int
+keep_dir(xipfs_mount_t *mp, const char *dirname)
 {
-    xipfs_file_position_t size;
-    int ret;
+    assert(mp != NULL);
+    assert(dirname != NULL);
 
-    if ((ret = xipfs_mp_check(mp)) < 0) {
-        return ret;
-    }
-    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
-        /* nothing to do */
+#if XIPFS_EMPTY_DIR_LOG > 0
+    if (xipfs_emptydir_add(mp, dirname) == 0) {
         return 0;
     }
-    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
-        return ret;
-    }
-    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
-        return ret;
-    }
-    if ((size = xipfs_file_get_size(descp->filp)) < 0) {
-        return -EIO;
-    }
-    if (size < descp->pos) {
-        /* synchronise file size */
-        if (xipfs_file_set_size(descp->filp, descp->pos) < 0) {
-            return -EIO;
-        }
+    if (xipfs_errno != XIPFS_ENOSPACE) {
+        /* xipfs_errno was set */
+        return -1;
     }
-    if ((ret = xipfs_file_desc_untrack(descp)) < 0) {
-        return ret;
+#endif /* XIPFS_EMPTY_DIR_LOG > 0 */
+    if (xipfs_fs_new_file(mp, dirname, XIPFS_NVM_PAGE_SIZE, 0) == NULL) {
+        /* xipfs_errno was set */
+        return -1;
     }
 
     return 0;
 }
 
-int
-xipfs_fstat(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
-            struct stat *buf)
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre xipath must be a pointer to an xipfs path structure
+ * about to be created
+ *
+ * @brief Drops what keeps the parent directory of an xipfs path
+ * while it is empty, the record of the directory or the file
+ * that marks it if the file holds no packed file
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param xipath A pointer to a memory region containing an
+ * xipfs path structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+fill_dir(xipfs_mount_t *mp, const xipfs_path_t *xipath)
 {
-    off_t size, reserved;
-    int ret;
+    assert(mp != NULL);
+    assert(xipath != NULL);
 
-    if (buf == NULL) {
-        return -EFAULT;
-    }
-    if ((ret = xipfs_mp_check(mp)) < 0) {
-        return ret;
-    }
-    if ( (descp != NULL) &&
-         ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) ) {
-        /* cannot fstat(2) */
-        return -EBADF;
-    }
-    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
-        return ret;
-    }
-    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
-        return ret;
+    if (xipath->witness == NULL || (xipath->dirname[0] == '/' &&
+            xipath->dirname[1] == '\0')) {
+        return 0;
     }
-    if ((size = (off_t)xipfs_file_get_size(descp->filp)) < 0) {
-        return -EIO;
+    if (xipfs_emptydir_remove(mp, xipath->dirname) < 0) {
+        /* xipfs_errno was set */
+        return -1;
     }
-    if ((reserved = (off_t)xipfs_file_get_reserved(descp->filp)) < 0) {
-        return -EIO;
+    if (xipfs_dirtab_is(xipath->witness, xipath->dirname) &&
+        xipfs_pack_count(xipath->witness) == 0) {
+        if (sync_remove_file(mp, xipath->witness) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
     }
 
-    (void)memset(buf, 0, sizeof(*buf));
-    buf->st_dev = (dev_t)(uintptr_t)mp;
-    buf->st_ino = (ino_t)(uintptr_t)descp->filp;
-    buf->st_mode = S_IFREG;
-    buf->st_nlink = 1;
-    buf->st_size = MAX(size, (off_t)descp->pos);
-    buf->st_blksize = XIPFS_NVM_PAGE_SIZE;
-    buf->st_blocks = reserved / XIPFS_NVM_PAGE_SIZE;
-
     return 0;
 }
 
-off_t
-xipfs_lseek(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
-            off_t off, int whence)
-{
-    off_t max_pos, new_pos, size;
-    int ret;
-
-    if ((ret = xipfs_mp_check(mp)) < 0) {
-        return ret;
-    }
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre specs must hold at least one specification
+ *
+ * @brief Checks the specifications of xipfs_new_files(3) and
+ * resolves all their paths with a single pass over the file
+ * system, which takes an xipfs path structure per specification
+ * on the stack
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param specs The specifications of the files to create
+ *
+ * @param n The number of specifications
+ *
+ * @param pages A pointer to the number of pages the files
+ * reserve
+ *
+ * @param placeholders A pointer to the number of files that
+ * mark the directories of the files, removed once the files fit
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * errno value otherwise
+ */
+static int
+check_new_files(xipfs_mount_t *mp, const xipfs_file_spec_t specs[],
+                size_t n, size_t *pages, size_t *placeholders)
+{
+    xipfs_path_t xipaths[n];
+    const char *paths[n];
+    size_t len, i, k;
+
+    assert(mp != NULL);
+    assert(specs != NULL);
+    assert(n > 0);
+
+    *pages = 0;
+    *placeholders = 0;
+    for (i = 0; i < n; i++) {
+        paths[i] = specs[i].path;
+        if (paths[i] == NULL) {
+            return -EFAULT;
+        }
+        if (paths[i][0] == '\0') {
+            return -ENOENT;
+        }
+        if (paths[i][0] == '/' && paths[i][1] == '\0') {
+            return -EISDIR;
+        }
+        len = strnlen(paths[i], XIPFS_PATH_MAX);
+        if (len == XIPFS_PATH_MAX) {
+            return -ENAMETOOLONG;
+        }
+        if (specs[i].exec != 0 && specs[i].exec != 1) {
+            return -EINVAL;
+        }
+        if (specs[i].size < 0 || (size_t)specs[i].size >
+                XIPFS_FILE_POSITION_MAX_AS_SIZE_T -
+                sizeof(xipfs_file_t)) {
+            return -EINVAL;
+        }
+        *pages += ((size_t)specs[i].size + sizeof(xipfs_file_t) +
+            XIPFS_NVM_PAGE_SIZE - 1) / XIPFS_NVM_PAGE_SIZE;
+        for (k = 0; k < i; k++) {
+            if (strcmp(specs[k].path, paths[i]) == 0) {
+                return -EEXIST;
+            }
+        }
+    }
+    if (xipfs_path_new_n(mp, xipaths, paths, n) < 0) {
+        return -EIO;
+    }
+    for (i = 0; i < n; i++) {
+        switch (xipaths[i].info) {
+        case XIPFS_PATH_EXISTS_AS_FILE:
+            return -EEXIST;
+        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+            return -EISDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+            return -ENOTDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+            return -ENOENT;
+        case XIPFS_PATH_CREATABLE:
+            break;
+        default:
+            return -EIO;
+        }
+        if (xipaths[i].path[xipaths[i].len-1] == '/') {
+            return -EISDIR;
+        }
+        if (xipaths[i].witness != NULL && !(xipaths[i].dirname[0] ==
+                '/' && xipaths[i].dirname[1] == '\0')) {
+            if (xipfs_dirtab_is(xipaths[i].witness,
+                    xipaths[i].dirname) &&
+                xipfs_pack_count(xipaths[i].witness) == 0) {
+                /* one page per directory, whatever the number
+                 * of files created in it */
+                len = (size_t)(strrchr(paths[i], '/') - paths[i]) + 1;
+                for (k = 0; k < i; k++) {
+                    if (strncmp(specs[k].path, paths[i], len) == 0 &&
+                        strchr(specs[k].path + len, '/') == NULL) {
+                        break;
+                    }
+                }
+                if (k == i) {
+                    (*placeholders)++;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Removes, in a single pass, the files that mark the
+ * directories where xipfs_new_files(3) creates a file
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param specs The specifications of the files to create
+ *
+ * @param n The number of specifications
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+remove_placeholders(xipfs_mount_t *mp, const xipfs_file_spec_t specs[],
+                    size_t n)
+{
+    char buf[XIPFS_PATH_MAX];
+    xipfs_file_t *filp, *next;
+    const char *path;
+    size_t len, i;
+
+    assert(mp != NULL);
+    assert(specs != NULL);
+
+    xipfs_errno = XIPFS_OK;
+    filp = xipfs_fs_head(mp);
+    while (filp != NULL) {
+        next = xipfs_fs_next(filp);
+        path = xipfs_dirtab_path(filp, buf);
+        len = strnlen(path, XIPFS_PATH_MAX);
+        if (len > 0 && path[len-1] == '/') {
+            for (i = 0; i < n; i++) {
+                if (strncmp(specs[i].path, path, len) == 0 &&
+                    strchr(specs[i].path + len, '/') == NULL) {
+                    break;
+                }
+            }
+            if (i < n && xipfs_pack_count(filp) == 0) {
+                if (sync_remove_file(mp, filp) < 0) {
+                    return -1;
+                }
+            }
+        }
+        filp = next;
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre xipath must be a pointer to an xipfs path structure
+ * whose parent directory lost a packed file
+ *
+ * @brief Removes the file that marks the parent directory of
+ * an xipfs path once it holds no packed file, unless it is the
+ * single page that keeps the directory
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param xipath A pointer to a memory region containing an
+ * xipfs path structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * errno value otherwise
+ */
+static int
+unpack_dir(xipfs_mount_t *mp, const xipfs_path_t *xipath)
+{
+    assert(mp != NULL);
+    assert(xipath != NULL);
+
+    if (xipath->dir == NULL || xipfs_pack_count(xipath->dir) > 0) {
+        return 0;
+    }
+    /* a small file that marks the directory keeps it as a new
+     * one would, unless the log keeps it for less */
+    if (XIPFS_EMPTY_DIR_LOG == 0 && xipath->parent == 1 &&
+        (size_t)xipath->dir->reserved <= EMPTY_DIR_RESERVED) {
+        return 0;
+    }
+    if (sync_remove_file(mp, xipath->dir) < 0) {
+        return -EIO;
+    }
+    if (xipath->parent == 1) {
+        if (keep_dir(mp, xipath->dirname) < 0) {
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Removes a file, keeping its parent directory if the
+ * file was its last entry. The pages of the file are reclaimed
+ * by the garbage collection
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param name The path of the file to remove
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * errno value otherwise
+ */
+static int
+unlink_file(xipfs_mount_t *mp, const char *name)
+{
+    xipfs_path_t xipath;
+    size_t len;
+
+    assert(mp != NULL);
+
+    if (name == NULL) {
+        return -EFAULT;
+    }
+    if (name[0] == '\0') {
+        return -ENOENT;
+    }
+    if (name[0] == '/' && name[1] == '\0') {
+        return -EISDIR;
+    }
+    len = strnlen(name, XIPFS_PATH_MAX);
+    if (len == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
+
+    if (xipfs_path_new(mp, &xipath, name) < 0) {
+        return -EIO;
+    }
+    switch (xipath.info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+        break;
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+        return -EISDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+    case XIPFS_PATH_CREATABLE:
+        return -ENOENT;
+    default:
+        return -EIO;
+    }
+
+    if (xipath.packed >= 0) {
+        if (xipfs_pack_remove(mp, xipath.witness, xipath.packed) < 0) {
+            return -EIO;
+        }
+        return unpack_dir(mp, &xipath);
+    }
+    if (sync_remove_file(mp, xipath.witness) < 0) {
+        return -EIO;
+    }
+    if (xipath.parent == 1 && !(xipath.dirname[0] ==
+            '/' && xipath.dirname[1] == '\0')) {
+        if (keep_dir(mp, xipath.dirname) < 0) {
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks if the xipfs mount point structure passed as
+ * an argument is valid
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the xipfs mount point structure
+ * passed as an argument is valid or a negative value otherwise
+ */
+static int
+xipfs_mp_check(const xipfs_mount_t *mp)
+{
+    unsigned int page;
+
+    if (mp == NULL) {
+        return -EFAULT;
+    }
+    if (mp->magic != XIPFS_MAGIC) {
+        return -EINVAL;
+    }
+    if ( (mp->mount_path == NULL) ||
+         (mp->mount_path[0] == '\0') ||
+         ((mp->mount_path[0] == '/') && mp->mount_path[1] == '\0') ) {
+        return -EINVAL;
+    }
+    if (!xipfs_flash_in(mp->page_addr)) {
+        return -EINVAL;
+    }
+    if (mp->page_num == 0) {
+        return -EINVAL;
+    }
+#if (XIPFS_NVM_NUMOF <= 0)
+#error "XIPFS_NVM_NUMOF <= 0"
+#endif
+
+#if (XIPFS_NVM_PAGE_SIZE <= 0)
+#error "XIPFS_NVM_PAGE_SIZE <= 0"
+#endif
+
+#if (! (XIPFS_FILE_POSITION_MAX > (0U)) )
+#error "XIPFS_FILE_POSITION_MAX <= 0"
+#endif
+    const size_t filesystem_max_pages_count = (size_t)XIPFS_FILE_POSITION_MAX / (size_t)XIPFS_NVM_PAGE_SIZE;
+    if (filesystem_max_pages_count == 0) {
+        return -EINVAL;
+    }
+    if (filesystem_max_pages_count < (size_t)XIPFS_NVM_NUMOF) {
+        return -EINVAL;
+    }
+    if (mp->page_num > (size_t)XIPFS_NVM_NUMOF) {
+        return -EINVAL;
+    }
+    /* Given that :
+     * - mp->page_num is a size_t,
+     * - xipfs_nvm_page returns an unsigned int,
+     * - both xipfs_fs_free_pages and xipfs_fs_get_page_number return an int,
+     * - (size_t)INT_MAX < (size_t)UINT_MAX <= SIZE_MAX,
+     * just ensure that mountpoint's page_num is less than INT_MAX to be consistent.
+     */
+    if (mp->page_num > (size_t)INT_MAX) {
+        return -EINVAL;
+    }
+    /*
+     * Because :
+     * - mp->page_num is a size_t,
+     * - both xipfs_fs_free_pages and xipfs_fs_get_page_number return an int,
+     * - (size_t)INT_MAX < (size_t)UINT_MAX <= SIZE_MAX,
+     * let's check that xipfs_nvm_page does not return values greater than INT_MAX.
+     */
+    page = xipfs_nvm_page(mp->page_addr);
+    if (page > (unsigned int)INT_MAX) {
+        return -EINVAL;
+    }
+    /* Check that the nvm range defined by the mountpoint is in the maximum
+     * pages count supported by the NVM.
+     */
+    if (((unsigned int)XIPFS_NVM_NUMOF - page) < mp->page_num) {
+        return -EINVAL;
+    }
+
+    if (mp->mutex == NULL) {
+        return -EINVAL;
+    }
+
+    if (mp->execution_mutex == NULL) {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre should be call after xipfs_mp_check
+ */
+static int
+xipfs_file_desc_check(const xipfs_mount_t *mp, const xipfs_file_desc_t *descp)
+{
+    uintptr_t start, end, filp;
+
+    assert(mp != NULL);
+
+    start = (uintptr_t)mp->page_addr;
+    end = start + mp->page_num * XIPFS_NVM_PAGE_SIZE;
+
+    if (descp == NULL) {
+        return -EFAULT;
+    }
+    if (descp->filp == NULL) {
+        return -EINVAL;
+    }
+    filp = (uintptr_t)descp->filp;
+    if (!(filp >= start && filp < end)) {
+        return -EINVAL;
+    }
+    /*
+     * Since xipfs_file_position_t is a signed type, ensure that
+     * the position is equal to or greater than zero.
+     */
+    if (descp->pos < 0) {
+        return -EINVAL;
+    }
+    if (descp->packed < -1) {
+        return -EINVAL;
+    }
+    if (descp->end < 0) {
+        return -EINVAL;
+    }
+    if (!((descp->flags & O_CREAT)  == O_CREAT  ||
+          (descp->flags & O_EXCL)   == O_EXCL   ||
+          (descp->flags & O_WRONLY) == O_WRONLY ||
+          (descp->flags & O_RDONLY) == O_RDONLY ||
+          (descp->flags & O_RDWR)   == O_RDWR   ||
+          (descp->flags & O_APPEND) == O_APPEND))
+    {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Computes the end of the bytes written through a file
+ * descriptor, whose size is recorded when the file is closed or
+ * synchronised
+ *
+ * @param descp The file descriptor
+ *
+ * @return Returns the position or the end of the bytes written
+ * with xipfs_pwrite(3), whichever is the greatest
+ */
+static xipfs_file_position_t
+xipfs_file_desc_end(const xipfs_file_desc_t *descp)
+{
+    assert(descp != NULL);
+
+    return MAX(descp->pos, descp->end);
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks the segments of a vectored read or write and
+ * computes their total length
+ *
+ * @param iov The segments to check
+ *
+ * @param iovcnt The number of segments
+ *
+ * @param len A pointer where to store the total length
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+static int
+xipfs_iov_check(const xipfs_iovec_t iov[], int iovcnt, size_t *len)
+{
+    int i;
+
+    if (iovcnt < 0) {
+        return -EINVAL;
+    }
+    if (iov == NULL && iovcnt > 0) {
+        return -EFAULT;
+    }
+    *len = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].base == NULL && iov[i].len > 0) {
+            return -EFAULT;
+        }
+        if (iov[i].len > XIPFS_FILE_POSITION_MAX_AS_SIZE_T - *len) {
+            return -EINVAL;
+        }
+        *len += iov[i].len;
+    }
+
+    return 0;
+}
+
+/*
+ * Operations on open files
+ */
+
+int
+xipfs_close(xipfs_mount_t *mp, xipfs_file_desc_t *descp)
+{
+    xipfs_file_position_t size;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
+        /* nothing to do */
+        return 0;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return ret;
+    }
+    if (descp->packed < 0) {
+        if ((size = xipfs_file_get_size(descp->filp)) < 0) {
+            return -EIO;
+        }
+        if (size < xipfs_file_desc_end(descp)) {
+            /* synchronise file size */
+            if (xipfs_file_set_size(descp->filp,
+                    xipfs_file_desc_end(descp)) < 0) {
+                return -EIO;
+            }
+        }
+    }
+    if ((ret = xipfs_file_desc_untrack(descp)) < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+int
+xipfs_fstat(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+            struct stat *buf)
+{
+    off_t size, reserved;
+    size_t packed_size;
+    int ret;
+
+    if (buf == NULL) {
+        return -EFAULT;
+    }
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ( (descp != NULL) &&
+         ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) ) {
+        /* cannot fstat(2) */
+        return -EBADF;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return ret;
+    }
+    if (descp->packed >= 0) {
+        /* a packed file shares the pages of its directory */
+        (void)xipfs_pack_data(descp->filp, descp->packed, &packed_size);
+        size = (off_t)packed_size;
+        reserved = 0;
+    } else {
+        if ((size = (off_t)xipfs_file_get_size(descp->filp)) < 0) {
+            return -EIO;
+        }
+        if ((reserved = (off_t)xipfs_file_get_reserved(descp->filp)) < 0) {
+            return -EIO;
+        }
+    }
+
+    (void)memset(buf, 0, sizeof(*buf));
+    buf->st_dev = (dev_t)(uintptr_t)mp;
+    if (descp->packed >= 0) {
+        buf->st_ino = (ino_t)(uintptr_t)&descp->filp->buf[descp->packed];
+    } else {
+        buf->st_ino = (ino_t)(uintptr_t)descp->filp;
+    }
+    buf->st_mode = S_IFREG;
+    buf->st_nlink = 1;
+    buf->st_size = MAX(size, (off_t)xipfs_file_desc_end(descp));
+    buf->st_blksize = XIPFS_NVM_PAGE_SIZE;
+    buf->st_blocks = reserved / XIPFS_NVM_PAGE_SIZE;
+
+    return 0;
+}
+
+off_t
+xipfs_lseek(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+            off_t off, int whence)
+{
+    off_t max_pos, new_pos, size;
+    size_t packed_size;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    /*
+     * No matter what architecture is used at compile time, both off_t and xipfs_file_position_t
+     * are signed types. Furthermore, sizeof(xipfs_file_position_t) <= sizeof(off_t).
+     * That means that values retrieved from xipfs_file_* can't overflow off_t.
+     * Then maxpos is necessary :
+     * - greater than or equal to 0,
+     * - less than or equal to XIPFS_FILE_POSITION_MAX.
+     */
+    if (descp->packed >= 0) {
+        /* a packed file cannot grow */
+        (void)xipfs_pack_data(descp->filp, descp->packed, &packed_size);
+        max_pos = (off_t)packed_size;
+        size = (off_t)packed_size;
+    } else if ((uintptr_t)descp->filp != (uintptr_t)xipfs_infos_file) {
+        if ((max_pos = (off_t)xipfs_file_get_max_pos(descp->filp)) < 0) {
+            return -EIO;
+        }
+        if ((size = (off_t)xipfs_file_get_size(descp->filp)) < 0) {
+            return -EIO;
+        }
+    } else {
+        max_pos = (off_t)sizeof(xipfs_mount_t);
+        size = (off_t)sizeof(xipfs_mount_t);
+    }
+    assert(size <= max_pos);
+    assert(descp->pos <= max_pos);
+
+    switch (whence) {
+        case SEEK_SET:
+            if ( (off < 0) || (off >= max_pos) ) {
+                return -EINVAL;
+            }
+            new_pos = off;
+            break;
+        case SEEK_CUR:
+            if ( off < 0 ) {
+                if (off < -((off_t)descp->pos)) {
+                    return -EINVAL;
+                }
+            } else {
+                const off_t remaining_bytes = max_pos - (off_t)descp->pos;
+                if ( remaining_bytes < off ) {
+                    return -EINVAL;
+                }
+            }
+            new_pos = descp->pos + off;
+            break;
+        case SEEK_END:
+            new_pos = MAX((off_t)xipfs_file_desc_end(descp), size);
+            if ( (off > 0) || (off < -new_pos) ) {
+                return -EINVAL;
+            }
+            new_pos += off;
+            break;
+        default:
+            return -EINVAL;
+    }
+    if (((off_t)descp->pos) > size && new_pos < ((off_t)descp->pos)) {
+        /* synchronise file size, with the bytes written with
+         * xipfs_pwrite(3) too */
+        if (xipfs_file_set_size(descp->filp,
+                xipfs_file_desc_end(descp)) < 0) {
+            return -EIO;
+        }
+    }
+    descp->pos = (xipfs_file_position_t)new_pos;
+
+    return new_pos;
+}
+
+int
+xipfs_open(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+           const char *name, int flags, mode_t mode)
+{
+    char buf[XIPFS_PATH_MAX];
+    xipfs_path_t xipath;
+    xipfs_file_t *filp;
+    size_t len;
+    xipfs_file_position_t pos;
+    int ret;
+
+    /* mode bits are ignored */
+    UNUSED(mode);
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (descp == NULL) {
+        return -EFAULT;
+    }
+    if (name == NULL) {
+        return -EFAULT;
+    }
+
+    /* only these flags are supported */
+#define XIPFS_SUPPORTED_FLAGS   \
+(                               \
+    O_CREAT | O_EXCL | O_APPEND \
+)
+    const int flags_acc_mode = flags & O_ACCMODE;
+    const int flags_without_acc_mode = flags & (~O_ACCMODE);
+    switch(flags_acc_mode) {
+        case O_RDONLY :
+            /* fallthrough */
+        case O_WRONLY :
+            /* fallthrough */
+        case O_RDWR :
+            if (   ( (flags_without_acc_mode & ~XIPFS_SUPPORTED_FLAGS) != 0 )
+                && ( (flags_without_acc_mode & XIPFS_SUPPORTED_FLAGS)  == 0 ) )
+                return -EINVAL;
+            break;
+        default :
+            // Should not happen
+            return -EINVAL;
+    }
+#undef XIPFS_SUPPORTED_FLAGS
+
+    len = strnlen(name, XIPFS_PATH_MAX);
+    if (len == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
+
+    /* virtual file handling */
+    basename(buf, name);
+    if (strncmp(buf, ".xipfs_infos", XIPFS_PATH_MAX) == 0) {
+        if ((flags & O_CREAT) == O_CREAT &&
+            (flags & O_EXCL) == O_EXCL) {
+            return -EEXIST;
+        }
+        if ((flags & O_WRONLY) == O_WRONLY ||
+            (flags & O_APPEND) == O_APPEND ||
+            (flags & O_RDWR) == O_RDWR) {
+            return -EACCES;
+        }
+        descp->filp = (void *)xipfs_infos_file;
+        descp->flags = flags;
+        descp->pos = 0;
+        descp->end = 0;
+        descp->packed = -1;
+        return 0;
+    }
+
+    if (xipfs_path_new(mp, &xipath, name) < 0) {
+        return -EIO;
+    }
+    switch (xipath.info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+        if ((flags & O_CREAT) == O_CREAT &&
+            (flags & O_EXCL) == O_EXCL) {
+            return -EEXIST;
+        }
+        if (xipath.packed >= 0 &&
+            ((flags & O_WRONLY) == O_WRONLY ||
+             (flags & O_APPEND) == O_APPEND ||
+             (flags & O_RDWR) == O_RDWR)) {
+            /* packed files are read-only */
+            return -EACCES;
+        }
+        filp = xipath.witness;
+        break;
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+        return -EISDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+        return -ENOENT;
+    case XIPFS_PATH_CREATABLE:
+        if ((flags & O_CREAT) != O_CREAT) {
+            return -ENOENT;
+        }
+        if (xipath.path[xipath.len-1] == '/') {
+            return -EISDIR;
+        }
+        /* the witness is only removed once the file fits in the
+         * directory table */
+        if (xipfs_dirtab_fit(mp, xipath.path) < 0) {
+            if (xipfs_errno == XIPFS_ENOSPACE) {
+                return -EDQUOT;
+            }
+            return -EIO;
+        }
+        if (fill_dir(mp, &xipath) < 0) {
+            return -EIO;
+        }
+        if ((filp = xipfs_fs_new_file(mp, name, 0, 0)) == NULL) {
+            /* file creation failed */
+            if (xipfs_errno == XIPFS_ENOSPACE ||
+                xipfs_errno == XIPFS_EFULL) {
+                return -EDQUOT;
+            }
+            return -EIO;
+        }
+        break;
+    default:
+        return -EIO;
+    }
+    if ((flags & O_APPEND) == O_APPEND) {
+        if ((pos = xipfs_file_get_size(filp)) < 0) {
+            return -EIO;
+        }
+    } else {
+        pos = 0;
+    }
+
+    if ((ret = xipfs_file_desc_track(descp)) < 0) {
+        return ret;
+    }
+    descp->filp = filp;
+    descp->flags = flags;
+    descp->pos = pos;
+    descp->end = 0;
+    descp->packed = xipath.packed;
+    /* the descriptor follows the file if it moves */
+    if (reclaim_removed(mp) < 0) {
+        (void)xipfs_file_desc_untrack(descp);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+ssize_t
+xipfs_read(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+           void *dest, size_t nbytes)
+{
+    xipfs_file_position_t size;
+    const char *packed = NULL;
+    size_t i;
+    int ret;
+
+    /** Special case : virtual file
+     * This code is used to retrieve the xipfs_mount_t where it is not provided
+     */
+    if ( (descp != NULL) && ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) ) {
+        if (nbytes != sizeof(xipfs_mount_t)) {
+            return -EINVAL;
+        }
+        if ((nbytes > 0) && (descp->pos >= (xipfs_file_position_t)sizeof(xipfs_mount_t))) {
+            return -EIO;
+        }
+        for (i = 0; i < nbytes && i < sizeof(xipfs_mount_t); i++) {
+            ((char *)dest)[i] = ((char *)mp)[i];
+        }
+        descp->pos = sizeof(xipfs_mount_t);
+        return i;
+    }
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return ret;
+    }
+    if (dest == NULL) {
+        return -EFAULT;
+    }
+    if (nbytes > XIPFS_FILE_POSITION_MAX_AS_SIZE_T) {
+        return -EINVAL;
+    }
+    switch(descp->flags & O_ACCMODE) {
+        case O_RDONLY :
+            /* fallthrough */
+        case O_RDWR :
+            break;
+        default :
+            return -EACCES;
+    }
+    if (descp->packed >= 0) {
+        /* a packed file is read in place */
+        packed = xipfs_pack_data(descp->filp, descp->packed, &i);
+        size = (xipfs_file_position_t)i;
+    } else {
+        if ((size = xipfs_file_get_size(descp->filp)) < 0) {
+            return -EIO;
+        }
+        /* the bytes written with xipfs_pwrite(3) can be read
+         * before the size of the file is synchronised */
+        size = MAX(size, descp->end);
+    }
+    if ((nbytes > 0) && (descp->pos >= size)) {
+        return -EIO;
+    }
+    i = (size_t)(size - descp->pos);
+    if (i > nbytes) {
+        i = nbytes;
+    }
+    if (packed != NULL) {
+        if (xipfs_buffer_read(dest, packed + descp->pos, i) < 0) {
+            return -EIO;
+        }
+    } else if (xipfs_file_read(descp->filp, descp->pos, dest, i) < 0) {
+        return -EIO;
+    }
+    descp->pos += (xipfs_file_position_t)i;
+
+    return i;
+}
+
+ssize_t
+xipfs_write(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+            const void *src, size_t nbytes)
+{
+    xipfs_file_position_t max_pos;
+    size_t i;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    if (src == NULL) {
+        return -EFAULT;
+    }
+    if (nbytes > XIPFS_FILE_POSITION_MAX_AS_SIZE_T) {
+        return -EINVAL;
+    }
+    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
+        ((descp->flags & O_RDWR) != O_RDWR)) {
+        return -EACCES;
+    }
+    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
+        /* cannot write(2) */
+        return -EBADF;
+    }
+    if ((max_pos = xipfs_file_get_max_pos(descp->filp)) < 0) {
+        return -EIO;
+    }
+    if ((nbytes > 0) && (descp->pos >= max_pos)) {
+        return -EDQUOT;
+    }
+    i = (size_t)(max_pos - descp->pos);
+    if (i > nbytes) {
+        i = nbytes;
+    }
+    if (xipfs_file_write(descp->filp, descp->pos, src, i) < 0) {
+        return -EIO;
+    }
+    descp->pos += (xipfs_file_position_t)i;
+
+    return i;
+}
+
+ssize_t
+xipfs_readv(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+            const xipfs_iovec_t iov[], int iovcnt)
+{
+    xipfs_file_position_t size;
+    const char *packed = NULL;
+    size_t i, j, len, nbytes;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ( (descp != NULL) &&
+         ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) ) {
+        /* cannot readv(2) */
+        return -EBADF;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_iov_check(iov, iovcnt, &nbytes)) < 0) {
+        return ret;
+    }
+    switch(descp->flags & O_ACCMODE) {
+        case O_RDONLY :
+            /* fallthrough */
+        case O_RDWR :
+            break;
+        default :
+            return -EACCES;
+    }
+    if (descp->packed >= 0) {
+        /* a packed file is read in place */
+        packed = xipfs_pack_data(descp->filp, descp->packed, &i);
+        size = (xipfs_file_position_t)i;
+    } else {
+        if ((size = xipfs_file_get_size(descp->filp)) < 0) {
+            return -EIO;
+        }
+        /* the bytes written with xipfs_pwrite(3) can be read
+         * before the size of the file is synchronised */
+        size = MAX(size, descp->end);
+    }
+    if ((nbytes > 0) && (descp->pos >= size)) {
+        return -EIO;
+    }
+    i = (size_t)(size - descp->pos);
+    if (i > nbytes) {
+        i = nbytes;
+    }
+    if (packed != NULL) {
+        packed += descp->pos;
+        for (j = 0, nbytes = i; nbytes > 0; j++) {
+            if (iov[j].len == 0) {
+                /* an empty segment may have no base */
+                continue;
+            }
+            len = (iov[j].len < nbytes) ? iov[j].len : nbytes;
+            if (xipfs_buffer_read(iov[j].base, packed, len) < 0) {
+                return -EIO;
+            }
+            packed += len;
+            nbytes -= len;
+        }
+    } else if (xipfs_file_readv(descp->filp, descp->pos, iov, i) < 0) {
+        return -EIO;
+    }
+    descp->pos += (xipfs_file_position_t)i;
+
+    return i;
+}
+
+ssize_t
+xipfs_writev(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+             const xipfs_iovec_t iov[], int iovcnt)
+{
+    xipfs_file_position_t max_pos;
+    size_t i, nbytes;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    if ((ret = xipfs_iov_check(iov, iovcnt, &nbytes)) < 0) {
+        return ret;
+    }
+    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
+        ((descp->flags & O_RDWR) != O_RDWR)) {
+        return -EACCES;
+    }
+    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
+        /* cannot writev(2) */
+        return -EBADF;
+    }
+    if ((max_pos = xipfs_file_get_max_pos(descp->filp)) < 0) {
+        return -EIO;
+    }
+    if ((nbytes > 0) && (descp->pos >= max_pos)) {
+        return -EDQUOT;
+    }
+    i = (size_t)(max_pos - descp->pos);
+    if (i > nbytes) {
+        i = nbytes;
+    }
+    if (xipfs_file_writev(descp->filp, descp->pos, iov, i) < 0) {
+        return -EIO;
+    }
+    descp->pos += (xipfs_file_position_t)i;
+
+    return i;
+}
+
+ssize_t
+xipfs_pread(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+            void *dest, size_t nbytes, off_t offset)
+{
+    xipfs_file_position_t size;
+    const char *packed = NULL;
+    size_t i;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ( (descp != NULL) &&
+         ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) ) {
+        /* cannot pread(2) */
+        return -EBADF;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return ret;
+    }
+    if (dest == NULL) {
+        return -EFAULT;
+    }
+    if (nbytes > XIPFS_FILE_POSITION_MAX_AS_SIZE_T) {
+        return -EINVAL;
+    }
+    if ( (offset < 0) || (offset > XIPFS_FILE_POSITION_MAX_AS_OFF_T) ) {
+        return -EINVAL;
+    }
+    switch(descp->flags & O_ACCMODE) {
+        case O_RDONLY :
+            /* fallthrough */
+        case O_RDWR :
+            break;
+        default :
+            return -EACCES;
+    }
+    /* the size is looked up once and the position is only read,
+     * so that several readers may share the descriptor */
+    if (descp->packed >= 0) {
+        packed = xipfs_pack_data(descp->filp, descp->packed, &i);
+        size = (xipfs_file_position_t)i;
+    } else {
+        if ((size = xipfs_file_get_size(descp->filp)) < 0) {
+            return -EIO;
+        }
+        size = MAX(size, xipfs_file_desc_end(descp));
+    }
+    if (offset >= (off_t)size) {
+        /* end of file */
+        return 0;
+    }
+    i = (size_t)(size - (xipfs_file_position_t)offset);
+    if (i > nbytes) {
+        i = nbytes;
+    }
+    if (packed != NULL) {
+        if (xipfs_buffer_read(dest, packed + offset, i) < 0) {
+            return -EIO;
+        }
+    } else if (xipfs_file_read(descp->filp,
+            (xipfs_file_position_t)offset, dest, i) < 0) {
+        return -EIO;
+    }
+
+    return i;
+}
+
+ssize_t
+xipfs_pwrite(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+             const void *src, size_t nbytes, off_t offset)
+{
+    xipfs_file_position_t max_pos, end;
+    size_t i;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    if (src == NULL) {
+        return -EFAULT;
+    }
+    if (nbytes > XIPFS_FILE_POSITION_MAX_AS_SIZE_T) {
+        return -EINVAL;
+    }
+    if ( (offset < 0) || (offset > XIPFS_FILE_POSITION_MAX_AS_OFF_T) ) {
+        return -EINVAL;
+    }
+    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
+        ((descp->flags & O_RDWR) != O_RDWR)) {
+        return -EACCES;
+    }
+    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
+        /* cannot pwrite(2) */
+        return -EBADF;
+    }
+    if ((max_pos = xipfs_file_get_max_pos(descp->filp)) < 0) {
+        return -EIO;
+    }
+    if ((nbytes > 0) && (offset >= (off_t)max_pos)) {
+        return -EDQUOT;
+    }
+    i = (size_t)(max_pos - (xipfs_file_position_t)offset);
+    if (i > nbytes) {
+        i = nbytes;
+    }
+    /* as POSIX requires, O_APPEND does not apply: the bytes are
+     * written at the offset, not at the end of the file */
+    if (xipfs_file_write(descp->filp, (xipfs_file_position_t)offset,
+            src, i) < 0) {
+        return -EIO;
+    }
+    /* the position does not move, the size of the file is
+     * recorded from the end of the bytes written when the file is
+     * closed or synchronised, like for xipfs_write(3) */
+    end = (xipfs_file_position_t)offset + (xipfs_file_position_t)i;
+    if (end > descp->end) {
+        descp->end = end;
+    }
+
+    return i;
+}
+
+int
+xipfs_fsync(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+            off_t pos)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return ret;
+    }
+    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
+        ((descp->flags & O_RDWR) != O_RDWR)) {
+        return -EACCES;
+    }
+    if ( (pos < 0) || (pos > XIPFS_FILE_POSITION_MAX_AS_OFF_T) ) {
+        return -EINVAL;
+    }
+    /* the bytes written with xipfs_pwrite(3) are synchronised too */
+    if (pos < (off_t)descp->end) {
+        pos = (off_t)descp->end;
+    }
+    if (xipfs_file_set_size(descp->filp, (xipfs_file_position_t)pos) < 0) {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int
+xipfs_ftruncate(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+                off_t length)
+{
+    xipfs_file_position_t size, pos;
+    char zeros[32];
+    size_t i;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    if ((length < 0) || (length > XIPFS_FILE_POSITION_MAX_AS_OFF_T)) {
+        return -EINVAL;
+    }
+    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
+        ((descp->flags & O_RDWR) != O_RDWR)) {
+        return -EACCES;
+    }
+    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
+        /* cannot ftruncate(2) */
+        return -EBADF;
+    }
+    if (descp->packed >= 0) {
+        /* packed files are read-only */
+        return -EACCES;
+    }
+    if ((size = xipfs_file_get_size(descp->filp)) < 0) {
+        return -EIO;
+    }
+    /* the bytes written through the descriptor are part of the
+     * file, even if its size is not synchronised yet */
+    if (size < xipfs_file_desc_end(descp)) {
+        size = xipfs_file_desc_end(descp);
+    }
+    if (xipfs_fs_resize(mp, descp->filp,
+            (xipfs_file_position_t)length) == NULL) {
+        if (xipfs_errno == XIPFS_ENOSPACE ||
+            xipfs_errno == XIPFS_EFULL) {
+            return -EDQUOT;
+        }
+        if (xipfs_errno == XIPFS_EINVALIDSIZE) {
+            return -EINVAL;
+        }
+        return -EIO;
+    }
+    /* the descriptor follows a moved file */
+
+    /* the extended part reads as zeros, which are programmed
+     * without erasing any page */
+    (void)memset(zeros, 0, sizeof(zeros));
+    pos = size;
+    while (pos < (xipfs_file_position_t)length) {
+        i = (size_t)((xipfs_file_position_t)length - pos);
+        if (i > sizeof(zeros)) {
+            i = sizeof(zeros);
+        }
+        if (xipfs_file_write(descp->filp, pos, zeros, i) < 0) {
+            return -EIO;
+        }
+        pos += (xipfs_file_position_t)i;
+    }
+    if (xipfs_file_set_size(descp->filp,
+            (xipfs_file_position_t)length) < 0) {
+        return -EIO;
+    }
+    (void)xipfs_desc_truncate(mp, descp->filp,
+        (xipfs_file_position_t)length);
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int
+xipfs_fallocate(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+                off_t offset, off_t len)
+{
+    xipfs_file_position_t max_pos;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    if ((offset < 0) || (len <= 0)) {
+        return -EINVAL;
+    }
+    if (offset > XIPFS_FILE_POSITION_MAX_AS_OFF_T - len) {
+        return -EFBIG;
+    }
+    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
+        ((descp->flags & O_RDWR) != O_RDWR)) {
+        return -EACCES;
+    }
+    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
+        /* cannot fallocate(2) */
+        return -EBADF;
+    }
+    if (descp->packed >= 0) {
+        /* packed files are read-only */
+        return -EACCES;
+    }
+    if ((max_pos = xipfs_file_get_max_pos(descp->filp)) < 0) {
+        return -EIO;
+    }
+    if (offset + len <= (off_t)max_pos) {
+        /* already reserved */
+        return 0;
+    }
+    /* the size is kept, the new pages stay erased so that the
+     * following writes need no erase */
+    if (xipfs_fs_resize(mp, descp->filp,
+            (xipfs_file_position_t)(offset + len)) == NULL) {
+        if (xipfs_errno == XIPFS_ENOSPACE ||
+            xipfs_errno == XIPFS_EFULL) {
+            return -EDQUOT;
+        }
+        return -EIO;
+    }
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int
+xipfs_mmap(xipfs_mount_t *mp, xipfs_file_desc_t *descp, off_t offset,
+           xipfs_map_t *mapp)
+{
+    const unsigned char *data;
+    size_t packed_size;
+    off_t size;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (mapp == NULL) {
+        return -EFAULT;
+    }
     if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
         return ret;
     }
-    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
-        return -EBADF;
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
+        /* cannot mmap(2) */
+        return -ENODEV;
+    }
+    switch(descp->flags & O_ACCMODE) {
+        case O_RDONLY :
+            /* fallthrough */
+        case O_RDWR :
+            break;
+        default :
+            return -EACCES;
+    }
+    if (descp->packed >= 0) {
+        /* a packed file is mapped in place too */
+        data = (const unsigned char *)xipfs_pack_data(descp->filp,
+            descp->packed, &packed_size);
+        size = (off_t)packed_size;
+    } else {
+        if ((size = (off_t)xipfs_file_get_size(descp->filp)) < 0) {
+            return -EIO;
+        }
+        size = MAX(size, (off_t)xipfs_file_desc_end(descp));
+        data = descp->filp->buf;
+    }
+    if ((offset < 0) || (offset > size)) {
+        return -EINVAL;
+    }
+    /* the mapped bytes are read from the flash, not from the
+     * buffer */
+    if (xipfs_buffer_flush() < 0) {
+        return -EIO;
+    }
+
+    mapp->filp = descp->filp;
+    mapp->packed = descp->packed;
+    mapp->addr = data + offset;
+    mapp->len = (size_t)(size - offset);
+    if ((ret = xipfs_map_track(mapp)) < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+int
+xipfs_munmap(xipfs_mount_t *mp, xipfs_map_t *mapp)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (mapp == NULL) {
+        return -EFAULT;
+    }
+    if (mapp->filp == NULL) {
+        /* the removal of the file ended the mapping */
+        return 0;
+    }
+    if ((ret = xipfs_map_untrack(mapp)) < 0) {
+        return -EINVAL;
+    }
+    (void)memset(mapp, 0, sizeof(*mapp));
+
+    return 0;
+}
+
+/*
+ * Operations on open directories
+ */
+
+int
+xipfs_opendir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp,
+              const char *dirname)
+{
+    xipfs_path_t xipath;
+    xipfs_file_t *headp;
+    size_t len;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (descp == NULL) {
+        return -EFAULT;
+    }
+    if (dirname == NULL) {
+        return -EFAULT;
+    }
+    if (dirname[0] == '\0') {
+        return -ENOENT;
+    }
+    len = strnlen(dirname, XIPFS_PATH_MAX);
+    if (len == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
+
+    xipfs_errno = XIPFS_OK;
+    headp = xipfs_fs_head(mp);
+    if (xipfs_errno != XIPFS_OK) {
+        return -EIO;
+    }
+    if ( (headp == NULL) && (dirname[0] == '/' && dirname[1] == '\0') ) {
+        /* this file system is empty, not an error
+         * the root of the file system is always present
+         */
+        if ((ret = xipfs_dir_desc_track(descp)) < 0) {
+            return ret;
+        }
+        descp->dirname[0] = '/';
+        descp->dirname[1] = '\0';
+        descp->filp = headp;
+        descp->packed = -1;
+        descp->empty = 0;
+        return 0;
+    }
+
+    if (xipfs_path_new(mp, &xipath, dirname) < 0) {
+        return -EIO;
+    }
+    switch (xipath.info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+        break;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+    case XIPFS_PATH_CREATABLE:
+    case XIPFS_PATH_UNDEFINED:
+        return -ENOENT;
+    default:
+        return -EIO;
+    }
+
+    if ((ret = xipfs_dir_desc_track(descp)) < 0) {
+        return ret;
+    }
+
+    /* it is safe to use strcpy(3) here */
+    (void)strcpy(descp->dirname, dirname);
+    descp->filp = headp;
+    descp->packed = -1;
+    descp->empty = 0;
+
+    len = xipath.len;
+    if (descp->dirname[len-1] != '/') {
+        if (len+1 == XIPFS_PATH_MAX) {
+            return -ENAMETOOLONG;
+        }
+        /* ensure dirname ends with a slash to indicate it's a
+         * directory */
+        descp->dirname[len] = '/';
+        descp->dirname[len+1] = '\0';
+    }
+
+    return 0;
+}
+
+int
+xipfs_readdir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp,
+              xipfs_dirent_t *direntp)
+{
+    char buf[XIPFS_PATH_MAX];
+    xipfs_file_position_t pos;
+    const char *path;
+    size_t i;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    /* TODO check descp integrity */
+    if (descp == NULL) {
+        return -EFAULT;
     }
-    /*
-     * No matter what architecture is used at compile time, both off_t and xipfs_file_position_t
-     * are signed types. Furthermore, sizeof(xipfs_file_position_t) <= sizeof(off_t).
-     * That means that values retrieved from xipfs_file_* can't overflow off_t.
-     * Then maxpos is necessary :
-     * - greater than or equal to 0,
-     * - less than or equal to XIPFS_FILE_POSITION_MAX.
-     */
-    if ((uintptr_t)descp->filp != (uintptr_t)xipfs_infos_file) {
-        if ((max_pos = (off_t)xipfs_file_get_max_pos(descp->filp)) < 0) {
-            return -EIO;
-        }
-        if ((size = (off_t)xipfs_file_get_size(descp->filp)) < 0) {
-            return -EIO;
-        }
-    } else {
-        max_pos = (off_t)sizeof(xipfs_mount_t);
-        size = (off_t)sizeof(xipfs_mount_t);
+    if (direntp == NULL) {
+        return -EFAULT;
+    }
+    if ((ret = xipfs_dir_desc_tracked(descp)) < 0) {
+        return ret;
     }
-    assert(size <= max_pos);
-    assert(descp->pos <= max_pos);
 
-    switch (whence) {
-        case SEEK_SET:
-            if ( (off < 0) || (off >= max_pos) ) {
-                return -EINVAL;
+    if (xipfs_dirtab_load(mp) < 0) {
+        return -EIO;
+    }
+
+    xipfs_errno = XIPFS_OK;
+    while (descp->filp != NULL) {
+        path = xipfs_dirtab_path(descp->filp, buf);
+        if ((i = dirent_prefix(descp->dirname, path)) == XIPFS_PATH_MAX) {
+            return -ENAMETOOLONG;
+        }
+        if (descp->dirname[i] == '\0' && (path[i] == '\0' ||
+                (path[i] == '/' && path[i+1] == '\0'))) {
+            /* the file that marks the directory lists its packed
+             * files, if any, in place of itself */
+            pos = xipfs_pack_list(descp->filp, MAX(descp->packed, 0),
+                direntp->dirname);
+            if (pos > 0) {
+                descp->packed = pos;
+                /* entry was updated */
+                return 1;
             }
-            new_pos = off;
-            break;
-        case SEEK_CUR:
-            if ( off < 0 ) {
-                if (off < -((off_t)descp->pos)) {
-                    return -EINVAL;
-                }
-            } else {
-                const off_t remaining_bytes = max_pos - (off_t)descp->pos;
-                if ( remaining_bytes < off ) {
-                    return -EINVAL;
+            if (descp->packed >= 0) {
+                descp->packed = -1;
+                descp->filp = xipfs_fs_next(descp->filp);
+                continue;
+            }
+        }
+        if (descp->dirname[i] == '\0') {
+            if (dirent_name(direntp, path, i) < 0) {
+                return -ENAMETOOLONG;
+            }
+            /* set the next file to the structure */
+            if ((descp->filp = xipfs_fs_next(descp->filp)) == NULL) {
+                if (xipfs_errno != XIPFS_OK) {
+                    return -EIO;
                 }
             }
-            new_pos = descp->pos + off;
+            /* entry was updated */
+            return 1;
+        }
+        descp->packed = -1;
+        descp->filp = xipfs_fs_next(descp->filp);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        return -EIO;
+    }
+
+    /* the empty directories of the log come after the files */
+    if (xipfs_emptydir_load(mp) < 0) {
+        return -EIO;
+    }
+    while (descp->empty >= 0) {
+        if ((descp->empty = xipfs_emptydir_next(descp->empty,
+                buf)) == 0) {
+            descp->empty = -1;
             break;
-        case SEEK_END:
-            new_pos = MAX((off_t)descp->pos, size);
-            if ( (off > 0) || (off < -new_pos) ) {
-                return -EINVAL;
+        }
+        if ((i = dirent_prefix(descp->dirname, buf)) == XIPFS_PATH_MAX) {
+            return -ENAMETOOLONG;
+        }
+        if (descp->dirname[i] == '\0') {
+            if (dirent_name(direntp, buf, i) < 0) {
+                return -ENAMETOOLONG;
             }
-            new_pos += off;
-            break;
-        default:
-            return -EINVAL;
+            /* entry was updated */
+            return 1;
+        }
     }
-    if (((off_t)descp->pos) > size && new_pos < ((off_t)descp->pos)) {
-        /* synchronise file size */
-        if (xipfs_file_set_size(descp->filp, descp->pos) < 0) {
+    /* end of the directory */
+    return 0;
+}
+
+int
+xipfs_closedir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    /* XXX check descp integrity */
+    if (descp == NULL) {
+        return -EFAULT;
+    }
+    if ((ret = xipfs_dir_desc_tracked(descp)) < 0) {
+        return ret;
+    }
+    (void)memset(descp, 0, sizeof(*descp));
+    if ((ret = xipfs_dir_desc_untrack(descp)) < 0) {
+        return ret;
+    }
+
+    return 0;
+}
+
+/*
+ * Operations on mounted file systems
+ */
+
+int
+xipfs_format(xipfs_mount_t *mp)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (xipfs_fs_format(mp) < 0) {
+        return -EIO;
+    }
+    if ((ret = xipfs_desc_untrack_all(mp)) < 0) {
+        return ret;
+    }
+    xipfs_index_invalidate(mp->page_addr);
+    xipfs_dirtab_invalidate(mp->page_addr);
+    xipfs_emptydir_invalidate(mp->page_addr);
+    xipfs_fs_invalidate(mp);
+
+    return 0;
+}
+
+int
+xipfs_gc(xipfs_mount_t *mp)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (xipfs_buffer_flush() < 0) {
+        return -EIO;
+    }
+    if (xipfs_fs_gc(mp) < 0) {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int
+xipfs_gc_step(xipfs_mount_t *mp, size_t max_pages)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (max_pages == 0) {
+        return -EINVAL;
+    }
+    if (xipfs_buffer_flush() < 0) {
+        return -EIO;
+    }
+    if ((ret = xipfs_fs_gc_step(mp, max_pages)) < 0) {
+        if (xipfs_errno == XIPFS_ENOSPACE) {
+            /* left to xipfs_gc(3) */
+            return -ENOSPC;
+        }
+        return -EIO;
+    }
+
+    return ret;
+}
+
+int
+xipfs_mount(xipfs_mount_t *mp)
+{
+    unsigned start, end;
+    void *addr;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    /* check file system integrity using last file pointer,
+     * which also computes the cached tail and page counts */
+    xipfs_fs_invalidate(mp);
+    xipfs_errno = XIPFS_OK;
+    if (xipfs_fs_tail(mp) == NULL) {
+        if (xipfs_errno != XIPFS_OK) {
             return -EIO;
         }
     }
-    descp->pos = (xipfs_file_position_t)new_pos;
+    /* ensure pages after the last file are erased, which also
+     * records them as erased for later allocations */
+    end = xipfs_nvm_page(mp->page_addr) + mp->page_num;
+    if ((addr = xipfs_fs_tail_next(mp)) == NULL) {
+        if (xipfs_errno != XIPFS_EFULL) {
+            return -EIO;
+        }
+        /* no page after the last file */
+        start = end;
+    } else {
+        start = xipfs_nvm_page(addr);
+    }
+    while (start < end) {
+        if (xipfs_flash_is_erased_page(start++) == 0) {
+            return -EIO;
+        }
+    }
+    /* the paths of the files are read through the directory
+     * table */
+    xipfs_dirtab_invalidate(mp->page_addr);
+    xipfs_emptydir_invalidate(mp->page_addr);
+    if (xipfs_dirtab_load(mp) < 0) {
+        return -EIO;
+    }
+    /* paths are scanned for if the index cannot hold them */
+    (void)xipfs_index_build(mp);
+    /* files left marked as removed by XIPFS_GC_DEFERRED */
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
+    }
 
-    return new_pos;
+    return 0;
 }
 
 int
-xipfs_open(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
-           const char *name, int flags, mode_t mode)
+xipfs_umount(xipfs_mount_t *mp)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_desc_untrack_all(mp)) < 0) {
+        return ret;
+    }
+    xipfs_index_invalidate(mp->page_addr);
+    xipfs_dirtab_invalidate(mp->page_addr);
+    xipfs_emptydir_invalidate(mp->page_addr);
+    xipfs_fs_invalidate(mp);
+
+    return 0;
+}
+
+int
+xipfs_unlink(xipfs_mount_t *mp, const char *name)
+{
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = unlink_file(mp, name)) < 0) {
+        return ret;
+    }
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int
+xipfs_unlink_many(xipfs_mount_t *mp, const char *const names[],
+                  size_t count)
+{
+    size_t i;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if (names == NULL && count > 0) {
+        return -EFAULT;
+    }
+
+    /* the files are only marked as removed, then reclaimed
+     * together so that each remaining page moves once, or left
+     * to the garbage collection with XIPFS_GC_DEFERRED */
+    for (i = 0; i < count; i++) {
+        if ((ret = unlink_file(mp, names[i])) < 0) {
+            break;
+        }
+    }
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
+    }
+
+    return ret;
+}
+
+int
+xipfs_unlink_cost(xipfs_mount_t *mp, const char *name)
 {
-    char buf[XIPFS_PATH_MAX];
     xipfs_path_t xipath;
-    xipfs_file_t *filp;
     size_t len;
-    xipfs_file_position_t pos;
     int ret;
 
-    /* mode bits are ignored */
-    UNUSED(mode);
-
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (descp == NULL) {
-        return -EFAULT;
-    }
     if (name == NULL) {
         return -EFAULT;
     }
-
-    /* only these flags are supported */
-#define XIPFS_SUPPORTED_FLAGS   \
-(                               \
-    O_CREAT | O_EXCL | O_APPEND \
-)
-    const int flags_acc_mode = flags & O_ACCMODE;
-    const int flags_without_acc_mode = flags & (~O_ACCMODE);
-    switch(flags_acc_mode) {
-        case O_RDONLY :
-            /* fallthrough */
-        case O_WRONLY :
-            /* fallthrough */
-        case O_RDWR :
-            if (   ( (flags_without_acc_mode & ~XIPFS_SUPPORTED_FLAGS) != 0 )
-                && ( (flags_without_acc_mode & XIPFS_SUPPORTED_FLAGS)  == 0 ) )
-                return -EINVAL;
-            break;
-        default :
-            // Should not happen
-            return -EINVAL;
+    if (name[0] == '\0') {
+        return -ENOENT;
+    }
+    if (name[0] == '/' && name[1] == '\0') {
+        return -EISDIR;
     }
-#undef XIPFS_SUPPORTED_FLAGS
-
     len = strnlen(name, XIPFS_PATH_MAX);
     if (len == XIPFS_PATH_MAX) {
         return -ENAMETOOLONG;
     }
 
-    /* virtual file handling */
-    basename(buf, name);
-    if (strncmp(buf, ".xipfs_infos", XIPFS_PATH_MAX) == 0) {
-        if ((flags & O_CREAT) == O_CREAT &&
-            (flags & O_EXCL) == O_EXCL) {
-            return -EEXIST;
-        }
-        if ((flags & O_WRONLY) == O_WRONLY ||
-            (flags & O_APPEND) == O_APPEND ||
-            (flags & O_RDWR) == O_RDWR) {
-            return -EACCES;
-        }
-        descp->filp = (void *)xipfs_infos_file;
-        descp->flags = flags;
-        descp->pos = 0;
-        return 0;
-    }
-
     if (xipfs_path_new(mp, &xipath, name) < 0) {
         return -EIO;
     }
     switch (xipath.info) {
     case XIPFS_PATH_EXISTS_AS_FILE:
-        if ((flags & O_CREAT) == O_CREAT &&
-            (flags & O_EXCL) == O_EXCL) {
-            return -EEXIST;
-        }
-        filp = xipath.witness;
         break;
     case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
     case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
@@ -599,243 +2370,194 @@ xipfs_open(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
     case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
         return -ENOTDIR;
     case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-        return -ENOENT;
     case XIPFS_PATH_CREATABLE:
-        if ((flags & O_CREAT) != O_CREAT) {
-            return -ENOENT;
-        }
-        if (xipath.path[xipath.len-1] == '/') {
-            return -EISDIR;
-        }
-        if (xipath.witness != NULL && !(xipath.dirname[0] == '/' &&
-                xipath.dirname[1] == '\0')) {
-            if (strcmp(xipath.witness->path, xipath.dirname) == 0) {
-                if (sync_remove_file(mp, xipath.witness) < 0) {
-                    return -EIO;
-                }
-            }
-        }
-        if ((filp = xipfs_fs_new_file(mp, name, 0, 0)) == NULL) {
-            /* file creation failed */
-            if (xipfs_errno == XIPFS_ENOSPACE ||
-                xipfs_errno == XIPFS_EFULL) {
-                return -EDQUOT;
-            }
-            return -EIO;
-        }
-        break;
+        return -ENOENT;
     default:
         return -EIO;
     }
-    if ((flags & O_APPEND) == O_APPEND) {
-        if ((pos = xipfs_file_get_size(filp)) < 0) {
-            return -EIO;
-        }
-    } else {
-        pos = 0;
+
+    /* clearing the state of a packed file erases nothing, unless
+     * the file that marks its directory goes with it */
+    if (xipath.packed >= 0 &&
+        (xipfs_pack_count(xipath.witness) > 1 ||
+            (XIPFS_EMPTY_DIR_LOG == 0 && xipath.parent == 1 &&
+            (size_t)xipath.witness->reserved <= EMPTY_DIR_RESERVED))) {
+        return 0;
     }
 
-    if ((ret = xipfs_file_desc_track(descp)) < 0) {
-        return ret;
+    /* the removal itself erases nothing, the garbage collection
+     * erases the file and moves the files after it */
+    if ((ret = xipfs_fs_gc_cost(mp, xipath.witness)) < 0) {
+        return -EIO;
     }
-    descp->filp = filp;
-    descp->flags = flags;
-    descp->pos = pos;
 
-    return 0;
+    return ret;
 }
 
-ssize_t
-xipfs_read(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
-           void *dest, size_t nbytes)
+int
+xipfs_mkdir(xipfs_mount_t *mp, const char *name, mode_t mode)
 {
-    xipfs_file_position_t size;
-    size_t i;
+    xipfs_path_t xipath;
     int ret;
 
-    /** Special case : virtual file
-     * This code is used to retrieve the xipfs_mount_t where it is not provided
-     */
-    if ( (descp != NULL) && ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) ) {
-        if (nbytes != sizeof(xipfs_mount_t)) {
-            return -EINVAL;
-        }
-        if ((nbytes > 0) && (descp->pos >= (xipfs_file_position_t)sizeof(xipfs_mount_t))) {
-            return -EIO;
-        }
-        for (i = 0; i < nbytes && i < sizeof(xipfs_mount_t); i++) {
-            ((char *)dest)[i] = ((char *)mp)[i];
-        }
-        descp->pos = sizeof(xipfs_mount_t);
-        return i;
-    }
+    /* mode bits are ignored */
+    UNUSED(mode);
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
-        return ret;
-    }
-    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
-        return ret;
-    }
-    if (dest == NULL) {
+    if (name == NULL) {
         return -EFAULT;
     }
-    if (nbytes > XIPFS_FILE_POSITION_MAX_AS_SIZE_T) {
-        return -EINVAL;
+    if (name[0] == '\0') {
+        return -ENOENT;
     }
-    switch(descp->flags & O_ACCMODE) {
-        case O_RDONLY :
-            /* fallthrough */
-        case O_RDWR :
-            break;
-        default :
-            return -EACCES;
+    if (name[0] == '/' && name[1] == '\0') {
+        return -EEXIST;
     }
-    if ((size = xipfs_file_get_size(descp->filp)) < 0) {
+    if (strnlen(name, XIPFS_PATH_MAX) == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
+
+    if (xipfs_path_new(mp, &xipath, name) < 0) {
         return -EIO;
     }
-    if ((nbytes > 0) && (descp->pos >= size)) {
+    switch (xipath.info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+        return -EEXIST;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+        return -ENOENT;
+    case XIPFS_PATH_CREATABLE:
+        break;
+    default:
         return -EIO;
     }
-    for (i = 0; i < nbytes && descp->pos < size; i++) {
-        if (xipfs_file_read_8(descp->filp, descp->pos,
-                &((char *)dest)[i]) < 0) {
-            return -EIO;
+
+    if (xipath.path[xipath.len-1] != '/') {
+        if (xipath.len == XIPFS_PATH_MAX-1) {
+            return -ENAMETOOLONG;
         }
-        descp->pos++;
+        xipath.path[xipath.len++] = '/';
+        xipath.path[xipath.len  ] = '\0';
     }
 
-    return i;
-}
-
-ssize_t
-xipfs_write(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
-            const void *src, size_t nbytes)
-{
-    xipfs_file_position_t max_pos;
-    size_t i;
-    int ret;
-
-    if ((ret = xipfs_mp_check(mp)) < 0) {
-        return ret;
-    }
-    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
-        return ret;
-    }
-    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
-        return -EBADF;
-    }
-    if (src == NULL) {
-        return -EFAULT;
-    }
-    if (nbytes > XIPFS_FILE_POSITION_MAX_AS_SIZE_T) {
-        return -EINVAL;
-    }
-    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
-        ((descp->flags & O_RDWR) != O_RDWR)) {
-        return -EACCES;
-    }
-    if ((uintptr_t)descp->filp == (uintptr_t)xipfs_infos_file) {
-        /* cannot write(2) */
-        return -EBADF;
+    /* the witness is only removed once the directory fits in
+     * the directory table */
+    if (xipfs_dirtab_fit(mp, xipath.path) < 0) {
+        return -EIO;
     }
-    if ((max_pos = xipfs_file_get_max_pos(descp->filp)) < 0) {
+    if (fill_dir(mp, &xipath) < 0) {
         return -EIO;
     }
-    if ((nbytes > 0) && (descp->pos >= max_pos)) {
-        return -EDQUOT;
+    if (keep_dir(mp, xipath.path) < 0) {
+        return -EIO;
     }
-    for (i = 0; i < nbytes && descp->pos < max_pos; i++) {
-        if (xipfs_file_write_8(descp->filp, descp->pos,
-                ((const char *)src)[i]) < 0) {
-            return -EIO;
-        }
-        descp->pos++;
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
     }
 
-    return i;
+    return 0;
 }
 
 int
-xipfs_fsync(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
-            off_t pos)
+xipfs_rmdir(xipfs_mount_t *mp, const char *name)
 {
+    xipfs_path_t xipath;
+    size_t len;
     int ret;
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
-        return ret;
+    if (name == NULL) {
+        return -EFAULT;
     }
-    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
-        return ret;
+    if (name[0] == '\0') {
+        return -ENOENT;
     }
-    if (((descp->flags & O_WRONLY) != O_WRONLY) &&
-        ((descp->flags & O_RDWR) != O_RDWR)) {
-        return -EACCES;
+    if (name[0] == '/' && name[1] == '\0') {
+        return -EBUSY;
+    }
+    len = strnlen(name, XIPFS_PATH_MAX);
+    if (len == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
+    if (name[len-1] == '.') {
+        return -EINVAL;
+    }
+
+    if (xipfs_path_new(mp, &xipath, name) < 0) {
+        return -EIO;
+    }
+    switch (xipath.info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+        break;
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+        return -ENOTEMPTY;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+    case XIPFS_PATH_CREATABLE:
+        return -ENOENT;
+    default:
+        return -EIO;
+    }
+
+    if (xipfs_emptydir_log(xipath.witness)) {
+        if (xipfs_emptydir_remove(mp, xipath.path) < 0) {
+            return -EIO;
+        }
+    } else if (sync_remove_file(mp, xipath.witness) < 0) {
+        return -EIO;
     }
-    if ( (pos < 0) || (pos > XIPFS_FILE_POSITION_MAX_AS_OFF_T) ) {
-        return -EINVAL;
+    if (xipath.parent == 1 && !(xipath.dirname[0] ==
+            '/' && xipath.dirname[1] == '\0')) {
+        if (keep_dir(mp, xipath.dirname) < 0) {
+            return -EIO;
+        }
     }
-    if (xipfs_file_set_size(descp->filp, (xipfs_file_position_t)pos) < 0) {
+    if (reclaim_removed(mp) < 0) {
         return -EIO;
     }
 
     return 0;
 }
 
-/*
- * Operations on open directories
- */
-
 int
-xipfs_opendir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp,
-              const char *dirname)
+xipfs_rmdir_all(xipfs_mount_t *mp, const char *name)
 {
+    char buf[XIPFS_PATH_MAX];
+    xipfs_file_t *filp, *next;
     xipfs_path_t xipath;
-    xipfs_file_t *headp;
-    size_t len;
+    size_t len, removed;
     int ret;
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (descp == NULL) {
-        return -EFAULT;
-    }
-    if (dirname == NULL) {
+    if (name == NULL) {
         return -EFAULT;
     }
-    if (dirname[0] == '\0') {
+    if (name[0] == '\0') {
         return -ENOENT;
     }
-    len = strnlen(dirname, XIPFS_PATH_MAX);
+    if (name[0] == '/' && name[1] == '\0') {
+        return -EBUSY;
+    }
+    len = strnlen(name, XIPFS_PATH_MAX);
     if (len == XIPFS_PATH_MAX) {
         return -ENAMETOOLONG;
     }
-
-    xipfs_errno = XIPFS_OK;
-    headp = xipfs_fs_head(mp);
-    if (xipfs_errno != XIPFS_OK) {
-        return -EIO;
-    }
-    if ( (headp == NULL) && (dirname[0] == '/' && dirname[1] == '\0') ) {
-        /* this file system is empty, not an error
-         * the root of the file system is always present
-         */
-        if ((ret = xipfs_dir_desc_track(descp)) < 0) {
-            return ret;
-        }
-        descp->dirname[0] = '/';
-        descp->dirname[1] = '\0';
-        descp->filp = headp;
-        return 0;
+    if (name[len-1] == '.') {
+        return -EINVAL;
     }
 
-    if (xipfs_path_new(mp, &xipath, dirname) < 0) {
+    if (xipfs_path_new(mp, &xipath, name) < 0) {
         return -EIO;
     }
     switch (xipath.info) {
@@ -847,185 +2569,389 @@ xipfs_opendir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp,
         break;
     case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
     case XIPFS_PATH_CREATABLE:
-    case XIPFS_PATH_UNDEFINED:
         return -ENOENT;
     default:
         return -EIO;
     }
-
-    if ((ret = xipfs_dir_desc_track(descp)) < 0) {
-        return ret;
+    if (xipath.path[xipath.len-1] != '/') {
+        if (xipath.len == XIPFS_PATH_MAX-1) {
+            return -ENAMETOOLONG;
+        }
+        xipath.path[xipath.len++] = '/';
+        xipath.path[xipath.len  ] = '\0';
     }
 
-    /* it is safe to use strcpy(3) here */
-    (void)strcpy(descp->dirname, dirname);
-    descp->filp = headp;
-
-    len = xipath.len;
-    if (descp->dirname[len-1] != '/') {
-        if (len+1 == XIPFS_PATH_MAX) {
-            return -ENAMETOOLONG;
+    /* the files are only marked as removed, then reclaimed
+     * together so that each remaining page moves once, or left
+     * to the garbage collection with XIPFS_GC_DEFERRED */
+    removed = 0;
+    xipfs_errno = XIPFS_OK;
+    filp = xipfs_fs_head(mp);
+    while (filp != NULL) {
+        next = xipfs_fs_next(filp);
+        if (strncmp(xipfs_dirtab_path(filp, buf), xipath.path,
+                xipath.len) == 0) {
+            if (sync_remove_file(mp, filp) < 0) {
+                return -EIO;
+            }
+            removed++;
         }
-        /* ensure dirname ends with a slash to indicate it's a
-         * directory */
-        descp->dirname[len] = '/';
-        descp->dirname[len+1] = '\0';
+        filp = next;
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        return -EIO;
+    }
+    if ((ret = xipfs_emptydir_remove_all(mp, xipath.path)) < 0) {
+        return -EIO;
+    }
+    removed += (size_t)ret;
+    if (xipath.parent == removed && !(xipath.dirname[0] ==
+            '/' && xipath.dirname[1] == '\0')) {
+        if (keep_dir(mp, xipath.dirname) < 0) {
+            return -EIO;
+        }
+    }
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
     }
 
     return 0;
 }
 
-int
-xipfs_readdir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp,
-              xipfs_dirent_t *direntp)
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Renames a file or a directory, leaving the files it
+ * removes marked as removed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param from_path The path to rename
+ *
+ * @param to_path The new path
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * errno value otherwise
+ */
+static int
+rename_path(xipfs_mount_t *mp, const char *from_path,
+            const char *to_path)
 {
-    size_t i, j;
-    int ret;
+    xipfs_path_t xipaths[2];
+    const char *paths[2];
+    size_t renamed;
+    ssize_t ret;
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    /* TODO check descp integrity */
-    if (descp == NULL) {
+    if (from_path == NULL) {
         return -EFAULT;
     }
-    if (direntp == NULL) {
+    if (to_path == NULL) {
         return -EFAULT;
     }
-    if ((ret = xipfs_dir_desc_tracked(descp)) < 0) {
-        return ret;
+    if (from_path[0] == '\0') {
+        return -ENOENT;
+    }
+    if (to_path[0] == '\0') {
+        return -ENOENT;
+    }
+    ret = strnlen(from_path, XIPFS_PATH_MAX);
+    if (ret == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
+    ret = strnlen(to_path, XIPFS_PATH_MAX);
+    if (ret == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
     }
 
-    xipfs_errno = XIPFS_OK;
-    while (descp->filp != NULL) {
-        i = 0;
-        while (i < XIPFS_PATH_MAX) {
-            if (descp->filp->path[i] != descp->dirname[i]) {
-                break;
+    /* the directory table is not rewritten once the witnesses
+     * are known */
+    if (xipfs_dirtab_reserve(mp) < 0) {
+        return -EIO;
+    }
+
+    paths[0] = from_path;
+    paths[1] = to_path;
+    if (xipfs_path_new_n(mp, xipaths, paths, 2) < 0) {
+        return -EIO;
+    }
+
+    if (xipaths[0].packed >= 0 || (xipaths[1].packed >= 0 &&
+            xipaths[0].info == XIPFS_PATH_EXISTS_AS_FILE)) {
+        if (xipaths[0].witness == xipaths[1].witness &&
+            xipaths[0].packed == xipaths[1].packed) {
+            return 0;
+        }
+        if (xipaths[1].info == XIPFS_PATH_EXISTS_AS_FILE) {
+            /* the packed file, or the file replacing a packed
+             * file, takes the place of the former one */
+            if ((ret = unlink_file(mp, to_path)) < 0) {
+                return ret;
+            }
+            if (xipfs_path_new_n(mp, xipaths, paths, 2) < 0) {
+                return -EIO;
+            }
+        }
+    }
+    if (xipaths[0].packed >= 0) {
+        switch (xipaths[1].info) {
+        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+            return -EISDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+            return -ENOTDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+            return -ENOENT;
+        case XIPFS_PATH_CREATABLE:
+            break;
+        default:
+            return -EIO;
+        }
+        if (xipaths[1].path[xipaths[1].len-1] == '/') {
+            return -ENOTDIR;
+        }
+        if (xipfs_pack_move(mp, xipaths[0].path, xipaths[1].path) < 0) {
+            if (xipfs_errno == XIPFS_ENOSPACE ||
+                xipfs_errno == XIPFS_EFULL) {
+                return -EDQUOT;
+            }
+            return -EIO;
+        }
+        if (xipfs_emptydir_remove(mp, xipaths[1].dirname) < 0) {
+            return -EIO;
+        }
+        /* the packed file was removed from its directory */
+        if (xipfs_path_new(mp, &xipaths[0], from_path) < 0) {
+            return -EIO;
+        }
+        return unpack_dir(mp, &xipaths[0]);
+    }
+
+    switch (xipaths[0].info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+    {
+        switch (xipaths[1].info) {
+        case XIPFS_PATH_EXISTS_AS_FILE:
+        {
+            if (xipaths[0].witness == xipaths[1].witness) {
+                return 0;
+            }
+            if (xipfs_fs_rename(mp, xipaths[0].witness,
+                    xipaths[1].path) < 0) {
+                return -EIO;
+            }
+            renamed = 1;
+            break;
+        }
+        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+            return -EISDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+            return -ENOTDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+            return -ENOENT;
+        case XIPFS_PATH_CREATABLE:
+        {
+            if (xipaths[1].path[xipaths[1].len-1] == '/') {
+                return -ENOTDIR;
+            }
+            if (xipfs_fs_rename(mp, xipaths[0].witness,
+                    xipaths[1].path) < 0) {
+                return -EIO;
+            }
+            renamed = 1;
+            break;
+        }
+        default:
+            return -EIO;
+        }
+        break;
+    }
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+    {
+        switch (xipaths[1].info) {
+        case XIPFS_PATH_EXISTS_AS_FILE:
+            return -ENOTDIR;
+        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+        {
+            /* the empty directories of the log share a witness */
+            if (xipaths[0].witness == xipaths[1].witness &&
+                strcmp(xipaths[0].path, xipaths[1].path) == 0) {
+                return 0;
+            }
+            /* the directory replaces an empty one, which keeps
+             * it already */
+            if (xipfs_emptydir_log(xipaths[0].witness)) {
+                if (xipfs_emptydir_remove(mp, xipaths[0].path) < 0) {
+                    return -EIO;
+                }
+            } else if (sync_remove_file(mp, xipaths[0].witness) < 0) {
+                return -EIO;
+            }
+            renamed = 1;
+            break;
+        }
+        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+            return -ENOTEMPTY;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+            return -ENOTDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+            return -ENOENT;
+        case XIPFS_PATH_CREATABLE:
+        {
+            /* from is an empty directory */
+            if (xipaths[1].path[xipaths[1].len-1] != '/') {
+                if (xipaths[1].len == XIPFS_PATH_MAX-1) {
+                    return -ENAMETOOLONG;
+                }
+                xipaths[1].path[xipaths[1].len++] = '/';
+                xipaths[1].path[xipaths[1].len  ] = '\0';
             }
-            if (descp->dirname[i] == '\0') {
-                break;
+            /* check whether an attempt was made to make a
+             * directory a subdirectory of itself */
+            if (strncmp(xipaths[0].path, xipaths[1].path,
+                    xipaths[0].len) == 0) {
+                return -EINVAL;
             }
-            if (descp->filp->path[i] == '\0') {
-                break;
+            if (xipfs_emptydir_log(xipaths[0].witness)) {
+                /* keeping the new directory may create a file,
+                 * which may move the witness of its parent */
+                if (fill_dir(mp, &xipaths[1]) < 0) {
+                    return -EIO;
+                }
+                xipaths[1].witness = NULL;
+                if (keep_dir(mp, xipaths[1].path) < 0) {
+                    return -EIO;
+                }
+                if (xipfs_emptydir_remove(mp, xipaths[0].path) < 0) {
+                    return -EIO;
+                }
+            } else if (xipfs_fs_rename(mp, xipaths[0].witness,
+                    xipaths[1].path) < 0) {
+                return -EIO;
             }
-            i++;
+            renamed = 1;
+            break;
         }
-        if (i == XIPFS_PATH_MAX) {
-            return -ENAMETOOLONG;
+        default:
+            return -EIO;
         }
-        if (descp->dirname[i] == '\0') {
-            if (descp->filp->path[i] == '/') {
-                /* skip first slash */
-                i++;
+        break;
+    }
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+    {
+        switch (xipaths[1].info) {
+        case XIPFS_PATH_EXISTS_AS_FILE:
+            return -ENOTDIR;
+        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+        {
+            /* check whether an attempt was made to make a
+             * directory a subdirectory of itself */
+            if (strncmp(xipaths[0].path, xipaths[1].path,
+                    xipaths[0].len) == 0) {
+                return -EINVAL;
             }
-            j = i;
-            while (j < XIPFS_PATH_MAX) {
-                if (descp->filp->path[j] == '\0') {
-                    direntp->dirname[j-i] = '\0';
-                    break;
+            /* the directory is no longer empty */
+            if (xipfs_emptydir_remove(mp, xipaths[1].path) < 0) {
+                return -EIO;
+            }
+            if (xipfs_pack_fit(mp, xipaths[0].path,
+                    xipaths[1].path) < 0 ||
+                xipfs_emptydir_fit(mp, xipaths[0].path,
+                    xipaths[1].path) < 0) {
+                if (xipfs_errno == XIPFS_ENULTER) {
+                    return -ENAMETOOLONG;
                 }
-                if (descp->filp->path[j] == '/') {
-                    direntp->dirname[j-i] = '/';
-                    direntp->dirname[j-i+1] = '\0';
-                    break;
+                return -EIO;
+            }
+            if ((ret = xipfs_fs_rename_all(mp, xipaths[0].path,
+                    xipaths[1].path)) < 0) {
+                return -EIO;
+            }
+            renamed = (size_t)ret;
+            if ((ret = xipfs_emptydir_rename_all(mp, xipaths[0].path,
+                    xipaths[1].path)) < 0) {
+                return -EIO;
+            }
+            renamed += (size_t)ret;
+            break;
+        }
+        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+            return -ENOTEMPTY;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+            return -ENOTDIR;
+        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+            return -ENOENT;
+        case XIPFS_PATH_CREATABLE:
+        {
+            /* from is an nonempty directory */
+            if (xipaths[1].path[xipaths[1].len-1] != '/') {
+                if (xipaths[1].len == XIPFS_PATH_MAX-1) {
+                    return -ENAMETOOLONG;
                 }
-                direntp->dirname[j-i] = descp->filp->path[j];
-                j++;
+                xipaths[1].path[xipaths[1].len++] = '/';
+                xipaths[1].path[xipaths[1].len  ] = '\0';
             }
-            if (j == XIPFS_PATH_MAX) {
-                return -ENAMETOOLONG;
+            /* check whether an attempt was made to make a
+             * directory a subdirectory of itself */
+            if (strncmp(xipaths[0].path, xipaths[1].path,
+                    xipaths[0].len) == 0) {
+                return -EINVAL;
             }
-            /* set the next file to the structure */
-            if ((descp->filp = xipfs_fs_next(descp->filp)) == NULL) {
-                if (xipfs_errno != XIPFS_OK) {
-                    return -EIO;
+            if (xipfs_pack_fit(mp, xipaths[0].path,
+                    xipaths[1].path) < 0 ||
+                xipfs_emptydir_fit(mp, xipaths[0].path,
+                    xipaths[1].path) < 0) {
+                if (xipfs_errno == XIPFS_ENULTER) {
+                    return -ENAMETOOLONG;
                 }
+                return -EIO;
             }
-            /* entry was updated */
-            return 1;
+            if ((ret = xipfs_fs_rename_all(mp, xipaths[0].path,
+                    xipaths[1].path)) < 0) {
+                return -EIO;
+            }
+            renamed = (size_t)ret;
+            if ((ret = xipfs_emptydir_rename_all(mp, xipaths[0].path,
+                    xipaths[1].path)) < 0) {
+                return -EIO;
+            }
+            renamed += (size_t)ret;
+            break;
         }
-        descp->filp = xipfs_fs_next(descp->filp);
+        default:
+            return -EIO;
+        }
+        break;
     }
-    if (xipfs_errno != XIPFS_OK) {
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+    case XIPFS_PATH_CREATABLE:
+        return -ENOENT;
+    default:
         return -EIO;
     }
-    /* end of the directory */
-    return 0;
-}
-
-int
-xipfs_closedir(xipfs_mount_t *mp, xipfs_dir_desc_t *descp)
-{
-    int ret;
-
-    if ((ret = xipfs_mp_check(mp)) < 0) {
-        return ret;
-    }
-    /* XXX check descp integrity */
-    if (descp == NULL) {
-        return -EFAULT;
-    }
-    if ((ret = xipfs_dir_desc_tracked(descp)) < 0) {
-        return ret;
-    }
-    (void)memset(descp, 0, sizeof(*descp));
-    if ((ret = xipfs_dir_desc_untrack(descp)) < 0) {
-        return ret;
-    }
-
-    return 0;
-}
-
-/*
- * Operations on mounted file systems
- */
-
-int
-xipfs_format(xipfs_mount_t *mp)
-{
-    int ret;
 
-    if ((ret = xipfs_mp_check(mp)) < 0) {
-        return ret;
-    }
-    if (xipfs_fs_format(mp) < 0) {
+    /* the witness must be removed first, since creating a file
+     * may run the garbage collection, which moves the files */
+    if (fill_dir(mp, &xipaths[1]) < 0) {
         return -EIO;
     }
-    if ((ret = xipfs_desc_untrack_all(mp)) < 0) {
-        return ret;
-    }
-
-    return 0;
-}
 
-int
-xipfs_mount(xipfs_mount_t *mp)
-{
-    int *start, *end;
-    int ret;
-
-    if ((ret = xipfs_mp_check(mp)) < 0) {
-        return ret;
-    }
-    /* check file system integrity using last file pointer */
-    xipfs_errno = XIPFS_OK;
-    if (xipfs_fs_tail(mp) == NULL) {
-        if (xipfs_errno != XIPFS_OK) {
-            return -EIO;
-        }
-    }
-    /* ensure pages after the last file are erased */
-    if ((start = (int *)xipfs_fs_tail_next(mp)) == NULL) {
-        if (xipfs_errno != XIPFS_OK) {
-            return -EIO;
-        }
-    }
-    end = (int *)((uintptr_t)mp->page_addr + mp->page_num *
-        XIPFS_NVM_PAGE_SIZE);
-    while (start < end) {
-        if (*start++ != (int)XIPFS_FLASH_ERASE_STATE) {
-            return -EIO;
+    if (xipaths[0].parent == renamed && !(xipaths[0].dirname[0] ==
+            '/' && xipaths[0].dirname[1] == '\0')) {
+        if (strcmp(xipaths[0].dirname, xipaths[1].dirname) != 0) {
+            if (keep_dir(mp, xipaths[0].dirname) < 0) {
+                return -EIO;
+            }
         }
     }
 
@@ -1033,53 +2959,57 @@ xipfs_mount(xipfs_mount_t *mp)
 }
 
 int
-xipfs_umount(xipfs_mount_t *mp)
+xipfs_rename(xipfs_mount_t *mp, const char *from_path,
+             const char *to_path)
 {
     int ret;
 
-    if ((ret = xipfs_mp_check(mp)) < 0) {
+    if ((ret = rename_path(mp, from_path, to_path)) < 0) {
         return ret;
     }
-    if ((ret = xipfs_desc_untrack_all(mp)) < 0) {
-        return ret;
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
     }
 
     return 0;
 }
 
 int
-xipfs_unlink(xipfs_mount_t *mp, const char *name)
+xipfs_stat(xipfs_mount_t *mp, const char *path,
+           struct stat *buf)
 {
+    char witness[XIPFS_PATH_MAX];
+    xipfs_file_position_t record;
     xipfs_path_t xipath;
-    size_t len;
+    size_t len, packed_size;
+    off_t size;
     int ret;
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (name == NULL) {
+    if (path == NULL) {
         return -EFAULT;
     }
-    if (name[0] == '\0') {
-        return -ENOENT;
+    if (buf == NULL) {
+        return -EFAULT;
     }
-    if (name[0] == '/' && name[1] == '\0') {
-        return -EISDIR;
+    if (path[0] == '\0') {
+        return -ENOENT;
     }
-    len = strnlen(name, XIPFS_PATH_MAX);
+    len = strnlen(path, XIPFS_PATH_MAX);
     if (len == XIPFS_PATH_MAX) {
         return -ENAMETOOLONG;
     }
 
-    if (xipfs_path_new(mp, &xipath, name) < 0) {
+    if (xipfs_path_new(mp, &xipath, path) < 0) {
         return -EIO;
     }
     switch (xipath.info) {
     case XIPFS_PATH_EXISTS_AS_FILE:
-        break;
     case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
     case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-        return -EISDIR;
+        break;
     case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
         return -ENOTDIR;
     case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
@@ -1089,88 +3019,106 @@ xipfs_unlink(xipfs_mount_t *mp, const char *name)
         return -EIO;
     }
 
-    if (sync_remove_file(mp, xipath.witness) < 0) {
+    if (xipath.packed >= 0) {
+        /* a packed file shares the pages of its directory */
+        (void)xipfs_pack_data(xipath.witness, xipath.packed, &packed_size);
+        (void)memset(buf, 0, sizeof(*buf));
+        buf->st_dev = (dev_t)(uintptr_t)mp;
+        buf->st_ino = (ino_t)(uintptr_t)&xipath.witness->buf[xipath.packed];
+        buf->st_mode = S_IFREG;
+        buf->st_nlink = 1;
+        buf->st_size = (off_t)packed_size;
+        buf->st_blksize = XIPFS_NVM_PAGE_SIZE;
+        buf->st_blocks = 0;
+        return 0;
+    }
+    if (xipfs_emptydir_log(xipath.witness)) {
+        /* a directory of the log shares its page with the
+         * others */
+        record = xipfs_emptydir_find(xipath.path);
+        (void)memset(buf, 0, sizeof(*buf));
+        buf->st_dev = (dev_t)(uintptr_t)mp;
+        buf->st_ino = (record >= 0) ?
+            (ino_t)(uintptr_t)&xipath.witness->buf[record] :
+            (ino_t)(uintptr_t)xipath.witness;
+        buf->st_mode = S_IFDIR;
+        buf->st_nlink = 1;
+        buf->st_size = 0;
+        buf->st_blksize = XIPFS_NVM_PAGE_SIZE;
+        buf->st_blocks = 0;
+        return 0;
+    }
+
+    if (strncmp(xipfs_dirtab_path(xipath.witness, witness), xipath.path,
+            len) != 0) {
+        return -ENOENT;
+    }
+
+    if ((size = (off_t)xipfs_file_get_size_(xipath.witness)) < 0) {
         return -EIO;
     }
-    if (xipath.parent == 1 && !(xipath.dirname[0] ==
-            '/' && xipath.dirname[1] == '\0')) {
-        if (xipfs_fs_new_file(mp, xipath.dirname,
-                XIPFS_NVM_PAGE_SIZE, 0) == NULL) {
-            return -EIO;
-        }
+
+    (void)memset(buf, 0, sizeof(*buf));
+    buf->st_dev = (dev_t)(uintptr_t)mp;
+    buf->st_ino = (ino_t)(uintptr_t)xipath.witness;
+    if (path[len-1] != '/') {
+        buf->st_mode = S_IFREG;
+    } else {
+        buf->st_mode = S_IFDIR;
     }
+    buf->st_nlink = 1;
+    buf->st_size = size;
+    buf->st_blksize = XIPFS_NVM_PAGE_SIZE;
+    buf->st_blocks = xipath.witness->reserved / XIPFS_NVM_PAGE_SIZE;
 
     return 0;
 }
 
 int
-xipfs_mkdir(xipfs_mount_t *mp, const char *name, mode_t mode)
+xipfs_statvfs(xipfs_mount_t *mp, const char *restrict path,
+              struct xipfs_statvfs *restrict buf)
 {
-    xipfs_path_t xipath;
+    unsigned free_pages, page_number;
     int ret;
 
-    /* mode bits are ignored */
-    UNUSED(mode);
+    UNUSED(path);
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (name == NULL) {
-        return -EFAULT;
-    }
-    if (name[0] == '\0') {
-        return -ENOENT;
-    }
-    if (name[0] == '/' && name[1] == '\0') {
-        return -EEXIST;
-    }
-    if (strnlen(name, XIPFS_PATH_MAX) == XIPFS_PATH_MAX) {
-        return -ENAMETOOLONG;
-    }
-
-    if (xipfs_path_new(mp, &xipath, name) < 0) {
-        return -EIO;
-    }
-    switch (xipath.info) {
-    case XIPFS_PATH_EXISTS_AS_FILE:
-    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
-    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-        return -EEXIST;
-    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
-        return -ENOTDIR;
-    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-        return -ENOENT;
-    case XIPFS_PATH_CREATABLE:
-        break;
-    default:
-        return -EIO;
-    }
-
-    if (xipath.path[xipath.len-1] != '/') {
-        if (xipath.len == XIPFS_PATH_MAX-1) {
-            return -ENAMETOOLONG;
-        }
-        xipath.path[xipath.len++] = '/';
-        xipath.path[xipath.len  ] = '\0';
+    if (buf == NULL) {
+        return -EFAULT;
     }
 
-    if (xipath.witness != NULL) {
-        if (strcmp(xipath.witness->path, xipath.dirname) == 0) {
-            if (sync_remove_file(mp, xipath.witness) < 0) {
-                return -EIO;
-            }
-        }
+    if ((ret = xipfs_fs_get_page_number(mp)) < 0) {
+        return -EIO;
     }
-    if (xipfs_fs_new_file(mp, xipath.path,
-            XIPFS_NVM_PAGE_SIZE, 0) == NULL) {
+    page_number = (unsigned)ret;
+
+    if ((ret = xipfs_fs_free_pages(mp)) < 0) {
         return -EIO;
     }
+    free_pages = (unsigned)ret;
+
+    (void)memset(buf, 0, sizeof(*buf));
+    buf->f_bsize = XIPFS_NVM_PAGE_SIZE;
+    buf->f_frsize = XIPFS_NVM_PAGE_SIZE;
+    buf->f_blocks = page_number;
+    buf->f_bfree = free_pages;
+    buf->f_bavail = free_pages;
+    buf->f_flag = ST_NOSUID;
+    buf->f_namemax = XIPFS_PATH_MAX;
 
     return 0;
 }
 
+/*
+ * xipfs-specific functions
+ */
+
 int
-xipfs_rmdir(xipfs_mount_t *mp, const char *name)
+xipfs_new_file(xipfs_mount_t *mp, const char *path,
+               xipfs_file_position_t size, uint32_t exec)
 {
     xipfs_path_t xipath;
     size_t len;
@@ -1179,261 +3127,141 @@ xipfs_rmdir(xipfs_mount_t *mp, const char *name)
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (name == NULL) {
+    if (path == NULL) {
         return -EFAULT;
     }
-    if (name[0] == '\0') {
+    if (path[0] == '\0') {
         return -ENOENT;
     }
-    if (name[0] == '/' && name[1] == '\0') {
-        return -EBUSY;
+    if (path[0] == '/' && path[1] == '\0') {
+        return -EISDIR;
     }
-    len = strnlen(name, XIPFS_PATH_MAX);
+    len = strnlen(path, XIPFS_PATH_MAX);
     if (len == XIPFS_PATH_MAX) {
         return -ENAMETOOLONG;
     }
-    if (name[len-1] == '.') {
+    if (exec != 0 && exec != 1) {
         return -EINVAL;
     }
 
-    if (xipfs_path_new(mp, &xipath, name) < 0) {
+    if (xipfs_path_new(mp, &xipath, path) < 0) {
         return -EIO;
     }
     switch (xipath.info) {
     case XIPFS_PATH_EXISTS_AS_FILE:
-    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
-        return -ENOTDIR;
+        return -EEXIST;
     case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
-        break;
     case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-        return -ENOTEMPTY;
+        return -EISDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
     case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-    case XIPFS_PATH_CREATABLE:
         return -ENOENT;
+    case XIPFS_PATH_CREATABLE:
+        break;
     default:
         return -EIO;
     }
 
-    if (sync_remove_file(mp, xipath.witness) < 0) {
+    if (xipath.path[xipath.len-1] == '/') {
+        return -EISDIR;
+    }
+    /* the witness is only removed once the file fits in the
+     * directory table */
+    if (xipfs_dirtab_fit(mp, xipath.path) < 0) {
+        if (xipfs_errno == XIPFS_ENOSPACE) {
+            return -EDQUOT;
+        }
         return -EIO;
     }
-    if (xipath.parent == 1 && !(xipath.dirname[0] ==
-            '/' && xipath.dirname[1] == '\0')) {
-        if (xipfs_fs_new_file(mp, xipath.dirname,
-                XIPFS_NVM_PAGE_SIZE, 0) == NULL) {
-            return -EIO;
+    if (fill_dir(mp, &xipath) < 0) {
+        return -EIO;
+    }
+    if (xipfs_fs_new_file(mp, path, size, exec) == NULL) {
+        /* file creation failed */
+        if (xipfs_errno == XIPFS_ENOSPACE ||
+            xipfs_errno == XIPFS_EFULL) {
+            return -EDQUOT;
+        }
+        if (xipfs_errno == XIPFS_EINVALIDSIZE) {
+            return -EINVAL;
         }
+        return -EIO;
+    }
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
     }
 
     return 0;
 }
 
 int
-xipfs_rename(xipfs_mount_t *mp, const char *from_path,
-             const char *to_path)
+xipfs_new_files(xipfs_mount_t *mp, const xipfs_file_spec_t specs[],
+                size_t n)
 {
-    xipfs_path_t xipaths[2];
-    const char *paths[2];
-    size_t renamed;
-    ssize_t ret;
+    size_t placeholders, pages, len, i;
+    char buf[XIPFS_PATH_MAX];
+    int ret;
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (from_path == NULL) {
-        return -EFAULT;
-    }
-    if (to_path == NULL) {
+    if (specs == NULL && n > 0) {
         return -EFAULT;
     }
-    if (from_path[0] == '\0') {
-        return -ENOENT;
-    }
-    if (to_path[0] == '\0') {
-        return -ENOENT;
-    }
-    ret = strnlen(from_path, XIPFS_PATH_MAX);
-    if (ret == XIPFS_PATH_MAX) {
-        return -ENAMETOOLONG;
-    }
-    ret = strnlen(to_path, XIPFS_PATH_MAX);
-    if (ret == XIPFS_PATH_MAX) {
-        return -ENAMETOOLONG;
-    }
 
-    paths[0] = from_path;
-    paths[1] = to_path;
-    if (xipfs_path_new_n(mp, xipaths, paths, 2) < 0) {
-        return -EIO;
+    /* check all the paths before creating any file */
+    placeholders = 0;
+    pages = 0;
+    if (n > 0 && (ret = check_new_files(mp, specs, n, &pages,
+            &placeholders)) < 0) {
+        return ret;
     }
 
-    switch (xipaths[0].info) {
-    case XIPFS_PATH_EXISTS_AS_FILE:
-    {
-        switch (xipaths[1].info) {
-        case XIPFS_PATH_EXISTS_AS_FILE:
-        {
-            if (xipaths[0].witness == xipaths[1].witness) {
-                return 0;
-            }
-            if (xipfs_file_rename(xipaths[0].witness,
-                    xipaths[1].path) < 0) {
-                return -EIO;
-            }
-            renamed = 1;
-            break;
-        }
-        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
-        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-            return -EISDIR;
-        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
-            return -ENOTDIR;
-        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-            return -ENOENT;
-        case XIPFS_PATH_CREATABLE:
-        {
-            if (xipaths[1].path[xipaths[1].len-1] == '/') {
-                return -ENOTDIR;
-            }
-            if (xipfs_file_rename(xipaths[0].witness,
-                    xipaths[1].path) < 0) {
-                return -EIO;
+    /* the placeholders are only removed once the files fit in
+     * the directory table and in the free pages, and before the
+     * files are created, so that reclaiming them moves none of
+     * the new files */
+    if (placeholders > 0) {
+        if (xipfs_dirtab_prepare(mp, specs, n) < 0) {
+            if (xipfs_errno == XIPFS_ENOSPACE ||
+                xipfs_errno == XIPFS_EFULL) {
+                return -EDQUOT;
             }
-            renamed = 1;
-            break;
-        }
-        default:
             return -EIO;
         }
-        break;
-    }
-    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
-    {
-        switch (xipaths[1].info) {
-        case XIPFS_PATH_EXISTS_AS_FILE:
-            return -ENOTDIR;
-        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
-        {
-            if (xipaths[0].witness == xipaths[1].witness) {
-                return 0;
-            }
-            if (xipfs_file_rename(xipaths[0].witness,
-                    xipaths[1].path) < 0) {
-                return -EIO;
-            }
-            renamed = 1;
-            break;
-        }
-        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-            return -ENOTEMPTY;
-        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
-            return -ENOTDIR;
-        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-            return -ENOENT;
-        case XIPFS_PATH_CREATABLE:
-        {
-            /* from is an empty directory */
-            if (xipaths[1].path[xipaths[1].len-1] != '/') {
-                if (xipaths[1].len == XIPFS_PATH_MAX-1) {
-                    return -ENAMETOOLONG;
-                }
-                xipaths[1].path[xipaths[1].len++] = '/';
-                xipaths[1].path[xipaths[1].len  ] = '\0';
-            }
-            /* check whether an attempt was made to make a
-             * directory a subdirectory of itself */
-            if (strncmp(xipaths[0].path, xipaths[1].path,
-                    xipaths[0].len) == 0) {
-                return -EINVAL;
-            }
-            if (xipfs_file_rename(xipaths[0].witness,
-                    xipaths[1].path) < 0) {
-                return -EIO;
-            }
-            renamed = 1;
-            break;
-        }
-        default:
+        if ((ret = xipfs_fs_free_pages(mp)) < 0) {
             return -EIO;
         }
-        break;
-    }
-    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-    {
-        switch (xipaths[1].info) {
-        case XIPFS_PATH_EXISTS_AS_FILE:
-            return -ENOTDIR;
-        case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
-        {
-            /* check whether an attempt was made to make a
-             * directory a subdirectory of itself */
-            if (strncmp(xipaths[0].path, xipaths[1].path,
-                    xipaths[0].len) == 0) {
-                return -EINVAL;
-            }
-            if ((ret = xipfs_fs_rename_all(mp, xipaths[0].path,
-                    xipaths[1].path)) < 0) {
-                return -EIO;
-            }
-            renamed = (size_t)ret;
-            break;
+        if (pages > (size_t)ret + placeholders) {
+            return -EDQUOT;
         }
-        case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-            return -ENOTEMPTY;
-        case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
-            return -ENOTDIR;
-        case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-            return -ENOENT;
-        case XIPFS_PATH_CREATABLE:
-        {
-            /* from is an nonempty directory */
-            if (xipaths[1].path[xipaths[1].len-1] != '/') {
-                if (xipaths[1].len == XIPFS_PATH_MAX-1) {
-                    return -ENAMETOOLONG;
-                }
-                xipaths[1].path[xipaths[1].len++] = '/';
-                xipaths[1].path[xipaths[1].len  ] = '\0';
-            }
-            /* check whether an attempt was made to make a
-             * directory a subdirectory of itself */
-            if (strncmp(xipaths[0].path, xipaths[1].path,
-                    xipaths[0].len) == 0) {
-                return -EINVAL;
-            }
-            if ((ret = xipfs_fs_rename_all(mp, xipaths[0].path,
-                    xipaths[1].path)) < 0) {
-                return -EIO;
-            }
-            renamed = (size_t)ret;
-            break;
+        if (remove_placeholders(mp, specs, n) < 0) {
+            return -EIO;
         }
-        default:
+        if (reclaim_removed(mp) < 0) {
             return -EIO;
         }
-        break;
-    }
-    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
-        return -ENOTDIR;
-    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-    case XIPFS_PATH_CREATABLE:
-        return -ENOENT;
-    default:
-        return -EIO;
     }
 
-    if (xipaths[0].parent == renamed && !(xipaths[0].dirname[0] ==
-            '/' && xipaths[0].dirname[1] == '\0')) {
-        if (strcmp(xipaths[0].dirname, xipaths[1].dirname) != 0) {
-            if (xipfs_fs_new_file(mp, xipaths[0].dirname,
-                    XIPFS_NVM_PAGE_SIZE, 0) == NULL) {
-                return -EIO;
-            }
+    if (xipfs_fs_new_files(mp, specs, n) < 0) {
+        /* file creation failed */
+        if (xipfs_errno == XIPFS_ENOSPACE ||
+            xipfs_errno == XIPFS_EFULL) {
+            return -EDQUOT;
+        }
+        if (xipfs_errno == XIPFS_EINVALIDSIZE) {
+            return -EINVAL;
         }
+        return -EIO;
     }
-
-    if (xipaths[1].witness != NULL) {
-        if (strcmp(xipaths[1].witness->path, xipaths[1].dirname) == 0) {
-            if (sync_remove_file(mp, xipaths[1].witness) < 0) {
+    /* the directories of the log are no longer empty */
+    for (i = 0; XIPFS_EMPTY_DIR_LOG > 0 && i < n; i++) {
+        len = (size_t)(strrchr(specs[i].path, '/') - specs[i].path) + 1;
+        if (len > 1) {
+            (void)memcpy(buf, specs[i].path, len);
+            buf[len] = '\0';
+            if (xipfs_emptydir_remove(mp, buf) < 0) {
                 return -EIO;
             }
         }
@@ -1443,126 +3271,203 @@ xipfs_rename(xipfs_mount_t *mp, const char *from_path,
 }
 
 int
-xipfs_stat(xipfs_mount_t *mp, const char *path,
-           struct stat *buf)
+xipfs_new_packed_file(xipfs_mount_t *mp, const char *path,
+                      const void *buf, size_t size)
 {
     xipfs_path_t xipath;
     size_t len;
-    off_t size;
     int ret;
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
+    if (XIPFS_PACKED_FILE_MAX == 0) {
+        return -ENOTSUP;
+    }
     if (path == NULL) {
         return -EFAULT;
     }
-    if (buf == NULL) {
+    if (buf == NULL && size > 0) {
         return -EFAULT;
     }
     if (path[0] == '\0') {
         return -ENOENT;
     }
+    if (path[0] == '/' && path[1] == '\0') {
+        return -EISDIR;
+    }
     len = strnlen(path, XIPFS_PATH_MAX);
     if (len == XIPFS_PATH_MAX) {
         return -ENAMETOOLONG;
     }
+    if (size > XIPFS_PACKED_FILE_MAX) {
+        return -EFBIG;
+    }
 
     if (xipfs_path_new(mp, &xipath, path) < 0) {
         return -EIO;
     }
     switch (xipath.info) {
     case XIPFS_PATH_EXISTS_AS_FILE:
+        return -EEXIST;
     case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
     case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
-        break;
+        return -EISDIR;
     case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
         return -ENOTDIR;
     case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
-    case XIPFS_PATH_CREATABLE:
         return -ENOENT;
+    case XIPFS_PATH_CREATABLE:
+        break;
     default:
         return -EIO;
     }
 
-    if (strncmp(xipath.witness->path, xipath.path, len) != 0) {
-        return -ENOENT;
+    if (xipath.path[xipath.len-1] == '/') {
+        return -EISDIR;
     }
-
-    if ((size = (off_t)xipfs_file_get_size_(xipath.witness)) < 0) {
+    if (xipath.last_slash == 0) {
+        /* the root directory is not marked by a file */
+        return -EINVAL;
+    }
+    if (xipfs_pack_new(mp, xipath.dir, xipath.path, buf, size) < 0) {
+        if (xipfs_errno == XIPFS_ENOSPACE ||
+            xipfs_errno == XIPFS_EFULL) {
+            return -EDQUOT;
+        }
         return -EIO;
     }
-
-    (void)memset(buf, 0, sizeof(*buf));
-    buf->st_dev = (dev_t)(uintptr_t)mp;
-    buf->st_ino = (ino_t)(uintptr_t)xipath.witness;
-    if (path[len-1] != '/') {
-        buf->st_mode = S_IFREG;
-    } else {
-        buf->st_mode = S_IFDIR;
+    if (xipfs_emptydir_remove(mp, xipath.dirname) < 0) {
+        return -EIO;
+    }
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
     }
-    buf->st_nlink = 1;
-    buf->st_size = size;
-    buf->st_blksize = XIPFS_NVM_PAGE_SIZE;
-    buf->st_blocks = xipath.witness->reserved / XIPFS_NVM_PAGE_SIZE;
 
     return 0;
 }
 
 int
-xipfs_statvfs(xipfs_mount_t *mp, const char *restrict path,
-              struct xipfs_statvfs *restrict buf)
+xipfs_copy(xipfs_mount_t *mp, const char *from, const char *to)
 {
-    unsigned free_pages, page_number;
+    xipfs_path_t xipath;
+    size_t len;
     int ret;
 
-    UNUSED(path);
-
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (buf == NULL) {
+    if (from == NULL || to == NULL) {
         return -EFAULT;
     }
+    if (from[0] == '\0' || to[0] == '\0') {
+        return -ENOENT;
+    }
+    if (to[0] == '/' && to[1] == '\0') {
+        return -EISDIR;
+    }
+    len = strnlen(from, XIPFS_PATH_MAX);
+    if (len == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
+    len = strnlen(to, XIPFS_PATH_MAX);
+    if (len == XIPFS_PATH_MAX) {
+        return -ENAMETOOLONG;
+    }
 
-    if ((ret = xipfs_fs_get_page_number(mp)) < 0) {
+    if (xipfs_path_new(mp, &xipath, from) < 0) {
         return -EIO;
     }
-    page_number = (unsigned)ret;
+    switch (xipath.info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+        break;
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+        return -EISDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+    case XIPFS_PATH_CREATABLE:
+        return -ENOENT;
+    default:
+        return -EIO;
+    }
+    if (xipath.packed >= 0) {
+        /* a packed file has no pages of its own to copy */
+        return -EINVAL;
+    }
 
-    if ((ret = xipfs_fs_free_pages(mp)) < 0) {
+    if (xipfs_path_new(mp, &xipath, to) < 0) {
+        return -EIO;
+    }
+    switch (xipath.info) {
+    case XIPFS_PATH_EXISTS_AS_FILE:
+        return -EEXIST;
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+    case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
+        return -EISDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS:
+        return -ENOTDIR;
+    case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
+        return -ENOENT;
+    case XIPFS_PATH_CREATABLE:
+        break;
+    default:
+        return -EIO;
+    }
+    if (xipath.path[xipath.len-1] == '/') {
+        return -EISDIR;
+    }
+    /* the witness is only removed once the file fits in the
+     * directory table */
+    if (xipfs_dirtab_fit(mp, xipath.path) < 0) {
+        if (xipfs_errno == XIPFS_ENOSPACE) {
+            return -EDQUOT;
+        }
+        return -EIO;
+    }
+    if (fill_dir(mp, &xipath) < 0) {
         return -EIO;
     }
-    free_pages = (unsigned)ret;
 
-    (void)memset(buf, 0, sizeof(*buf));
-    buf->f_bsize = XIPFS_NVM_PAGE_SIZE;
-    buf->f_frsize = XIPFS_NVM_PAGE_SIZE;
-    buf->f_blocks = page_number;
-    buf->f_bfree = free_pages;
-    buf->f_bavail = free_pages;
-    buf->f_flag = ST_NOSUID;
-    buf->f_namemax = XIPFS_PATH_MAX;
+    /* the source may have moved in the meantime */
+    if (xipfs_path_new(mp, &xipath, from) < 0) {
+        return -EIO;
+    }
+    if (xipath.info != XIPFS_PATH_EXISTS_AS_FILE) {
+        return -EIO;
+    }
+    if (xipfs_fs_copy(mp, xipath.witness, to) == NULL) {
+        if (xipfs_errno == XIPFS_ENOSPACE ||
+            xipfs_errno == XIPFS_EFULL) {
+            return -EDQUOT;
+        }
+        if (xipfs_errno == XIPFS_EPERM) {
+            return -EACCES;
+        }
+        return -EIO;
+    }
+    if (reclaim_removed(mp) < 0) {
+        return -EIO;
+    }
 
     return 0;
 }
 
-/*
- * xipfs-specific functions
- */
-
-int
-xipfs_new_file(xipfs_mount_t *mp, const char *path,
-               xipfs_file_position_t size, uint32_t exec)
+off_t
+xipfs_install_open(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+                   const char *path, xipfs_file_position_t size)
 {
     xipfs_path_t xipath;
+    xipfs_file_position_t pos;
+    xipfs_file_t *filp;
     size_t len;
     int ret;
 
     if ((ret = xipfs_mp_check(mp)) < 0) {
         return ret;
     }
-    if (path == NULL) {
+    if (descp == NULL || path == NULL) {
         return -EFAULT;
     }
     if (path[0] == '\0') {
@@ -1575,7 +3480,7 @@ xipfs_new_file(xipfs_mount_t *mp, const char *path,
     if (len == XIPFS_PATH_MAX) {
         return -ENAMETOOLONG;
     }
-    if (exec != 0 && exec != 1) {
+    if (size < 0) {
         return -EINVAL;
     }
 
@@ -1584,7 +3489,21 @@ xipfs_new_file(xipfs_mount_t *mp, const char *path,
     }
     switch (xipath.info) {
     case XIPFS_PATH_EXISTS_AS_FILE:
-        return -EEXIST;
+        if (xipath.packed >= 0 ||
+            xipath.witness->exec != XIPFS_FILE_EXEC_INSTALL) {
+            /* a complete file is not installed again */
+            return -EEXIST;
+        }
+        filp = xipath.witness;
+        if (xipfs_file_get_max_pos(filp) < size) {
+            return -EINVAL;
+        }
+        /* the bytes programmed past the committed size are
+         * dropped */
+        if (xipfs_file_install_resume(filp, &pos) < 0) {
+            return -EIO;
+        }
+        break;
     case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
     case XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR:
         return -EISDIR;
@@ -1593,33 +3512,115 @@ xipfs_new_file(xipfs_mount_t *mp, const char *path,
     case XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND:
         return -ENOENT;
     case XIPFS_PATH_CREATABLE:
+        if (xipath.path[xipath.len-1] == '/') {
+            return -EISDIR;
+        }
+        /* the witness is only removed once the file fits in the
+         * directory table */
+        if (xipfs_dirtab_fit(mp, xipath.path) < 0) {
+            if (xipfs_errno == XIPFS_ENOSPACE) {
+                return -EDQUOT;
+            }
+            return -EIO;
+        }
+        if (fill_dir(mp, &xipath) < 0) {
+            return -EIO;
+        }
+        if ((filp = xipfs_fs_new_file(mp, path, size,
+                XIPFS_FILE_EXEC_INSTALL)) == NULL) {
+            if (xipfs_errno == XIPFS_ENOSPACE ||
+                xipfs_errno == XIPFS_EFULL) {
+                return -EDQUOT;
+            }
+            if (xipfs_errno == XIPFS_EINVALIDSIZE) {
+                return -EINVAL;
+            }
+            return -EIO;
+        }
+        pos = 0;
         break;
     default:
         return -EIO;
     }
 
-    if (xipath.path[xipath.len-1] == '/') {
-        return -EISDIR;
+    if ((ret = xipfs_file_desc_track(descp)) < 0) {
+        return ret;
     }
-    if (xipath.witness != NULL && !(xipath.dirname[0] ==
-            '/' && xipath.dirname[1] == '\0')) {
-        if (strcmp(xipath.witness->path, xipath.dirname) == 0) {
-            if (sync_remove_file(mp, xipath.witness) < 0) {
-                return -EIO;
-            }
-        }
+    descp->filp = filp;
+    descp->flags = O_WRONLY;
+    descp->pos = pos;
+    descp->end = 0;
+    descp->packed = -1;
+    /* the descriptor follows the file if it moves */
+    if (reclaim_removed(mp) < 0) {
+        (void)xipfs_file_desc_untrack(descp);
+        return -EIO;
     }
-    if (xipfs_fs_new_file(mp, path, size, exec) == NULL) {
-        /* file creation failed */
-        if (xipfs_errno == XIPFS_ENOSPACE ||
-            xipfs_errno == XIPFS_EFULL) {
-            return -EDQUOT;
-        }
-        if (xipfs_errno == XIPFS_EINVALIDSIZE) {
-            return -EINVAL;
-        }
+
+    return (off_t)pos;
+}
+
+int
+xipfs_install_commit(xipfs_mount_t *mp, xipfs_file_desc_t *descp)
+{
+    xipfs_file_position_t size;
+    int ret;
+
+    if ((ret = xipfs_mp_check(mp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_check(mp, descp)) < 0) {
+        return ret;
+    }
+    if ((ret = xipfs_file_desc_tracked(descp)) < 0) {
+        return -EBADF;
+    }
+    if (descp->packed >= 0 ||
+        descp->filp->exec != XIPFS_FILE_EXEC_INSTALL) {
+        return -EINVAL;
+    }
+    if ((size = xipfs_file_get_size(descp->filp)) < 0) {
+        return -EIO;
+    }
+    if (size == descp->pos) {
+        return 0;
+    }
+    /* the bytes reach flash before the size that covers them */
+    if (xipfs_buffer_flush() < 0) {
+        return -EIO;
+    }
+    if (xipfs_file_set_size(descp->filp, descp->pos) < 0) {
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int
+xipfs_install_finish(xipfs_mount_t *mp, xipfs_file_desc_t *descp,
+                     uint32_t exec)
+{
+    int ret;
+
+    if (exec != 0 && exec != 1) {
+        return -EINVAL;
+    }
+    if ((ret = xipfs_install_commit(mp, descp)) < 0) {
+        return ret;
+    }
+    /* the file structure is programmed behind the buffer */
+    if (xipfs_buffer_flush() < 0) {
+        return -EIO;
+    }
+    xipfs_buffer_invalidate();
+    /* only clears bits of the execution right */
+    if (xipfs_flash_write_unaligned(&descp->filp->exec, &exec,
+            sizeof(exec)) < 0) {
         return -EIO;
     }
+    if ((ret = xipfs_file_desc_untrack(descp)) < 0) {
+        return ret;
+    }
 
     return 0;
 }
@@ -1682,27 +3683,32 @@ xipfs_execv_check(xipfs_mount_t *mp, const char *path,
         return -EACCES;
     case 1:
         break;
+    case XIPFS_FILE_EXEC_INSTALL:
+        /* the installation is not complete */
+        return -ETXTBSY;
     default:
         return -EINVAL;
     }
 
-    xipfs_file_desc_t descp;
+    xipfs_file_position_t size;
     uint32_t last_uint32_value;
 
-    if (xipfs_open(mp, &descp, path, O_RDONLY, 0) < 0)
-        return -EINVAL;
-
-    if (xipfs_lseek(mp, &descp, -sizeof(last_uint32_value), SEEK_END) < 0) {
-        (void)xipfs_close(mp, &descp);
+    /* the binary is executed in place, thus its pages buffered
+     * in RAM must reach the flash first */
+    if (xipfs_buffer_flush() < 0) {
         return -EIO;
     }
-
-    if (xipfs_read(mp, &descp, &last_uint32_value, sizeof(last_uint32_value)) < 0) {
-        (void)xipfs_close(mp, &descp);
+    if ((size = xipfs_file_get_size(xipath->witness)) < 0) {
+        return -EIO;
+    }
+    if ((size_t)size < sizeof(last_uint32_value)) {
+        return -EIO;
+    }
+    if (xipfs_file_read(xipath->witness,
+            size - (xipfs_file_position_t)sizeof(last_uint32_value),
+            &last_uint32_value, sizeof(last_uint32_value)) < 0) {
         return -EIO;
     }
-
-    (void)xipfs_close(mp, &descp);
 
 #define CRT0_MAGIC_NUMBER_AND_VERSION (0xFACADE12)
     if (last_uint32_value != CRT0_MAGIC_NUMBER_AND_VERSION)
@@ -0,0 +1,994 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * libc includes
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * xipfs includes
+ */
+#include "include/xipfs.h"
+#include "include/buffer.h"
+#include "include/emptydir.h"
+#include "include/errno.h"
+#include "include/file.h"
+#include "include/flash.h"
+#include "include/fs.h"
+
+#if XIPFS_EMPTY_DIR_LOG > 0
+
+/**
+ * @internal
+ *
+ * @def ROUND
+ *
+ * @brief Round x to the next power of two y
+ *
+ * @param x The number to round to the next power of two y
+ *
+ * @param y The power of two with which to round x
+ */
+#define ROUND(x, y) (((x) + (y) - 1) & ~((y) - 1))
+
+/**
+ * @internal
+ *
+ * @def XIPFS_EMPTYDIR_LIVE
+ *
+ * @brief The state of a record once it is whole
+ */
+#define XIPFS_EMPTYDIR_LIVE (0x0f)
+
+/**
+ * @internal
+ *
+ * @def XIPFS_EMPTYDIR_DEAD
+ *
+ * @brief The state of a record once its directory is no longer
+ * empty or is removed
+ */
+#define XIPFS_EMPTYDIR_DEAD (0x00)
+
+/**
+ * @internal
+ *
+ * @def XIPFS_EMPTYDIR_LOG_SIZE
+ *
+ * @brief The number of bytes of the file of the log available
+ * for records
+ */
+#define XIPFS_EMPTYDIR_LOG_SIZE \
+    (XIPFS_NVM_PAGE_SIZE - sizeof(xipfs_file_t))
+
+/**
+ * @internal
+ *
+ * @def XIPFS_EMPTYDIR_RECORD_SIZE
+ *
+ * @brief The size of a record holding a path of len characters
+ *
+ * @param len The length of the path
+ */
+#define XIPFS_EMPTYDIR_RECORD_SIZE(len) \
+    (sizeof(xipfs_emptydir_record_t) + \
+     ROUND((size_t)(len), sizeof(uint32_t)))
+
+/**
+ * @internal
+ *
+ * @brief A record of an empty directory in the log, followed by
+ * the path of the directory padded to a 32-bit boundary. The
+ * records are appended to the log, an erased word follows the
+ * last one
+ */
+typedef struct xipfs_emptydir_record_s {
+    /**
+     * The length of the path, with its trailing slash
+     */
+    uint8_t len;
+    /**
+     * Erased until the record is whole, XIPFS_EMPTYDIR_LIVE
+     * then and XIPFS_EMPTYDIR_DEAD once the directory is no
+     * longer empty
+     */
+    uint8_t state;
+    /**
+     * Left erased
+     */
+    uint16_t unused;
+} xipfs_emptydir_record_t;
+
+/**
+ * @internal
+ *
+ * @brief A structure that describes the log of the empty
+ * directories
+ */
+typedef struct xipfs_emptydir_s {
+    /**
+     * The mount point the log is bound to, NULL if none
+     */
+    xipfs_mount_t *mp;
+    /**
+     * The address range of the mount point
+     */
+    uintptr_t start, end;
+    /**
+     * Non-zero if the log reflects the file system
+     */
+    int valid;
+    /**
+     * The file holding the log, NULL if there is none yet
+     */
+    xipfs_file_t *log;
+} xipfs_emptydir_t;
+
+/**
+ * @internal
+ *
+ * @brief The log of the empty directories of xipfs
+ */
+static xipfs_emptydir_t xipfs_emptydir;
+
+/*
+ * Helper functions
+ */
+
+/**
+ * @internal
+ *
+ * @pre The pages of the log must not be buffered
+ *
+ * @brief Retrieves the record at a position of the log
+ *
+ * @param off The position of the record
+ *
+ * @return Returns a pointer to the record or NULL if the
+ * records end before this position
+ */
+static const xipfs_emptydir_record_t *
+xipfs_emptydir_record(size_t off)
+{
+    const xipfs_emptydir_record_t *record;
+
+    if (xipfs_emptydir.log == NULL ||
+        off + sizeof(*record) > XIPFS_EMPTYDIR_LOG_SIZE) {
+        return NULL;
+    }
+    record = (const xipfs_emptydir_record_t *)
+        (xipfs_emptydir.log->buf + off);
+    if (*(const uint32_t *)record == (uint32_t)XIPFS_FLASH_ERASE_STATE) {
+        return NULL;
+    }
+    if (record->len < 2 || record->len >= XIPFS_PATH_MAX ||
+        off + XIPFS_EMPTYDIR_RECORD_SIZE(record->len) >
+            XIPFS_EMPTYDIR_LOG_SIZE) {
+        return NULL;
+    }
+
+    return record;
+}
+
+/**
+ * @internal
+ *
+ * @brief Retrieves the path of a record
+ *
+ * @param record A pointer to the record
+ *
+ * @return Returns a pointer to the path, which is not
+ * null-terminated
+ */
+static const char *
+xipfs_emptydir_path(const xipfs_emptydir_record_t *record)
+{
+    return (const char *)(record + 1);
+}
+
+/**
+ * @internal
+ *
+ * @brief Retrieves the position past the last record of the log
+ *
+ * @return Returns the position where the next record goes, the
+ * size of the log if an interrupted record ends it, so that the
+ * log is folded before anything is appended
+ */
+static size_t
+xipfs_emptydir_end(void)
+{
+    const xipfs_emptydir_record_t *record;
+    size_t off;
+
+    off = 0;
+    while ((record = xipfs_emptydir_record(off)) != NULL) {
+        off += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+    }
+    if (off + sizeof(*record) <= XIPFS_EMPTYDIR_LOG_SIZE &&
+        *(const uint32_t *)(xipfs_emptydir.log->buf + off) !=
+            (uint32_t)XIPFS_FLASH_ERASE_STATE) {
+        return XIPFS_EMPTYDIR_LOG_SIZE;
+    }
+
+    return off;
+}
+
+/**
+ * @internal
+ *
+ * @brief Looks the live record of a directory up
+ *
+ * @param path A pointer to the path of the directory, which
+ * ends with a slash
+ *
+ * @param len The length of the path
+ *
+ * @return Returns the position of the record or a negative
+ * value if there is none
+ */
+static xipfs_file_position_t
+xipfs_emptydir_lookup(const char *path, size_t len)
+{
+    const xipfs_emptydir_record_t *record;
+    size_t off;
+
+    off = 0;
+    while ((record = xipfs_emptydir_record(off)) != NULL) {
+        if (record->state == XIPFS_EMPTYDIR_LIVE && record->len == len &&
+            memcmp(xipfs_emptydir_path(record), path, len) == 0) {
+            return (xipfs_file_position_t)off;
+        }
+        off += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+    }
+
+    return -1;
+}
+
+/**
+ * @internal
+ *
+ * @pre The log must have room for the record
+ *
+ * @brief Appends a record to the log. The record only counts
+ * once it is whole
+ *
+ * @param off The position of the record
+ *
+ * @param path A pointer to the path of the directory
+ *
+ * @param len The length of the path
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_emptydir_append(size_t off, const char *path, size_t len)
+{
+    const uint32_t erased = (uint32_t)XIPFS_FLASH_ERASE_STATE;
+    const uint8_t live = XIPFS_EMPTYDIR_LIVE;
+    struct {
+        xipfs_emptydir_record_t record;
+        char path[XIPFS_PATH_MAX + sizeof(uint32_t)];
+    } buf;
+    size_t size;
+
+    assert(off + XIPFS_EMPTYDIR_RECORD_SIZE(len) <=
+        XIPFS_EMPTYDIR_LOG_SIZE);
+
+    (void)memset(&buf, XIPFS_NVM_ERASE_STATE, sizeof(buf));
+    buf.record.len = (uint8_t)len;
+    (void)memcpy(buf.path, path, len);
+    size = XIPFS_EMPTYDIR_RECORD_SIZE(len);
+
+    if (xipfs_file_write(xipfs_emptydir.log, (xipfs_file_position_t)off,
+            &buf, size) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    /* the records end with an erased word */
+    if (off + size + sizeof(erased) <= XIPFS_EMPTYDIR_LOG_SIZE &&
+        xipfs_file_write(xipfs_emptydir.log, (xipfs_file_position_t)
+            (off + size), &erased, sizeof(erased)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_file_write(xipfs_emptydir.log, (xipfs_file_position_t)
+            (off + offsetof(xipfs_emptydir_record_t, state)), &live,
+            sizeof(live)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return xipfs_buffer_flush();
+}
+
+/**
+ * @internal
+ *
+ * @brief Clears the state of a record
+ *
+ * @param off The position of the record
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_emptydir_kill(xipfs_file_position_t off)
+{
+    const uint8_t dead = XIPFS_EMPTYDIR_DEAD;
+
+    if (xipfs_file_write(xipfs_emptydir.log, off +
+            (xipfs_file_position_t)offsetof(xipfs_emptydir_record_t,
+            state), &dead, sizeof(dead)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return xipfs_buffer_flush();
+}
+
+/**
+ * @internal
+ *
+ * @brief Copies the live records to a new log, which replaces
+ * the former one once complete
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_emptydir_fold(xipfs_mount_t *mp)
+{
+    const xipfs_emptydir_record_t *record;
+    xipfs_file_t *filp;
+    size_t off, used;
+
+    /* the garbage collection may move the former log, which
+     * keeps track of it */
+    if ((filp = xipfs_fs_new_table(mp, XIPFS_EMPTYDIR_LOG, 1)) == NULL) {
+        /* xipfs_errno was set */
+        xipfs_emptydir.valid = 0;
+        return -1;
+    }
+    used = 0;
+    off = 0;
+    while ((record = xipfs_emptydir_record(off)) != NULL) {
+        if (record->state == XIPFS_EMPTYDIR_LIVE) {
+            if (xipfs_file_write(filp, (xipfs_file_position_t)used,
+                    record, XIPFS_EMPTYDIR_RECORD_SIZE(record->len)) < 0) {
+                /* xipfs_errno was set */
+                xipfs_emptydir.valid = 0;
+                return -1;
+            }
+            used += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+        }
+        off += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+    }
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        xipfs_emptydir.valid = 0;
+        return -1;
+    }
+    /* the new log replaces the former ones once complete */
+    if (xipfs_fs_table_commit(mp, filp, used) < 0) {
+        /* xipfs_errno was set */
+        xipfs_emptydir.valid = 0;
+        return -1;
+    }
+    xipfs_emptydir.log = filp;
+
+    return 0;
+}
+
+/*
+ * Extern functions
+ */
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre path must be the path of an empty directory without
+ * record, ending with a slash
+ *
+ * @brief Records an empty directory in the log, which is folded
+ * if the record does not fit
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param path A pointer to the path of the directory
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise, with xipfs_errno set to XIPFS_ENOSPACE if the
+ * live records fill the log
+ */
+int
+xipfs_emptydir_add(xipfs_mount_t *mp, const char *path)
+{
+    size_t len, off;
+
+    assert(path != NULL);
+
+    len = strnlen(path, XIPFS_PATH_MAX);
+    assert(len >= 2 && len < XIPFS_PATH_MAX && path[len-1] == '/');
+
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_emptydir_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    off = (xipfs_emptydir.log != NULL) ? xipfs_emptydir_end() :
+        XIPFS_EMPTYDIR_LOG_SIZE;
+    if (off + XIPFS_EMPTYDIR_RECORD_SIZE(len) > XIPFS_EMPTYDIR_LOG_SIZE) {
+        if (xipfs_emptydir_fold(mp) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        off = xipfs_emptydir_end();
+        if (off + XIPFS_EMPTYDIR_RECORD_SIZE(len) >
+                XIPFS_EMPTYDIR_LOG_SIZE) {
+            xipfs_errno = XIPFS_ENOSPACE;
+            return -1;
+        }
+    }
+
+    return xipfs_emptydir_append(off, path, len);
+}
+
+/**
+ * @pre The log must be loaded for the mount point of the path
+ *
+ * @pre path must be a pointer that references a null-terminated
+ * string
+ *
+ * @brief Looks the record of an empty directory up
+ *
+ * @param path A pointer to the path of the directory, ending
+ * with a slash
+ *
+ * @return Returns the position of the record in the file of
+ * the log or a negative value if there is none
+ */
+xipfs_file_position_t
+xipfs_emptydir_find(const char *path)
+{
+    assert(path != NULL);
+
+    return xipfs_emptydir_lookup(path, strnlen(path, XIPFS_PATH_MAX));
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre from and to must be pointers that reference paths of
+ * directories, ending with a slash
+ *
+ * @brief Checks whether the paths of the empty directories below
+ * a directory stay shorter than XIPFS_PATH_MAX once it is
+ * renamed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param from A pointer to the path of the directory
+ *
+ * @param to A pointer to the new path of the directory
+ *
+ * @return Returns zero if the paths fit or a negative value
+ * otherwise
+ */
+int
+xipfs_emptydir_fit(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    const xipfs_emptydir_record_t *record;
+    size_t from_len, to_len, off;
+
+    assert(from != NULL);
+    assert(to != NULL);
+
+    if (xipfs_emptydir_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    from_len = strnlen(from, XIPFS_PATH_MAX);
+    to_len = strnlen(to, XIPFS_PATH_MAX);
+
+    off = 0;
+    while ((record = xipfs_emptydir_record(off)) != NULL) {
+        if (record->state == XIPFS_EMPTYDIR_LIVE &&
+            record->len >= from_len &&
+            memcmp(xipfs_emptydir_path(record), from, from_len) == 0 &&
+            to_len + record->len - from_len >= XIPFS_PATH_MAX) {
+            xipfs_errno = XIPFS_ENULTER;
+            return -1;
+        }
+        off += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Drops the log if the address belongs to the mount
+ * point it is bound to, it is loaded again on next use
+ *
+ * @param addr An address in the NVM
+ */
+void
+xipfs_emptydir_invalidate(const void *addr)
+{
+    if (xipfs_emptydir.mp != NULL &&
+        (uintptr_t)addr >= xipfs_emptydir.start &&
+        (uintptr_t)addr < xipfs_emptydir.end) {
+        xipfs_emptydir.valid = 0;
+    }
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Binds the log to a mount point, looking its file up
+ * unless it is already known
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_emptydir_load(xipfs_mount_t *mp)
+{
+    xipfs_file_t *log;
+
+    assert(mp != NULL);
+
+    /* the mount point structure may have been set up again for
+     * other pages */
+    if (xipfs_emptydir.mp == mp && xipfs_emptydir.valid == 1 &&
+        xipfs_emptydir.start == (uintptr_t)mp->page_addr &&
+        xipfs_emptydir.end == xipfs_emptydir.start +
+            mp->page_num * XIPFS_NVM_PAGE_SIZE) {
+        return 0;
+    }
+
+    (void)memset(&xipfs_emptydir, 0, sizeof(xipfs_emptydir));
+    xipfs_errno = XIPFS_OK;
+    if ((log = xipfs_fs_table(mp, XIPFS_EMPTYDIR_LOG)) == NULL &&
+        xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_emptydir.mp = mp;
+    xipfs_emptydir.start = (uintptr_t)mp->page_addr;
+    xipfs_emptydir.end = xipfs_emptydir.start +
+        mp->page_num * XIPFS_NVM_PAGE_SIZE;
+    xipfs_emptydir.log = log;
+    xipfs_emptydir.valid = 1;
+
+    return 0;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Checks whether a file holds the log
+ *
+ * @param filp A pointer to the xipfs file structure
+ *
+ * @return Returns one if the file holds the log or zero
+ * otherwise
+ */
+int
+xipfs_emptydir_log(const xipfs_file_t *filp)
+{
+    return filp->path[0] == XIPFS_EMPTYDIR_LOG;
+}
+
+/**
+ * @brief Updates the log after a file was moved
+ *
+ * @param from The former address of the moved file
+ *
+ * @param to The new address of the moved file
+ */
+void
+xipfs_emptydir_move(xipfs_file_t *from, xipfs_file_t *to)
+{
+    if (xipfs_emptydir.log == from) {
+        xipfs_emptydir.log = to;
+    }
+}
+
+/**
+ * @pre The log must be loaded
+ *
+ * @pre path must be a pointer that references an accessible
+ * memory region of XIPFS_PATH_MAX bytes
+ *
+ * @brief Lists the empty directories
+ *
+ * @param pos The position where to look for the next record,
+ * zero for the first one
+ *
+ * @param path A pointer where to copy the path of the empty
+ * directory
+ *
+ * @return Returns the position past the record found, to pass
+ * to the next call, or zero if there is none
+ */
+xipfs_file_position_t
+xipfs_emptydir_next(xipfs_file_position_t pos, char *path)
+{
+    const xipfs_emptydir_record_t *record;
+    size_t off;
+
+    assert(pos >= 0);
+    assert(path != NULL);
+
+    off = (size_t)pos;
+    while ((record = xipfs_emptydir_record(off)) != NULL) {
+        off += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+        if (record->state == XIPFS_EMPTYDIR_LIVE) {
+            (void)memcpy(path, xipfs_emptydir_path(record), record->len);
+            path[record->len] = '\0';
+            return (xipfs_file_position_t)off;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre path must be a pointer that references a path ending
+ * with a slash
+ *
+ * @brief Removes the record of a directory that is no longer
+ * empty or that is removed, if it has one
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param path A pointer to the path of the directory
+ *
+ * @return Returns one if a record was removed, zero if there is
+ * none or a negative value otherwise
+ */
+int
+xipfs_emptydir_remove(xipfs_mount_t *mp, const char *path)
+{
+    xipfs_file_position_t off;
+
+    assert(path != NULL);
+
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_emptydir_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if ((off = xipfs_emptydir_find(path)) < 0) {
+        return 0;
+    }
+    if (xipfs_emptydir_kill(off) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return 1;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre path must be a pointer that references a path ending
+ * with a slash
+ *
+ * @brief Removes the records of the empty directories below a
+ * directory, and of the directory itself
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param path A pointer to the path of the directory
+ *
+ * @return Returns the number of records removed or a negative
+ * value otherwise
+ */
+int
+xipfs_emptydir_remove_all(xipfs_mount_t *mp, const char *path)
+{
+    const xipfs_emptydir_record_t *record;
+    size_t len, off;
+    int count;
+
+    assert(path != NULL);
+
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_emptydir_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    len = strnlen(path, XIPFS_PATH_MAX);
+
+    count = 0;
+    off = 0;
+    while ((record = xipfs_emptydir_record(off)) != NULL) {
+        if (record->state == XIPFS_EMPTYDIR_LIVE && record->len >= len &&
+            memcmp(xipfs_emptydir_path(record), path, len) == 0) {
+            if (xipfs_emptydir_kill((xipfs_file_position_t)off) < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+            count++;
+        }
+        off += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+    }
+
+    return count;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre from and to must be pointers that reference paths of
+ * directories ending with a slash, to not starting with from
+ *
+ * @brief Renames the empty directories below a directory, and
+ * the directory itself
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param from Renames all paths with this prefix
+ *
+ * @param to Renames all paths with the prefix from to the to
+ * prefix
+ *
+ * @return Returns the number of records renamed or a negative
+ * value otherwise
+ */
+int
+xipfs_emptydir_rename_all(xipfs_mount_t *mp, const char *from,
+                          const char *to)
+{
+    const xipfs_emptydir_record_t *record;
+    char path[XIPFS_PATH_MAX];
+    size_t from_len, to_len, off;
+    int count;
+
+    assert(from != NULL);
+    assert(to != NULL);
+
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_emptydir_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    from_len = strnlen(from, XIPFS_PATH_MAX);
+    to_len = strnlen(to, XIPFS_PATH_MAX);
+    assert(strncmp(to, from, from_len) != 0);
+
+    count = 0;
+    off = 0;
+    while ((record = xipfs_emptydir_record(off)) != NULL) {
+        if (record->state != XIPFS_EMPTYDIR_LIVE || record->len < from_len ||
+            memcmp(xipfs_emptydir_path(record), from, from_len) != 0) {
+            off += XIPFS_EMPTYDIR_RECORD_SIZE(record->len);
+            continue;
+        }
+        if (to_len + record->len - from_len >= XIPFS_PATH_MAX) {
+            xipfs_errno = XIPFS_ENULTER;
+            return -1;
+        }
+        (void)memcpy(path, to, to_len);
+        (void)memcpy(&path[to_len], xipfs_emptydir_path(record) +
+            from_len, record->len - from_len);
+        path[to_len + record->len - from_len] = '\0';
+        /* the former record is removed first so that folding
+         * the log always makes room for the new one. Folding
+         * moves the records, the walk then starts over */
+        if (xipfs_emptydir_kill((xipfs_file_position_t)off) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (xipfs_emptydir_add(mp, path) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        count++;
+        off = 0;
+    }
+
+    return count;
+}
+
+/**
+ * @pre The log must be loaded
+ *
+ * @brief Retrieves the file holding the log, which witnesses
+ * the empty directories
+ *
+ * @return Returns a pointer to the file or NULL if there is
+ * none
+ */
+xipfs_file_t *
+xipfs_emptydir_witness(void)
+{
+    return xipfs_emptydir.log;
+}
+
+#else /* XIPFS_EMPTY_DIR_LOG > 0 */
+
+int
+xipfs_emptydir_add(xipfs_mount_t *mp, const char *path)
+{
+    (void)mp;
+    (void)path;
+
+    xipfs_errno = XIPFS_EPERM;
+
+    return -1;
+}
+
+xipfs_file_position_t
+xipfs_emptydir_find(const char *path)
+{
+    (void)path;
+
+    return -1;
+}
+
+int
+xipfs_emptydir_fit(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    (void)mp;
+    (void)from;
+    (void)to;
+
+    return 0;
+}
+
+void
+xipfs_emptydir_invalidate(const void *addr)
+{
+    (void)addr;
+}
+
+int
+xipfs_emptydir_load(xipfs_mount_t *mp)
+{
+    (void)mp;
+
+    return 0;
+}
+
+int
+xipfs_emptydir_log(const xipfs_file_t *filp)
+{
+    (void)filp;
+
+    return 0;
+}
+
+void
+xipfs_emptydir_move(xipfs_file_t *from, xipfs_file_t *to)
+{
+    (void)from;
+    (void)to;
+}
+
+xipfs_file_position_t
+xipfs_emptydir_next(xipfs_file_position_t pos, char *path)
+{
+    (void)pos;
+    (void)path;
+
+    return 0;
+}
+
+int
+xipfs_emptydir_remove(xipfs_mount_t *mp, const char *path)
+{
+    (void)mp;
+    (void)path;
+
+    return 0;
+}
+
+int
+xipfs_emptydir_remove_all(xipfs_mount_t *mp, const char *path)
+{
+    (void)mp;
+    (void)path;
+
+    return 0;
+}
+
+int
+xipfs_emptydir_rename_all(xipfs_mount_t *mp, const char *from,
+                          const char *to)
+{
+    (void)mp;
+    (void)from;
+    (void)to;
+
+    return 0;
+}
+
+xipfs_file_t *
+xipfs_emptydir_witness(void)
+{
+    return NULL;
+}
+
+#endif /* XIPFS_EMPTY_DIR_LOG > 0 */
@@ -45,9 +45,12 @@
  */
 #include "include/xipfs.h"
 #include "include/buffer.h"
+#include "include/dirtab.h"
+#include "include/emptydir.h"
 #include "include/errno.h"
 #include "include/file.h"
 #include "include/flash.h"
+#include "include/index.h"
 
 #ifdef XIPFS_ENABLE_SAFE_EXEC_SUPPORT
 #include "include/mpu_driver.h"
@@ -808,11 +811,15 @@ xipfs_file_filp_check(const xipfs_file_t *filp)
         xipfs_errno = XIPFS_EINVAL;
         return -1;
     }
-    if (xipfs_file_path_check(filp->path) < 0) {
+    /* a removed file has an empty path, the log of the empty
+     * directories a mark */
+    if (filp->path[0] != '\0' && !xipfs_emptydir_log(filp) &&
+            xipfs_dirtab_check(xipfs_file_get_path(filp)) < 0) {
         /* xipfs_errno was set */
         return -1;
     }
-    if (filp->exec != 0 && filp->exec != 1) {
+    if (filp->exec != 0 && filp->exec != 1 &&
+        filp->exec != XIPFS_FILE_EXEC_INSTALL) {
         xipfs_errno = XIPFS_EPERM;
         return -1;
     }
@@ -911,6 +918,49 @@ xipfs_file_erase(xipfs_file_t *filp)
     return 0;
 }
 
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Retrieves the index of the first free slot of the list
+ * of previous sizes
+ *
+ * Slots are filled strictly in order and reset together, thus
+ * the used slots always form a prefix of the list and the
+ * boundary can be found by binary search
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @return Returns the index of the first free slot,
+ * XIPFS_FILESIZE_SLOT_MAX if all the slots are used, or a
+ * negative value otherwise
+ */
+static int
+xipfs_file_get_free_slot(const xipfs_file_t *filp)
+{
+    size_t lo = 0, hi = XIPFS_FILESIZE_SLOT_MAX, mid;
+    xipfs_file_position_t size;
+
+    /* invariant: slots below lo are used, slots from hi are free */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (xipfs_buffer_read_32((unsigned *)&size, &(filp->size[mid])) < 0) {
+            // xipfs_errno has been set.
+            return -1;
+        }
+        if (size == (xipfs_file_position_t)XIPFS_FLASH_ERASE_STATE) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return (int)lo;
+}
+
 /**
  * @pre filp must be a pointer to an accessible and valid xipfs
  * file structure
@@ -927,37 +977,26 @@ xipfs_file_erase(xipfs_file_t *filp)
 xipfs_file_position_t
 xipfs_file_get_size_(const xipfs_file_t *filp)
 {
-    size_t i = 1;
-    xipfs_file_position_t size, last_size;
+    xipfs_file_position_t size;
+    int i;
 
-    if (xipfs_buffer_read_32((unsigned *)&size, &(filp->size[0])) < 0) {
+    if ((i = xipfs_file_get_free_slot(filp)) < 0) {
         // xipfs_errno has been set.
         return -1;
     }
 
-    if (size == (xipfs_file_position_t)XIPFS_FLASH_ERASE_STATE) {
+    if (i == 0) {
         /* file size not in flash yet */
         return 0;
     }
 
-    // Find last occupied slot.
-    last_size = size;
-    while (i < XIPFS_FILESIZE_SLOT_MAX) {
-        if (xipfs_buffer_read_32((unsigned *)&size, &(filp->size[i])) < 0) {
-            // xipfs_errno has been set.
-            return -1;
-        }
-
-        if (size == (xipfs_file_position_t)XIPFS_FLASH_ERASE_STATE) {
-            return last_size;
-        }
-
-        i++;
-        last_size = size;
+    // The last occupied slot holds the current size.
+    if (xipfs_buffer_read_32((unsigned *)&size, &(filp->size[i - 1])) < 0) {
+        // xipfs_errno has been set.
+        return -1;
     }
 
-    // We've browsed all the slots array. Return the last read size.
-    return last_size;
+    return size;
 }
 
 /**
@@ -1001,8 +1040,8 @@ xipfs_file_get_size(const xipfs_file_t *filp)
 int
 xipfs_file_set_size(xipfs_file_t *filp, xipfs_file_position_t size)
 {
-    size_t i = 0;
-    xipfs_file_position_t flash_value;
+    size_t i;
+    int slot;
 
     if (xipfs_file_filp_check(filp) < 0) {
         /* xipfs_errno was set */
@@ -1020,15 +1059,13 @@ xipfs_file_set_size(xipfs_file_t *filp, xipfs_file_position_t size)
     }
 
     // Find the first free size slot.
-    while (i < XIPFS_FILESIZE_SLOT_MAX) {
-        if (xipfs_buffer_read_32((unsigned int *)&flash_value, &(filp->size[i])) < 0) {
-            // xipfs_errno has been set.
-            return -1;
-        }
-        if (flash_value == (xipfs_file_position_t)XIPFS_FLASH_ERASE_STATE) {
-            goto write_size;
-        }
-        i++;
+    if ((slot = xipfs_file_get_free_slot(filp)) < 0) {
+        // xipfs_errno has been set.
+        return -1;
+    }
+    if (slot < XIPFS_FILESIZE_SLOT_MAX) {
+        i = (size_t)slot;
+        goto write_size;
     }
 
     // No free slot, reinit the slots array, except from the first slot.
@@ -1058,13 +1095,232 @@ write_size :
     return 0;
 }
 
+#if XIPFS_PATH_SLOT_MAX > 0
+
 /**
+ * @internal
+ *
  * @pre filp must be a pointer to an accessible and valid xipfs
  * file structure
  *
- * @pre path must be a pointer that references a path which is
- * accessible, null-terminated, starts with a slash, normalized,
- * and shorter than XIPFS_PATH_MAX
+ * @brief Retrieves the index of the first free slot of the list
+ * of previous paths
+ *
+ * Slots are filled strictly in order and reset together, thus
+ * the used slots always form a prefix of the list and the
+ * boundary can be found by binary search. The first byte of a
+ * slot is programmed last, so that an interrupted rename leaves
+ * the slot free
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @return Returns the index of the first free slot, or
+ * XIPFS_PATH_SLOT_MAX if all the slots are used
+ */
+static size_t
+xipfs_file_get_free_path_slot(const xipfs_file_t *filp)
+{
+    size_t lo = 0, hi = XIPFS_PATH_SLOT_MAX, mid;
+
+    /* invariant: slots below lo are used, slots from hi are free */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if ((unsigned char)filp->path_slot[mid][0] ==
+                (unsigned char)XIPFS_NVM_ERASE_STATE) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre slot must be the index of a free slot of the list of
+ * previous paths
+ *
+ * @brief Checks whether a free slot of the list of previous
+ * paths is fully erased, which is not the case when a rename
+ * was interrupted while programming it
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param slot The index of the slot to check
+ *
+ * @return Returns one if the slot is fully erased or zero
+ * otherwise
+ */
+static int
+xipfs_file_path_slot_erased(const xipfs_file_t *filp, size_t slot)
+{
+    size_t i;
+
+    for (i = 1; i < XIPFS_PATH_MAX; i++) {
+        if ((unsigned char)filp->path_slot[slot][i] !=
+                (unsigned char)XIPFS_NVM_ERASE_STATE) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre path must be a pointer that references a path in the
+ * form stored in file structures, which is accessible,
+ * null-terminated, and shorter than XIPFS_PATH_MAX
+ *
+ * @brief Appends a path to the list of previous paths, without
+ * erasing the first page of the file
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param path The new path of the file
+ *
+ * @return Returns one if the path was appended, zero if there
+ * is no free slot left, or a negative value otherwise
+ */
+static int
+xipfs_file_append_path(xipfs_file_t *filp, const char *path)
+{
+    const char dead = '\0';
+    size_t slot, len;
+
+    if ((slot = xipfs_file_get_free_path_slot(filp)) ==
+            XIPFS_PATH_SLOT_MAX) {
+        return 0;
+    }
+
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_buffer_invalidate();
+
+    if (xipfs_file_path_slot_erased(filp, slot) == 0) {
+        /* an interrupted rename left this slot, mark it dead */
+        if (xipfs_flash_write_unaligned(&filp->path_slot[slot][0],
+                &dead, sizeof(dead)) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (++slot == XIPFS_PATH_SLOT_MAX) {
+            return 0;
+        }
+    }
+
+    len = strlen(path) + 1;
+    if (xipfs_flash_write_unaligned(&filp->path_slot[slot][1],
+            &path[1], len - 1) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_flash_write_unaligned(&filp->path_slot[slot][0],
+            &path[0], 1) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre path must be a pointer that references a path in the
+ * form stored in file structures, which is accessible,
+ * null-terminated, and shorter than XIPFS_PATH_MAX
+ *
+ * @brief Writes a path to the file structure and resets the
+ * list of previous paths, which rewrites the first page of the
+ * file
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param path The new path of the file
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+static int
+xipfs_file_fold_path(xipfs_file_t *filp, const char *path)
+{
+    char erased[XIPFS_PATH_MAX];
+    size_t i;
+
+    (void)memset(erased, XIPFS_NVM_ERASE_STATE, sizeof(erased));
+    for (i = 0; i < XIPFS_PATH_SLOT_MAX; i++) {
+        if (xipfs_buffer_write(filp->path_slot[i], erased,
+                sizeof(erased)) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+
+    return xipfs_buffer_write(filp->path, path, strlen(path) + 1);
+}
+
+#endif /* XIPFS_PATH_SLOT_MAX > 0 */
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Retrieves the current path of a file from the list of
+ * previous paths, in the form stored in file structures
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @return Returns a pointer to the current path of the file
+ */
+const char *
+xipfs_file_get_path(const xipfs_file_t *filp)
+{
+#if XIPFS_PATH_SLOT_MAX > 0
+    size_t slot;
+
+    /* a removed file has an empty path whatever its slots hold */
+    if (filp->path[0] == '\0') {
+        return filp->path;
+    }
+    /* the last used slot that is not dead holds the current path */
+    slot = xipfs_file_get_free_path_slot(filp);
+    while (slot > 0) {
+        if (filp->path_slot[--slot][0] != '\0') {
+            return filp->path_slot[slot];
+        }
+    }
+#endif /* XIPFS_PATH_SLOT_MAX > 0 */
+
+    return filp->path;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre path must be a pointer that references a path in the
+ * form stored in file structures, which is accessible,
+ * null-terminated, and shorter than XIPFS_PATH_MAX
  *
  * @brief Changes the path of an xipfs file
  *
@@ -1079,26 +1335,227 @@ write_size :
 int
 xipfs_file_rename(xipfs_file_t *filp, const char *to_path)
 {
+#if XIPFS_PATH_SLOT_MAX > 0
+    int ret;
+#else
     size_t len;
+#endif /* XIPFS_PATH_SLOT_MAX > 0 */
 
     if (xipfs_file_filp_check(filp) < 0) {
         /* xipfs_errno was set */
         return -1;
     }
 
-    if (xipfs_file_path_check(to_path) < 0) {
+    if (xipfs_dirtab_check(to_path) < 0) {
         /* xipfs_errno was set */
         return -1;
     }
 
+    xipfs_index_remove(filp);
+#if XIPFS_PATH_SLOT_MAX > 0
+    if ((ret = xipfs_file_append_path(filp, to_path)) < 0) {
+        /* xipfs_errno was set */
+        xipfs_index_invalidate(filp);
+        return -1;
+    }
+    if (ret == 0 && xipfs_file_fold_path(filp, to_path) < 0) {
+        /* xipfs_errno was set */
+        xipfs_index_invalidate(filp);
+        return -1;
+    }
+#else
     len = strlen(to_path) + 1;
-
     if (xipfs_buffer_write(filp->path, to_path, len) < 0) {
         /* xipfs_errno was set */
+        xipfs_index_invalidate(filp);
         return -1;
     }
+#endif /* XIPFS_PATH_SLOT_MAX > 0 */
 
     if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        xipfs_index_invalidate(filp);
+        return -1;
+    }
+    xipfs_index_add(filp);
+
+    return 0;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure being installed
+ *
+ * @brief Prepares a file being installed to receive the bytes
+ * past its size again, after an installation was interrupted.
+ * The pages past the size are erased if they were programmed.
+ * The page holding the size is erased too and the size lowered
+ * to its start, unless it also holds the file structure, in
+ * which case its bytes past the size are rewritten erased
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param pos A pointer where to store the position from which
+ * the installation resumes
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+int
+xipfs_file_install_resume(xipfs_file_t *filp, xipfs_file_position_t *pos)
+{
+    char erased[32];
+    xipfs_file_position_t size;
+    char *ptr, *page, *end;
+    size_t i, n;
+
+    if (xipfs_file_filp_check(filp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if ((size = xipfs_file_get_size_(filp)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    /* the pages are erased behind the buffer */
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_buffer_invalidate();
+
+    ptr = (char *)&filp->buf[size];
+    end = (char *)filp + filp->reserved;
+    page = ptr - (uintptr_t)ptr % XIPFS_NVM_PAGE_SIZE;
+    if (page < ptr) {
+        for (i = 0; &ptr[i] < page + XIPFS_NVM_PAGE_SIZE; i++) {
+            if ((uint8_t)ptr[i] != XIPFS_NVM_ERASE_STATE) {
+                break;
+            }
+        }
+        if (&ptr[i] < page + XIPFS_NVM_PAGE_SIZE) {
+            if (page == (char *)filp) {
+                (void)memset(erased, XIPFS_NVM_ERASE_STATE,
+                    sizeof(erased));
+                for (i = 0; &ptr[i] < page + XIPFS_NVM_PAGE_SIZE; i += n) {
+                    n = (size_t)(page + XIPFS_NVM_PAGE_SIZE - &ptr[i]);
+                    if (n > sizeof(erased)) {
+                        n = sizeof(erased);
+                    }
+                    if (xipfs_buffer_write(&ptr[i], erased, n) < 0) {
+                        /* xipfs_errno was set */
+                        return -1;
+                    }
+                }
+                if (xipfs_buffer_flush() < 0) {
+                    /* xipfs_errno was set */
+                    return -1;
+                }
+                xipfs_buffer_invalidate();
+            } else {
+                /* the size is lowered before its page is erased */
+                size = (xipfs_file_position_t)(page - (char *)filp->buf);
+                if (xipfs_file_set_size(filp, size) < 0) {
+                    /* xipfs_errno was set */
+                    return -1;
+                }
+                xipfs_buffer_invalidate();
+                if (xipfs_flash_erase_page(xipfs_nvm_page(page)) < 0) {
+                    /* xipfs_errno was set */
+                    return -1;
+                }
+            }
+        }
+        page += XIPFS_NVM_PAGE_SIZE;
+    }
+    for (; page < end; page += XIPFS_NVM_PAGE_SIZE) {
+        /* a no-op unless the page was programmed */
+        if (xipfs_flash_erase_page(xipfs_nvm_page(page)) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    *pos = size;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Checks that the len bytes starting at position pos lie
+ * within the reserved space of a file
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param pos The position of the first byte of the span
+ *
+ * @param len The number of bytes of the span
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+static int
+xipfs_file_span_check(xipfs_file_t *filp, xipfs_file_position_t pos,
+                      size_t len)
+{
+    xipfs_file_position_t pos_max;
+
+    if (xipfs_file_filp_check(filp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    pos_max = filp->reserved - (xipfs_file_position_t)sizeof(*filp);
+    /* Since xipfs_file_position_t is defined as an int32_t, we must
+     * verify that the value is non-negative. */
+    if (pos < XIPFS_FILE_POSITION_MIN || pos > pos_max ||
+        len > (size_t)(pos_max - pos)) {
+        xipfs_errno = XIPFS_EMAXOFF;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre dest must be a pointer that references an accessible
+ * memory region of at least len bytes
+ *
+ * @brief Reads len bytes of a file starting at position pos
+ *
+ * The xipfs file structure is checked once for the whole
+ * request, then the bytes are copied page by page
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param pos The position of the first byte to read
+ *
+ * @param dest A pointer to a memory region where to store the
+ * read bytes
+ *
+ * @param len The number of bytes to read
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+int
+xipfs_file_read(xipfs_file_t *filp, xipfs_file_position_t pos,
+                void *dest, size_t len)
+{
+    if (xipfs_file_span_check(filp, pos, len) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_buffer_read(dest, &filp->buf[pos], len) < 0) {
         /* xipfs_errno was set */
         return -1;
     }
@@ -1149,6 +1606,58 @@ xipfs_file_read_8(xipfs_file_t *filp, xipfs_file_position_t pos, char *byte)
     return 0;
 }
 
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre iov must be a pointer to segments that reference
+ * accessible memory regions of at least len bytes in total
+ *
+ * @brief Reads len bytes of a file starting at position pos into
+ * consecutive segments
+ *
+ * The xipfs file structure is checked once for the whole
+ * request, then the bytes are copied segment by segment
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param pos The position of the first byte to read
+ *
+ * @param iov The segments where to store the read bytes
+ *
+ * @param len The number of bytes to read
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+int
+xipfs_file_readv(xipfs_file_t *filp, xipfs_file_position_t pos,
+                 const xipfs_iovec_t iov[], size_t len)
+{
+    size_t i, n;
+
+    if (xipfs_file_span_check(filp, pos, len) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    for (i = 0; len > 0; i++) {
+        if (iov[i].len == 0) {
+            /* an empty segment may have no base */
+            continue;
+        }
+        n = (iov[i].len < len) ? iov[i].len : len;
+        if (xipfs_buffer_read(iov[i].base, &filp->buf[pos], n) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        pos += (xipfs_file_position_t)n;
+        len -= n;
+    }
+
+    return 0;
+}
+
 /**
  * @pre vfs_filp must be a pointer to an accessible and valid VFS
  * file structure
@@ -1192,6 +1701,102 @@ xipfs_file_write_8(xipfs_file_t *filp, xipfs_file_position_t pos, char byte)
     return 0;
 }
 
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre src must be a pointer that references an accessible
+ * memory region of at least len bytes
+ *
+ * @brief Writes len bytes to a file starting at position pos
+ *
+ * The xipfs file structure is checked once for the whole
+ * request, then the bytes are copied into the I/O buffer page
+ * by page
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param pos The position of the first byte to write
+ *
+ * @param src A pointer to a memory region containing the bytes
+ * to write
+ *
+ * @param len The number of bytes to write
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+int
+xipfs_file_write(xipfs_file_t *filp, xipfs_file_position_t pos,
+                 const void *src, size_t len)
+{
+    if (xipfs_file_span_check(filp, pos, len) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_buffer_write(&filp->buf[pos], src, len) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre iov must be a pointer to segments that reference
+ * accessible memory regions of at least len bytes in total
+ *
+ * @brief Writes len bytes from consecutive segments to a file
+ * starting at position pos
+ *
+ * The xipfs file structure is checked once for the whole
+ * request, then the segments are copied into the I/O buffer one
+ * after the other, so that a flash page they share is loaded
+ * and flushed only once
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @param pos The position of the first byte to write
+ *
+ * @param iov The segments containing the bytes to write
+ *
+ * @param len The number of bytes to write
+ *
+ * @return Returns zero if the function succeed or a negative
+ * value otherwise
+ */
+int
+xipfs_file_writev(xipfs_file_t *filp, xipfs_file_position_t pos,
+                  const xipfs_iovec_t iov[], size_t len)
+{
+    size_t i, n;
+
+    if (xipfs_file_span_check(filp, pos, len) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    for (i = 0; len > 0; i++) {
+        if (iov[i].len == 0) {
+            /* an empty segment may have no base */
+            continue;
+        }
+        n = (iov[i].len < len) ? iov[i].len : len;
+        if (xipfs_buffer_write(&filp->buf[pos], iov[i].base, n) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        pos += (xipfs_file_position_t)n;
+        len -= n;
+    }
+
+    return 0;
+}
+
 /**
  * @pre filp must be a pointer to an accessible and valid xipfs
  * file structure
@@ -1579,7 +2184,7 @@ int xipfs_file_safe_exec(xipfs_file_t *filp, char *const argv[],
 #else /* XIPFS_ENABLE_SAFE_EXEC_SUPPORT */
     (void)filp;
     (void)argv;
-    (void)user_syscalls;
+    (void)syscalls;
     xipfs_errno = XIPFS_ENOSAFESUPPORT;
     return -1;
 #endif /* XIPFS_ENABLE_SAFE_EXEC_SUPPORT */
@@ -33,13 +33,26 @@
 /*******************************************************************************/
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 /*
  * xipfs include
  */
 #include "include/errno.h"
+#include "include/flash.h"
 #include "include/xipfs.h"
 
+/**
+ * @internal
+ *
+ * @def XIPFS_FLASH_BOUNCE_SIZE
+ *
+ * @brief The size of the stack buffer used to realign source
+ * bytes on the flash write block alignment before programming
+ */
+#define XIPFS_FLASH_BOUNCE_SIZE (16 * XIPFS_NVM_WRITE_BLOCK_SIZE)
+
 /**
  * @brief Returns the MCU flash memory base address
  *
@@ -142,6 +155,10 @@ xipfs_flash_page_overflow(const void *addr, size_t n)
  * @brief Copy n bytes from the unaligned memory area
  * src to the unaligned memory area dest
  *
+ * The partial head and tail write blocks are merged with the
+ * bytes already in flash, the aligned blocks in between are
+ * programmed in bursts and the copy is verified at once
+ *
  * @param dest The address where to copy n bytes from
  * src
  *
@@ -167,81 +184,206 @@ xipfs_flash_page_overflow(const void *addr, size_t n)
 int
 xipfs_flash_write_unaligned(void *dest, const void *src, size_t n)
 {
-    uint32_t mod, shift, addr, addr4, val4;
-    uint8_t byte;
-    size_t i;
+    uint8_t block[XIPFS_NVM_WRITE_BLOCK_SIZE]
+        __attribute__ ((aligned(XIPFS_NVM_WRITE_BLOCK_ALIGNMENT)));
+    uint8_t bounce[XIPFS_FLASH_BOUNCE_SIZE]
+        __attribute__ ((aligned(XIPFS_NVM_WRITE_BLOCK_ALIGNMENT)));
+    const uint8_t *in;
+    uint8_t *out;
+    size_t mod, len, chunk;
 
     assert(dest != src);
     assert(xipfs_flash_in(dest) == 1);
     assert(xipfs_flash_overflow(dest, n) == 0);
     assert(xipfs_flash_page_overflow(dest, n) == 0);
 
-    for (i = 0; i < n; i++) {
-        /* retrieve the current byte to write */
-        byte = ((uint8_t *)src)[i];
+    out = dest;
+    in = src;
+    len = n;
 
-        /* cast the address to a 4-bytes integer */
-        addr = (uint32_t)dest + i;
+    /* merge the partial head block with the bytes in flash */
+    mod = (uintptr_t)out % XIPFS_NVM_WRITE_BLOCK_SIZE;
+    if (mod != 0 && len > 0) {
+        chunk = XIPFS_NVM_WRITE_BLOCK_SIZE - mod;
+        if (chunk > len) {
+            chunk = len;
+        }
+        (void)memcpy(block, out - mod, XIPFS_NVM_WRITE_BLOCK_SIZE);
+        (void)memcpy(&block[mod], in, chunk);
+        xipfs_nvm_write(out - mod, block, XIPFS_NVM_WRITE_BLOCK_SIZE);
+        out += chunk;
+        in += chunk;
+        len -= chunk;
+    }
 
-        /* calculate the modulus from the address */
-        mod = addr & ((uint32_t)XIPFS_NVM_WRITE_BLOCK_ALIGNMENT-1);
+    /* program the aligned middle blocks in bursts */
+    chunk = len - len % XIPFS_NVM_WRITE_BLOCK_SIZE;
+    if (chunk > 0) {
+        if ((uintptr_t)in % XIPFS_NVM_WRITE_BLOCK_ALIGNMENT == 0) {
+            xipfs_nvm_write(out, in, chunk);
+            out += chunk;
+            in += chunk;
+            len -= chunk;
+        } else {
+            while (len >= XIPFS_NVM_WRITE_BLOCK_SIZE) {
+                chunk = len - len % XIPFS_NVM_WRITE_BLOCK_SIZE;
+                if (chunk > sizeof(bounce)) {
+                    chunk = sizeof(bounce);
+                }
+                (void)memcpy(bounce, in, chunk);
+                xipfs_nvm_write(out, bounce, chunk);
+                out += chunk;
+                in += chunk;
+                len -= chunk;
+            }
+        }
+    }
 
-        /* align the address to the previous multiple of 4 */
-        addr4 = addr & ~mod;
+    /* merge the partial tail block with the bytes in flash */
+    if (len > 0) {
+        (void)memcpy(block, out, XIPFS_NVM_WRITE_BLOCK_SIZE);
+        (void)memcpy(block, in, len);
+        xipfs_nvm_write(out, block, XIPFS_NVM_WRITE_BLOCK_SIZE);
+    }
 
-        /* read 4 bytes at the address aligned to a multiple of 4 */
-        val4 = *(uint32_t *)addr4;
+    if (n > 0) {
+        xipfs_flash_page_programmed(xipfs_nvm_page(dest));
+    }
+    if (memcmp(dest, src, n) != 0) {
+        xipfs_errno = XIPFS_ENVMC;
+        return -1;
+    }
 
-        /* calculate the byte shift value */
-        shift = mod << ((uint32_t)XIPFS_NVM_WRITE_BLOCK_SIZE-1);
+    return 0;
+}
 
-        /* clear the byte corresponding to the shift */
-        val4 &= ~((uint32_t)XIPFS_NVM_ERASE_STATE << shift);
+/**
+ * @internal
+ *
+ * @brief A bitmap of the flash pages known to be erased, one bit
+ * per page of the whole NVM so that it serves every mount point
+ */
+static uint8_t xipfs_flash_erased[(XIPFS_NVM_NUMOF + 7) / 8];
 
-        /* set the byte corresponding to the shift */
-        val4 |= (uint32_t)byte << shift;
+/**
+ * @internal
+ *
+ * @brief A bitmap of the flash pages known to be programmed, one
+ * bit per page of the whole NVM. A page with neither bit set has
+ * an unknown state and must be scanned
+ */
+static uint8_t xipfs_flash_programmed[(XIPFS_NVM_NUMOF + 7) / 8];
 
-        /* write bytes to flash memory */
-        xipfs_nvm_write((void *)addr4, &val4, XIPFS_NVM_WRITE_BLOCK_SIZE);
+/**
+ * @internal
+ *
+ * @brief Tests the bit of a flash page in a page bitmap
+ *
+ * @param bitmap The page bitmap to test
+ *
+ * @param page The flash page whose bit to test
+ *
+ * @return 1 if the bit is set, 0 otherwise
+ */
+static inline int
+xipfs_flash_bit_get(const uint8_t *bitmap, unsigned page)
+{
+    return (bitmap[page / 8] >> (page % 8)) & 1;
+}
 
-        /* checks the written byte against the expected byte */
-        if (*(uint8_t *)addr != byte) {
-            /* write failed */
-            return -1;
-        }
+/**
+ * @internal
+ *
+ * @brief Sets or clears the bit of a flash page in a page bitmap
+ *
+ * @param bitmap The page bitmap to update
+ *
+ * @param page The flash page whose bit to update
+ *
+ * @param val 1 to set the bit, 0 to clear it
+ */
+static inline void
+xipfs_flash_bit_set(uint8_t *bitmap, unsigned page, int val)
+{
+    if (val != 0) {
+        bitmap[page / 8] |= (uint8_t)(1 << (page % 8));
+    } else {
+        bitmap[page / 8] &= (uint8_t)~(1 << (page % 8));
     }
+}
 
-    /* write succeeded */
-    return 0;
+/**
+ * @brief Records that a flash page has been programmed, so that
+ * it is no longer assumed to be erased and that erasing it does
+ * not require a scan first
+ *
+ * @param page The flash page that has been programmed
+ */
+void
+xipfs_flash_page_programmed(unsigned page)
+{
+    assert(page < XIPFS_NVM_NUMOF);
+
+    xipfs_flash_bit_set(xipfs_flash_erased, page, 0);
+    xipfs_flash_bit_set(xipfs_flash_programmed, page, 1);
 }
 
 /**
- * @brief Checks whether a flash page needs to be erased
+ * @internal
+ *
+ * @brief Reads a flash page to check whether it is erased and
+ * records the result
  *
  * @param page The flash page to check
  *
- * @return 1 if the flash page needs to be erased, 0
- * otherwise
+ * @return 1 if the flash page is erased, 0 otherwise
  */
-int
-xipfs_flash_is_erased_page(unsigned page)
+static int
+xipfs_flash_scan_page(unsigned page)
 {
-    char *ptr;
+    const uint32_t *ptr;
     size_t i;
 
     ptr = xipfs_nvm_addr(page);
-    for (i = 0; i < XIPFS_NVM_PAGE_SIZE; i++) {
-        if (ptr[i] != XIPFS_NVM_ERASE_STATE) {
+    for (i = 0; i < XIPFS_NVM_PAGE_SIZE / sizeof(*ptr); i++) {
+        if (ptr[i] != (uint32_t)XIPFS_FLASH_ERASE_STATE) {
+            xipfs_flash_bit_set(xipfs_flash_erased, page, 0);
+            xipfs_flash_bit_set(xipfs_flash_programmed, page, 1);
             return 0;
         }
     }
+    xipfs_flash_bit_set(xipfs_flash_erased, page, 1);
+    xipfs_flash_bit_set(xipfs_flash_programmed, page, 0);
 
     return 1;
 }
 
+/**
+ * @brief Checks whether a flash page is erased. The page is
+ * read only if it is not already known to be erased
+ *
+ * @param page The flash page to check
+ *
+ * @return 1 if the flash page is erased, 0 otherwise
+ */
+int
+xipfs_flash_is_erased_page(unsigned page)
+{
+    assert(page < XIPFS_NVM_NUMOF);
+
+    if (xipfs_flash_bit_get(xipfs_flash_erased, page) == 1) {
+        return 1;
+    }
+
+    return xipfs_flash_scan_page(page);
+}
+
 /**
  * @brief Erases a flash page, if needed
  *
+ * A page known to be erased is skipped and a page known to be
+ * programmed is erased without being read first
+ *
  * @param page The flash page to erase
  *
  * @return 0 if the flash page was erased or if the
@@ -250,13 +392,16 @@ xipfs_flash_is_erased_page(unsigned page)
 int
 xipfs_flash_erase_page(unsigned page)
 {
-    if (xipfs_flash_is_erased_page(page)) {
+    assert(page < XIPFS_NVM_NUMOF);
+
+    if (xipfs_flash_bit_get(xipfs_flash_programmed, page) == 0 &&
+        xipfs_flash_is_erased_page(page)) {
         return 0;
     }
 
     xipfs_nvm_erase(page);
 
-    if (xipfs_flash_is_erased_page(page)) {
+    if (xipfs_flash_scan_page(page)) {
         return 0;
     }
 
@@ -52,10 +52,14 @@
  */
 #include "include/xipfs.h"
 #include "include/buffer.h"
+#include "include/desc.h"
+#include "include/dirtab.h"
+#include "include/emptydir.h"
 #include "include/errno.h"
 #include "include/file.h"
 #include "include/flash.h"
 #include "include/fs.h"
+#include "include/index.h"
 
 /*
  * Macro definition
@@ -75,16 +79,83 @@
 #define ROUND(x, y) (((x) + (y) - 1) & ~((y) - 1))
 
 /*
- * Extern functions
+ * Helper functions
+ */
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Checks whether a file was removed. A removed file has
+ * the first character of its path cleared, which only turns
+ * bits from one to zero and thus needs no erase, and stays in
+ * the linked list until the next garbage collection
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @return Returns one if the file was removed or zero otherwise
+ */
+static int
+xipfs_fs_removed(const xipfs_file_t *filp)
+{
+    return filp->path[0] == '\0';
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Checks whether a file holds a table of the file
+ * system, that is the directory table or the records of the
+ * empty directories
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @return Returns one if the file holds a table or zero
+ * otherwise
+ */
+static int
+xipfs_fs_table_file(const xipfs_file_t *filp)
+{
+    return xipfs_dirtab_table(filp) || xipfs_emptydir_log(filp);
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Checks whether a file is left out of the walks over
+ * the files, which is the case of the removed files and of the
+ * files holding a table
+ *
+ * @param filp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @return Returns one if the file is hidden or zero otherwise
  */
+static int
+xipfs_fs_hidden(const xipfs_file_t *filp)
+{
+    return xipfs_fs_removed(filp) || xipfs_fs_table_file(filp);
+}
 
 /**
+ * @internal
+ *
  * @pre xipfs_mp must be a pointer that references a memory
  * region containing an xipfs mount point structure which is
  * accessible and valid
  *
  * @brief Retrieves the first xipfs file in the mount point's
- * linked list passed as an argument
+ * linked list passed as an argument, removed or not
  *
  * @param xipfs_mp A pointer to a memory region containing an
  * xipfs mount point structure
@@ -92,8 +163,8 @@
  * @return Returns the address of the first xipfs file in the
  * mount point's linked list or NULL otherwise
  */
-xipfs_file_t *
-xipfs_fs_head(xipfs_mount_t *mp)
+static xipfs_file_t *
+xipfs_fs_head_(xipfs_mount_t *mp)
 {
     xipfs_file_t *headp;
 
@@ -113,11 +184,14 @@ xipfs_fs_head(xipfs_mount_t *mp)
 }
 
 /**
+ * @internal
+ *
  * @pre filp must be a pointer that references an accessible
  * memory region
  *
  * @brief Retrieves the next xipfs file of the linked list from
- * the xipfs file structure passed as an argument
+ * the xipfs file structure passed as an argument, removed or
+ * not
  *
  * @param xipfs_mp A pointer to a memory region containing an
  * accessible xipfs file structure
@@ -126,8 +200,8 @@ xipfs_fs_head(xipfs_mount_t *mp)
  * linked list from the xipfs file structure passed as an
  * argument or NULL otherwise
  */
-xipfs_file_t *
-xipfs_fs_next(xipfs_file_t *filp)
+static xipfs_file_t *
+xipfs_fs_next_(xipfs_file_t *filp)
 {
     xipfs_file_t *nextp;
 
@@ -156,6 +230,147 @@ xipfs_fs_next(xipfs_file_t *filp)
     return nextp;
 }
 
+/**
+ * @internal
+ *
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Walks the linked list of files of the mount point
+ * passed as an argument to compute its cached tail, file count,
+ * used page count and removed page count, unless they are
+ * already known
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_load(xipfs_mount_t *mp)
+{
+    xipfs_file_t *filp, *tailp;
+    size_t count, dead;
+
+    assert(mp != NULL);
+
+    if (mp->cached != 0) {
+        return 0;
+    }
+
+    tailp = NULL;
+    count = 0;
+    dead = 0;
+    xipfs_errno = XIPFS_OK;
+    if ((filp = xipfs_fs_head_(mp)) != NULL) {
+        do {
+            tailp = filp;
+            if (xipfs_fs_removed(filp)) {
+                dead += (size_t)filp->reserved / XIPFS_NVM_PAGE_SIZE;
+            } else if (!xipfs_fs_table_file(filp)) {
+                count++;
+            }
+        } while ((filp = xipfs_fs_next_(filp)) != NULL);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    mp->tail = tailp;
+    mp->file_count = count;
+    mp->dead_pages = dead;
+    mp->used_pages = 0;
+    if (tailp != NULL) {
+        assert(tailp->reserved > 0);
+        assert((uintptr_t)tailp >= (uintptr_t)mp->page_addr);
+        mp->used_pages = ((uintptr_t)tailp + (size_t)tailp->reserved -
+            (uintptr_t)mp->page_addr) / XIPFS_NVM_PAGE_SIZE;
+    }
+    assert(mp->used_pages <= mp->page_num);
+    mp->cached = 1;
+
+    return 0;
+}
+
+/*
+ * Extern functions
+ */
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure
+ *
+ * @brief Forgets the cached tail, file count and used page
+ * count of the mount point passed as an argument, so that they
+ * are computed again by walking the files on next use
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ */
+void
+xipfs_fs_invalidate(xipfs_mount_t *mp)
+{
+    assert(mp != NULL);
+
+    mp->cached = 0;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Retrieves the first xipfs file in the mount point's
+ * linked list passed as an argument, skipping removed files and
+ * the file holding the directory table
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns the address of the first xipfs file in the
+ * mount point's linked list or NULL otherwise
+ */
+xipfs_file_t *
+xipfs_fs_head(xipfs_mount_t *mp)
+{
+    xipfs_file_t *filp;
+
+    filp = xipfs_fs_head_(mp);
+    while (filp != NULL && xipfs_fs_hidden(filp)) {
+        filp = xipfs_fs_next_(filp);
+    }
+
+    return filp;
+}
+
+/**
+ * @pre filp must be a pointer that references an accessible
+ * memory region
+ *
+ * @brief Retrieves the next xipfs file of the linked list from
+ * the xipfs file structure passed as an argument, skipping
+ * removed files and the files holding a table
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * accessible xipfs file structure
+ *
+ * @return Returns the address of the next xipfs file of the
+ * linked list from the xipfs file structure passed as an
+ * argument or NULL otherwise
+ */
+xipfs_file_t *
+xipfs_fs_next(xipfs_file_t *filp)
+{
+    do {
+        filp = xipfs_fs_next_(filp);
+    } while (filp != NULL && xipfs_fs_hidden(filp));
+
+    return filp;
+}
+
 /**
  * @pre xipfs_mp must be a pointer that references a memory
  * region containing an xipfs mount point structure which is
@@ -173,26 +388,14 @@ xipfs_fs_next(xipfs_file_t *filp)
 xipfs_file_t *
 xipfs_fs_tail(xipfs_mount_t *mp)
 {
-    xipfs_file_t *filp, *tailp;
-
     assert(mp != NULL);
 
-    if ((filp = xipfs_fs_head(mp)) == NULL) {
-        /* no file in the file system or error */
-        return NULL;
-    }
-    do {
-        tailp = filp;
-        xipfs_errno = XIPFS_OK;
-        filp = xipfs_fs_next(filp);
-    } while (filp != NULL);
-
-    if (xipfs_errno != XIPFS_OK) {
+    if (xipfs_fs_load(mp) < 0) {
         /* xipfs_errno was set */
         return NULL;
     }
 
-    return tailp;
+    return mp->tail;
 }
 
 /**
@@ -262,7 +465,8 @@ xipfs_fs_get_page_number(const xipfs_mount_t *mp)
  * accessible and valid
  *
  * @brief Retrieves the number of NVM free page in the mount
- * point passed as an argument
+ * point passed as an argument, including the pages of removed
+ * files that the garbage collection can reclaim
  *
  * @param xipfs_mp A pointer to a memory region containing an
  * xipfs mount point structure
@@ -273,52 +477,49 @@ xipfs_fs_get_page_number(const xipfs_mount_t *mp)
 int
 xipfs_fs_free_pages(xipfs_mount_t *mp)
 {
-    xipfs_file_t *headp, *tailp;
-    int used, free;
-
     assert(mp != NULL);
 
-    xipfs_errno = XIPFS_OK;
-    if ((headp = xipfs_fs_head(mp)) == NULL) {
-        if (xipfs_errno != XIPFS_OK) {
-            /* xipfs_errno was set */
-            return -1;
-        }
-        /* all pages are free */
-        assert(mp->page_num <= XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
-        assert(mp->page_num <= (size_t)INT_MAX);
-        assert(mp->page_num <= (size_t)XIPFS_NVM_NUMOF);
-        return mp->page_num;
-    }
-    if ((tailp = xipfs_fs_tail(mp)) == NULL) {
+    if (xipfs_fs_load(mp) < 0) {
         /* xipfs_errno was set */
         return -1;
     }
 
-    assert(tailp >= headp);
-
-    assert((void *)tailp <= (void *)INT_MAX);
-    assert((INT_MAX - (int)tailp) > 0);
-    used  = (int)tailp;
+    assert(mp->page_num <= XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
+    assert(mp->page_num <= (size_t)INT_MAX);
+    assert(mp->used_pages <= mp->page_num);
+    assert(mp->dead_pages <= mp->used_pages);
 
-    assert(tailp->reserved > (int)0);
-    assert(tailp->reserved <= INT_MAX);
-    assert((INT_MAX - (int)used) >= tailp->reserved);
-    used += (int)tailp->reserved;
+    /* the pages of removed files are reclaimed on demand */
+    return (int)(mp->page_num - mp->used_pages + mp->dead_pages);
+}
 
-    assert((void *)headp <= (void *)INT_MAX);
-    assert((int)headp <= used);
-    used -= (int)headp;
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Retrieves the number of files in the mount point
+ * passed as an argument
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns the number of files in the mount point or a
+ * negative value otherwise
+ */
+int
+xipfs_fs_file_count(xipfs_mount_t *mp)
+{
+    assert(mp != NULL);
 
-    used /= XIPFS_NVM_PAGE_SIZE;
-    assert((size_t)used <= (size_t)XIPFS_NVM_NUMOF);
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
 
-    assert(mp->page_num <= XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
-    assert(mp->page_num <= (size_t)INT_MAX);
-    assert(used <= (int)mp->page_num);
-    free = mp->page_num - used;
+    assert(mp->file_count <= (size_t)INT_MAX);
 
-    return free;
+    return (int)mp->file_count;
 }
 
 /**
@@ -349,6 +550,7 @@ xipfs_fs_new_file(xipfs_mount_t *mp, const char *path, xipfs_file_position_t siz
                   int exec)
 {
     int free_pages, reserved_pages;
+    char raw[XIPFS_PATH_MAX];
     xipfs_file_t file, *filp;
     size_t reserved;
     void *next;
@@ -357,21 +559,19 @@ xipfs_fs_new_file(xipfs_mount_t *mp, const char *path, xipfs_file_position_t siz
         /* xipfs_errno was set */
         return NULL;
     }
-    if (exec != 0 && exec != 1) {
+    if (exec != 0 && exec != 1 && exec != XIPFS_FILE_EXEC_INSTALL) {
         xipfs_errno = XIPFS_EPERM;
         return NULL;
     }
-    if ((filp = xipfs_fs_tail_next(mp)) == NULL) {
-        /* xipfs_errno was set */
-        return NULL;
-    }
-    if ((free_pages = xipfs_fs_free_pages(mp)) < 0) {
-        /* xipfs_errno was set */
+    if (size < 0) {
+        xipfs_errno = XIPFS_EINVALIDSIZE;
         return NULL;
     }
 
-    if (size < 0) {
-        xipfs_errno = XIPFS_EINVALIDSIZE;
+    /* the directory table may take a page, before the tail is
+     * known */
+    if (xipfs_dirtab_encode(mp, path, raw) < 0) {
+        /* xipfs_errno was set */
         return NULL;
     }
 
@@ -384,6 +584,25 @@ xipfs_fs_new_file(xipfs_mount_t *mp, const char *path, xipfs_file_position_t siz
     assert(reserved <= (size_t)INT_MAX);
     reserved_pages = (int)reserved / XIPFS_NVM_PAGE_SIZE;
 
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    /* reclaim the pages of removed files once the free pages
+     * fall below the watermark */
+    if (mp->dead_pages > 0 && mp->page_num - mp->used_pages <
+            (size_t)reserved_pages + XIPFS_GC_WATERMARK) {
+        if (xipfs_fs_gc(mp) < 0) {
+            /* xipfs_errno was set */
+            return NULL;
+        }
+    }
+    if ((filp = xipfs_fs_tail_next(mp)) == NULL) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    free_pages = (int)(mp->page_num - mp->used_pages);
+
     if (reserved_pages < free_pages) {
         next = (char *)filp + reserved;
     } else if (reserved_pages == free_pages) {
@@ -394,7 +613,7 @@ xipfs_fs_new_file(xipfs_mount_t *mp, const char *path, xipfs_file_position_t siz
     }
 
     (void)memset(&file, XIPFS_NVM_ERASE_STATE, sizeof(file));
-    (void)strncpy(file.path, path, XIPFS_PATH_MAX - 1);
+    (void)strncpy(file.path, raw, XIPFS_PATH_MAX - 1);
     /* Should be already covered up above, but let's keep it for safety */
     assert(reserved < XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
     file.reserved = reserved;
@@ -403,112 +622,63 @@ xipfs_fs_new_file(xipfs_mount_t *mp, const char *path, xipfs_file_position_t siz
 
     if (xipfs_buffer_write(filp, &file, sizeof(*filp)) < 0) {
         /* xipfs_errno was set */
+        xipfs_fs_invalidate(mp);
         return NULL;
     }
     if (xipfs_buffer_flush() < 0) {
         /* xipfs_errno was set */
+        xipfs_fs_invalidate(mp);
         return NULL;
     }
+    mp->tail = filp;
+    mp->file_count++;
+    mp->used_pages += (size_t)reserved_pages;
+    xipfs_index_add(filp);
 
     return filp;
 }
 
 /**
- * @pre dst must be a pointer that references an accessible
- * memory region
+ * @internal
  *
- * @brief Removes a file from the file system and consolidates
- * it
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
  *
- * @param dst The address of the xipfs file to remove
+ * @brief Removes the files xipfs_fs_new_files programmed before
+ * it failed, keeping the error that made it fail. A file the NVM
+ * also fails to remove is kept
  *
- * @return Returns zero if the function succeeds or a negative
- * value otherwise
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The first file programmed
+ *
+ * @param count The number of files programmed
  */
-int
-xipfs_fs_remove(xipfs_file_t *destination)
+static void
+xipfs_fs_new_files_undo(xipfs_mount_t *mp, xipfs_file_t *filp,
+                        size_t count)
 {
-    xipfs_file_t file;
-    size_t pagenum, i;
-    void *src, *next, *dst;
-    unsigned int num;
-    size_t size;
-
-    assert(destination != NULL);
+    const char removed = '\0';
+    const uint32_t exec = 0;
+    int errnum;
 
-    dst = destination;
-    xipfs_errno = XIPFS_OK;
-    /* get the next file if any */
-    if ((next = xipfs_fs_next(dst)) == NULL) {
-        if (xipfs_errno != XIPFS_OK) {
-            /* xipfs_errno was set */
-            return -1;
-        }
-    }
-    /* erase the file's pages */
-    if (xipfs_file_erase(dst) < 0) {
-        /* xipfs_errno was set */
-        return -1;
-    }
-    /*
-     * Consolidate the file system by moving files
-     * after the deleted one.
-     */
-    while (next != NULL) {
-        src = next;
-        if ((next = xipfs_fs_next(src)) == NULL) {
-            if (xipfs_errno != XIPFS_OK) {
-                /* xipfs_errno was set */
-                return -1;
-            }
-        }
-        /* copy and fix up the file structure */
-        (void)memcpy(&file, src, sizeof(file));
-        assert((uintptr_t)src <= (uintptr_t)((xipfs_file_t *)src)->next);
-        size = (uintptr_t)((xipfs_file_t *)src)->next - (uintptr_t)src;
-        assert(size <= XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
-        file.next = (xipfs_file_t *)((uintptr_t)dst + size);
-        // This assert is aimed at detecting when (dst + size) overflows uintptr_t capacity.
-        assert((uintptr_t)file.next >= (uintptr_t)dst);
-        if (xipfs_flash_write_unaligned(dst, &file, sizeof(file)) < 0) {
-            /* xipfs_errno was set */
-            return -1;
-        }
-        /* copy the rest of the file's first page */
-        if (xipfs_flash_write_unaligned(
-            (char *)dst + sizeof(file),
-            (char *)src + sizeof(file),
-            XIPFS_NVM_PAGE_SIZE - sizeof(file)) < 0) {
-            /* xipfs_errno was set */
-            return -1;
-        }
-        if (xipfs_flash_erase_page(xipfs_nvm_page(src)) < 0) {
-            /* xipfs_errno was set */
-            return -1;
-        }
-        dst = (char *)dst + XIPFS_NVM_PAGE_SIZE;
-        src = (char *)src + XIPFS_NVM_PAGE_SIZE;
-        /* first page of the file already copied */
-        pagenum = size / XIPFS_NVM_PAGE_SIZE;
-        for (i = 1; i < pagenum; i++) {
-            num = xipfs_nvm_page(src);
-            if (xipfs_flash_is_erased_page(num) == 0) {
-                if (xipfs_flash_write_unaligned(dst, src,
-                        XIPFS_NVM_PAGE_SIZE) < 0) {
-                    /* xipfs_errno was set */
-                    return -1;
-                }
-                if (xipfs_flash_erase_page(num) < 0) {
-                    /* xipfs_errno was set */
-                    return -1;
-                }
-            }
-            dst = (char *)dst + XIPFS_NVM_PAGE_SIZE;
-            src = (char *)src + XIPFS_NVM_PAGE_SIZE;
+    errnum = xipfs_errno;
+    while (count-- > 0) {
+        xipfs_index_remove(filp);
+        (void)xipfs_flash_write_unaligned(filp->path, &removed,
+            sizeof(removed));
+        if (filp->exec == (uint32_t)XIPFS_FLASH_ERASE_STATE) {
+            /* the execution right of the file that failed */
+            (void)xipfs_flash_write_unaligned(&filp->exec, &exec,
+                sizeof(exec));
         }
+        filp = filp->next;
     }
-
-    return 0;
+    /* the counts are computed again from the files in flash */
+    xipfs_fs_invalidate(mp);
+    xipfs_errno = errnum;
 }
 
 /**
@@ -516,21 +686,1774 @@ xipfs_fs_remove(xipfs_file_t *destination)
  * region containing an xipfs mount point structure which is
  * accessible and valid
  *
- * @brief Format the file system specified by the mount point
- * structure passed as an argument
+ * @pre The paths of the specifications must be creatable,
+ * distinct, null-terminated, start with a slash, normalized, and
+ * be shorter than XIPFS_PATH_MAX
+ *
+ * @brief Creates new files in the file system specified by the
+ * mount point structure passed as an argument. Either all the
+ * files are created, or none is kept: when the NVM fails partway,
+ * the files already programmed are removed again. The files are
+ * placed one after the other past the last file, and their file
+ * structures are programmed directly into the erased NVM pages
  *
  * @param xipfs_mp A pointer to a memory region containing an
  * xipfs mount point structure
  *
+ * @param specs The specifications of the files to create
+ *
+ * @param n The number of specifications
+ *
  * @return Returns zero if the function succeeds or a negative
  * value otherwise
  */
 int
-xipfs_fs_format(xipfs_mount_t *mp)
+xipfs_fs_new_files(xipfs_mount_t *mp, const xipfs_file_spec_t specs[],
+                   size_t n)
 {
-    unsigned start_page, end_page;
-    void *start_addr, *end_addr;
-    size_t i;
+    size_t reserved, pages, free_pages, i;
+    char raw[XIPFS_PATH_MAX];
+    xipfs_file_t file, *filp, *first;
+    void *next;
+
+    assert(mp != NULL);
+    assert(specs != NULL || n == 0);
+
+    pages = 0;
+    for (i = 0; i < n; i++) {
+        if (xipfs_file_path_check(specs[i].path) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (specs[i].exec != 0 && specs[i].exec != 1) {
+            xipfs_errno = XIPFS_EPERM;
+            return -1;
+        }
+        if (specs[i].size < 0 || (size_t)specs[i].size >
+                XIPFS_FILE_POSITION_MAX_AS_SIZE_T - sizeof(xipfs_file_t)) {
+            xipfs_errno = XIPFS_EINVALIDSIZE;
+            return -1;
+        }
+        reserved = ROUND((size_t)specs[i].size + sizeof(xipfs_file_t),
+            XIPFS_NVM_PAGE_SIZE);
+        pages += reserved / XIPFS_NVM_PAGE_SIZE;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    /* the directories get their identifiers before the tail is
+     * known, the directory table is not rewritten afterwards */
+    if (xipfs_dirtab_prepare(mp, specs, n) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        if (xipfs_dirtab_encode(mp, specs[i].path, raw) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (pages > mp->page_num - mp->used_pages + mp->dead_pages) {
+        xipfs_errno = XIPFS_ENOSPACE;
+        return -1;
+    }
+    /* reclaim the pages of removed files once the free pages
+     * fall below the watermark */
+    if (mp->dead_pages > 0 && mp->page_num - mp->used_pages <
+            pages + XIPFS_GC_WATERMARK) {
+        if (xipfs_fs_gc(mp) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    if ((filp = xipfs_fs_tail_next(mp)) == NULL) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    free_pages = mp->page_num - mp->used_pages;
+    assert(pages <= free_pages);
+
+    /* the file structures are written behind the buffer */
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_buffer_invalidate();
+
+    first = filp;
+    for (i = 0; i < n; i++) {
+        reserved = ROUND((size_t)specs[i].size + sizeof(xipfs_file_t),
+            XIPFS_NVM_PAGE_SIZE);
+        free_pages -= reserved / XIPFS_NVM_PAGE_SIZE;
+        /* the last file of a full file system points to itself */
+        next = (free_pages > 0) ? (char *)filp + reserved : (void *)filp;
+
+        if (xipfs_dirtab_encode(mp, specs[i].path, raw) < 0) {
+            /* xipfs_errno was set */
+            xipfs_fs_new_files_undo(mp, first, i);
+            return -1;
+        }
+        (void)memset(&file, XIPFS_NVM_ERASE_STATE, sizeof(file));
+        (void)strncpy(file.path, raw, XIPFS_PATH_MAX - 1);
+        file.reserved = (xipfs_file_position_t)reserved;
+        file.next = next;
+        file.exec = specs[i].exec;
+
+        /* a no-op unless the page is not known to be erased */
+        if (xipfs_flash_erase_page(xipfs_nvm_page(filp)) < 0) {
+            /* xipfs_errno was set */
+            xipfs_fs_new_files_undo(mp, first, i);
+            return -1;
+        }
+        /* the size table stays in the erased state */
+        if (xipfs_flash_write_unaligned(filp, &file,
+                offsetof(xipfs_file_t, size)) < 0) {
+            /* xipfs_errno was set */
+            xipfs_fs_new_files_undo(mp, first, i);
+            return -1;
+        }
+        if (xipfs_flash_write_unaligned(&filp->exec, &file.exec,
+                sizeof(file.exec)) < 0) {
+            /* xipfs_errno was set */
+            xipfs_fs_new_files_undo(mp, first, i + 1);
+            return -1;
+        }
+        mp->tail = filp;
+        mp->file_count++;
+        mp->used_pages += reserved / XIPFS_NVM_PAGE_SIZE;
+        xipfs_index_add(filp);
+        filp = next;
+    }
+
+    return 0;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Creates a one page file past the last file to hold a
+ * new table. The file is neither counted nor indexed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param kind The path of the file, XIPFS_DIRTAB_TABLE or
+ * XIPFS_EMPTYDIR_LOG
+ *
+ * @param reclaim Non-zero if the pages of removed files may be
+ * reclaimed when no page is free, which moves files
+ *
+ * @return Returns a pointer to the newly created xipfs file
+ * structure or NULL otherwise
+ */
+xipfs_file_t *
+xipfs_fs_new_table(xipfs_mount_t *mp, char kind, int reclaim)
+{
+    xipfs_file_t file, *filp;
+    void *next;
+
+    assert(mp != NULL);
+
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (mp->used_pages == mp->page_num) {
+        if (reclaim == 0 || mp->dead_pages == 0) {
+            xipfs_errno = XIPFS_ENOSPACE;
+            return NULL;
+        }
+        if (xipfs_fs_gc(mp) < 0) {
+            /* xipfs_errno was set */
+            return NULL;
+        }
+    }
+    if ((filp = xipfs_fs_tail_next(mp)) == NULL) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (mp->page_num - mp->used_pages > 1) {
+        next = (char *)filp + XIPFS_NVM_PAGE_SIZE;
+    } else {
+        next = filp;
+    }
+
+    (void)memset(&file, XIPFS_NVM_ERASE_STATE, sizeof(file));
+    file.path[0] = kind;
+    file.path[1] = '\0';
+    file.reserved = XIPFS_NVM_PAGE_SIZE;
+    file.next = next;
+    file.exec = 0;
+
+    if (xipfs_buffer_write(filp, &file, sizeof(*filp)) < 0) {
+        /* xipfs_errno was set */
+        xipfs_fs_invalidate(mp);
+        return NULL;
+    }
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        xipfs_fs_invalidate(mp);
+        return NULL;
+    }
+    mp->tail = filp;
+    mp->used_pages++;
+
+    return filp;
+}
+
+/**
+ * @internal
+ *
+ * @pre src must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre The NVM pages from dst up to the last page of src that
+ * are not part of src must be erased
+ *
+ * @brief Moves a file down to a lower address, erasing its
+ * former pages along the way
+ *
+ * @param src A pointer to the xipfs file structure to move
+ *
+ * @param dst The address where to move the file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_move(xipfs_file_t *src, void *dst)
+{
+    xipfs_file_t file;
+    size_t pagenum, size, i;
+    unsigned int num;
+
+    assert(src != NULL);
+    assert(dst != NULL);
+    assert((uintptr_t)dst < (uintptr_t)src);
+
+    /* copy and fix up the file structure */
+    (void)memcpy(&file, src, sizeof(file));
+    /* the next field of the last file of a full file system
+     * points to itself, so the reserved size is used */
+    assert(file.reserved > 0);
+    size = (size_t)file.reserved;
+    assert(size <= XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
+    file.next = (xipfs_file_t *)((uintptr_t)dst + size);
+    // This assert is aimed at detecting when (dst + size) overflows uintptr_t capacity.
+    assert((uintptr_t)file.next >= (uintptr_t)dst);
+    if (xipfs_flash_write_unaligned(dst, &file, sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    /* copy the rest of the file's first page */
+    if (xipfs_flash_write_unaligned(
+        (char *)dst + sizeof(file),
+        (char *)src + sizeof(file),
+        XIPFS_NVM_PAGE_SIZE - sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_flash_erase_page(xipfs_nvm_page(src)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    dst = (char *)dst + XIPFS_NVM_PAGE_SIZE;
+    src = (xipfs_file_t *)((char *)src + XIPFS_NVM_PAGE_SIZE);
+    /* first page of the file already copied */
+    pagenum = size / XIPFS_NVM_PAGE_SIZE;
+    for (i = 1; i < pagenum; i++) {
+        num = xipfs_nvm_page(src);
+        if (xipfs_flash_is_erased_page(num) == 0) {
+            if (xipfs_flash_write_unaligned(dst, src,
+                    XIPFS_NVM_PAGE_SIZE) < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+            if (xipfs_flash_erase_page(num) < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+        }
+        dst = (char *)dst + XIPFS_NVM_PAGE_SIZE;
+        src = (xipfs_file_t *)((char *)src + XIPFS_NVM_PAGE_SIZE);
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Computes the address of a file once the removed files
+ * of its mount point are reclaimed in a single pass, that is
+ * its address lowered by the reserved sizes of the removed
+ * files before it
+ *
+ * @param filp The address of an xipfs file of the mount point
+ *
+ * @param arg A pointer to a memory region containing an xipfs
+ * mount point structure
+ *
+ * @return Returns the address of the file after the garbage
+ * collection or NULL if the file is a removed one
+ */
+static xipfs_file_t *
+xipfs_fs_gc_target(xipfs_file_t *filp, void *arg)
+{
+    xipfs_file_t *curp;
+    size_t shift;
+
+    shift = 0;
+    curp = xipfs_fs_head_(arg);
+    while (curp != NULL && (uintptr_t)curp < (uintptr_t)filp) {
+        if (xipfs_fs_removed(curp)) {
+            shift += (size_t)curp->reserved;
+        }
+        curp = xipfs_fs_next_(curp);
+    }
+    if (curp == filp && xipfs_fs_removed(curp)) {
+        return NULL;
+    }
+
+    return (xipfs_file_t *)((uintptr_t)filp - shift);
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Reclaims the pages of the removed files of the mount
+ * point passed as an argument, by erasing them and moving the
+ * files that follow them down in a single pass, where each page
+ * of the remaining files is copied once to its final place
+ *
+ * The open descriptors are updated once, before the files move,
+ * and the path index as if each removed file was consolidated
+ * on its own
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_fs_gc(xipfs_mount_t *mp)
+{
+    xipfs_file_t *filp, *next, *tailp, *removed;
+    xipfs_file_position_t reserved;
+    size_t shift;
+
+    assert(mp != NULL);
+
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (mp->dead_pages == 0) {
+        return 0;
+    }
+
+    /* the consolidation rewrites pages behind the buffer */
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_buffer_invalidate();
+
+    (void)xipfs_desc_update(mp, xipfs_fs_gc_target, mp);
+
+    tailp = NULL;
+    shift = 0;
+    xipfs_errno = XIPFS_OK;
+    filp = xipfs_fs_head_(mp);
+    while (filp != NULL) {
+        /* get the next file before moving or erasing this one */
+        if ((next = xipfs_fs_next_(filp)) == NULL) {
+            if (xipfs_errno != XIPFS_OK) {
+                /* xipfs_errno was set */
+                goto fail;
+            }
+        }
+        reserved = filp->reserved;
+        if (xipfs_fs_removed(filp)) {
+            if (xipfs_file_erase(filp) < 0) {
+                /* xipfs_errno was set */
+                goto fail;
+            }
+            /* the address the removed file would have after the
+             * consolidation of the removed files before it */
+            removed = (xipfs_file_t *)((uintptr_t)filp - shift);
+            xipfs_index_shift(removed, reserved);
+            shift += (size_t)reserved;
+        } else {
+            if (shift > 0) {
+                if (xipfs_fs_move(filp, (char *)filp - shift) < 0) {
+                    /* xipfs_errno was set */
+                    goto fail;
+                }
+                xipfs_dirtab_move(filp, (xipfs_file_t *)
+                    ((uintptr_t)filp - shift));
+                xipfs_emptydir_move(filp, (xipfs_file_t *)
+                    ((uintptr_t)filp - shift));
+            }
+            tailp = (xipfs_file_t *)((uintptr_t)filp - shift);
+        }
+        filp = next;
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        goto fail;
+    }
+
+    assert(mp->used_pages >= mp->dead_pages);
+    mp->used_pages -= mp->dead_pages;
+    mp->dead_pages = 0;
+    mp->tail = tailp;
+    mp->gc_hole = NULL;
+
+    return 0;
+
+fail:
+    /* the caches may no longer match the files in flash */
+    xipfs_index_invalidate(mp->page_addr);
+    xipfs_dirtab_invalidate(mp->page_addr);
+    xipfs_fs_invalidate(mp);
+    return -1;
+}
+
+/**
+ * @internal
+ *
+ * @brief Writes the file structure of a removed file, which
+ * stands for a run of pages to reclaim, erasing its first page
+ * beforehand if needed
+ *
+ * @param addr The address of the removed file
+ *
+ * @param reserved The number of bytes to reclaim
+ *
+ * @param next The address of the next file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_hole_new(void *addr, size_t reserved, void *next)
+{
+    xipfs_file_t file;
+
+    assert(addr != NULL);
+    assert(reserved <= XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
+
+    if (xipfs_flash_erase_page(xipfs_nvm_page(addr)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    (void)memset(&file, XIPFS_NVM_ERASE_STATE, sizeof(file));
+    file.next = next;
+    file.path[0] = '\0';
+    file.reserved = (xipfs_file_position_t)reserved;
+    file.exec = 0;
+
+    return xipfs_flash_write_unaligned(addr, &file, sizeof(file));
+}
+
+/**
+ * @internal
+ *
+ * @brief Erases the pages of the last file of the mount point
+ * passed as an argument, a removed one, from its last page to
+ * its first one so that it stays a valid file until the end
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param prev The file before the removed file or NULL
+ *
+ * @param hole The removed file
+ *
+ * @param max_pages The maximum number of pages to erase
+ *
+ * @return Returns the number of erased pages or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_gc_trim(xipfs_mount_t *mp, xipfs_file_t *prev,
+                 xipfs_file_t *hole, size_t max_pages)
+{
+    size_t pagenum, done, i;
+    unsigned int start;
+
+    pagenum = (size_t)hole->reserved / XIPFS_NVM_PAGE_SIZE;
+    start = xipfs_nvm_page(hole);
+    done = 0;
+    for (i = pagenum - 1; i > 0; i--) {
+        if (xipfs_flash_is_erased_page(start + i) == 1) {
+            continue;
+        }
+        if (done == max_pages) {
+            return (int)done;
+        }
+        if (xipfs_flash_erase_page(start + i) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        done++;
+    }
+    if (done == max_pages) {
+        return (int)done;
+    }
+
+    /* the file before becomes the last one */
+    (void)xipfs_desc_move(mp, hole, NULL);
+    if (xipfs_flash_erase_page(start) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    done++;
+
+    assert(mp->dead_pages >= pagenum);
+    mp->used_pages -= pagenum;
+    mp->dead_pages -= pagenum;
+    mp->tail = prev;
+    mp->gc_hole = NULL;
+
+    return (int)done;
+}
+
+/**
+ * @internal
+ *
+ * @brief Merges a removed file into the removed file right
+ * before it
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param hole The removed file
+ *
+ * @param filp The removed file that follows it
+ *
+ * @return Returns the number of erased pages or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_gc_merge(xipfs_mount_t *mp, xipfs_file_t *hole,
+                  xipfs_file_t *filp)
+{
+    xipfs_file_t *next;
+    size_t reserved;
+
+    reserved = (size_t)hole->reserved + (size_t)filp->reserved;
+    /* the last file of a full file system points to itself */
+    next = (filp->next == filp) ? hole : filp->next;
+    (void)xipfs_desc_move(mp, filp, NULL);
+    if (xipfs_fs_hole_new(hole, reserved, next) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (mp->tail == filp) {
+        mp->tail = hole;
+    }
+    mp->gc_pages = 0;
+
+    return 1;
+}
+
+/**
+ * @internal
+ *
+ * @brief Moves a file over the removed file right before it,
+ * then puts a removed file standing for the pages left behind
+ * after it
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param hole The removed file
+ *
+ * @param filp The file that follows it, moved to its address
+ *
+ * @param newhole The address of the removed file to put after
+ * the moved file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_gc_link(xipfs_mount_t *mp, xipfs_file_t *hole,
+                 xipfs_file_t *filp, xipfs_file_t *newhole)
+{
+    xipfs_index_move(filp, hole);
+    xipfs_dirtab_move(filp, hole);
+    xipfs_emptydir_move(filp, hole);
+    (void)xipfs_desc_move(mp, filp, hole);
+    if (mp->tail == filp) {
+        mp->tail = newhole;
+    }
+    mp->gc_hole = newhole;
+    mp->gc_pages = 0;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Moves a file over the removed file right before it,
+ * when the file is not larger than the removed file. The pages
+ * of the file but the first one are copied at most max_pages at
+ * a time while the file stays in place, then the first page is
+ * copied, which links the file at its new address
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param hole The removed file
+ *
+ * @param filp The file that follows it
+ *
+ * @param max_pages The maximum number of pages to copy
+ *
+ * @return Returns the number of copied pages or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_gc_slide(xipfs_mount_t *mp, xipfs_file_t *hole,
+                  xipfs_file_t *filp, size_t max_pages)
+{
+    xipfs_file_t file, *newhole;
+    size_t pagenum, done, i;
+    char *dst, *src;
+    const char removed = '\0';
+
+    pagenum = (size_t)filp->reserved / XIPFS_NVM_PAGE_SIZE;
+    done = 0;
+    while (mp->gc_pages + 1 < pagenum) {
+        if (done == max_pages) {
+            return (int)done;
+        }
+        i = mp->gc_pages + 1;
+        dst = (char *)hole + i * XIPFS_NVM_PAGE_SIZE;
+        src = (char *)filp + i * XIPFS_NVM_PAGE_SIZE;
+        if (xipfs_flash_erase_page(xipfs_nvm_page(dst)) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (xipfs_flash_is_erased_page(xipfs_nvm_page(src)) == 0) {
+            if (xipfs_flash_write_unaligned(dst, src,
+                    XIPFS_NVM_PAGE_SIZE) < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+        }
+        mp->gc_pages = i;
+        done++;
+    }
+    if (done == max_pages) {
+        return (int)done;
+    }
+
+    /* the file may have been written between two steps */
+    for (i = 1; i < pagenum; i++) {
+        dst = (char *)hole + i * XIPFS_NVM_PAGE_SIZE;
+        src = (char *)filp + i * XIPFS_NVM_PAGE_SIZE;
+        if (memcmp(dst, src, XIPFS_NVM_PAGE_SIZE) != 0) {
+            mp->gc_pages = i - 1;
+            return (int)done;
+        }
+    }
+
+    (void)xipfs_desc_move(mp, hole, NULL);
+    newhole = (xipfs_file_t *)((uintptr_t)hole + filp->reserved);
+    if (filp->reserved < hole->reserved) {
+        /* the last file of a full file system points to itself */
+        if (xipfs_fs_hole_new(newhole, (size_t)hole->reserved,
+                (filp->next == filp) ? newhole : filp->next) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    (void)memcpy(&file, filp, sizeof(file));
+    file.next = newhole;
+    if (xipfs_flash_erase_page(xipfs_nvm_page(hole)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_flash_write_unaligned(hole, &file, sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_flash_write_unaligned(
+        (char *)hole + sizeof(file),
+        (char *)filp + sizeof(file),
+        XIPFS_NVM_PAGE_SIZE - sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (newhole == filp) {
+        /* the former copy of the file becomes the removed file */
+        if (xipfs_flash_write_unaligned(filp->path, &removed,
+                sizeof(removed)) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    done++;
+
+    (void)xipfs_fs_gc_link(mp, hole, filp, newhole);
+
+    return (int)done;
+}
+
+/**
+ * @internal
+ *
+ * @brief Moves a file larger than the removed file right before
+ * it into a removed file of its size past it, since it would
+ * overlap its own pages if it was moved over the removed file.
+ * The removed file is created past the last file unless a
+ * previous step left one, so that the pages past the last file
+ * stay erased. The pages of the file but the first one are
+ * copied at most max_pages at a time while the file stays in
+ * place, then the first page is copied, which links the file at
+ * its new address, and the former copy is removed, to be merged
+ * into the removed file before it
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The file that follows the removed file
+ *
+ * @param max_pages The maximum number of pages to copy
+ *
+ * @return Returns the number of copied pages or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_gc_relocate(xipfs_mount_t *mp, xipfs_file_t *filp,
+                     size_t max_pages)
+{
+    size_t pagenum, free_pages, done, i;
+    const char removed = '\0';
+    xipfs_file_t file, *newp;
+    char *dst, *src;
+
+    pagenum = (size_t)filp->reserved / XIPFS_NVM_PAGE_SIZE;
+
+    /* look for the copy left by a previous step */
+    xipfs_errno = XIPFS_OK;
+    newp = xipfs_fs_next_(filp);
+    while (newp != NULL && !(xipfs_fs_removed(newp) &&
+            newp->reserved == filp->reserved)) {
+        newp = xipfs_fs_next_(newp);
+    }
+    if (newp == NULL) {
+        if (xipfs_errno != XIPFS_OK) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        free_pages = mp->page_num - mp->used_pages;
+        if (pagenum > free_pages) {
+            xipfs_errno = XIPFS_ENOSPACE;
+            return -1;
+        }
+        if ((newp = xipfs_fs_tail_next(mp)) == NULL) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        /* the last file of a full file system points to itself */
+        if (xipfs_fs_hole_new(newp, (size_t)filp->reserved,
+                (pagenum < free_pages) ?
+                (void *)((char *)newp + filp->reserved) :
+                (void *)newp) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        mp->tail = newp;
+        mp->used_pages += pagenum;
+        mp->dead_pages += pagenum;
+        mp->gc_pages = 0;
+    }
+
+    done = 0;
+    while (mp->gc_pages + 1 < pagenum) {
+        if (done == max_pages) {
+            return (int)done;
+        }
+        i = mp->gc_pages + 1;
+        dst = (char *)newp + i * XIPFS_NVM_PAGE_SIZE;
+        src = (char *)filp + i * XIPFS_NVM_PAGE_SIZE;
+        if (xipfs_flash_erase_page(xipfs_nvm_page(dst)) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (xipfs_flash_is_erased_page(xipfs_nvm_page(src)) == 0) {
+            if (xipfs_flash_write_unaligned(dst, src,
+                    XIPFS_NVM_PAGE_SIZE) < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+        }
+        mp->gc_pages = i;
+        done++;
+    }
+    if (done == max_pages) {
+        return (int)done;
+    }
+
+    /* the file may have been written, or the copy left by
+     * another step, between two steps */
+    for (i = 1; i < pagenum; i++) {
+        dst = (char *)newp + i * XIPFS_NVM_PAGE_SIZE;
+        src = (char *)filp + i * XIPFS_NVM_PAGE_SIZE;
+        if (memcmp(dst, src, XIPFS_NVM_PAGE_SIZE) != 0) {
+            mp->gc_pages = i - 1;
+            return (int)done;
+        }
+    }
+
+    (void)memcpy(&file, filp, sizeof(file));
+    file.next = newp->next;
+    if (xipfs_flash_erase_page(xipfs_nvm_page(newp)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_flash_write_unaligned(newp, &file, sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_flash_write_unaligned(
+        (char *)newp + sizeof(file),
+        (char *)filp + sizeof(file),
+        XIPFS_NVM_PAGE_SIZE - sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    /* the former copy is removed once the new one is linked */
+    xipfs_index_move(filp, newp);
+    xipfs_dirtab_move(filp, newp);
+    xipfs_emptydir_move(filp, newp);
+    if (xipfs_flash_write_unaligned(filp->path, &removed,
+            sizeof(removed)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    done++;
+
+    (void)xipfs_desc_move(mp, filp, newp);
+    mp->gc_pages = 0;
+
+    return (int)done;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Estimates the number of pages to erase or copy to
+ * reclaim a file and the removed files after it, that is the
+ * pages of these files and of the files after them
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The file to reclaim or NULL for the first
+ * removed file
+ *
+ * @return Returns the number of pages or a negative value
+ * otherwise
+ */
+int
+xipfs_fs_gc_cost(xipfs_mount_t *mp, xipfs_file_t *filp)
+{
+    xipfs_file_t *curp;
+    size_t pages;
+    int found;
+
+    assert(mp != NULL);
+
+    pages = 0;
+    found = 0;
+    xipfs_errno = XIPFS_OK;
+    curp = xipfs_fs_head_(mp);
+    while (curp != NULL) {
+        if (found == 0) {
+            found = (filp != NULL) ? curp == filp :
+                xipfs_fs_removed(curp);
+        }
+        if (found == 1) {
+            pages += (size_t)curp->reserved / XIPFS_NVM_PAGE_SIZE;
+        }
+        curp = xipfs_fs_next_(curp);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    assert(pages <= (size_t)INT_MAX);
+
+    return (int)pages;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Performs a part of the garbage collection of the mount
+ * point passed as an argument, erasing or copying at most
+ * max_pages pages, so that the collection can be interleaved
+ * with the other operations
+ *
+ * The file system stays consistent between two steps: the
+ * removed files are merged together and moved towards the end
+ * of the file system, then erased. The progress of the file
+ * being copied is kept in the mount point and checked again by
+ * the next step. A file larger than the removed files in front
+ * of it would overlap its own pages, it is thus copied into a
+ * removed file created past the last file, and the step fails
+ * when the free pages cannot hold it, leaving it to xipfs_fs_gc
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param max_pages The maximum number of pages to erase or
+ * copy, at least one
+ *
+ * @return Returns the estimated number of pages left to erase
+ * or copy, zero once the collection is complete, or a negative
+ * value otherwise
+ */
+int
+xipfs_fs_gc_step(xipfs_mount_t *mp, size_t max_pages)
+{
+    xipfs_file_t *prev, *hole, *filp;
+    size_t done;
+    int ret;
+
+    assert(mp != NULL);
+    assert(max_pages > 0);
+
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (mp->dead_pages == 0) {
+        mp->gc_hole = NULL;
+        return 0;
+    }
+
+    /* the collection rewrites pages behind the buffer */
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    xipfs_buffer_invalidate();
+
+    /* look for the first removed file */
+    prev = NULL;
+    xipfs_errno = XIPFS_OK;
+    hole = xipfs_fs_head_(mp);
+    while (hole != NULL && !xipfs_fs_removed(hole)) {
+        prev = hole;
+        hole = xipfs_fs_next_(hole);
+    }
+    if (hole == NULL) {
+        if (xipfs_errno == XIPFS_OK) {
+            /* the cached page counts are wrong */
+            xipfs_errno = XIPFS_ELINK;
+        }
+        goto fail;
+    }
+    if (hole != mp->gc_hole || hole->next != mp->gc_file) {
+        /* a previous step stopped on another file */
+        mp->gc_pages = 0;
+    }
+    mp->gc_hole = hole;
+
+    done = 0;
+    while (done < max_pages && mp->gc_hole != NULL) {
+        xipfs_errno = XIPFS_OK;
+        if ((filp = xipfs_fs_next_(hole)) == NULL) {
+            if (xipfs_errno != XIPFS_OK) {
+                /* xipfs_errno was set */
+                goto fail;
+            }
+            ret = xipfs_fs_gc_trim(mp, prev, hole, max_pages - done);
+        } else if (xipfs_fs_removed(filp)) {
+            ret = xipfs_fs_gc_merge(mp, hole, filp);
+        } else if (filp->reserved <= hole->reserved) {
+            ret = xipfs_fs_gc_slide(mp, hole, filp, max_pages - done);
+        } else {
+            ret = xipfs_fs_gc_relocate(mp, filp, max_pages - done);
+            if (ret < 0 && xipfs_errno == XIPFS_ENOSPACE) {
+                if (done > 0) {
+                    /* left to the next step */
+                    break;
+                }
+                /* only xipfs_fs_gc moves the file */
+                mp->gc_hole = NULL;
+                return -1;
+            }
+        }
+        if (ret < 0) {
+            /* xipfs_errno was set */
+            goto fail;
+        }
+        done += (size_t)ret;
+        if (mp->gc_hole != hole) {
+            /* the file was moved over the removed file */
+            prev = hole;
+            hole = mp->gc_hole;
+        }
+    }
+    if (mp->gc_hole != NULL) {
+        mp->gc_file = mp->gc_hole->next;
+    }
+
+    return xipfs_fs_gc_cost(mp, NULL);
+
+fail:
+    /* the caches may no longer match the files in flash */
+    mp->gc_hole = NULL;
+    xipfs_index_invalidate(mp->page_addr);
+    xipfs_dirtab_invalidate(mp->page_addr);
+    xipfs_fs_invalidate(mp);
+    return -1;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Removes a file from the file system by clearing the
+ * first character of its path. Its pages are reclaimed by the
+ * next garbage collection
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The address of the xipfs file to remove
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_fs_remove(xipfs_mount_t *mp, xipfs_file_t *filp)
+{
+    const char removed = '\0';
+
+    assert(mp != NULL);
+    assert(filp != NULL);
+
+    if (xipfs_file_filp_check(filp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_fs_removed(filp)) {
+        xipfs_errno = XIPFS_EEMPTY;
+        return -1;
+    }
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    xipfs_index_remove(filp);
+    if (xipfs_buffer_write(filp->path, &removed, sizeof(removed)) < 0) {
+        /* xipfs_errno was set */
+        xipfs_index_invalidate(filp);
+        xipfs_fs_invalidate(mp);
+        return -1;
+    }
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        xipfs_index_invalidate(filp);
+        xipfs_fs_invalidate(mp);
+        return -1;
+    }
+
+    assert(mp->file_count > 0);
+    mp->file_count--;
+    mp->dead_pages += (size_t)filp->reserved / XIPFS_NVM_PAGE_SIZE;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Rewrites the reserved size and the next file of a file
+ * through the buffer. A reserved size can seldom be changed by
+ * clearing bits alone, so the first page of the file is usually
+ * erased and programmed again, and the bytes of this page past
+ * the ones to keep are left in the erased state for the
+ * following writes
+ *
+ * @param filp A pointer to the xipfs file structure to rewrite
+ *
+ * @param reserved The new reserved size of the file
+ *
+ * @param next The new address of the next file
+ *
+ * @param keep The number of bytes of the first page to keep,
+ * including the file structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_relink(xipfs_file_t *filp, size_t reserved, void *next,
+                size_t keep)
+{
+    unsigned char erased[32];
+    xipfs_file_position_t size;
+    size_t n;
+
+    assert(reserved <= XIPFS_FILE_POSITION_MAX_AS_SIZE_T);
+    assert(keep >= sizeof(*filp));
+    size = (xipfs_file_position_t)reserved;
+
+    if (xipfs_buffer_write(&filp->next, &next, sizeof(next)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_buffer_write(&filp->reserved, &size, sizeof(size)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    (void)memset(erased, XIPFS_NVM_ERASE_STATE, sizeof(erased));
+    while (keep < XIPFS_NVM_PAGE_SIZE) {
+        n = XIPFS_NVM_PAGE_SIZE - keep;
+        if (n > sizeof(erased)) {
+            n = sizeof(erased);
+        }
+        if (xipfs_buffer_write((char *)filp + keep, erased, n) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        keep += n;
+    }
+
+    return xipfs_buffer_flush();
+}
+
+/**
+ * @internal
+ *
+ * @brief Releases the last pages of a file without copying it.
+ * The pages past the last file are erased at once, those of
+ * another file become a removed file that the next garbage
+ * collection reclaims
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The file to shrink
+ *
+ * @param reserved The new reserved size of the file, smaller
+ * than the current one
+ *
+ * @param size The number of bytes of the file to keep
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_resize_shrink(xipfs_mount_t *mp, xipfs_file_t *filp,
+                       size_t reserved, size_t size)
+{
+    size_t pagenum, keep, i;
+    unsigned int start;
+    char *hole;
+
+    hole = (char *)filp + reserved;
+    keep = sizeof(*filp) + size;
+    if (keep > XIPFS_NVM_PAGE_SIZE) {
+        keep = XIPFS_NVM_PAGE_SIZE;
+    }
+    pagenum = ((size_t)filp->reserved - reserved) / XIPFS_NVM_PAGE_SIZE;
+
+    if (filp != mp->tail) {
+        /* the removed file is linked before the file points to it */
+        if (xipfs_fs_hole_new(hole, pagenum * XIPFS_NVM_PAGE_SIZE,
+                filp->next) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (xipfs_fs_relink(filp, reserved, hole, keep) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        mp->dead_pages += pagenum;
+        return 0;
+    }
+
+    if (xipfs_fs_relink(filp, reserved, hole, keep) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    /* the pages past the last file are kept erased */
+    start = xipfs_nvm_page(hole);
+    for (i = 0; i < pagenum; i++) {
+        if (xipfs_flash_erase_page(start + i) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    assert(mp->used_pages >= pagenum);
+    mp->used_pages -= pagenum;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Extends the last file over the erased pages that
+ * follow it, which only rewrites its file structure
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The last file
+ *
+ * @param reserved The new reserved size of the file, larger
+ * than the current one
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_resize_tail(xipfs_mount_t *mp, xipfs_file_t *filp,
+                     size_t reserved)
+{
+    size_t pagenum, free_pages;
+    void *next;
+
+    pagenum = (reserved - (size_t)filp->reserved) / XIPFS_NVM_PAGE_SIZE;
+    free_pages = mp->page_num - mp->used_pages;
+    assert(pagenum <= free_pages);
+    /* the last file of a full file system points to itself */
+    next = (pagenum < free_pages) ? (char *)filp + reserved : (void *)filp;
+
+    if (xipfs_fs_relink(filp, reserved, next,
+            XIPFS_NVM_PAGE_SIZE) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    mp->used_pages += pagenum;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Extends a file over the removed file that follows it,
+ * which rewrites its file structure and the one of a removed
+ * file standing for the pages left over if any, then erases the
+ * pages taken over
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The file followed by a removed file
+ *
+ * @param reserved The new reserved size of the file, larger
+ * than the current one and not larger than the reserved sizes
+ * of both files
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_fs_resize_merge(xipfs_mount_t *mp, xipfs_file_t *filp,
+                      size_t reserved)
+{
+    size_t total, pagenum, i;
+    xipfs_file_t *hole, *left;
+    unsigned int start;
+    void *next;
+
+    hole = filp->next;
+    total = (size_t)filp->reserved + (size_t)hole->reserved;
+    assert(reserved <= total);
+    pagenum = (reserved - (size_t)filp->reserved) / XIPFS_NVM_PAGE_SIZE;
+    left = (xipfs_file_t *)((uintptr_t)filp + reserved);
+
+    (void)xipfs_desc_move(mp, hole, NULL);
+    if (reserved < total) {
+        /* the last file of a full file system points to itself */
+        next = (hole->next == hole) ? (void *)left : hole->next;
+        if (xipfs_fs_hole_new(left, total - reserved, next) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        next = left;
+    } else {
+        next = (hole->next == hole) ? (void *)filp : hole->next;
+    }
+    if (mp->tail == hole) {
+        mp->tail = (reserved < total) ? left : filp;
+    }
+    if (xipfs_fs_relink(filp, reserved, next, XIPFS_NVM_PAGE_SIZE) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    /* the pages taken over are erased once they belong to the
+     * file, so that the removed file stays linked until then */
+    start = xipfs_nvm_page(hole);
+    for (i = 0; i < pagenum; i++) {
+        if (xipfs_flash_erase_page(start + i) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    }
+    assert(mp->dead_pages >= pagenum);
+    mp->dead_pages -= pagenum;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @brief Copies a file past the last file with a larger
+ * reserved size, then removes its former copy. Each page of the
+ * file is copied once, and the erased pages are skipped
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The file to move
+ *
+ * @param reserved The new reserved size of the file, larger
+ * than the current one
+ *
+ * @return Returns the new address of the file or NULL otherwise
+ */
+static xipfs_file_t *
+xipfs_fs_resize_move(xipfs_mount_t *mp, xipfs_file_t *filp,
+                     size_t reserved)
+{
+    size_t pagenum, free_pages, i;
+    xipfs_file_position_t size;
+    const char removed = '\0';
+    xipfs_file_t file, *newp;
+    char *dst, *src;
+    void *next;
+
+    if ((size = xipfs_file_get_size_(filp)) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if ((newp = xipfs_fs_tail_next(mp)) == NULL) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    pagenum = reserved / XIPFS_NVM_PAGE_SIZE;
+    free_pages = mp->page_num - mp->used_pages;
+    assert(pagenum <= free_pages);
+    /* the last file of a full file system points to itself */
+    next = (pagenum < free_pages) ? (char *)newp + reserved : (void *)newp;
+
+    /* the current path and size go to the first slots */
+    (void)memset(&file, XIPFS_NVM_ERASE_STATE, sizeof(file));
+    (void)strncpy(file.path, xipfs_file_get_path(filp), XIPFS_PATH_MAX - 1);
+    file.reserved = (xipfs_file_position_t)reserved;
+    file.next = next;
+    if (size > 0) {
+        file.size[0] = size;
+    }
+    file.exec = filp->exec;
+
+    /* a no-op unless the page is not known to be erased */
+    if (xipfs_flash_erase_page(xipfs_nvm_page(newp)) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (xipfs_flash_write_unaligned(newp, &file, sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (xipfs_flash_write_unaligned(
+        (char *)newp + sizeof(file),
+        (char *)filp + sizeof(file),
+        XIPFS_NVM_PAGE_SIZE - sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    pagenum = (size_t)filp->reserved / XIPFS_NVM_PAGE_SIZE;
+    for (i = 1; i < pagenum; i++) {
+        dst = (char *)newp + i * XIPFS_NVM_PAGE_SIZE;
+        src = (char *)filp + i * XIPFS_NVM_PAGE_SIZE;
+        if (xipfs_flash_is_erased_page(xipfs_nvm_page(src)) == 1) {
+            continue;
+        }
+        if (xipfs_flash_erase_page(xipfs_nvm_page(dst)) < 0) {
+            /* xipfs_errno was set */
+            return NULL;
+        }
+        if (xipfs_flash_write_unaligned(dst, src,
+                XIPFS_NVM_PAGE_SIZE) < 0) {
+            /* xipfs_errno was set */
+            return NULL;
+        }
+    }
+
+    /* the former copy is removed once the new one is complete */
+    xipfs_index_remove(filp);
+    if (xipfs_flash_write_unaligned(filp->path, &removed,
+            sizeof(removed)) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    (void)xipfs_desc_move(mp, filp, newp);
+    mp->tail = newp;
+    mp->used_pages += reserved / XIPFS_NVM_PAGE_SIZE;
+    mp->dead_pages += pagenum;
+    xipfs_index_add(newp);
+
+    return newp;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Changes the number of NVM pages reserved for a file of
+ * the mount point passed as an argument, keeping its content up
+ * to the new reserved size. A file grows over the erased pages
+ * or the removed file that follow it, otherwise it is moved
+ * past the last file, and shrinks by releasing its last pages
+ * without copying them. The open descriptors follow a moved
+ * file
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The address of the xipfs file to resize
+ *
+ * @param size Determines how many pages of NVM will be reserved
+ * for the file
+ *
+ * @return Returns a pointer to the resized xipfs file structure
+ * or NULL otherwise
+ */
+xipfs_file_t *
+xipfs_fs_resize(xipfs_mount_t *mp, xipfs_file_t *filp,
+                xipfs_file_position_t size)
+{
+    size_t reserved, pagenum;
+    xipfs_file_t *nextp;
+    int merge;
+
+    assert(mp != NULL);
+    assert(filp != NULL);
+
+    if (xipfs_file_filp_check(filp) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (xipfs_fs_hidden(filp)) {
+        xipfs_errno = XIPFS_EPERM;
+        return NULL;
+    }
+    if (size < 0 || (size_t)size >
+            XIPFS_FILE_POSITION_MAX_AS_SIZE_T - sizeof(xipfs_file_t)) {
+        xipfs_errno = XIPFS_EINVALIDSIZE;
+        return NULL;
+    }
+    reserved = ROUND((size_t)size + sizeof(xipfs_file_t),
+        XIPFS_NVM_PAGE_SIZE);
+
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (reserved == (size_t)filp->reserved) {
+        return filp;
+    }
+
+    /* a file followed by a large enough removed file grows in
+     * place */
+    merge = 0;
+    if (reserved > (size_t)filp->reserved && filp != mp->tail) {
+        nextp = filp->next;
+        merge = xipfs_fs_removed(nextp) && reserved <=
+            (size_t)filp->reserved + (size_t)nextp->reserved;
+    }
+
+    if (reserved > (size_t)filp->reserved && merge == 0) {
+        pagenum = reserved / XIPFS_NVM_PAGE_SIZE;
+        if (filp == mp->tail) {
+            pagenum -= (size_t)filp->reserved / XIPFS_NVM_PAGE_SIZE;
+        }
+        /* reclaim the pages of removed files once the free
+         * pages fall below the watermark */
+        if (mp->dead_pages > 0 && mp->page_num - mp->used_pages <
+                pagenum + XIPFS_GC_WATERMARK) {
+            filp = xipfs_fs_gc_target(filp, mp);
+            assert(filp != NULL);
+            if (xipfs_fs_gc(mp) < 0) {
+                /* xipfs_errno was set */
+                return NULL;
+            }
+            pagenum = reserved / XIPFS_NVM_PAGE_SIZE;
+            if (filp == mp->tail) {
+                pagenum -= (size_t)filp->reserved / XIPFS_NVM_PAGE_SIZE;
+            }
+        }
+        if (pagenum > mp->page_num - mp->used_pages) {
+            xipfs_errno = XIPFS_ENOSPACE;
+            return NULL;
+        }
+    }
+
+    /* the file structures are rewritten behind the buffer */
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    xipfs_buffer_invalidate();
+    /* a step of the garbage collection in progress starts over */
+    mp->gc_hole = NULL;
+
+    if (reserved < (size_t)filp->reserved) {
+        if (xipfs_fs_resize_shrink(mp, filp, reserved,
+                (size_t)size) < 0) {
+            /* xipfs_errno was set */
+            goto fail;
+        }
+    } else if (merge == 1) {
+        if (xipfs_fs_resize_merge(mp, filp, reserved) < 0) {
+            /* xipfs_errno was set */
+            goto fail;
+        }
+    } else if (filp == mp->tail) {
+        if (xipfs_fs_resize_tail(mp, filp, reserved) < 0) {
+            /* xipfs_errno was set */
+            goto fail;
+        }
+    } else if ((filp = xipfs_fs_resize_move(mp, filp, reserved)) == NULL) {
+        /* xipfs_errno was set */
+        goto fail;
+    }
+
+    return filp;
+
+fail:
+    /* the caches may no longer match the files in flash */
+    xipfs_buffer_invalidate();
+    xipfs_index_invalidate(mp->page_addr);
+    xipfs_fs_invalidate(mp);
+    return NULL;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre path must be a pointer that references a creatable path
+ * which is accessible, null-terminated, starts with a slash,
+ * normalized, shorter than XIPFS_PATH_MAX, and whose
+ * directories fit in the directory table
+ *
+ * @brief Copies a file of the mount point passed as an argument
+ * to a new file past the last one, with the same reserved size
+ * and execution right. The bytes up to the size of the source
+ * are programmed straight from its pages into the erased NVM
+ * pages, without going through the I/O buffer
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The address of the xipfs file to copy
+ *
+ * @param path A pointer to the path of the copy
+ *
+ * @return Returns a pointer to the xipfs file structure of the
+ * copy or NULL otherwise
+ */
+xipfs_file_t *
+xipfs_fs_copy(xipfs_mount_t *mp, xipfs_file_t *filp, const char *path)
+{
+    size_t reserved, pagenum, free_pages, end, off, n;
+    char raw[XIPFS_PATH_MAX];
+    xipfs_file_position_t size;
+    xipfs_file_t file, *newp;
+    void *next;
+
+    assert(mp != NULL);
+    assert(filp != NULL);
+
+    if (xipfs_file_filp_check(filp) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (xipfs_fs_hidden(filp)) {
+        xipfs_errno = XIPFS_EPERM;
+        return NULL;
+    }
+    if (xipfs_file_path_check(path) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    /* the directory table already has room, no file moves */
+    if (xipfs_dirtab_encode(mp, path, raw) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    reserved = (size_t)filp->reserved;
+    pagenum = reserved / XIPFS_NVM_PAGE_SIZE;
+    /* reclaim the pages of removed files once the free pages
+     * fall below the watermark */
+    if (mp->dead_pages > 0 && mp->page_num - mp->used_pages <
+            pagenum + XIPFS_GC_WATERMARK) {
+        filp = xipfs_fs_gc_target(filp, mp);
+        assert(filp != NULL);
+        if (xipfs_fs_gc(mp) < 0) {
+            /* xipfs_errno was set */
+            return NULL;
+        }
+    }
+    free_pages = mp->page_num - mp->used_pages;
+    if (pagenum > free_pages) {
+        xipfs_errno = XIPFS_ENOSPACE;
+        return NULL;
+    }
+    if ((size = xipfs_file_get_size_(filp)) < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    if ((newp = xipfs_fs_tail_next(mp)) == NULL) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    /* the last file of a full file system points to itself */
+    next = (pagenum < free_pages) ? (char *)newp + reserved : (void *)newp;
+
+    /* the source is read from flash and the copy is programmed
+     * behind the buffer */
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+    xipfs_buffer_invalidate();
+
+    (void)memset(&file, XIPFS_NVM_ERASE_STATE, sizeof(file));
+    (void)strncpy(file.path, raw, XIPFS_PATH_MAX - 1);
+    file.reserved = (xipfs_file_position_t)reserved;
+    file.next = next;
+    if (size > 0) {
+        file.size[0] = size;
+    }
+    file.exec = filp->exec;
+
+    /* a no-op unless the page is not known to be erased */
+    if (xipfs_flash_erase_page(xipfs_nvm_page(newp)) < 0) {
+        /* xipfs_errno was set */
+        goto fail;
+    }
+    if (xipfs_flash_write_unaligned(newp, &file, sizeof(file)) < 0) {
+        /* xipfs_errno was set */
+        goto fail;
+    }
+    end = sizeof(file) + (size_t)size;
+    for (off = sizeof(file); off < end; off += n) {
+        n = XIPFS_NVM_PAGE_SIZE - off % XIPFS_NVM_PAGE_SIZE;
+        if (n > end - off) {
+            n = end - off;
+        }
+        if (off % XIPFS_NVM_PAGE_SIZE == 0) {
+            if (xipfs_flash_is_erased_page(
+                    xipfs_nvm_page((char *)filp + off)) == 1) {
+                continue;
+            }
+            if (xipfs_flash_erase_page(
+                    xipfs_nvm_page((char *)newp + off)) < 0) {
+                /* xipfs_errno was set */
+                goto fail;
+            }
+        }
+        if (xipfs_flash_write_unaligned((char *)newp + off,
+                (char *)filp + off, n) < 0) {
+            /* xipfs_errno was set */
+            goto fail;
+        }
+    }
+    mp->tail = newp;
+    mp->file_count++;
+    mp->used_pages += pagenum;
+    xipfs_index_add(newp);
+
+    return newp;
+
+fail:
+    /* the caches may no longer match the files in flash */
+    xipfs_index_invalidate(mp->page_addr);
+    xipfs_fs_invalidate(mp);
+    return NULL;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Format the file system specified by the mount point
+ * structure passed as an argument
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_fs_format(xipfs_mount_t *mp)
+{
+    unsigned start_page, end_page;
+    void *start_addr, *end_addr;
+    size_t i;
+
+    /* buffered bytes are meaningless once the pages are erased */
+    xipfs_buffer_invalidate();
+    xipfs_index_invalidate(mp->page_addr);
+    xipfs_dirtab_invalidate(mp->page_addr);
+    xipfs_fs_invalidate(mp);
 
     start_addr = mp->page_addr;
     end_addr = (char *)start_addr + mp->page_num * XIPFS_NVM_PAGE_SIZE;
@@ -549,10 +2472,168 @@ xipfs_fs_format(xipfs_mount_t *mp)
         }
         i++;
     }
+    mp->tail = NULL;
+    mp->file_count = 0;
+    mp->used_pages = 0;
+    mp->dead_pages = 0;
+    mp->cached = 1;
+    mp->gc_hole = NULL;
+
+    return 0;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @brief Retrieves the last complete file holding a table in
+ * the mount point passed as an argument
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param kind The path of the file, XIPFS_DIRTAB_TABLE or
+ * XIPFS_EMPTYDIR_LOG
+ *
+ * @return Returns a pointer to the xipfs file structure or NULL
+ * otherwise, with xipfs_errno set to XIPFS_OK if there is none
+ */
+xipfs_file_t *
+xipfs_fs_table(xipfs_mount_t *mp, char kind)
+{
+    xipfs_file_t *filp, *table;
+
+    assert(mp != NULL);
+
+    table = NULL;
+    xipfs_errno = XIPFS_OK;
+    if ((filp = xipfs_fs_head_(mp)) != NULL) {
+        do {
+            /* the size is set once the records are written */
+            if (filp->path[0] == kind && filp->size[0] !=
+                    (xipfs_file_position_t)XIPFS_FLASH_ERASE_STATE) {
+                table = filp;
+            }
+        } while ((filp = xipfs_fs_next_(filp)) != NULL);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return NULL;
+    }
+
+    return table;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure holding a table
+ *
+ * @brief Marks a file holding a table as complete, then removes
+ * the files holding former tables of the same kind
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The file holding the new table
+ *
+ * @param size The number of bytes of records of the table
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_fs_table_commit(xipfs_mount_t *mp, xipfs_file_t *filp, size_t size)
+{
+    const char removed = '\0';
+    xipfs_file_t *curp;
+
+    assert(mp != NULL);
+    assert(filp != NULL);
+
+    if (xipfs_file_set_size(filp, (xipfs_file_position_t)size) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_fs_load(mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    xipfs_errno = XIPFS_OK;
+    if ((curp = xipfs_fs_head_(mp)) != NULL) {
+        do {
+            if (curp == filp || curp->path[0] != filp->path[0]) {
+                continue;
+            }
+            if (xipfs_buffer_write(curp->path, &removed,
+                    sizeof(removed)) < 0) {
+                /* xipfs_errno was set */
+                xipfs_fs_invalidate(mp);
+                return -1;
+            }
+            if (xipfs_buffer_flush() < 0) {
+                /* xipfs_errno was set */
+                xipfs_fs_invalidate(mp);
+                return -1;
+            }
+            mp->dead_pages += (size_t)curp->reserved / XIPFS_NVM_PAGE_SIZE;
+        } while ((curp = xipfs_fs_next_(curp)) != NULL);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
 
     return 0;
 }
 
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre to must be a pointer that references a path which is
+ * accessible, null-terminated, starts with a slash, normalized,
+ * and shorter than XIPFS_PATH_MAX
+ *
+ * @brief Changes the path of a file of the mount point passed
+ * as an argument
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param filp The address of the xipfs file to rename
+ *
+ * @param to The new path of the file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_fs_rename(xipfs_mount_t *mp, xipfs_file_t *filp, const char *to)
+{
+    char raw[XIPFS_PATH_MAX];
+
+    if (xipfs_file_path_check(to) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_dirtab_encode(mp, to, raw) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return xipfs_file_rename(filp, raw);
+}
+
 /**
  * @pre xipfs_mp must be a pointer that references a memory
  * region containing an xipfs mount point structure which is
@@ -584,9 +2665,10 @@ xipfs_fs_format(xipfs_mount_t *mp)
 int
 xipfs_fs_rename_all(xipfs_mount_t *mp, const char *from, const char *to)
 {
-    char path[XIPFS_PATH_MAX];
+    char path[XIPFS_PATH_MAX], buf[XIPFS_PATH_MAX];
     size_t from_len, to_len;
     xipfs_file_t *filp;
+    const char *curr;
     int counter;
 
     from_len = strnlen(from, XIPFS_PATH_MAX);
@@ -600,17 +2682,24 @@ xipfs_fs_rename_all(xipfs_mount_t *mp, const char *from, const char *to)
         return -1;
     }
 
+    /* with a directory table, the files follow the record of
+     * their directory */
+    if ((counter = xipfs_dirtab_rename(mp, from, to)) != 0) {
+        /* xipfs_errno was set if negative */
+        return counter;
+    }
+
     (void)strcpy(path, to);
     xipfs_errno = XIPFS_OK;
-    counter = 0;
     if ((filp = xipfs_fs_head(mp)) != NULL) {
         do {
-            if (strncmp(filp->path, from, from_len) == 0) {
+            curr = xipfs_dirtab_path(filp, buf);
+            if (strncmp(curr, from, from_len) == 0) {
                 /* XXX Handle file name truncation */
-                (void)strncpy(&path[to_len], &filp->path[from_len],
+                (void)strncpy(&path[to_len], &curr[from_len],
                     XIPFS_PATH_MAX-to_len);
                 path[XIPFS_PATH_MAX-1] = '\0';
-                if (xipfs_file_rename(filp, path) < 0) {
+                if (xipfs_fs_rename(mp, filp, path) < 0) {
                     /* xipfs_errno was set */
                     return -1;
                 }
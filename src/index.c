@@ -0,0 +1,745 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * libc includes
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * xipfs includes
+ */
+#include "include/xipfs.h"
+#include "include/dirtab.h"
+#include "include/errno.h"
+#include "include/fs.h"
+#include "include/index.h"
+
+#if XIPFS_PATH_INDEX_SIZE > 0
+
+/**
+ * @internal
+ *
+ * @def XIPFS_INDEX_LOAD_MAX
+ *
+ * @brief The maximum number of entries of a table of the index,
+ * which keeps at least one free slot so that probing ends
+ */
+#define XIPFS_INDEX_LOAD_MAX ((XIPFS_PATH_INDEX_SIZE * 3) / 4)
+
+/**
+ * @internal
+ *
+ * @brief An entry of the file table of the index
+ */
+typedef struct xipfs_index_file_s {
+    /**
+     * The indexed file, NULL if the entry is free
+     */
+    xipfs_file_t *filp;
+    /**
+     * The hash of the path of the file
+     */
+    uint32_t hash;
+} xipfs_index_file_t;
+
+/**
+ * @internal
+ *
+ * @brief An entry of the directory table of the index
+ */
+typedef struct xipfs_index_dir_s {
+    /**
+     * The first file, in file system order, whose path starts
+     * with the path of the directory, NULL if the entry is free
+     */
+    xipfs_file_t *filp;
+    /**
+     * The hash of the path of the directory
+     */
+    uint32_t hash;
+    /**
+     * The number of files whose path starts with the path of
+     * the directory
+     */
+    uint16_t count;
+    /**
+     * The length of the path of the directory, including its
+     * trailing slash
+     */
+    uint8_t len;
+} xipfs_index_dir_t;
+
+/**
+ * @internal
+ *
+ * @brief A structure that describes the path index
+ */
+typedef struct xipfs_index_s {
+    /**
+     * The mount point the index is bound to, NULL if none
+     */
+    xipfs_mount_t *mp;
+    /**
+     * The address range of the mount point
+     */
+    uintptr_t start, end;
+    /**
+     * Non-zero if the index reflects the whole file system
+     */
+    int valid;
+    /**
+     * Non-zero if rebuilding an invalid index may succeed
+     */
+    int retry;
+    /**
+     * The number of entries in each table
+     */
+    size_t files, dirs;
+    /**
+     * The file table, indexed by the hash of the file path
+     */
+    xipfs_index_file_t file[XIPFS_PATH_INDEX_SIZE];
+    /**
+     * The directory table, indexed by the hash of the
+     * directory path
+     */
+    xipfs_index_dir_t dir[XIPFS_PATH_INDEX_SIZE];
+} xipfs_index_t;
+
+/**
+ * @internal
+ *
+ * @brief The path index of xipfs
+ */
+static xipfs_index_t xipfs_index;
+
+/**
+ * @internal
+ *
+ * @brief Computes the FNV-1a hash of the len first characters
+ * of a path
+ *
+ * @param path A pointer to a path
+ *
+ * @param len The number of characters to hash
+ *
+ * @return Returns the hash of the path
+ */
+static uint32_t
+xipfs_index_hash(const char *path, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks whether an address belongs to the mount point
+ * the index is bound to
+ *
+ * @param addr An address in the NVM
+ *
+ * @return Returns one if the address belongs to the indexed
+ * mount point or zero otherwise
+ */
+static int
+xipfs_index_in(const void *addr)
+{
+    return xipfs_index.mp != NULL &&
+        (uintptr_t)addr >= xipfs_index.start &&
+        (uintptr_t)addr < xipfs_index.end;
+}
+
+/**
+ * @internal
+ *
+ * @brief Looks for the slot of a file in the file table
+ *
+ * @param path A pointer to the path of the file
+ *
+ * @param len The length of the path
+ *
+ * @param hash The hash of the path
+ *
+ * @return Returns the slot holding the file or the free slot
+ * where to insert it
+ */
+static size_t
+xipfs_index_file_slot(const char *path, size_t len, uint32_t hash)
+{
+    char buf[XIPFS_PATH_MAX];
+    xipfs_index_file_t *entry;
+    const char *curr;
+    size_t i;
+
+    i = hash % XIPFS_PATH_INDEX_SIZE;
+    while ((entry = &xipfs_index.file[i])->filp != NULL) {
+        if (entry->hash == hash) {
+            curr = xipfs_dirtab_path(entry->filp, buf);
+            if (strncmp(curr, path, len) == 0 && curr[len] == '\0') {
+                break;
+            }
+        }
+        i = (i + 1) % XIPFS_PATH_INDEX_SIZE;
+    }
+
+    return i;
+}
+
+/**
+ * @internal
+ *
+ * @brief Looks for the slot of a directory in the directory
+ * table
+ *
+ * @param path A pointer to a path starting with the path of the
+ * directory
+ *
+ * @param len The length of the path of the directory
+ *
+ * @param hash The hash of the path of the directory
+ *
+ * @return Returns the slot holding the directory or the free
+ * slot where to insert it
+ */
+static size_t
+xipfs_index_dir_slot(const char *path, size_t len, uint32_t hash)
+{
+    char buf[XIPFS_PATH_MAX];
+    xipfs_index_dir_t *entry;
+    size_t i;
+
+    i = hash % XIPFS_PATH_INDEX_SIZE;
+    while ((entry = &xipfs_index.dir[i])->filp != NULL) {
+        if (entry->hash == hash && entry->len == len &&
+            strncmp(xipfs_dirtab_path(entry->filp, buf), path, len) == 0) {
+            break;
+        }
+        i = (i + 1) % XIPFS_PATH_INDEX_SIZE;
+    }
+
+    return i;
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks whether an entry can be moved to a freed slot
+ * without becoming unreachable from its home slot
+ *
+ * @param freed The freed slot
+ *
+ * @param home The home slot of the entry
+ *
+ * @param slot The slot of the entry
+ *
+ * @return Returns one if the entry can be moved or zero
+ * otherwise
+ */
+static int
+xipfs_index_movable(size_t freed, size_t home, size_t slot)
+{
+    if (freed <= slot) {
+        return home <= freed || home > slot;
+    }
+
+    return home <= freed && home > slot;
+}
+
+/**
+ * @internal
+ *
+ * @brief Frees a slot of the file table, shifting back the
+ * entries of the same probe sequence
+ *
+ * @param i The slot to free
+ */
+static void
+xipfs_index_file_delete(size_t i)
+{
+    size_t j = i;
+
+    for (;;) {
+        j = (j + 1) % XIPFS_PATH_INDEX_SIZE;
+        if (xipfs_index.file[j].filp == NULL) {
+            break;
+        }
+        if (xipfs_index_movable(i, xipfs_index.file[j].hash %
+                XIPFS_PATH_INDEX_SIZE, j)) {
+            xipfs_index.file[i] = xipfs_index.file[j];
+            i = j;
+        }
+    }
+    xipfs_index.file[i].filp = NULL;
+    xipfs_index.files--;
+}
+
+/**
+ * @internal
+ *
+ * @brief Frees a slot of the directory table, shifting back the
+ * entries of the same probe sequence
+ *
+ * @param i The slot to free
+ */
+static void
+xipfs_index_dir_delete(size_t i)
+{
+    size_t j = i;
+
+    for (;;) {
+        j = (j + 1) % XIPFS_PATH_INDEX_SIZE;
+        if (xipfs_index.dir[j].filp == NULL) {
+            break;
+        }
+        if (xipfs_index_movable(i, xipfs_index.dir[j].hash %
+                XIPFS_PATH_INDEX_SIZE, j)) {
+            xipfs_index.dir[i] = xipfs_index.dir[j];
+            i = j;
+        }
+    }
+    xipfs_index.dir[i].filp = NULL;
+    xipfs_index.dirs--;
+}
+
+/**
+ * @internal
+ *
+ * @brief Drops the content of the index, which is then no
+ * longer used until it is rebuilt
+ *
+ * @param retry Non-zero if a rebuild may succeed
+ */
+static void
+xipfs_index_drop(int retry)
+{
+    xipfs_index.valid = 0;
+    xipfs_index.retry = retry;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure whose header is already in flash
+ *
+ * @brief Adds a file to the index
+ *
+ * The index is dropped if one of its tables is full, the file
+ * system is then scanned again until the index can be rebuilt
+ *
+ * @param filp A pointer to the xipfs file structure to add
+ */
+void
+xipfs_index_add(xipfs_file_t *filp)
+{
+    char buf[XIPFS_PATH_MAX];
+    const char *path;
+    size_t i, k, len;
+    uint32_t hash;
+
+    if (xipfs_index.valid == 0 || xipfs_index_in(filp) == 0) {
+        return;
+    }
+    path = xipfs_dirtab_path(filp, buf);
+    len = strnlen(path, XIPFS_PATH_MAX);
+    hash = xipfs_index_hash(path, len);
+    i = xipfs_index_file_slot(path, len, hash);
+    if (xipfs_index.file[i].filp != NULL ||
+        xipfs_index.files == XIPFS_INDEX_LOAD_MAX) {
+        /* duplicated path or full table */
+        xipfs_index_drop(0);
+        return;
+    }
+    xipfs_index.file[i].filp = filp;
+    xipfs_index.file[i].hash = hash;
+    xipfs_index.files++;
+
+    /* account the file in each directory of its path */
+    for (k = 1; k < len; k++) {
+        if (path[k] != '/') {
+            continue;
+        }
+        hash = xipfs_index_hash(path, k + 1);
+        i = xipfs_index_dir_slot(path, k + 1, hash);
+        if (xipfs_index.dir[i].filp == NULL) {
+            if (xipfs_index.dirs == XIPFS_INDEX_LOAD_MAX) {
+                xipfs_index_drop(0);
+                return;
+            }
+            xipfs_index.dir[i].filp = filp;
+            xipfs_index.dir[i].hash = hash;
+            xipfs_index.dir[i].count = 0;
+            xipfs_index.dir[i].len = (uint8_t)(k + 1);
+            xipfs_index.dirs++;
+        } else if ((uintptr_t)filp < (uintptr_t)xipfs_index.dir[i].filp) {
+            xipfs_index.dir[i].filp = filp;
+        }
+        xipfs_index.dir[i].count++;
+    }
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure whose header is still in flash
+ *
+ * @brief Removes a file from the index
+ *
+ * @param filp A pointer to the xipfs file structure to remove
+ */
+void
+xipfs_index_remove(xipfs_file_t *filp)
+{
+    char buf[XIPFS_PATH_MAX], other[XIPFS_PATH_MAX];
+    xipfs_file_t *first;
+    size_t i, j, k, len;
+    const char *path;
+
+    if (xipfs_index_in(filp) == 0) {
+        return;
+    }
+    if (xipfs_index.valid == 0) {
+        /* the files left may now fit in the index */
+        xipfs_index.retry = 1;
+        return;
+    }
+    path = xipfs_dirtab_path(filp, buf);
+    len = strnlen(path, XIPFS_PATH_MAX);
+    i = xipfs_index_file_slot(path, len, xipfs_index_hash(path, len));
+    if (xipfs_index.file[i].filp != filp) {
+        xipfs_index_drop(1);
+        return;
+    }
+    xipfs_index_file_delete(i);
+
+    for (k = 1; k < len; k++) {
+        if (path[k] != '/') {
+            continue;
+        }
+        i = xipfs_index_dir_slot(path, k + 1,
+            xipfs_index_hash(path, k + 1));
+        if (xipfs_index.dir[i].filp == NULL) {
+            xipfs_index_drop(1);
+            return;
+        }
+        if (--xipfs_index.dir[i].count == 0) {
+            xipfs_index_dir_delete(i);
+            continue;
+        }
+        if (xipfs_index.dir[i].filp != filp) {
+            continue;
+        }
+        /* elect the next first file of the directory */
+        first = NULL;
+        for (j = 0; j < XIPFS_PATH_INDEX_SIZE; j++) {
+            if (xipfs_index.file[j].filp != NULL &&
+                strncmp(xipfs_dirtab_path(xipfs_index.file[j].filp, other),
+                    path, k + 1) == 0 &&
+                (first == NULL ||
+                 (uintptr_t)xipfs_index.file[j].filp < (uintptr_t)first)) {
+                first = xipfs_index.file[j].filp;
+            }
+        }
+        if (first == NULL) {
+            xipfs_index_drop(1);
+            return;
+        }
+        xipfs_index.dir[i].filp = first;
+    }
+}
+
+/**
+ * @brief Updates the index after a file was moved over the
+ * removed files right before it, which keeps the order of the
+ * files and thus the first file of each directory
+ *
+ * @param from The former address of the moved file
+ *
+ * @param to The new address of the moved file
+ */
+void
+xipfs_index_move(xipfs_file_t *from, xipfs_file_t *to)
+{
+    size_t i;
+
+    if (xipfs_index.valid == 0 || xipfs_index_in(from) == 0) {
+        return;
+    }
+    for (i = 0; i < XIPFS_PATH_INDEX_SIZE; i++) {
+        if (xipfs_index.file[i].filp == from) {
+            xipfs_index.file[i].filp = to;
+        }
+        if (xipfs_index.dir[i].filp == from) {
+            xipfs_index.dir[i].filp = to;
+        }
+    }
+}
+
+/**
+ * @brief Updates the index after a file was removed and the
+ * files following it were moved back by its reserved size
+ *
+ * @param removed The address of the removed file
+ *
+ * @param reserved The reserved size of the removed file
+ */
+void
+xipfs_index_shift(xipfs_file_t *removed, xipfs_file_position_t reserved)
+{
+    size_t i;
+
+    if (xipfs_index.valid == 0 || xipfs_index_in(removed) == 0) {
+        return;
+    }
+    for (i = 0; i < XIPFS_PATH_INDEX_SIZE; i++) {
+        if ((uintptr_t)xipfs_index.file[i].filp > (uintptr_t)removed) {
+            xipfs_index.file[i].filp = (xipfs_file_t *)
+                ((uintptr_t)xipfs_index.file[i].filp - reserved);
+        }
+        if ((uintptr_t)xipfs_index.dir[i].filp > (uintptr_t)removed) {
+            xipfs_index.dir[i].filp = (xipfs_file_t *)
+                ((uintptr_t)xipfs_index.dir[i].filp - reserved);
+        }
+    }
+}
+
+/**
+ * @pre mp must be a pointer that references a memory region
+ * containing an xipfs mount point structure which is accessible
+ * and valid
+ *
+ * @brief Binds the index to a mount point and fills it by
+ * scanning the file system
+ *
+ * @param mp A pointer to a memory region containing an xipfs
+ * mount point structure
+ *
+ * @return Returns zero if the index can be used or a negative
+ * value if the file system has to be scanned instead
+ */
+int
+xipfs_index_build(xipfs_mount_t *mp)
+{
+    xipfs_file_t *filp;
+
+    assert(mp != NULL);
+
+    (void)memset(&xipfs_index, 0, sizeof(xipfs_index));
+    xipfs_index.mp = mp;
+    xipfs_index.start = (uintptr_t)mp->page_addr;
+    xipfs_index.end = xipfs_index.start +
+        mp->page_num * XIPFS_NVM_PAGE_SIZE;
+    xipfs_index.valid = 1;
+
+    xipfs_errno = XIPFS_OK;
+    filp = xipfs_fs_head(mp);
+    while (filp != NULL && xipfs_index.valid == 1) {
+        xipfs_index_add(filp);
+        filp = xipfs_fs_next(filp);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        xipfs_index_drop(0);
+    }
+
+    return (xipfs_index.valid == 1) ? 0 : -1;
+}
+
+/**
+ * @brief Drops the index if the address belongs to the mount
+ * point it is bound to, it is rebuilt on next use
+ *
+ * @param addr An address in the NVM
+ */
+void
+xipfs_index_invalidate(const void *addr)
+{
+    if (xipfs_index_in(addr)) {
+        xipfs_index_drop(1);
+    }
+}
+
+/**
+ * @brief Checks whether the index can be used to look up paths
+ * of a mount point, rebuilding it if needed
+ *
+ * @param mp A pointer to a memory region containing an xipfs
+ * mount point structure
+ *
+ * @return Returns one if the index can be used or zero if the
+ * file system has to be scanned instead
+ */
+int
+xipfs_index_ready(xipfs_mount_t *mp)
+{
+    if (xipfs_index.mp != mp) {
+        return 0;
+    }
+    if (xipfs_index.valid == 0 && xipfs_index.retry == 1) {
+        (void)xipfs_index_build(mp);
+    }
+
+    return xipfs_index.valid;
+}
+
+/**
+ * @pre The index must be ready
+ *
+ * @brief Looks up a file by its path
+ *
+ * @param path A pointer to a path
+ *
+ * @param len The number of characters of the path to look up
+ *
+ * @return Returns a pointer to the xipfs file structure or NULL
+ * if no file has this path
+ */
+xipfs_file_t *
+xipfs_index_file(const char *path, size_t len)
+{
+    size_t i;
+
+    i = xipfs_index_file_slot(path, len, xipfs_index_hash(path, len));
+
+    return xipfs_index.file[i].filp;
+}
+
+/**
+ * @pre The index must be ready
+ *
+ * @brief Looks up a directory by its path
+ *
+ * @param path A pointer to a path
+ *
+ * @param len The number of characters of the path of the
+ * directory, including its trailing slash
+ *
+ * @param count A pointer to a memory region where to store the
+ * number of files whose path starts with the path of the
+ * directory
+ *
+ * @return Returns a pointer to the first of these files in file
+ * system order or NULL if the directory does not exist
+ */
+xipfs_file_t *
+xipfs_index_dir(const char *path, size_t len, size_t *count)
+{
+    size_t i;
+
+    i = xipfs_index_dir_slot(path, len, xipfs_index_hash(path, len));
+    *count = (xipfs_index.dir[i].filp != NULL) ?
+        xipfs_index.dir[i].count : 0;
+
+    return xipfs_index.dir[i].filp;
+}
+
+#else /* XIPFS_PATH_INDEX_SIZE > 0 */
+
+void
+xipfs_index_add(xipfs_file_t *filp)
+{
+    (void)filp;
+}
+
+int
+xipfs_index_build(xipfs_mount_t *mp)
+{
+    (void)mp;
+
+    return -1;
+}
+
+xipfs_file_t *
+xipfs_index_dir(const char *path, size_t len, size_t *count)
+{
+    (void)path;
+    (void)len;
+    *count = 0;
+
+    return NULL;
+}
+
+xipfs_file_t *
+xipfs_index_file(const char *path, size_t len)
+{
+    (void)path;
+    (void)len;
+
+    return NULL;
+}
+
+void
+xipfs_index_invalidate(const void *addr)
+{
+    (void)addr;
+}
+
+void
+xipfs_index_move(xipfs_file_t *from, xipfs_file_t *to)
+{
+    (void)from;
+    (void)to;
+}
+
+int
+xipfs_index_ready(xipfs_mount_t *mp)
+{
+    (void)mp;
+
+    return 0;
+}
+
+void
+xipfs_index_remove(xipfs_file_t *filp)
+{
+    (void)filp;
+}
+
+void
+xipfs_index_shift(xipfs_file_t *removed, xipfs_file_position_t reserved)
+{
+    (void)removed;
+    (void)reserved;
+}
+
+#endif /* XIPFS_PATH_INDEX_SIZE > 0 */
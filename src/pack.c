@@ -0,0 +1,923 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * libc includes
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * xipfs includes
+ */
+#include "include/xipfs.h"
+#include "include/buffer.h"
+#include "include/desc.h"
+#include "include/dirtab.h"
+#include "include/errno.h"
+#include "include/file.h"
+#include "include/flash.h"
+#include "include/fs.h"
+#include "include/pack.h"
+#include "include/path.h"
+
+#if XIPFS_PACKED_FILE_MAX > 0
+
+/**
+ * @internal
+ *
+ * @def ROUND
+ *
+ * @brief Round x to the next power of two y
+ *
+ * @param x The number to round to the next power of two y
+ *
+ * @param y The power of two with which to round x
+ */
+#define ROUND(x, y) (((x) + (y) - 1) & ~((y) - 1))
+
+/**
+ * @internal
+ *
+ * @def XIPFS_PACK_LIVE
+ *
+ * @brief The state of a record once it is whole
+ */
+#define XIPFS_PACK_LIVE (0x0f)
+
+/**
+ * @internal
+ *
+ * @def XIPFS_PACK_DEAD
+ *
+ * @brief The state of a record once its packed file is removed
+ */
+#define XIPFS_PACK_DEAD (0x00)
+
+/**
+ * @internal
+ *
+ * @def XIPFS_PACK_LOG_SIZE
+ *
+ * @brief The number of bytes of a file available for records
+ *
+ * @param filp A pointer to the file
+ */
+#define XIPFS_PACK_LOG_SIZE(filp) \
+    ((size_t)(filp)->reserved - sizeof(xipfs_file_t))
+
+/**
+ * @internal
+ *
+ * @def XIPFS_PACK_RECORD_SIZE
+ *
+ * @brief The size of a record holding a packed file of size
+ * bytes named with len characters
+ *
+ * @param len The length of the name
+ *
+ * @param size The size of the packed file
+ */
+#define XIPFS_PACK_RECORD_SIZE(len, size) \
+    (sizeof(xipfs_pack_record_t) + \
+     ROUND((size_t)(len), sizeof(uint32_t)) + \
+     ROUND((size_t)(size), sizeof(uint32_t)))
+
+/**
+ * @internal
+ *
+ * @brief A record of a packed file in the file that marks its
+ * directory, followed by the name of the packed file and by its
+ * data, both padded to a 32-bit boundary. The records are
+ * appended to the file, an erased word follows the last one
+ */
+typedef struct xipfs_pack_record_s {
+    /**
+     * The size of the packed file
+     */
+    uint16_t size;
+    /**
+     * The length of the name
+     */
+    uint8_t len;
+    /**
+     * Erased until the record is whole, XIPFS_PACK_LIVE then
+     * and XIPFS_PACK_DEAD once the packed file is removed
+     */
+    uint8_t state;
+} xipfs_pack_record_t;
+
+/*
+ * Helper functions
+ */
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure whose pages are not buffered
+ *
+ * @brief Retrieves the record at a position of a file
+ *
+ * @param filp A pointer to the file that marks a directory
+ *
+ * @param off The position of the record
+ *
+ * @return Returns a pointer to the record or NULL if the
+ * records end before this position
+ */
+static const xipfs_pack_record_t *
+xipfs_pack_record(const xipfs_file_t *filp, size_t off)
+{
+    const xipfs_pack_record_t *record;
+    size_t size;
+
+    if (off + sizeof(*record) > XIPFS_PACK_LOG_SIZE(filp)) {
+        return NULL;
+    }
+    record = (const xipfs_pack_record_t *)(filp->buf + off);
+    if (*(const uint32_t *)record == (uint32_t)XIPFS_FLASH_ERASE_STATE) {
+        return NULL;
+    }
+    size = XIPFS_PACK_RECORD_SIZE(record->len, record->size);
+    if (record->len == 0 || record->len >= XIPFS_PATH_MAX ||
+        record->size > XIPFS_PACKED_FILE_MAX ||
+        off + size > XIPFS_PACK_LOG_SIZE(filp)) {
+        return NULL;
+    }
+
+    return record;
+}
+
+/**
+ * @internal
+ *
+ * @brief Returns the size of a record
+ *
+ * @param record A pointer to the record
+ */
+static size_t
+xipfs_pack_record_size(const xipfs_pack_record_t *record)
+{
+    return XIPFS_PACK_RECORD_SIZE(record->len, record->size);
+}
+
+/**
+ * @internal
+ *
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure whose pages are not buffered
+ *
+ * @brief Retrieves the position past the last record of a file
+ *
+ * @param filp A pointer to the file that marks a directory
+ *
+ * @return Returns the position where the next record goes, the
+ * size of the log if an interrupted record ends it, so that the
+ * records are copied to a new file before anything is appended
+ */
+static size_t
+xipfs_pack_end(const xipfs_file_t *filp)
+{
+    const xipfs_pack_record_t *record;
+    size_t off;
+
+    off = 0;
+    while ((record = xipfs_pack_record(filp, off)) != NULL) {
+        off += xipfs_pack_record_size(record);
+    }
+    if (off + sizeof(*record) <= XIPFS_PACK_LOG_SIZE(filp) &&
+        *(const uint32_t *)(filp->buf + off) !=
+            (uint32_t)XIPFS_FLASH_ERASE_STATE) {
+        return XIPFS_PACK_LOG_SIZE(filp);
+    }
+
+    return off;
+}
+
+/**
+ * @internal
+ *
+ * @brief Repacking function of xipfs_desc_repack, which gives
+ * the position of a record once the records of the file are
+ * copied without the removed ones
+ *
+ * @param packed The former position of the record
+ *
+ * @param arg A pointer to the former file
+ *
+ * @return Returns the new position of the record
+ */
+static xipfs_file_position_t
+xipfs_pack_shift(xipfs_file_position_t packed, void *arg)
+{
+    const xipfs_pack_record_t *record;
+    const xipfs_file_t *filp = arg;
+    size_t off, pos;
+
+    pos = 0;
+    off = 0;
+    while (off < (size_t)packed &&
+           (record = xipfs_pack_record(filp, off)) != NULL) {
+        if (record->state == XIPFS_PACK_LIVE) {
+            pos += xipfs_pack_record_size(record);
+        }
+        off += xipfs_pack_record_size(record);
+    }
+
+    return (xipfs_file_position_t)pos;
+}
+
+/**
+ * @internal
+ *
+ * @pre The file must have room for the record
+ *
+ * @brief Appends the record of a packed file to a file. The
+ * record only counts once it is whole
+ *
+ * @param filp A pointer to the file that marks the directory
+ *
+ * @param off The position of the record
+ *
+ * @param name A pointer to the name of the packed file
+ *
+ * @param len The length of the name
+ *
+ * @param data A pointer to the data of the packed file
+ *
+ * @param size The size of the packed file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_pack_append(xipfs_file_t *filp, size_t off, const char *name,
+                  size_t len, const void *data, size_t size)
+{
+    const uint32_t erased = (uint32_t)XIPFS_FLASH_ERASE_STATE;
+    const uint8_t live = XIPFS_PACK_LIVE;
+    struct {
+        xipfs_pack_record_t record;
+        char name[XIPFS_PATH_MAX + sizeof(uint32_t)];
+    } buf;
+    size_t head;
+
+    assert(off + XIPFS_PACK_RECORD_SIZE(len, size) <=
+        XIPFS_PACK_LOG_SIZE(filp));
+
+    (void)memset(&buf, XIPFS_NVM_ERASE_STATE, sizeof(buf));
+    buf.record.size = (uint16_t)size;
+    buf.record.len = (uint8_t)len;
+    (void)memcpy(buf.name, name, len);
+    head = sizeof(buf.record) + ROUND(len, sizeof(uint32_t));
+
+    if (xipfs_file_write(filp, (xipfs_file_position_t)off, &buf,
+            head) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    off += head;
+    if (size > 0 && xipfs_file_write(filp, (xipfs_file_position_t)off,
+            data, size) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    off += ROUND(size, sizeof(uint32_t));
+    /* the records end with an erased word */
+    if (off + sizeof(erased) <= XIPFS_PACK_LOG_SIZE(filp) &&
+        xipfs_file_write(filp, (xipfs_file_position_t)off, &erased,
+            sizeof(erased)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    off -= XIPFS_PACK_RECORD_SIZE(len, size);
+    if (xipfs_file_write(filp, (xipfs_file_position_t)(off +
+            offsetof(xipfs_pack_record_t, state)), &live,
+            sizeof(live)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return xipfs_buffer_flush();
+}
+
+/**
+ * @internal
+ *
+ * @brief Retrieves the first file that marks a directory
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param dirname A pointer to the path of the directory
+ *
+ * @return Returns a pointer to the file or NULL otherwise
+ */
+static xipfs_file_t *
+xipfs_pack_dir(xipfs_mount_t *mp, const char *dirname)
+{
+    xipfs_file_t *filp;
+
+    xipfs_errno = XIPFS_OK;
+    filp = xipfs_fs_head(mp);
+    while (filp != NULL) {
+        if (xipfs_dirtab_is(filp, dirname)) {
+            return filp;
+        }
+        filp = xipfs_fs_next(filp);
+    }
+    if (xipfs_errno == XIPFS_OK) {
+        xipfs_errno = XIPFS_ELINK;
+    }
+
+    return NULL;
+}
+
+/*
+ * Extern functions
+ */
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @brief Counts the packed files of the directory a file marks
+ *
+ * @param filp A pointer to the file that marks the directory
+ *
+ * @return Returns the number of packed files
+ */
+int
+xipfs_pack_count(const xipfs_file_t *filp)
+{
+    const xipfs_pack_record_t *record;
+    size_t off;
+    int count;
+
+    assert(filp != NULL);
+
+    count = 0;
+    off = 0;
+    while ((record = xipfs_pack_record(filp, off)) != NULL) {
+        if (record->state == XIPFS_PACK_LIVE) {
+            count++;
+        }
+        off += xipfs_pack_record_size(record);
+    }
+
+    return count;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre packed must be the position of a packed file of filp
+ *
+ * @brief Retrieves the data of a packed file, which is read in
+ * place
+ *
+ * @param filp A pointer to the file that marks the directory
+ *
+ * @param packed The position of the packed file
+ *
+ * @param size A pointer where to store the size of the packed
+ * file
+ *
+ * @return Returns a pointer to the data of the packed file
+ */
+const void *
+xipfs_pack_data(const xipfs_file_t *filp, xipfs_file_position_t packed,
+                size_t *size)
+{
+    const xipfs_pack_record_t *record;
+
+    assert(filp != NULL);
+    assert(packed >= 0);
+    assert(size != NULL);
+
+    record = (const xipfs_pack_record_t *)(filp->buf + packed);
+    *size = record->size;
+
+    return (const char *)(record + 1) +
+        ROUND((size_t)record->len, sizeof(uint32_t));
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre name must be a pointer that references a null-terminated
+ * string
+ *
+ * @brief Looks a packed file up by name
+ *
+ * @param filp A pointer to the file that marks the directory
+ *
+ * @param name A pointer to the name of the packed file
+ *
+ * @return Returns the position of the packed file or a negative
+ * value if there is none
+ */
+xipfs_file_position_t
+xipfs_pack_find(const xipfs_file_t *filp, const char *name)
+{
+    const xipfs_pack_record_t *record;
+    size_t off, len;
+
+    assert(filp != NULL);
+    assert(name != NULL);
+
+    len = strnlen(name, XIPFS_PATH_MAX);
+    off = 0;
+    while ((record = xipfs_pack_record(filp, off)) != NULL) {
+        if (record->state == XIPFS_PACK_LIVE && record->len == len &&
+            memcmp(record + 1, name, len) == 0) {
+            return (xipfs_file_position_t)off;
+        }
+        off += xipfs_pack_record_size(record);
+    }
+
+    return -1;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre from and to must be pointers that reference paths of
+ * directories, ending with a slash
+ *
+ * @brief Checks whether the paths of the packed files below a
+ * directory stay shorter than XIPFS_PATH_MAX once it is renamed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param from A pointer to the path of the directory
+ *
+ * @param to A pointer to the new path of the directory
+ *
+ * @return Returns zero if the paths fit or a negative value
+ * otherwise
+ */
+int
+xipfs_pack_fit(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    const xipfs_pack_record_t *record;
+    size_t from_len, to_len, len, off;
+    char buf[XIPFS_PATH_MAX];
+    xipfs_file_t *filp;
+    const char *path;
+
+    assert(from != NULL);
+    assert(to != NULL);
+
+    from_len = strnlen(from, XIPFS_PATH_MAX);
+    to_len = strnlen(to, XIPFS_PATH_MAX);
+
+    xipfs_errno = XIPFS_OK;
+    filp = xipfs_fs_head(mp);
+    while (filp != NULL) {
+        path = xipfs_dirtab_path(filp, buf);
+        len = strnlen(path, XIPFS_PATH_MAX);
+        if (len >= from_len && path[len-1] == '/' &&
+            strncmp(path, from, from_len) == 0) {
+            off = 0;
+            while ((record = xipfs_pack_record(filp, off)) != NULL) {
+                if (record->state == XIPFS_PACK_LIVE &&
+                    to_len + len - from_len + record->len >=
+                        XIPFS_PATH_MAX) {
+                    xipfs_errno = XIPFS_ENULTER;
+                    return -1;
+                }
+                off += xipfs_pack_record_size(record);
+            }
+        }
+        filp = xipfs_fs_next(filp);
+    }
+    if (xipfs_errno != XIPFS_OK) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @pre filp must be a pointer to an accessible and valid xipfs
+ * file structure
+ *
+ * @pre name must be a pointer that references an accessible
+ * memory region of XIPFS_PATH_MAX bytes
+ *
+ * @brief Lists the packed files of a directory
+ *
+ * @param filp A pointer to the file that marks the directory
+ *
+ * @param pos The position where to look for the next packed
+ * file, zero for the first one
+ *
+ * @param name A pointer where to copy the name of the packed
+ * file
+ *
+ * @return Returns the position past the packed file found, to
+ * pass to the next call, or zero if there is none
+ */
+xipfs_file_position_t
+xipfs_pack_list(const xipfs_file_t *filp, xipfs_file_position_t pos,
+                char *name)
+{
+    const xipfs_pack_record_t *record;
+    size_t off;
+
+    assert(filp != NULL);
+    assert(pos >= 0);
+    assert(name != NULL);
+
+    off = (size_t)pos;
+    while ((record = xipfs_pack_record(filp, off)) != NULL) {
+        off += xipfs_pack_record_size(record);
+        if (record->state == XIPFS_PACK_LIVE) {
+            (void)memcpy(name, record + 1, record->len);
+            name[record->len] = '\0';
+            return (xipfs_file_position_t)off;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre from must be the path of a packed file and to the path
+ * of a file that can be created
+ *
+ * @brief Moves a packed file to another path. The file stays
+ * packed unless its new directory is the root, which holds no
+ * packed file
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param from A pointer to the path of the packed file
+ *
+ * @param to A pointer to the new path of the file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_pack_move(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    uint32_t data[ROUND(XIPFS_PACKED_FILE_MAX, sizeof(uint32_t)) /
+        sizeof(uint32_t)];
+    xipfs_path_t xipath;
+    xipfs_file_t *filp;
+    const void *src;
+    size_t size;
+
+    assert(from != NULL);
+    assert(to != NULL);
+
+    /* the data is copied first, since creating the file may run
+     * the garbage collection, which moves the files */
+    if (xipfs_path_new(mp, &xipath, from) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    assert(xipath.packed >= 0);
+    src = xipfs_pack_data(xipath.witness, xipath.packed, &size);
+    (void)memcpy(data, src, size);
+
+    if (xipfs_path_new(mp, &xipath, to) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipath.last_slash == 0) {
+        if ((filp = xipfs_fs_new_file(mp, to, (xipfs_file_position_t)size,
+                0)) == NULL) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (xipfs_file_write(filp, 0, data, size) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        if (xipfs_file_set_size(filp, (xipfs_file_position_t)size) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+    } else if (xipfs_pack_new(mp, xipath.dir, to, data, size) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    if (xipfs_path_new(mp, &xipath, from) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    assert(xipath.packed >= 0);
+
+    return xipfs_pack_remove(mp, xipath.witness, xipath.packed);
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre path must be the path of a file that can be created,
+ * outside of the root directory
+ *
+ * @brief Creates a packed file. Its record is appended to the
+ * file that marks its directory, or the live records are copied
+ * to a new file that fits them all, the former one being
+ * removed
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param dirp A pointer to the file that marks the directory,
+ * NULL if there is none
+ *
+ * @param path A pointer to the path of the packed file
+ *
+ * @param data A pointer to the data of the packed file, which
+ * must not belong to the file system
+ *
+ * @param size The size of the packed file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_pack_new(xipfs_mount_t *mp, xipfs_file_t *dirp, const char *path,
+               const void *data, size_t size)
+{
+    const xipfs_pack_record_t *record;
+    char dirname[XIPFS_PATH_MAX];
+    size_t len, need, live, off, pos;
+    const char *name;
+    xipfs_file_t *newp;
+
+    assert(path != NULL);
+    assert(data != NULL || size == 0);
+
+    if (size > XIPFS_PACKED_FILE_MAX) {
+        xipfs_errno = XIPFS_EINVALIDSIZE;
+        return -1;
+    }
+    name = strrchr(path, '/');
+    assert(name != NULL && name != path);
+    name++;
+    len = strnlen(name, XIPFS_PATH_MAX);
+    (void)memcpy(dirname, path, (size_t)(name - path));
+    dirname[name - path] = '\0';
+
+    need = XIPFS_PACK_RECORD_SIZE(len, size);
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (dirp != NULL) {
+        off = xipfs_pack_end(dirp);
+        if (off + need <= XIPFS_PACK_LOG_SIZE(dirp)) {
+            return xipfs_pack_append(dirp, off, name, len, data, size);
+        }
+    }
+
+    /* the live records and the new one are copied to a new
+     * file, the former one is only removed afterwards */
+    live = 0;
+    if (dirp != NULL) {
+        off = 0;
+        while ((record = xipfs_pack_record(dirp, off)) != NULL) {
+            if (record->state == XIPFS_PACK_LIVE) {
+                live += xipfs_pack_record_size(record);
+            }
+            off += xipfs_pack_record_size(record);
+        }
+    }
+    if ((newp = xipfs_fs_new_file(mp, dirname,
+            (xipfs_file_position_t)(live + need), 0)) == NULL) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (dirp != NULL) {
+        /* the garbage collection may have moved the former file,
+         * which comes before the new one */
+        if ((dirp = xipfs_pack_dir(mp, dirname)) == NULL) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        assert(dirp != newp);
+    }
+
+    pos = 0;
+    if (dirp != NULL) {
+        off = 0;
+        while ((record = xipfs_pack_record(dirp, off)) != NULL) {
+            if (record->state == XIPFS_PACK_LIVE) {
+                if (xipfs_file_write(newp, (xipfs_file_position_t)pos,
+                        record, xipfs_pack_record_size(record)) < 0) {
+                    /* xipfs_errno was set */
+                    return -1;
+                }
+                pos += xipfs_pack_record_size(record);
+            }
+            off += xipfs_pack_record_size(record);
+        }
+    }
+    if (xipfs_pack_append(newp, pos, name, len, data, size) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (dirp == NULL) {
+        return 0;
+    }
+
+    (void)xipfs_desc_repack(mp, dirp, newp, xipfs_pack_shift, dirp);
+
+    return xipfs_fs_remove(mp, dirp);
+}
+
+/**
+ * @pre xipfs_mp must be a pointer that references a memory
+ * region containing an xipfs mount point structure which is
+ * accessible and valid
+ *
+ * @pre packed must be the position of a packed file of dirp
+ *
+ * @brief Removes a packed file by clearing the state of its
+ * record, and closes the open descriptors that refer to it
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param dirp A pointer to the file that marks the directory
+ *
+ * @param packed The position of the packed file
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+int
+xipfs_pack_remove(xipfs_mount_t *mp, xipfs_file_t *dirp,
+                  xipfs_file_position_t packed)
+{
+    const uint8_t dead = XIPFS_PACK_DEAD;
+
+    assert(dirp != NULL);
+    assert(packed >= 0);
+
+    if (xipfs_file_write(dirp, packed + (xipfs_file_position_t)
+            offsetof(xipfs_pack_record_t, state), &dead,
+            sizeof(dead)) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_buffer_flush() < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    (void)xipfs_desc_unpack(mp, dirp, packed);
+
+    return 0;
+}
+
+#else /* XIPFS_PACKED_FILE_MAX > 0 */
+
+int
+xipfs_pack_count(const xipfs_file_t *filp)
+{
+    (void)filp;
+
+    return 0;
+}
+
+const void *
+xipfs_pack_data(const xipfs_file_t *filp, xipfs_file_position_t packed,
+                size_t *size)
+{
+    (void)filp;
+    (void)packed;
+
+    *size = 0;
+
+    return NULL;
+}
+
+xipfs_file_position_t
+xipfs_pack_find(const xipfs_file_t *filp, const char *name)
+{
+    (void)filp;
+    (void)name;
+
+    return -1;
+}
+
+int
+xipfs_pack_fit(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    (void)mp;
+    (void)from;
+    (void)to;
+
+    return 0;
+}
+
+xipfs_file_position_t
+xipfs_pack_list(const xipfs_file_t *filp, xipfs_file_position_t pos,
+                char *name)
+{
+    (void)filp;
+    (void)pos;
+    (void)name;
+
+    return 0;
+}
+
+int
+xipfs_pack_move(xipfs_mount_t *mp, const char *from, const char *to)
+{
+    (void)mp;
+    (void)from;
+    (void)to;
+
+    xipfs_errno = XIPFS_EPERM;
+
+    return -1;
+}
+
+int
+xipfs_pack_new(xipfs_mount_t *mp, xipfs_file_t *dirp, const char *path,
+               const void *data, size_t size)
+{
+    (void)mp;
+    (void)dirp;
+    (void)path;
+    (void)data;
+    (void)size;
+
+    xipfs_errno = XIPFS_EPERM;
+
+    return -1;
+}
+
+int
+xipfs_pack_remove(xipfs_mount_t *mp, xipfs_file_t *dirp,
+                  xipfs_file_position_t packed)
+{
+    (void)mp;
+    (void)dirp;
+    (void)packed;
+
+    xipfs_errno = XIPFS_EPERM;
+
+    return -1;
+}
+
+#endif /* XIPFS_PACKED_FILE_MAX > 0 */
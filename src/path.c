@@ -44,8 +44,12 @@
  * xipfs includes
  */
 #include "include/xipfs.h"
+#include "include/dirtab.h"
+#include "include/emptydir.h"
 #include "include/errno.h"
 #include "include/fs.h"
+#include "include/index.h"
+#include "include/pack.h"
 #include "include/path.h"
 
 /*
@@ -437,6 +441,7 @@ xipfs_path_init(xipfs_path_t *xipath, const char *path)
     assert(path != NULL);
 
     (void)memset(xipath, 0, sizeof(*xipath));
+    xipath->packed = -1;
 
     if (!(path[0] == '/' && path[1] == '\0')) {
         for (len = 0; path[len] != '\0'; len++) {
@@ -457,6 +462,286 @@ xipfs_path_init(xipfs_path_t *xipath, const char *path)
     xipfs_path_dirname(xipath);
 }
 
+/**
+ * @internal
+ *
+ * @pre The path index must be ready for the mount point
+ *
+ * @pre xipath must be a pointer to an xipfs path structure
+ * initialized by xipfs_path_init
+ *
+ * @brief Identifies the nature of an xipfs path using the path
+ * index instead of scanning the file system
+ *
+ * @param xipfs_mp A pointer to a memory region containing an
+ * xipfs mount point structure
+ *
+ * @param xipath A pointer to a memory region containing an
+ * xipfs path structure
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_path_lookup(xipfs_mount_t *xipfs_mp, xipfs_path_t *xipath)
+{
+    xipfs_file_t *filp, *first;
+    size_t i, len, count;
+    int ret;
+
+    assert(xipath != NULL);
+
+    if (xipath->last_slash == 0) {
+        if ((ret = xipfs_fs_file_count(xipfs_mp)) < 0) {
+            /* xipfs_errno was set */
+            return -1;
+        }
+        xipath->parent = (size_t)ret;
+    } else {
+        (void)xipfs_index_dir(xipath->path, xipath->last_slash+1,
+            &xipath->parent);
+        xipath->dir = xipfs_index_file(xipath->path,
+            xipath->last_slash+1);
+    }
+
+    if (xipath->path[0] == '/' && xipath->path[1] == '\0') {
+        if (xipath->parent > 0) {
+            xipath->info = XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR;
+            xipath->witness = xipfs_fs_head(xipfs_mp);
+        } else {
+            xipath->info = XIPFS_PATH_CREATABLE;
+            xipath->witness = NULL;
+        }
+        return 0;
+    }
+
+    /* one of the parents is a file */
+    for (i = 1; i < xipath->len-1; i++) {
+        if (xipath->path[i] == '/' &&
+            (filp = xipfs_index_file(xipath->path, i)) != NULL) {
+            xipath->info = XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS;
+            xipath->witness = filp;
+            return 0;
+        }
+    }
+
+    len = xipath->len;
+    if (xipath->path[len-1] != '/') {
+        if ((filp = xipfs_index_file(xipath->path, len)) != NULL) {
+            xipath->info = XIPFS_PATH_EXISTS_AS_FILE;
+            xipath->witness = filp;
+            return 0;
+        }
+        if (len < XIPFS_PATH_MAX-1) {
+            /* a directory is looked up with its trailing slash */
+            xipath->path[len++] = '/';
+            xipath->path[len  ] = '\0';
+        }
+    }
+    if (xipath->path[len-1] == '/' &&
+        (first = xipfs_index_dir(xipath->path, len, &count)) != NULL) {
+        xipath->len = len;
+        filp = xipfs_index_file(xipath->path, len);
+        if (filp != NULL && count == 1) {
+            xipath->info = XIPFS_PATH_EXISTS_AS_EMPTY_DIR;
+            xipath->witness = filp;
+        } else {
+            xipath->info = XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR;
+            xipath->witness = first;
+        }
+        return 0;
+    }
+    xipath->path[xipath->len] = '\0';
+
+    if (xipath->last_slash == 0) {
+        xipath->info = XIPFS_PATH_CREATABLE;
+        xipath->witness = NULL;
+        return 0;
+    }
+    if ((first = xipfs_index_dir(xipath->path, xipath->last_slash+1,
+            &count)) != NULL) {
+        /* the witness is the empty directory file, if any */
+        filp = xipfs_index_file(xipath->path, xipath->last_slash+1);
+        xipath->info = XIPFS_PATH_CREATABLE;
+        xipath->witness = (filp != NULL) ? filp : first;
+        return 0;
+    }
+    xipath->info = XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND;
+    xipath->witness = NULL;
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre xipath must be a pointer to an xipfs path structure
+ * whose type was identified
+ *
+ * @brief Refines the type of an xipfs path with the packed
+ * files of the directories, which the scan of the file
+ * structures does not see
+ *
+ * @param xipath A pointer to a memory region containing an
+ * xipfs path structure
+ */
+static void
+xipfs_path_packed(xipfs_path_t *xipath)
+{
+    xipfs_file_position_t packed;
+
+    assert(xipath != NULL);
+
+    switch (xipath->info) {
+    case XIPFS_PATH_CREATABLE:
+        if (xipath->dir == NULL || xipath->path[xipath->len-1] == '/') {
+            break;
+        }
+        if ((packed = xipfs_pack_find(xipath->dir,
+                xipath->basename)) >= 0) {
+            xipath->info = XIPFS_PATH_EXISTS_AS_FILE;
+            xipath->witness = xipath->dir;
+            xipath->packed = packed;
+        }
+        break;
+    case XIPFS_PATH_EXISTS_AS_EMPTY_DIR:
+        /* the witness marks the directory */
+        if (xipfs_pack_count(xipath->witness) > 0) {
+            xipath->info = XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @internal
+ *
+ * @pre xipath must be a pointer to an xipfs path structure
+ * initialized by xipfs_path_init
+ *
+ * @pre path must be the path of an existing file, or of an
+ * empty directory with its trailing slash
+ *
+ * @brief Refines the type of an xipfs path with a path that
+ * exists in the file system
+ *
+ * @param xipath A pointer to a memory region containing an
+ * xipfs path structure
+ *
+ * @param path The path that exists in the file system
+ *
+ * @param filp A pointer to the file that witnesses the path
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_path_visit(xipfs_path_t *xipath, const char *path,
+                 xipfs_file_t *filp)
+{
+    size_t i;
+
+    assert(xipath != NULL);
+    assert(path != NULL);
+
+    if (strncmp(xipath->path, path, xipath->last_slash+1) == 0) {
+        xipath->parent++;
+    }
+    if (xipath->info == XIPFS_PATH_EXISTS_AS_EMPTY_DIR) {
+        /* a directory that holds packed files may
+         * hold other files too */
+        if ((i = compare_paths(path, xipath->path))
+                == XIPFS_PATH_MAX) {
+            return -1;
+        }
+        if (exists_as_nonempty_dir(path, xipath->path, i)) {
+            xipath->info = XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR;
+            xipath->witness = filp;
+        }
+    } else if (xipath->info == XIPFS_PATH_UNDEFINED ||
+        xipath->info == XIPFS_PATH_CREATABLE) {
+        if ((i = compare_paths(path, xipath->path))
+                == XIPFS_PATH_MAX) {
+            return -1;
+        }
+        if (exists_as_file(path, xipath->path, i)) {
+            xipath->info = XIPFS_PATH_EXISTS_AS_FILE;
+            xipath->witness = filp;
+        } else if (exists_as_empty_dir(path, xipath->path, i)) {
+            if (xipath->path[xipath->len-1] != '/') {
+                if (xipath->len == XIPFS_PATH_MAX-1) {
+                    return -ENAMETOOLONG;
+                }
+                xipath->path[xipath->len++] = '/';
+                xipath->path[xipath->len  ] = '\0';
+            }
+            xipath->info = XIPFS_PATH_EXISTS_AS_EMPTY_DIR;
+            xipath->witness = filp;
+        } else if (exists_as_nonempty_dir(path, xipath->path, i)) {
+            if (xipath->path[xipath->len-1] != '/') {
+                if (xipath->len == XIPFS_PATH_MAX-1) {
+                    return -ENAMETOOLONG;
+                }
+                xipath->path[xipath->len++] = '/';
+                xipath->path[xipath->len  ] = '\0';
+            }
+            xipath->info = XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR;
+            xipath->witness = filp;
+        } else if (invalid_because_not_dirs(path, xipath->path, i)) {
+            xipath->info = XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS;
+            xipath->witness = filp;
+        } else if (creatable(path, xipath->path,
+                       xipath->last_slash+1)) {
+            xipath->info = XIPFS_PATH_CREATABLE;
+            xipath->witness = filp;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * @pre The log of the empty directories must be loaded
+ *
+ * @brief Refines the types of xipfs paths with the empty
+ * directories recorded in the log, which the scan of the file
+ * structures does not see
+ *
+ * @param xipaths A pointer to a list of xipfs path structures
+ *
+ * @param n The number of elements in xipaths
+ *
+ * @return Returns zero if the function succeeds or a negative
+ * value otherwise
+ */
+static int
+xipfs_path_empty_dirs(xipfs_path_t *xipaths, size_t n)
+{
+    char path[XIPFS_PATH_MAX];
+    xipfs_file_position_t pos;
+    xipfs_file_t *log;
+    size_t j;
+    int ret;
+
+    if ((log = xipfs_emptydir_witness()) == NULL) {
+        return 0;
+    }
+    pos = 0;
+    while ((pos = xipfs_emptydir_next(pos, path)) != 0) {
+        for (j = 0; j < n; j++) {
+            if ((ret = xipfs_path_visit(&xipaths[j], path, log)) < 0) {
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
 /*
  * Extern functions
  */
@@ -495,8 +780,11 @@ int
 xipfs_path_new_n(xipfs_mount_t *xipfs_mp, xipfs_path_t *xipaths,
                      const char **paths, size_t n)
 {
+    char buf[XIPFS_PATH_MAX];
     xipfs_file_t *filp;
-    size_t i, j;
+    const char *path;
+    size_t j;
+    int ret;
 
     assert(xipaths != NULL);
     assert(paths != NULL);
@@ -511,55 +799,59 @@ xipfs_path_new_n(xipfs_mount_t *xipfs_mp, xipfs_path_t *xipaths,
         xipfs_path_init(&xipaths[j], paths[j]);
     }
 
+    /* the paths of the files are read through the directory
+     * table */
+    if (xipfs_dirtab_load(xipfs_mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+    if (xipfs_emptydir_load(xipfs_mp) < 0) {
+        /* xipfs_errno was set */
+        return -1;
+    }
+
+    if (xipfs_index_ready(xipfs_mp)) {
+        for (j = 0; j < n; j++) {
+            if (xipfs_path_lookup(xipfs_mp, &xipaths[j]) < 0) {
+                /* xipfs_errno was set */
+                return -1;
+            }
+            /* the index does not hold the empty directories of
+             * the log */
+            if (xipaths[j].info == XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND) {
+                xipaths[j].info = XIPFS_PATH_UNDEFINED;
+            }
+        }
+        if ((ret = xipfs_path_empty_dirs(xipaths, n)) < 0) {
+            return ret;
+        }
+        for (j = 0; j < n; j++) {
+            if (xipaths[j].info == XIPFS_PATH_UNDEFINED) {
+                xipaths[j].info = XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND;
+                xipaths[j].witness = NULL;
+            }
+            xipfs_path_packed(&xipaths[j]);
+        }
+        return 0;
+    }
+
     xipfs_errno = XIPFS_OK;
     if ((filp = xipfs_fs_head(xipfs_mp)) != NULL) {
         /* one file at least */
         do {
+            path = xipfs_dirtab_path(filp, buf);
             for (j = 0; j < n; j++) {
-                if (strncmp(xipaths[j].path, filp->path,
-                        xipaths[j].last_slash) == 0) {
-                    xipaths[j].parent++;
+                /* the first file that marks the parent directory
+                 * holds its packed files */
+                if (xipaths[j].last_slash > 0 &&
+                    xipaths[j].dir == NULL &&
+                    strncmp(xipaths[j].path, path,
+                        xipaths[j].last_slash+1) == 0 &&
+                    path[xipaths[j].last_slash+1] == '\0') {
+                    xipaths[j].dir = filp;
                 }
-                if (xipaths[j].info == XIPFS_PATH_UNDEFINED ||
-                    xipaths[j].info == XIPFS_PATH_CREATABLE) {
-                    if ((i = compare_paths(filp->path, xipaths[j].path))
-                            == XIPFS_PATH_MAX) {
-                        return -1;
-                    }
-                    if (exists_as_file(filp->path, xipaths[j].path, i)) {
-                        xipaths[j].info = XIPFS_PATH_EXISTS_AS_FILE;
-                        xipaths[j].witness = filp;
-                    } else if (exists_as_empty_dir(filp->path,
-                                   xipaths[j].path, i)) {
-                        if (xipaths[j].path[xipaths[j].len-1] != '/') {
-                            if (xipaths[j].len == XIPFS_PATH_MAX-1) {
-                                return -ENAMETOOLONG;
-                            }
-                            xipaths[j].path[xipaths[j].len++] = '/';
-                            xipaths[j].path[xipaths[j].len  ] = '\0';
-                        }
-                        xipaths[j].info = XIPFS_PATH_EXISTS_AS_EMPTY_DIR;
-                        xipaths[j].witness = filp;
-                    } else if (exists_as_nonempty_dir(filp->path,
-                                   xipaths[j].path, i)) {
-                        if (xipaths[j].path[xipaths[j].len-1] != '/') {
-                            if (xipaths[j].len == XIPFS_PATH_MAX-1) {
-                                return -ENAMETOOLONG;
-                            }
-                            xipaths[j].path[xipaths[j].len++] = '/';
-                            xipaths[j].path[xipaths[j].len  ] = '\0';
-                        }
-                        xipaths[j].info = XIPFS_PATH_EXISTS_AS_NONEMPTY_DIR;
-                        xipaths[j].witness = filp;
-                    } else if (invalid_because_not_dirs(filp->path,
-                                   xipaths[j].path, i)) {
-                        xipaths[j].info = XIPFS_PATH_INVALID_BECAUSE_NOT_DIRS;
-                        xipaths[j].witness = filp;
-                    } else if (creatable(filp->path, xipaths[j].path,
-                                   xipaths[j].last_slash+1)) {
-                        xipaths[j].info = XIPFS_PATH_CREATABLE;
-                        xipaths[j].witness = filp;
-                    }
+                if ((ret = xipfs_path_visit(&xipaths[j], path, filp)) < 0) {
+                    return ret;
                 }
             }
         } while ((filp = xipfs_fs_next(filp)) != NULL);
@@ -572,9 +864,7 @@ xipfs_path_new_n(xipfs_mount_t *xipfs_mp, xipfs_path_t *xipaths,
          * invalid.
          */
         for (j = 0; j < n; j++) {
-            size_t last_slash = (xipaths[j].last_slash > 0) ?
-                xipaths[j].last_slash-1 : 0;
-            if (creatable("/", xipaths[j].path, last_slash)) {
+            if (xipaths[j].last_slash == 0) {
                 xipaths[j].info = XIPFS_PATH_CREATABLE;
                 xipaths[j].witness = NULL;
             }
@@ -586,6 +876,9 @@ xipfs_path_new_n(xipfs_mount_t *xipfs_mp, xipfs_path_t *xipaths,
          */
         return -1;
     }
+    if ((ret = xipfs_path_empty_dirs(xipaths, n)) < 0) {
+        return ret;
+    }
     /*
      * If the type of the path is still undefined upon reaching
      * this point. It means that one or more of its components,
@@ -596,6 +889,7 @@ xipfs_path_new_n(xipfs_mount_t *xipfs_mp, xipfs_path_t *xipaths,
             xipaths[j].info = XIPFS_PATH_INVALID_BECAUSE_NOT_FOUND;
             xipaths[j].witness = NULL;
         }
+        xipfs_path_packed(&xipaths[j]);
     }
 
     return 0;
@@ -0,0 +1,159 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Cost of copying a six page file, through RAM one byte or 256
+ * bytes at a time, or flash to flash with xipfs_copy
+ */
+
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+
+/**
+ * @internal
+ *
+ * @def BENCH_SIZE
+ *
+ * @brief The size of the file copied, which fills six pages
+ */
+#define BENCH_SIZE (6 * FLASHPAGE_SIZE - sizeof(xipfs_file_t))
+
+/**
+ * @internal
+ *
+ * @def BENCH_CHUNK
+ *
+ * @brief The size of the chunks of the RAM copy
+ */
+#define BENCH_CHUNK 256
+
+static unsigned char data[BENCH_SIZE], out[BENCH_SIZE];
+
+/**
+ * @internal
+ *
+ * @brief Copies a file through RAM with chunks of a given size
+ *
+ * @param mp The mount point
+ *
+ * @param from The path of the file to copy
+ *
+ * @param to The path of the copy
+ *
+ * @param chunk The size of the chunks
+ */
+static void
+copy_ram(xipfs_mount_t *mp, const char *from, const char *to,
+         size_t chunk)
+{
+    unsigned char buf[BENCH_CHUNK];
+    xipfs_file_desc_t src, dst;
+    size_t i, n;
+
+    CHECK_EQ(xipfs_new_file(mp, to, sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(mp, &src, from, O_RDONLY, 0), 0);
+    CHECK_EQ(xipfs_open(mp, &dst, to, O_WRONLY, 0), 0);
+    /* reading past the end of a file fails */
+    for (i = 0; i < sizeof(data); i += n) {
+        n = (sizeof(data) - i < chunk) ? sizeof(data) - i : chunk;
+        CHECK_EQ(xipfs_read(mp, &src, buf, n), n);
+        CHECK_EQ(xipfs_write(mp, &dst, buf, n), n);
+    }
+    CHECK_EQ(xipfs_close(mp, &dst), 0);
+    CHECK_EQ(xipfs_close(mp, &src), 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks that a copy holds the bytes of the original
+ *
+ * @param mp The mount point
+ *
+ * @param path The path of the copy
+ */
+static void
+check(xipfs_mount_t *mp, const char *path)
+{
+    xipfs_file_desc_t desc;
+
+    CHECK_EQ(xipfs_open(mp, &desc, path, O_RDONLY, 0), 0);
+    CHECK_EQ(xipfs_read(mp, &desc, out, sizeof(out)), sizeof(out));
+    CHECK_EQ(xipfs_close(mp, &desc), 0);
+    CHECK(memcmp(out, data, sizeof(out)) == 0);
+}
+
+int
+main(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    double t0, t1;
+
+    host_nvm_init(0);
+    host_fill(data, sizeof(data), 6);
+    host_mount(&mp, 0, FLASHPAGE_NUMOF);
+    CHECK_EQ(xipfs_new_file(&mp, "/bin", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/bin", O_WRONLY, 0), 0);
+    CHECK_EQ(xipfs_write(&mp, &desc, data, sizeof(data)), sizeof(data));
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+
+    host_nvm_reset();
+    t0 = host_now();
+    copy_ram(&mp, "/bin", "/bin.1", 1);
+    t1 = host_now();
+    printf("1 byte copy loop:   %7.0f us, %lu erases, %5lu words\n",
+           (t1 - t0) * 1e6, host_nvm_erases, host_nvm_words);
+    check(&mp, "/bin.1");
+
+    host_nvm_reset();
+    t0 = host_now();
+    copy_ram(&mp, "/bin", "/bin.2", BENCH_CHUNK);
+    t1 = host_now();
+    printf("%u byte copy loop: %7.0f us, %lu erases, %5lu words\n",
+           BENCH_CHUNK, (t1 - t0) * 1e6, host_nvm_erases, host_nvm_words);
+    check(&mp, "/bin.2");
+
+    host_nvm_reset();
+    t0 = host_now();
+    CHECK_EQ(xipfs_copy(&mp, "/bin", "/bin.3"), 0);
+    t1 = host_now();
+    printf("xipfs_copy:         %7.0f us, %lu erases, %5lu words\n",
+           (t1 - t0) * 1e6, host_nvm_erases, host_nvm_words);
+    check(&mp, "/bin.3");
+
+    return 0;
+}
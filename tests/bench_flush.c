@@ -0,0 +1,113 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Flash cost of writes flushed through the I/O buffer: small
+ * appends each followed by fsync, then a sequential write into
+ * a fresh file
+ */
+
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+
+static unsigned char data[64 * 1024];
+
+/**
+ * @internal
+ *
+ * @brief Appends 64 records of 64 bytes to a file, each followed
+ * by fsync, and prints the flash cost
+ *
+ * @param mp The mount point to write to
+ */
+static void
+bench_append(xipfs_mount_t *mp)
+{
+    xipfs_file_desc_t desc;
+    int i;
+
+    host_mount(mp, 0, FLASHPAGE_NUMOF);
+    CHECK_EQ(xipfs_new_file(mp, "/log", 16384, 0), 0);
+    CHECK_EQ(xipfs_open(mp, &desc, "/log", O_WRONLY, 0), 0);
+    host_nvm_reset();
+    for (i = 0; i < 64; i++) {
+        CHECK_EQ(xipfs_write(mp, &desc, &data[i * 64], 64), 64);
+        CHECK_EQ(xipfs_fsync(mp, &desc, (i + 1) * 64), 0);
+    }
+    CHECK_EQ(xipfs_close(mp, &desc), 0);
+    printf("64 appends of 64 bytes with fsync: %4lu erases, "
+           "%6lu words\n", host_nvm_erases, host_nvm_words);
+}
+
+/**
+ * @internal
+ *
+ * @brief Writes 64 KiB in chunks of a page into a fresh file and
+ * prints the flash cost
+ *
+ * @param mp The mount point to write to
+ */
+static void
+bench_sequential(xipfs_mount_t *mp)
+{
+    xipfs_file_desc_t desc;
+    size_t off;
+
+    host_mount(mp, 0, FLASHPAGE_NUMOF);
+    CHECK_EQ(xipfs_new_file(mp, "/big", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(mp, &desc, "/big", O_WRONLY, 0), 0);
+    host_nvm_reset();
+    for (off = 0; off < sizeof(data); off += FLASHPAGE_SIZE) {
+        CHECK_EQ(xipfs_write(mp, &desc, &data[off], FLASHPAGE_SIZE),
+                 FLASHPAGE_SIZE);
+    }
+    CHECK_EQ(xipfs_close(mp, &desc), 0);
+    printf("64 KiB sequential write:           %4lu erases, "
+           "%6lu words\n", host_nvm_erases, host_nvm_words);
+}
+
+int
+main(void)
+{
+    xipfs_mount_t mp;
+
+    host_nvm_init(0);
+    host_fill(data, sizeof(data), 2);
+    bench_append(&mp);
+    bench_sequential(&mp);
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Cost of creating fifty files of 100 bytes in five empty
+ * directories, one xipfs_new_file at a time or with a single
+ * xipfs_new_files
+ */
+
+#include <sys/stat.h>
+
+#include "host/host.h"
+
+/**
+ * @internal
+ *
+ * @def BENCH_DIRS
+ *
+ * @brief The number of directories
+ */
+#define BENCH_DIRS 5
+
+/**
+ * @internal
+ *
+ * @def BENCH_FILES
+ *
+ * @brief The number of files created
+ */
+#define BENCH_FILES 50
+
+/**
+ * @internal
+ *
+ * @def BENCH_ROUNDS
+ *
+ * @brief The number of times each variant runs, the time
+ * printed being their mean
+ */
+#define BENCH_ROUNDS 20
+
+static char paths[BENCH_FILES][16];
+
+static xipfs_file_spec_t specs[BENCH_FILES];
+
+/**
+ * @internal
+ *
+ * @brief Formats the flash and creates the empty directories
+ *
+ * @param mp The mount point
+ */
+static void
+setup(xipfs_mount_t *mp)
+{
+    char path[8];
+    size_t i;
+
+    host_mount(mp, 0, FLASHPAGE_NUMOF);
+    for (i = 0; i < BENCH_DIRS; i++) {
+        snprintf(path, sizeof(path), "/d%u", (unsigned)i);
+        CHECK_EQ(xipfs_mkdir(mp, path, 0), 0);
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Runs a variant, checks that every file was created and
+ * prints the mean time per file and the flash counts of a round
+ *
+ * @param what The name of the variant
+ *
+ * @param batch Non-zero to create the files with xipfs_new_files
+ */
+static void
+run(const char *what, int batch)
+{
+    xipfs_mount_t mp;
+    struct stat st;
+    double t, t0;
+    size_t i, r;
+
+    t = 0;
+    for (r = 0; r < BENCH_ROUNDS; r++) {
+        setup(&mp);
+        host_nvm_reset();
+        t0 = host_now();
+        if (batch) {
+            CHECK_EQ(xipfs_new_files(&mp, specs, BENCH_FILES), 0);
+        } else {
+            for (i = 0; i < BENCH_FILES; i++) {
+                CHECK_EQ(xipfs_new_file(&mp, specs[i].path,
+                         specs[i].size, specs[i].exec), 0);
+            }
+        }
+        t += host_now() - t0;
+        for (i = 0; i < BENCH_FILES; i++) {
+            CHECK_EQ(xipfs_stat(&mp, specs[i].path, &st), 0);
+        }
+    }
+    printf("%-20s %6.2f us/file, %3lu erases, %5lu words\n", what,
+           t * 1e6 / (BENCH_ROUNDS * BENCH_FILES), host_nvm_erases,
+           host_nvm_words);
+}
+
+int
+main(void)
+{
+    size_t i;
+
+    host_nvm_init(0);
+    for (i = 0; i < BENCH_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/d%u/f%u",
+                 (unsigned)(i % BENCH_DIRS), (unsigned)i);
+        specs[i].path = paths[i];
+        specs[i].size = 100;
+        specs[i].exec = 0;
+    }
+
+    run("50 x xipfs_new_file", 0);
+    run("xipfs_new_files", 1);
+
+    return 0;
+}
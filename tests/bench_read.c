@@ -0,0 +1,105 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Sequential read throughput of a 64 KiB file, in one call, in
+ * chunks of 256 bytes and one byte at a time
+ */
+
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+
+/**
+ * @internal
+ *
+ * @def BENCH_READ_SIZE
+ *
+ * @brief The size of the file to read
+ */
+#define BENCH_READ_SIZE (64 * 1024)
+
+static unsigned char data[BENCH_READ_SIZE], out[BENCH_READ_SIZE];
+
+/**
+ * @internal
+ *
+ * @brief Reads the file in chunks of the given size and prints
+ * the throughput
+ *
+ * @param mp The mount point holding the file
+ *
+ * @param chunk The size of a chunk
+ */
+static void
+bench_read(xipfs_mount_t *mp, size_t chunk)
+{
+    xipfs_file_desc_t desc;
+    double t0, t1;
+    size_t off;
+
+    (void)memset(out, 0, sizeof(out));
+    CHECK_EQ(xipfs_open(mp, &desc, "/big", O_RDONLY, 0), 0);
+    t0 = host_now();
+    for (off = 0; off < sizeof(out); off += chunk) {
+        CHECK_EQ(xipfs_read(mp, &desc, &out[off], chunk), chunk);
+    }
+    t1 = host_now();
+    CHECK_EQ(xipfs_close(mp, &desc), 0);
+    CHECK(memcmp(out, data, sizeof(out)) == 0);
+    printf("read 64 KiB in %5u byte chunks: %8.1f MB/s\n",
+           (unsigned)chunk, sizeof(out) / (t1 - t0) / 1e6);
+}
+
+int
+main(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+
+    host_nvm_init(0);
+    host_mount(&mp, 0, FLASHPAGE_NUMOF);
+    host_fill(data, sizeof(data), 1);
+    CHECK_EQ(xipfs_new_file(&mp, "/big", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/big", O_WRONLY, 0), 0);
+    CHECK_EQ(xipfs_write(&mp, &desc, data, sizeof(data)), sizeof(data));
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+
+    bench_read(&mp, sizeof(data));
+    bench_read(&mp, 256);
+    bench_read(&mp, 1);
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Cost of removing a one page file placed in front of a 100 KiB
+ * file, whose pages then move down by one page
+ */
+
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+
+/**
+ * @internal
+ *
+ * @def BENCH_LARGE_SIZE
+ *
+ * @brief The size of the file that moves
+ */
+#define BENCH_LARGE_SIZE (100 * 1024)
+
+static unsigned char data[BENCH_LARGE_SIZE], out[BENCH_LARGE_SIZE];
+
+int
+main(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    double t0, t1;
+
+    host_nvm_init(0);
+    host_fill(data, sizeof(data), 3);
+    host_mount(&mp, 0, FLASHPAGE_NUMOF);
+    CHECK_EQ(xipfs_new_file(&mp, "/small", 100, 0), 0);
+    CHECK_EQ(xipfs_new_file(&mp, "/large", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/large", O_WRONLY, 0), 0);
+    CHECK_EQ(xipfs_write(&mp, &desc, data, sizeof(data)), sizeof(data));
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+
+    /* the pages are reclaimed at once, whether the removal
+     * defers it or not */
+    host_nvm_reset();
+    t0 = host_now();
+    CHECK_EQ(xipfs_unlink(&mp, "/small"), 0);
+    CHECK_EQ(xipfs_gc(&mp), 0);
+    t1 = host_now();
+    printf("unlink and reclaim before 100 KiB: %7.2f ms, %3lu erases, "
+           "%6lu words\n", (t1 - t0) * 1e3, host_nvm_erases,
+           host_nvm_words);
+
+    CHECK_EQ(xipfs_open(&mp, &desc, "/large", O_RDONLY, 0), 0);
+    CHECK_EQ(xipfs_read(&mp, &desc, out, sizeof(out)), sizeof(out));
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK(memcmp(out, data, sizeof(out)) == 0);
+
+    return 0;
+}
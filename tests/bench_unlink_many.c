@@ -0,0 +1,197 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Cost of removing eight one page files, each in front of a four
+ * page file, one xipfs_unlink at a time or with a single
+ * xipfs_unlink_many, the pages being reclaimed by the removal or,
+ * with XIPFS_GC_DEFERRED, by the following xipfs_gc
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "host/host.h"
+
+/**
+ * @internal
+ *
+ * @def BENCH_FILES
+ *
+ * @brief The number of files removed
+ */
+#define BENCH_FILES 8
+
+/**
+ * @internal
+ *
+ * @def BENCH_KEPT_SIZE
+ *
+ * @brief The size of the files that are kept and move
+ */
+#define BENCH_KEPT_SIZE (4 * FLASHPAGE_SIZE - sizeof(xipfs_file_t))
+
+static unsigned char data[BENCH_KEPT_SIZE], out[BENCH_KEPT_SIZE];
+
+static char paths[BENCH_FILES][16];
+
+static const char *names[BENCH_FILES];
+
+/**
+ * @internal
+ *
+ * @brief Formats the flash and creates the files removed, each
+ * followed by a file that is kept
+ *
+ * @param mp The mount point
+ */
+static void
+setup(xipfs_mount_t *mp)
+{
+    xipfs_file_desc_t desc;
+    char path[16];
+    size_t i;
+
+    host_mount(mp, 0, FLASHPAGE_NUMOF);
+    for (i = 0; i < BENCH_FILES; i++) {
+        CHECK_EQ(xipfs_new_file(mp, paths[i], 100, 0), 0);
+        snprintf(path, sizeof(path), "/kept%u", (unsigned)i);
+        CHECK_EQ(xipfs_new_file(mp, path, sizeof(data), 0), 0);
+        CHECK_EQ(xipfs_open(mp, &desc, path, O_WRONLY, 0), 0);
+        CHECK_EQ(xipfs_write(mp, &desc, data, sizeof(data)),
+                 sizeof(data));
+        CHECK_EQ(xipfs_close(mp, &desc), 0);
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks that the removed files are gone and that the kept
+ * ones are intact
+ *
+ * @param mp The mount point
+ */
+static void
+check(xipfs_mount_t *mp)
+{
+    xipfs_file_desc_t desc;
+    struct stat st;
+    char path[16];
+    size_t i;
+
+    for (i = 0; i < BENCH_FILES; i++) {
+        CHECK_EQ(xipfs_stat(mp, paths[i], &st), -ENOENT);
+        snprintf(path, sizeof(path), "/kept%u", (unsigned)i);
+        CHECK_EQ(xipfs_open(mp, &desc, path, O_RDONLY, 0), 0);
+        CHECK_EQ(xipfs_read(mp, &desc, out, sizeof(out)), sizeof(out));
+        CHECK_EQ(xipfs_close(mp, &desc), 0);
+        CHECK(memcmp(out, data, sizeof(out)) == 0);
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Prints the cost of a removal and of the xipfs_gc that
+ * follows it
+ *
+ * @param what The name of the removal
+ *
+ * @param t0 The time before the removal
+ *
+ * @param t1 The time after the removal
+ *
+ * @param erases The pages erased by the removal
+ *
+ * @param words The words programmed by the removal
+ *
+ * @param t2 The time after xipfs_gc
+ */
+static void
+report(const char *what, double t0, double t1, unsigned long erases,
+       unsigned long words, double t2)
+{
+    printf("%-14s remove %7.2f ms, %3lu erases, %6lu words; "
+           "gc %7.2f ms, %3lu erases, %6lu words\n", what,
+           (t1 - t0) * 1e3, erases, words, (t2 - t1) * 1e3,
+           host_nvm_erases - erases, host_nvm_words - words);
+}
+
+int
+main(void)
+{
+    unsigned long erases, words;
+    xipfs_mount_t mp;
+    double t0, t1, t2;
+    size_t i;
+
+    host_nvm_init(0);
+    host_fill(data, sizeof(data), 5);
+    for (i = 0; i < BENCH_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/gone%u", (unsigned)i);
+        names[i] = paths[i];
+    }
+    printf("XIPFS_GC_DEFERRED=%d\n", XIPFS_GC_DEFERRED);
+
+    setup(&mp);
+    host_nvm_reset();
+    t0 = host_now();
+    for (i = 0; i < BENCH_FILES; i++) {
+        CHECK_EQ(xipfs_unlink(&mp, names[i]), 0);
+    }
+    t1 = host_now();
+    erases = host_nvm_erases;
+    words = host_nvm_words;
+    CHECK_EQ(xipfs_gc(&mp), 0);
+    t2 = host_now();
+    report("xipfs_unlink", t0, t1, erases, words, t2);
+    check(&mp);
+
+    setup(&mp);
+    host_nvm_reset();
+    t0 = host_now();
+    CHECK_EQ(xipfs_unlink_many(&mp, names, BENCH_FILES), 0);
+    t1 = host_now();
+    erases = host_nvm_erases;
+    words = host_nvm_words;
+    CHECK_EQ(xipfs_gc(&mp), 0);
+    t2 = host_now();
+    report("unlink_many", t0, t1, erases, words, t2);
+    check(&mp);
+
+    return 0;
+}
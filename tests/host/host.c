@@ -0,0 +1,229 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Simulated flash and helpers shared by the host tests and
+ * benchmarks. The flash is mapped at CPU_FLASH_BASE, starts
+ * erased and, like NOR flash, programming can only clear bits
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "host.h"
+
+/**
+ * @internal
+ *
+ * @def HOST_NVM_SIZE
+ *
+ * @brief The size of the simulated flash
+ */
+#define HOST_NVM_SIZE (FLASHPAGE_NUMOF * FLASHPAGE_SIZE)
+
+unsigned long host_nvm_erases;
+unsigned long host_nvm_words;
+
+/**
+ * @internal
+ *
+ * @brief The simulated flash
+ */
+static unsigned char *host_nvm;
+
+/**
+ * @internal
+ *
+ * @brief Non-zero to keep the simulated flash read-only outside
+ * of the erase and program functions, which catches the writes
+ * that do not go through them but slows these functions down
+ */
+static int host_nvm_protect;
+
+/**
+ * @internal
+ *
+ * @brief The mutexes of the mount points of the tests
+ */
+static mutex_t host_mutex, host_execution_mutex;
+
+/**
+ * @internal
+ *
+ * @brief Makes the simulated flash writable or read-only
+ *
+ * @param prot PROT_READ | PROT_WRITE or PROT_READ
+ */
+static void
+host_nvm_set_prot(int prot)
+{
+    if (host_nvm_protect != 0) {
+        if (mprotect(host_nvm, HOST_NVM_SIZE, prot) != 0) {
+            perror("mprotect");
+            abort();
+        }
+    }
+}
+
+void
+host_nvm_init(int protect)
+{
+    void *addr;
+
+    addr = mmap((void *)CPU_FLASH_BASE, HOST_NVM_SIZE,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS |
+        MAP_FIXED, -1, 0);
+    if (addr == MAP_FAILED) {
+        perror("mmap");
+        abort();
+    }
+    host_nvm = addr;
+    (void)memset(host_nvm, FLASHPAGE_ERASE_STATE, HOST_NVM_SIZE);
+    host_nvm_protect = protect;
+    host_nvm_set_prot(PROT_READ);
+}
+
+void
+host_nvm_reset(void)
+{
+    host_nvm_erases = 0;
+    host_nvm_words = 0;
+}
+
+void *
+xipfs_nvm_addr(unsigned page)
+{
+    assert(page < FLASHPAGE_NUMOF);
+
+    return host_nvm + page * FLASHPAGE_SIZE;
+}
+
+unsigned
+xipfs_nvm_page(const void *addr)
+{
+    uintptr_t a = (uintptr_t)addr;
+
+    assert(a >= (uintptr_t)host_nvm);
+    assert(a <= (uintptr_t)host_nvm + HOST_NVM_SIZE);
+
+    return (a - (uintptr_t)host_nvm) / FLASHPAGE_SIZE;
+}
+
+void
+xipfs_nvm_erase(unsigned page)
+{
+    assert(page < FLASHPAGE_NUMOF);
+
+    host_nvm_set_prot(PROT_READ | PROT_WRITE);
+    (void)memset(host_nvm + page * FLASHPAGE_SIZE,
+        FLASHPAGE_ERASE_STATE, FLASHPAGE_SIZE);
+    host_nvm_set_prot(PROT_READ);
+    host_nvm_erases++;
+}
+
+void
+xipfs_nvm_write(void *target_addr, const void *data, size_t len)
+{
+    const unsigned char *src = data;
+    unsigned char *dst = target_addr;
+    size_t i;
+
+    assert((uintptr_t)dst % FLASHPAGE_WRITE_BLOCK_ALIGNMENT == 0);
+    assert((uintptr_t)src % FLASHPAGE_WRITE_BLOCK_ALIGNMENT == 0);
+    assert(len % FLASHPAGE_WRITE_BLOCK_SIZE == 0);
+    assert(dst >= host_nvm && dst + len <= host_nvm + HOST_NVM_SIZE);
+
+    host_nvm_set_prot(PROT_READ | PROT_WRITE);
+    for (i = 0; i < len; i++) {
+        if ((src[i] & ~dst[i]) != 0) {
+            fprintf(stderr, "nvm: bit set at %p without erase "
+                    "(%02x -> %02x)\n", (void *)&dst[i], dst[i],
+                    src[i]);
+            abort();
+        }
+        dst[i] &= src[i];
+    }
+    host_nvm_set_prot(PROT_READ);
+    host_nvm_words += len / FLASHPAGE_WRITE_BLOCK_SIZE;
+}
+
+int
+flashpage_write_and_verify(unsigned page, const void *data)
+{
+    void *addr = xipfs_nvm_addr(page);
+
+    xipfs_nvm_erase(page);
+    xipfs_nvm_write(addr, data, FLASHPAGE_SIZE);
+
+    return memcmp(addr, data, FLASHPAGE_SIZE) == 0 ?
+        FLASHPAGE_OK : FLASHPAGE_NOMATCH;
+}
+
+void
+host_mount(xipfs_mount_t *mp, unsigned first_page, unsigned num)
+{
+    (void)memset(mp, 0, sizeof(*mp));
+    mp->magic = XIPFS_MAGIC;
+    mp->mount_path = "/nvme0p0";
+    mp->page_num = num;
+    mp->page_addr = xipfs_nvm_addr(first_page);
+    mp->mutex = &host_mutex;
+    mp->execution_mutex = &host_execution_mutex;
+    CHECK_EQ(xipfs_format(mp), 0);
+    CHECK_EQ(xipfs_mount(mp), 0);
+}
+
+void
+host_fill(void *buf, size_t len, unsigned seed)
+{
+    unsigned char *p = buf;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        p[i] = (unsigned char)(seed * 131 + i * 7 + (i >> 8));
+    }
+}
+
+double
+host_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,87 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+#ifndef XIPFS_TESTS_HOST_H
+#define XIPFS_TESTS_HOST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "include/xipfs.h"
+
+/**
+ * @def CHECK
+ *
+ * @brief Aborts the program with the location of the failed
+ * condition if c is false
+ */
+#define CHECK(c)                                                  \
+    do {                                                          \
+        if (!(c)) {                                               \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n",          \
+                    __FILE__, __LINE__, #c);                      \
+            abort();                                              \
+        }                                                         \
+    } while (0)
+
+/**
+ * @def CHECK_EQ
+ *
+ * @brief Aborts the program with both values if a is not equal
+ * to b
+ */
+#define CHECK_EQ(a, b)                                            \
+    do {                                                          \
+        long a_ = (long)(a), b_ = (long)(b);                      \
+        if (a_ != b_) {                                           \
+            fprintf(stderr, "%s:%d: %s = %ld, expected %ld\n",    \
+                    __FILE__, __LINE__, #a, a_, b_);              \
+            abort();                                              \
+        }                                                         \
+    } while (0)
+
+/**
+ * @brief The number of pages erased and of words programmed in
+ * the simulated flash since the last host_nvm_reset call
+ */
+extern unsigned long host_nvm_erases;
+extern unsigned long host_nvm_words;
+
+void host_nvm_init(int protect);
+void host_nvm_reset(void);
+void host_mount(xipfs_mount_t *mp, unsigned first_page, unsigned num);
+void host_fill(void *buf, size_t len, unsigned seed);
+double host_now(void);
+
+#endif /* XIPFS_TESTS_HOST_H */
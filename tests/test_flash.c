@@ -0,0 +1,106 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * xipfs_flash_write_unaligned at random offsets and lengths within
+ * a page, from sources of every alignment, checked against a copy
+ * in RAM
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "host/host.h"
+#include "include/flash.h"
+
+/**
+ * @internal
+ *
+ * @def TEST_PAGES
+ *
+ * @brief The number of pages written by a round
+ */
+#define TEST_PAGES (3)
+
+/**
+ * @internal
+ *
+ * @def TEST_ROUNDS
+ *
+ * @brief The number of rounds
+ */
+#define TEST_ROUNDS (2000)
+
+static unsigned char model[TEST_PAGES * FLASHPAGE_SIZE];
+static unsigned char src[FLASHPAGE_SIZE + 8]
+    __attribute__ ((aligned(8)));
+
+int
+main(void)
+{
+    unsigned char *nvm;
+    size_t off, len, shift;
+    unsigned i, round;
+
+    host_nvm_init(1);
+    nvm = xipfs_nvm_addr(0);
+    srand(1);
+    for (round = 0; round < TEST_ROUNDS; round++) {
+        for (i = 0; i < TEST_PAGES; i++) {
+            xipfs_nvm_erase(i);
+        }
+        (void)memset(model, FLASHPAGE_ERASE_STATE, sizeof(model));
+
+        /* short writes within a block, long ones up to a page,
+         * which a write must not cross */
+        len = (round % 4 == 0) ? (size_t)(rand() % 8) + 1 :
+            (size_t)(rand() % FLASHPAGE_SIZE) + 1;
+        off = (size_t)(rand() % TEST_PAGES) * FLASHPAGE_SIZE +
+            (size_t)rand() % (FLASHPAGE_SIZE - len + 1);
+        shift = (size_t)rand() % 8;
+        host_fill(&src[shift], len, round);
+
+        CHECK_EQ(xipfs_flash_write_unaligned(&nvm[off], &src[shift],
+                 len), 0);
+        (void)memcpy(&model[off], &src[shift], len);
+        if (memcmp(nvm, model, sizeof(model)) != 0) {
+            fprintf(stderr, "round %u: offset %zu, length %zu, "
+                    "shift %zu\n", round, off, len, shift);
+            abort();
+        }
+    }
+    printf("%u unaligned writes ok\n", TEST_ROUNDS);
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Removed files: without XIPFS_GC_DEFERRED no file is left marked
+ * as removed once an operation returns, with it the marked files
+ * keep their pages until the garbage collection
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+
+/**
+ * @internal
+ *
+ * @brief Counts the files marked as removed by walking the
+ * linked list of files in flash
+ *
+ * @param mp The mount point
+ *
+ * @return Returns the number of marked files
+ */
+static int
+marked_files(const xipfs_mount_t *mp)
+{
+    const xipfs_file_t *filp;
+    int count;
+
+    count = 0;
+    filp = mp->page_addr;
+    while (filp->next != (void *)UINTPTR_MAX) {
+        if (filp->path[0] == '\0') {
+            count++;
+        }
+        if (filp->next == filp) {
+            break;
+        }
+        filp = filp->next;
+    }
+
+    return count;
+}
+
+/**
+ * @internal
+ *
+ * @brief Creates a file holding bytes derived from a seed
+ *
+ * @param mp The mount point
+ *
+ * @param path The path of the file
+ *
+ * @param seed The seed of the bytes
+ */
+static void
+create(xipfs_mount_t *mp, const char *path, unsigned seed)
+{
+    unsigned char data[3000];
+    xipfs_file_desc_t desc;
+
+    host_fill(data, sizeof(data), seed);
+    CHECK_EQ(xipfs_new_file(mp, path, sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(mp, &desc, path, O_WRONLY, 0), 0);
+    CHECK_EQ(xipfs_write(mp, &desc, data, sizeof(data)),
+             sizeof(data));
+    CHECK_EQ(xipfs_close(mp, &desc), 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Checks the bytes of a file created by create through
+ * an open descriptor
+ *
+ * @param mp The mount point
+ *
+ * @param desc The descriptor of the file
+ *
+ * @param seed The seed of the bytes
+ */
+static void
+check(xipfs_mount_t *mp, xipfs_file_desc_t *desc, unsigned seed)
+{
+    unsigned char data[3000], out[3000];
+
+    host_fill(data, sizeof(data), seed);
+    CHECK_EQ(xipfs_lseek(mp, desc, 0, SEEK_SET), 0);
+    CHECK_EQ(xipfs_read(mp, desc, out, sizeof(out)), sizeof(out));
+    CHECK(memcmp(out, data, sizeof(out)) == 0);
+}
+
+int
+main(void)
+{
+    xipfs_file_desc_t b, c;
+    xipfs_mount_t mp;
+    struct stat st;
+
+    host_nvm_init(1);
+    host_mount(&mp, 0, 32);
+    create(&mp, "/a", 1);
+    create(&mp, "/b", 2);
+    create(&mp, "/c", 3);
+    CHECK_EQ(xipfs_open(&mp, &c, "/c", O_RDONLY, 0), 0);
+
+    /* a removal, and a rename that drops the file marking the
+     * empty directory */
+    CHECK_EQ(xipfs_unlink(&mp, "/a"), 0);
+    CHECK_EQ(xipfs_mkdir(&mp, "/d", 0), 0);
+    CHECK_EQ(xipfs_rename(&mp, "/b", "/d/b"), 0);
+#if XIPFS_GC_DEFERRED == 0
+    CHECK_EQ(marked_files(&mp), 0);
+#else
+    CHECK(marked_files(&mp) > 0);
+    CHECK_EQ(xipfs_close(&mp, &c), 0);
+    CHECK_EQ(xipfs_umount(&mp), 0);
+    CHECK_EQ(xipfs_mount(&mp), 0);
+    CHECK(marked_files(&mp) > 0);
+    CHECK_EQ(xipfs_open(&mp, &c, "/c", O_RDONLY, 0), 0);
+    CHECK_EQ(xipfs_gc(&mp), 0);
+    CHECK_EQ(marked_files(&mp), 0);
+#endif /* XIPFS_GC_DEFERRED == 0 */
+
+    /* the descriptor followed the file */
+    check(&mp, &c, 3);
+    CHECK_EQ(xipfs_close(&mp, &c), 0);
+    CHECK_EQ(xipfs_open(&mp, &b, "/d/b", O_RDONLY, 0), 0);
+    check(&mp, &b, 2);
+    CHECK_EQ(xipfs_close(&mp, &b), 0);
+    CHECK_EQ(xipfs_stat(&mp, "/a", &st), -ENOENT);
+    printf("removed files ok\n");
+
+    return 0;
+}
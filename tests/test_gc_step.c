@@ -0,0 +1,220 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Bounded garbage collection steps over a small removed file in
+ * front of a large one
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+#include "include/fs.h"
+
+/**
+ * @internal
+ *
+ * @def TEST_LARGE_SIZE
+ *
+ * @brief The size of the file behind the removed file
+ */
+#define TEST_LARGE_SIZE (100 * 1024)
+
+static unsigned char data[TEST_LARGE_SIZE], out[TEST_LARGE_SIZE];
+
+/**
+ * @internal
+ *
+ * @brief Creates a one page file followed by a large file
+ *
+ * @param mp The mount point
+ *
+ * @param num The number of pages of the file system
+ */
+static void
+setup(xipfs_mount_t *mp, unsigned num)
+{
+    xipfs_file_desc_t desc;
+
+    host_mount(mp, 0, num);
+    CHECK_EQ(xipfs_new_file(mp, "/small", 100, 0), 0);
+    CHECK_EQ(xipfs_new_file(mp, "/large", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(mp, &desc, "/large", O_WRONLY, 0), 0);
+    CHECK_EQ(xipfs_write(mp, &desc, data, sizeof(data)), sizeof(data));
+    CHECK_EQ(xipfs_close(mp, &desc), 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Marks the small file as removed without reclaiming it,
+ * as the operations of the driver would
+ *
+ * @param mp The mount point
+ */
+static void
+remove_small(xipfs_mount_t *mp)
+{
+    CHECK_EQ(xipfs_fs_remove(mp, xipfs_fs_head(mp)), 0);
+    CHECK_EQ(mp->dead_pages, 1);
+}
+
+/**
+ * @internal
+ *
+ * @brief Reads the large file through a descriptor and checks its
+ * bytes
+ *
+ * @param mp The mount point
+ *
+ * @param desc The descriptor of the file
+ */
+static void
+check(xipfs_mount_t *mp, xipfs_file_desc_t *desc)
+{
+    CHECK_EQ(xipfs_lseek(mp, desc, 0, SEEK_SET), 0);
+    CHECK_EQ(xipfs_read(mp, desc, out, sizeof(out)), sizeof(out));
+    CHECK(memcmp(out, data, sizeof(out)) == 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Every step erases and programs at most max_pages pages,
+ * and the file stays readable through an open descriptor between
+ * two steps
+ *
+ * @param max_pages The maximum number of pages of a step
+ */
+static void
+test_bound(size_t max_pages)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    size_t steps;
+    int ret;
+
+    setup(&mp, FLASHPAGE_NUMOF);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/large", O_RDONLY, 0), 0);
+    remove_small(&mp);
+    steps = 0;
+    do {
+        host_nvm_reset();
+        CHECK((ret = xipfs_gc_step(&mp, max_pages)) >= 0);
+        /* the pages copied, and the header of the removed file
+         * left behind or the mark of a removed copy */
+        CHECK(host_nvm_erases <= max_pages + 1);
+        CHECK(host_nvm_words <= max_pages * FLASHPAGE_SIZE /
+              sizeof(uint32_t) + 2 * sizeof(xipfs_file_t));
+        check(&mp, &desc);
+        CHECK(++steps < 4 * FLASHPAGE_NUMOF);
+    } while (ret > 0);
+    CHECK_EQ(mp.dead_pages, 0);
+    CHECK_EQ(mp.used_pages, (sizeof(data) + sizeof(xipfs_file_t) +
+             FLASHPAGE_SIZE - 1) / FLASHPAGE_SIZE);
+    CHECK(desc.filp == (xipfs_file_t *)mp.page_addr);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    printf("gc steps of %zu pages: %zu steps\n", max_pages, steps);
+}
+
+/**
+ * @internal
+ *
+ * @brief A file created while the large file is being copied is
+ * placed past the copy, and the file system mounts again
+ * between two steps
+ */
+static void
+test_interleaved(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    int ret;
+
+    setup(&mp, FLASHPAGE_NUMOF);
+    remove_small(&mp);
+    CHECK(xipfs_gc_step(&mp, 3) > 0);
+    CHECK(xipfs_fs_new_file(&mp, "/other", 1, 0) != NULL);
+    CHECK(xipfs_gc_step(&mp, 3) > 0);
+    CHECK_EQ(xipfs_mount(&mp), 0);
+    do {
+        CHECK((ret = xipfs_gc_step(&mp, 3)) >= 0);
+    } while (ret > 0);
+    CHECK_EQ(mp.dead_pages, 0);
+    CHECK_EQ(mp.used_pages, (sizeof(data) + sizeof(xipfs_file_t) +
+             FLASHPAGE_SIZE - 1) / FLASHPAGE_SIZE + 1);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/large", O_RDONLY, 0), 0);
+    check(&mp, &desc);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/other", O_RDONLY, 0), 0);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief A step fails when the free pages cannot hold the large
+ * file, which xipfs_gc then moves
+ */
+static void
+test_no_space(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+
+    setup(&mp, 32);
+    remove_small(&mp);
+    CHECK_EQ(xipfs_gc_step(&mp, 1), -ENOSPC);
+    CHECK_EQ(xipfs_gc(&mp), 0);
+    CHECK_EQ(mp.dead_pages, 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/large", O_RDONLY, 0), 0);
+    check(&mp, &desc);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+}
+
+int
+main(void)
+{
+    host_nvm_init(1);
+    host_fill(data, sizeof(data), 12);
+    test_bound(1);
+    test_bound(3);
+    test_interleaved();
+    test_no_space();
+    printf("bounded gc steps ok\n");
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Vectored reads and writes with empty segments, which may have
+ * no base, mixed with the others
+ */
+
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+
+static unsigned char data[300], out[300];
+
+/**
+ * @internal
+ *
+ * @brief Reads the bytes of data back into segments of out mixed
+ * with empty segments
+ *
+ * @param mp The mount point
+ *
+ * @param desc The descriptor to read from
+ *
+ * @param len The number of bytes to read
+ */
+static void
+readv_mixed(xipfs_mount_t *mp, xipfs_file_desc_t *desc, size_t len)
+{
+    xipfs_iovec_t iov[] = {
+        { NULL, 0 }, { out, 4 }, { NULL, 0 }, { NULL, 0 },
+        { out + 4, len - 8 }, { out, 0 }, { out + len - 4, 4 },
+        { NULL, 0 },
+    };
+
+    (void)memset(out, 0, sizeof(out));
+    CHECK_EQ(xipfs_readv(mp, desc, iov, 8), len);
+    CHECK(memcmp(out, data, len) == 0);
+}
+
+int
+main(void)
+{
+    xipfs_iovec_t empty[] = { { NULL, 0 }, { NULL, 0 } };
+    xipfs_iovec_t iov[] = {
+        { NULL, 0 }, { data, 4 }, { NULL, 0 }, { data + 4, 92 },
+        { NULL, 0 }, { data + 96, 4 }, { NULL, 0 },
+    };
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+
+    host_nvm_init(1);
+    host_fill(data, sizeof(data), 22);
+    host_mount(&mp, 0, 16);
+    CHECK_EQ(xipfs_new_file(&mp, "/f", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/f", O_RDWR, 0), 0);
+    CHECK_EQ(xipfs_writev(&mp, &desc, empty, 2), 0);
+    CHECK_EQ(xipfs_writev(&mp, &desc, iov, 7), 100);
+    CHECK_EQ(xipfs_fsync(&mp, &desc, desc.pos), 0);
+    CHECK_EQ(xipfs_lseek(&mp, &desc, 0, SEEK_SET), 0);
+    CHECK_EQ(xipfs_readv(&mp, &desc, empty, 2), 0);
+    readv_mixed(&mp, &desc, 100);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+
+#if XIPFS_PACKED_FILE_MAX > 0
+    CHECK_EQ(xipfs_mkdir(&mp, "/etc", 0), 0);
+    CHECK_EQ(xipfs_new_packed_file(&mp, "/etc/p", data, 40), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/etc/p", O_RDONLY, 0), 0);
+    readv_mixed(&mp, &desc, 40);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+#endif /* XIPFS_PACKED_FILE_MAX > 0 */
+    printf("empty segments ok\n");
+
+    return 0;
+}
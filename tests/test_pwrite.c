@@ -0,0 +1,225 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Writes at an offset: the size of the file is recorded when the
+ * file is closed or synchronised, and O_APPEND does not apply
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "host/host.h"
+
+static unsigned char data[2048], out[2048];
+
+/**
+ * @internal
+ *
+ * @brief Formats the flash and opens a new file of one page
+ *
+ * @param mp The mount point
+ *
+ * @param desc The descriptor to open
+ *
+ * @param flags The flags of the descriptor
+ */
+static void
+new_file(xipfs_mount_t *mp, xipfs_file_desc_t *desc, int flags)
+{
+    host_mount(mp, 0, 16);
+    CHECK_EQ(xipfs_new_file(mp, "/f", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(mp, desc, "/f", flags, 0), 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Returns the size of a file recorded in flash
+ *
+ * @param mp The mount point
+ *
+ * @return Returns the size of the file
+ */
+static off_t
+recorded_size(xipfs_mount_t *mp)
+{
+    struct stat st;
+
+    CHECK_EQ(xipfs_stat(mp, "/f", &st), 0);
+
+    return st.st_size;
+}
+
+/**
+ * @internal
+ *
+ * @brief Writes past the position record no size until the file
+ * is closed, while the descriptor sees them at once
+ */
+static void
+test_close(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    struct stat st;
+    size_t i;
+
+    new_file(&mp, &desc, O_RDWR);
+    for (i = 0; i < 16; i++) {
+        CHECK_EQ(xipfs_pwrite(&mp, &desc, data + i * 64, 64,
+                 (off_t)(i * 64)), 64);
+    }
+    CHECK_EQ(desc.pos, 0);
+    CHECK_EQ(recorded_size(&mp), 0);
+    CHECK_EQ(xipfs_fstat(&mp, &desc, &st), 0);
+    CHECK_EQ(st.st_size, 1024);
+    CHECK_EQ(xipfs_pread(&mp, &desc, out, sizeof(out), 0), 1024);
+    CHECK(memcmp(out, data, 1024) == 0);
+    CHECK_EQ(xipfs_lseek(&mp, &desc, 0, SEEK_END), 1024);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(recorded_size(&mp), 1024);
+    /* a single size slot was used */
+    CHECK_EQ(xipfs_open(&mp, &desc, "/f", O_RDONLY, 0), 0);
+    CHECK(desc.filp->size[0] == 1024);
+    CHECK(desc.filp->size[1] == (xipfs_file_position_t)0xffffffff);
+    CHECK_EQ(xipfs_read(&mp, &desc, out, sizeof(out)), 1024);
+    CHECK(memcmp(out, data, 1024) == 0);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief A sync records the end of the writes past the position
+ * given to it, and a truncation shortens it
+ */
+static void
+test_sync(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+
+    new_file(&mp, &desc, O_RDWR);
+    CHECK_EQ(xipfs_pwrite(&mp, &desc, data, 512, 256), 512);
+    CHECK_EQ(xipfs_fsync(&mp, &desc, desc.pos), 0);
+    CHECK_EQ(recorded_size(&mp), 768);
+    CHECK_EQ(xipfs_pwrite(&mp, &desc, data, 512, 1024), 512);
+    CHECK_EQ(xipfs_ftruncate(&mp, &desc, 1200), 0);
+    CHECK_EQ(recorded_size(&mp), 1200);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(recorded_size(&mp), 1200);
+}
+
+/**
+ * @internal
+ *
+ * @brief Bytes written past the end of the file with pwrite are
+ * read through the same descriptor before any synchronisation,
+ * and moving the position back records them with the position
+ */
+static void
+test_read(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    xipfs_iovec_t iov[2];
+
+    new_file(&mp, &desc, O_RDWR);
+    CHECK_EQ(xipfs_pwrite(&mp, &desc, data, 300, 0), 300);
+    CHECK_EQ(recorded_size(&mp), 0);
+    CHECK_EQ(xipfs_read(&mp, &desc, out, sizeof(out)), 300);
+    CHECK(memcmp(out, data, 300) == 0);
+    CHECK_EQ(xipfs_read(&mp, &desc, out, 1), -EIO);
+    CHECK_EQ(xipfs_lseek(&mp, &desc, 100, SEEK_SET), 100);
+    iov[0].base = out;
+    iov[0].len = 50;
+    iov[1].base = out + 50;
+    iov[1].len = sizeof(out) - 50;
+    CHECK_EQ(xipfs_readv(&mp, &desc, iov, 2), 200);
+    CHECK(memcmp(out, data + 100, 200) == 0);
+
+    /* the position is past the recorded size when it moves back */
+    CHECK_EQ(xipfs_write(&mp, &desc, data, 100), 100);
+    CHECK_EQ(xipfs_pwrite(&mp, &desc, data, 200, 600), 200);
+    CHECK_EQ(xipfs_lseek(&mp, &desc, 0, SEEK_SET), 0);
+    CHECK_EQ(recorded_size(&mp), 800);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(recorded_size(&mp), 800);
+}
+
+/**
+ * @internal
+ *
+ * @brief On a descriptor opened with O_APPEND, the bytes are
+ * written at the offset and the position stays at the end
+ */
+static void
+test_append(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+
+    new_file(&mp, &desc, O_WRONLY);
+    CHECK_EQ(xipfs_write(&mp, &desc, data, 100), 100);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/f", O_WRONLY | O_APPEND, 0), 0);
+    CHECK_EQ(desc.pos, 100);
+    CHECK_EQ(xipfs_pwrite(&mp, &desc, data + 1000, 10, 20), 10);
+    CHECK_EQ(desc.pos, 100);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(recorded_size(&mp), 100);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/f", O_RDONLY, 0), 0);
+    CHECK_EQ(xipfs_read(&mp, &desc, out, 100), 100);
+    CHECK(memcmp(out, data, 20) == 0);
+    CHECK(memcmp(out + 20, data + 1000, 10) == 0);
+    CHECK(memcmp(out + 30, data + 30, 70) == 0);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+}
+
+int
+main(void)
+{
+    host_nvm_init(1);
+    host_fill(data, sizeof(data), 21);
+    test_close();
+    test_sync();
+    test_read();
+    test_append();
+    printf("positioned writes ok\n");
+
+    return 0;
+}
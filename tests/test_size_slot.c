@@ -0,0 +1,223 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Size slots of a file: the used slots form a prefix of size[],
+ * found by binary search, and wrap around to the first slot once
+ * they are all used
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "host/host.h"
+#include "include/buffer.h"
+#include "include/errno.h"
+#include "include/file.h"
+
+/**
+ * @internal
+ *
+ * @brief Counts the used size slots of a file in flash, checking
+ * that they form a prefix of size[]
+ *
+ * @param filp The file
+ *
+ * @return Returns the number of used slots
+ */
+static size_t
+used_slots(const xipfs_file_t *filp)
+{
+    size_t i, used;
+
+    used = 0;
+    while (used < XIPFS_FILESIZE_SLOT_MAX &&
+           filp->size[used] != (xipfs_file_position_t)0xffffffff) {
+        used++;
+    }
+    for (i = used; i < XIPFS_FILESIZE_SLOT_MAX; i++) {
+        CHECK(filp->size[i] == (xipfs_file_position_t)0xffffffff);
+    }
+
+    return used;
+}
+
+/**
+ * @internal
+ *
+ * @brief Opens a new file of two pages and returns its structure
+ *
+ * @param mp The mount point
+ *
+ * @param desc The descriptor to open
+ *
+ * @return Returns the structure of the file
+ */
+static xipfs_file_t *
+new_file(xipfs_mount_t *mp, xipfs_file_desc_t *desc)
+{
+    host_mount(mp, 0, 16);
+    CHECK_EQ(xipfs_new_file(mp, "/f", 2 * FLASHPAGE_SIZE -
+             sizeof(xipfs_file_t), 0), 0);
+    CHECK_EQ(xipfs_open(mp, desc, "/f", O_RDWR, 0), 0);
+
+    return desc->filp;
+}
+
+/**
+ * @internal
+ *
+ * @brief A new file has no used slot, which reads as an empty file
+ */
+static void
+test_new_file(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    xipfs_file_t *filp;
+
+    filp = new_file(&mp, &desc);
+    CHECK_EQ(used_slots(filp), 0);
+    CHECK_EQ(xipfs_file_get_size_(filp), 0);
+}
+
+/**
+ * @internal
+ *
+ * @brief Every slot count from none to all the slots, over three
+ * wrap-arounds, reads back the last size, whether from the
+ * buffer or from flash, and only a wrap-around erases a page
+ */
+static void
+test_wrap_around(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_file_position_t size;
+    xipfs_mount_t mp;
+    xipfs_file_t *filp;
+    size_t i, used;
+
+    filp = new_file(&mp, &desc);
+    used = 0;
+    for (i = 1; i <= 3 * XIPFS_FILESIZE_SLOT_MAX; i++) {
+        size = (xipfs_file_position_t)((i * 97) % (filp->reserved + 1));
+        host_nvm_reset();
+        CHECK_EQ(xipfs_file_set_size(filp, size), 0);
+        if (used == XIPFS_FILESIZE_SLOT_MAX) {
+            /* the first page was rewritten with the new size in
+             * the first slot */
+            used = 1;
+            CHECK_EQ(host_nvm_erases, 1);
+        } else {
+            used++;
+            CHECK_EQ(host_nvm_erases, 0);
+        }
+        CHECK_EQ(xipfs_file_get_size_(filp), size);
+        xipfs_buffer_invalidate();
+        CHECK_EQ(used_slots(filp), used);
+        CHECK_EQ(filp->size[used - 1], size);
+        CHECK_EQ(xipfs_file_get_size_(filp), size);
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief The size may be the reserved size but not more, and a
+ * rejected size leaves the slots unchanged
+ */
+static void
+test_bounds(void)
+{
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    xipfs_file_t *filp;
+
+    filp = new_file(&mp, &desc);
+    CHECK_EQ(xipfs_file_set_size(filp, filp->reserved), 0);
+    CHECK_EQ(xipfs_file_get_size_(filp), filp->reserved);
+    CHECK_EQ(xipfs_file_set_size(filp, filp->reserved + 1), -1);
+    CHECK_EQ(xipfs_errno, XIPFS_EOUTNVM);
+    CHECK_EQ(used_slots(filp), 1);
+    CHECK_EQ(xipfs_file_set_size(filp, 0), 0);
+    CHECK_EQ(xipfs_file_get_size_(filp), 0);
+    CHECK_EQ(used_slots(filp), 2);
+}
+
+/**
+ * @internal
+ *
+ * @brief Sizes recorded by fsync across the wrap-arounds are seen
+ * by fstat, also after a remount
+ */
+static void
+test_fsync(void)
+{
+    unsigned char data[64];
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    struct stat st;
+    size_t i;
+
+    (void)new_file(&mp, &desc);
+    host_fill(data, sizeof(data), 8);
+    for (i = 1; i <= 2 * XIPFS_FILESIZE_SLOT_MAX + 1; i++) {
+        CHECK_EQ(xipfs_write(&mp, &desc, data, 16), 16);
+        CHECK_EQ(xipfs_fsync(&mp, &desc, desc.pos), 0);
+        CHECK_EQ(xipfs_fstat(&mp, &desc, &st), 0);
+        CHECK_EQ(st.st_size, i * 16);
+    }
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(xipfs_umount(&mp), 0);
+    CHECK_EQ(xipfs_mount(&mp), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/f", O_RDONLY, 0), 0);
+    CHECK_EQ(xipfs_fstat(&mp, &desc, &st), 0);
+    CHECK_EQ(st.st_size, (2 * XIPFS_FILESIZE_SLOT_MAX + 1) * 16);
+    CHECK_EQ(used_slots(desc.filp), 1);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+}
+
+int
+main(void)
+{
+    host_nvm_init(1);
+    test_new_file();
+    test_wrap_around();
+    test_bounds();
+    test_fsync();
+    printf("size slots ok\n");
+
+    return 0;
+}
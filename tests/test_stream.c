@@ -0,0 +1,109 @@
+/*******************************************************************************/
+/*  © Université de Lille, The Pip Development Team (2015-2025)                */
+/*  Copyright (C) 2020-2025 Orange                                             */
+/*                                                                             */
+/*  This software is a computer program whose purpose is to run a filesystem   */
+/*  with in-place execution and memory isolation.                              */
+/*                                                                             */
+/*  This software is governed by the CeCILL license under French law and       */
+/*  abiding by the rules of distribution of free software.  You can  use,      */
+/*  modify and/ or redistribute the software under the terms of the CeCILL     */
+/*  license as circulated by CEA, CNRS and INRIA at the following URL          */
+/*  "http://www.cecill.info".                                                  */
+/*                                                                             */
+/*  As a counterpart to the access to the source code and  rights to copy,     */
+/*  modify and redistribute granted by the license, users are provided only    */
+/*  with a limited warranty  and the software's author,  the holder of the     */
+/*  economic rights,  and the successive licensors  have only  limited         */
+/*  liability.                                                                 */
+/*                                                                             */
+/*  In this respect, the user's attention is drawn to the risks associated     */
+/*  with loading,  using,  modifying and/or developing or reproducing the      */
+/*  software by the user in light of its specific status of free software,     */
+/*  that may mean  that it is complicated to manipulate,  and  that  also      */
+/*  therefore means  that it is reserved for developers  and  experienced      */
+/*  professionals having in-depth computer knowledge. Users are therefore      */
+/*  encouraged to load and test the software's suitability as regards their    */
+/*  requirements in conditions enabling the security of their systems and/or   */
+/*  data to be ensured and,  more generally, to use and operate it in the      */
+/*  same conditions as regards security.                                       */
+/*                                                                             */
+/*  The fact that you are presently reading this means that you have had       */
+/*  knowledge of the CeCILL license and that you accept its terms.             */
+/*******************************************************************************/
+
+/*
+ * Writes streamed straight into flash, which keep a trailing
+ * partial write block in RAM, against later writes that overlap
+ * that block
+ */
+
+#include <fcntl.h>
+#include <string.h>
+
+#include "host/host.h"
+
+static unsigned char data[256], out[256];
+
+/**
+ * @internal
+ *
+ * @brief Writes a byte past the start of a write block, then a
+ * few bytes from the previous block over it, and checks that the
+ * file holds the last bytes written
+ *
+ * @param mod The offset of the first byte within its block
+ *
+ * @param back How far before the first byte the second write
+ * starts
+ *
+ * @param len The length of the second write
+ */
+static void
+test_overlap(size_t mod, size_t back, size_t len)
+{
+    unsigned char expected[64];
+    xipfs_file_desc_t desc;
+    xipfs_mount_t mp;
+    size_t off, span;
+
+    host_mount(&mp, 0, 16);
+    CHECK_EQ(xipfs_new_file(&mp, "/f", sizeof(data), 0), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/f", O_RDWR, 0), 0);
+    off = 16 + (mod + XIPFS_NVM_WRITE_BLOCK_SIZE -
+        (uintptr_t)desc.filp->buf % XIPFS_NVM_WRITE_BLOCK_SIZE) %
+        XIPFS_NVM_WRITE_BLOCK_SIZE;
+    (void)memset(expected, 0xff, sizeof(expected));
+    expected[back] = data[0];
+    (void)memcpy(expected, data + 100, len);
+    CHECK_EQ(xipfs_pwrite(&mp, &desc, data, 1, (off_t)off), 1);
+    CHECK_EQ(xipfs_pwrite(&mp, &desc, data + 100, len,
+             (off_t)(off - back)), len);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+    CHECK_EQ(xipfs_open(&mp, &desc, "/f", O_RDONLY, 0), 0);
+    span = (back + 1 > len) ? back + 1 : len;
+    CHECK_EQ(xipfs_pread(&mp, &desc, out, span, (off_t)(off - back)),
+             span);
+    CHECK(memcmp(out, expected, span) == 0);
+    CHECK_EQ(xipfs_close(&mp, &desc), 0);
+}
+
+int
+main(void)
+{
+    size_t mod, back, len;
+
+    host_nvm_init(1);
+    host_fill(data, sizeof(data), 24);
+    for (mod = 0; mod < XIPFS_NVM_WRITE_BLOCK_SIZE; mod++) {
+        for (back = 1; back <= 2 * XIPFS_NVM_WRITE_BLOCK_SIZE; back++) {
+            for (len = 1; len <= back + 2 * XIPFS_NVM_WRITE_BLOCK_SIZE;
+                 len++) {
+                test_overlap(mod, back, len);
+            }
+        }
+    }
+    printf("overlapping streamed writes ok\n");
+
+    return 0;
+}